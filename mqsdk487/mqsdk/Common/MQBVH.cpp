@@ -0,0 +1,677 @@
+﻿//---------------------------------------------------------------------------
+//
+//   MQBVH.cpp
+//
+//		Bounding volume hierarchy over faces of an object
+//
+//    　オブジェクトの面のバウンディングボリューム階層
+//
+//---------------------------------------------------------------------------
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+#include "MQBVH.h"
+#include "MQ3DLib.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MQBVH_USE_SSE
+#include <emmintrin.h>
+#endif
+
+
+// Minimum number of faces processed by one thread
+// 1スレッドで処理する面の最小数
+#define MQBVH_MIN_FACES_PER_THREAD (8192)
+// Minimum number of rays cast by one thread
+// 1スレッドで飛ばすレイの最小数
+#define MQBVH_MIN_RAYS_PER_THREAD (256)
+
+
+// Half of the surface area of a box
+// 箱の表面積の半分
+static float GetHalfArea(const MQBoundingBox& box)
+{
+	MQPoint d = box.maxp - box.minp;
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static float GetAxis(const MQPoint& p, int axis)
+{
+	return (axis == 0) ? p.x : (axis == 1) ? p.y : p.z;
+}
+
+static bool IsTouched(const MQBoundingBox& a, const MQBoundingBox& b)
+{
+	return a.minp.x <= b.maxp.x && b.minp.x <= a.maxp.x &&
+		a.minp.y <= b.maxp.y && b.minp.y <= a.maxp.y &&
+		a.minp.z <= b.maxp.z && b.minp.z <= a.maxp.z;
+}
+
+// Squared distance from a point to a box
+// 点から箱までの距離の2乗
+static float GetBoxDistance2(const MQBoundingBox& box, const MQPoint& p)
+{
+	float dx = (std::max)((std::max)(box.minp.x - p.x, p.x - box.maxp.x), 0.0f);
+	float dy = (std::max)((std::max)(box.minp.y - p.y, p.y - box.maxp.y), 0.0f);
+	float dz = (std::max)((std::max)(box.minp.z - p.z, p.z - box.maxp.z), 0.0f);
+	return dx*dx + dy*dy + dz*dz;
+}
+
+
+//---------------------------------------------------------------------------
+//  MQBVH
+//---------------------------------------------------------------------------
+MQBVH::MQBVH()
+{
+}
+
+void MQBVH::Clear()
+{
+	m_nodes.clear();
+	m_leaf_face.clear();
+	m_pts.clear();
+	m_face_offset.clear();
+	m_face_vert.clear();
+}
+
+//---------------------------------------------------------------------------
+//  MQBVH::Build()
+//     Build the tree.
+//     木を構築する。
+//---------------------------------------------------------------------------
+bool MQBVH::Build(MQObject obj)
+{
+	Clear();
+	if(obj == NULL)
+		return false;
+
+	int vert_num = obj->GetVertexCount();
+	m_pts.resize(vert_num);
+	if(vert_num > 0)
+		obj->GetVertexArray(m_pts.data());
+
+	int face_num = obj->GetFaceCount();
+	m_face_offset.resize(face_num+1);
+	m_face_offset[0] = 0;
+	for(int i=0; i<face_num; i++){
+		m_face_offset[i+1] = m_face_offset[i] + obj->GetFacePointCount(i);
+	}
+	m_face_vert.resize(m_face_offset[face_num]);
+	for(int i=0; i<face_num; i++){
+		if(m_face_offset[i+1] > m_face_offset[i])
+			obj->GetFacePointArray(i, &m_face_vert[m_face_offset[i]]);
+	}
+
+	return BuildTree();
+}
+
+bool MQBVH::Build(const MQPoint *pts, int vert_count, const int *face_offset, const int *face_vert, int face_count)
+{
+	Clear();
+	if(vert_count < 0 || face_count < 0)
+		return false;
+
+	m_pts.assign(pts, pts + vert_count);
+	m_face_offset.assign(face_offset, face_offset + face_count + 1);
+	m_face_vert.assign(face_vert + face_offset[0], face_vert + face_offset[face_count]);
+	if(face_offset[0] != 0){
+		for(int i=0; i<=face_count; i++){
+			m_face_offset[i] -= face_offset[0];
+		}
+	}
+
+	return BuildTree();
+}
+
+void MQBVH::GetFaceBox(int face, MQBoundingBox& box) const
+{
+	const int *vi = GetFacePointArray(face);
+	int num = GetFacePointCount(face);
+	box.minp = box.maxp = m_pts[vi[0]];
+	for(int i=1; i<num; i++){
+		box.expand(m_pts[vi[i]]);
+	}
+}
+
+bool MQBVH::BuildTree()
+{
+	int face_num = GetFaceCount();
+	m_leaf_face.clear();
+	for(int i=0; i<face_num; i++){
+		if(GetFacePointCount(i) >= 3)
+			m_leaf_face.push_back(i);
+	}
+	if(m_leaf_face.empty()){
+		m_nodes.clear();
+		return false;
+	}
+
+	// 面の箱と中心をまとめて求めておく
+	// Calculate boxes and centers of faces in advance.
+	std::vector<MQBoundingBox> face_box(face_num);
+	std::vector<MQPoint> face_center(face_num);
+	MQParallelRange((int)m_leaf_face.size(), 0, MQBVH_MIN_FACES_PER_THREAD, [&](int begin, int end) {
+		for(int i=begin; i<end; i++){
+			int fi = m_leaf_face[i];
+			GetFaceBox(fi, face_box[fi]);
+			face_center[fi] = face_box[fi].getCenter();
+		}
+	});
+
+	struct Task {
+		int node, begin, end, depth;
+	};
+	struct Bin {
+		MQBoundingBox box;
+		int count;
+	};
+	std::vector<Task> tasks;
+	Task root = {0, 0, (int)m_leaf_face.size(), 0};
+	tasks.push_back(root);
+	m_nodes.clear();
+	m_nodes.reserve(m_leaf_face.size() * 2);
+	m_nodes.push_back(Node());
+
+	while(!tasks.empty()){
+		Task task = tasks.back();
+		tasks.pop_back();
+		int count = task.end - task.begin;
+
+		MQBoundingBox box = face_box[m_leaf_face[task.begin]];
+		MQBoundingBox cbox(face_center[m_leaf_face[task.begin]], face_center[m_leaf_face[task.begin]]);
+		for(int i=task.begin+1; i<task.end; i++){
+			int fi = m_leaf_face[i];
+			box.combine(face_box[fi]);
+			cbox.expand(face_center[fi]);
+		}
+		m_nodes[task.node].box = box;
+		m_nodes[task.node].index = task.begin;
+		m_nodes[task.node].count = count;
+		if(count <= 1)
+			continue;
+
+		// 中心の広がりが最も大きい軸で分割する
+		// Split along the axis where centers spread most.
+		MQPoint csize = cbox.getSize();
+		int axis = (csize.x >= csize.y && csize.x >= csize.z) ? 0 : (csize.y >= csize.z) ? 1 : 2;
+		float cmin = GetAxis(cbox.minp, axis);
+		float extent = GetAxis(csize, axis);
+
+		int mid = -1;
+		if(extent > 0.0f && task.depth < MQBVH_MAX_DEPTH){
+			// ビンに分けてSAHが最小となる境界を探す
+			// Put faces into bins and find the boundary with the minimum SAH cost.
+			Bin bins[MQBVH_BIN_NUM];
+			for(int b=0; b<MQBVH_BIN_NUM; b++){
+				bins[b].count = 0;
+			}
+			float scale = MQBVH_BIN_NUM / extent;
+			for(int i=task.begin; i<task.end; i++){
+				int fi = m_leaf_face[i];
+				int b = (std::min)((int)((GetAxis(face_center[fi], axis) - cmin) * scale), MQBVH_BIN_NUM-1);
+				if(bins[b].count++ == 0)
+					bins[b].box = face_box[fi];
+				else
+					bins[b].box.combine(face_box[fi]);
+			}
+
+			float right_cost[MQBVH_BIN_NUM];
+			MQBoundingBox acc;
+			int acc_count = 0;
+			for(int b=MQBVH_BIN_NUM-1; b>0; b--){
+				if(bins[b].count > 0){
+					if(acc_count == 0)
+						acc = bins[b].box;
+					else
+						acc.combine(bins[b].box);
+					acc_count += bins[b].count;
+				}
+				right_cost[b] = (acc_count > 0) ? GetHalfArea(acc) * acc_count : 0.0f;
+			}
+
+			float best_cost = FLT_MAX;
+			int best_bin = -1;
+			acc_count = 0;
+			for(int b=0; b<MQBVH_BIN_NUM-1; b++){
+				if(bins[b].count > 0){
+					if(acc_count == 0)
+						acc = bins[b].box;
+					else
+						acc.combine(bins[b].box);
+					acc_count += bins[b].count;
+				}
+				if(acc_count == 0 || acc_count == count) continue;
+				float cost = GetHalfArea(acc) * acc_count + right_cost[b+1];
+				if(cost < best_cost){
+					best_cost = cost;
+					best_bin = b;
+				}
+			}
+
+			// 分割の費用(走査1+交差判定)が葉のままの費用を下回らなければ葉にする
+			// Keep a leaf if splitting (1 traversal + intersections) does not cost less.
+			if(best_bin >= 0){
+				float area = GetHalfArea(box);
+				if(count <= MQBVH_MAX_LEAF_SIZE && area + best_cost >= area * count)
+					continue;
+				int *first = m_leaf_face.data() + task.begin;
+				int *last = m_leaf_face.data() + task.end;
+				mid = (int)(std::partition(first, last, [&](int fi) {
+					int b = (std::min)((int)((GetAxis(face_center[fi], axis) - cmin) * scale), MQBVH_BIN_NUM-1);
+					return b <= best_bin;
+				}) - m_leaf_face.data());
+			}
+		}
+		if(mid < 0){
+			if(count <= MQBVH_MAX_LEAF_SIZE)
+				continue;
+			// 中心が重なるか深すぎる場合は中央で分ける
+			// Split at the median if centers overlap or the node is too deep.
+			mid = task.begin + count / 2;
+			std::nth_element(m_leaf_face.begin() + task.begin, m_leaf_face.begin() + mid, m_leaf_face.begin() + task.end,
+				[&](int a, int b) { return GetAxis(face_center[a], axis) < GetAxis(face_center[b], axis); });
+		}
+
+		int child = (int)m_nodes.size();
+		m_nodes[task.node].index = child;
+		m_nodes[task.node].count = 0;
+		m_nodes.push_back(Node());
+		m_nodes.push_back(Node());
+		Task left = {child, task.begin, mid, task.depth+1};
+		Task right = {child+1, mid, task.end, task.depth+1};
+		tasks.push_back(right);
+		tasks.push_back(left);
+	}
+
+	return true;
+}
+
+//---------------------------------------------------------------------------
+//  MQBVH::Refit()
+//     Update boxes for moved vertices.
+//     頂点の移動に合わせて箱を更新する。
+//---------------------------------------------------------------------------
+bool MQBVH::Refit(MQObject obj)
+{
+	if(obj == NULL || obj->GetVertexCount() != (int)m_pts.size())
+		return false;
+	if(!m_pts.empty())
+		obj->GetVertexArray(m_pts.data());
+	return Refit(NULL, (int)m_pts.size());
+}
+
+bool MQBVH::Refit(const MQPoint *pts, int vert_count)
+{
+	if(vert_count != (int)m_pts.size())
+		return false;
+	if(pts != NULL && vert_count > 0)
+		std::copy(pts, pts + vert_count, m_pts.begin());
+	if(m_nodes.empty())
+		return true;
+
+	// 葉は互いに独立なので並列に更新する
+	// Leaves are independent of each other, so they are updated in parallel.
+	MQParallelRange((int)m_nodes.size(), 0, MQBVH_MIN_FACES_PER_THREAD / MQBVH_MAX_LEAF_SIZE, [&](int begin, int end) {
+		for(int i=begin; i<end; i++){
+			Node& node = m_nodes[i];
+			if(!node.isLeaf()) continue;
+			GetFaceBox(m_leaf_face[node.index], node.box);
+			for(int j=1; j<node.count; j++){
+				MQBoundingBox box;
+				GetFaceBox(m_leaf_face[node.index + j], box);
+				node.box.combine(box);
+			}
+		}
+	});
+
+	// 子は親より後ろにあるので、逆順にたどれば子が先に更新される
+	// Children are placed after their parent, so reverse order updates children first.
+	for(int i=(int)m_nodes.size()-1; i>=0; i--){
+		Node& node = m_nodes[i];
+		if(node.isLeaf()) continue;
+		node.box = m_nodes[node.index].box;
+		node.box.combine(m_nodes[node.index+1].box);
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------
+//  MQBVH::QueryBox()
+//     Get faces whose boxes touch the box.
+//     箱が接する面を取得する。
+//---------------------------------------------------------------------------
+void MQBVH::QueryBox(const MQBoundingBox& box, std::vector<int>& faces) const
+{
+	faces.clear();
+	Traverse(
+		[&](const Node& node) { return IsTouched(node.box, box); },
+		[&](int face) {
+			MQBoundingBox fbox;
+			GetFaceBox(face, fbox);
+			if(IsTouched(fbox, box))
+				faces.push_back(face);
+		});
+}
+
+//---------------------------------------------------------------------------
+//  MQBVH::GetNearestPointOnTriangle()
+//     Get the nearest point on a triangle.
+//     三角形上の最も近い点を取得する。
+//---------------------------------------------------------------------------
+MQPoint MQBVH::GetNearestPointOnTriangle(const MQPoint& p, const MQPoint& a, const MQPoint& b, const MQPoint& c)
+{
+	// 点がどの頂点、辺、面の領域にあるかで場合分けする
+	// Classify the point by the Voronoi regions of vertices, edges and the face.
+	MQPoint ab = b - a;
+	MQPoint ac = c - a;
+	MQPoint ap = p - a;
+	float d1 = GetInnerProduct(ab, ap);
+	float d2 = GetInnerProduct(ac, ap);
+	if(d1 <= 0.0f && d2 <= 0.0f) return a;
+
+	MQPoint bp = p - b;
+	float d3 = GetInnerProduct(ab, bp);
+	float d4 = GetInnerProduct(ac, bp);
+	if(d3 >= 0.0f && d4 <= d3) return b;
+
+	float vc = d1*d4 - d3*d2;
+	if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f){
+		float v = d1 / (d1 - d3);
+		return a + ab * v;
+	}
+
+	MQPoint cp = p - c;
+	float d5 = GetInnerProduct(ab, cp);
+	float d6 = GetInnerProduct(ac, cp);
+	if(d6 >= 0.0f && d5 <= d6) return c;
+
+	float vb = d5*d2 - d1*d6;
+	if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f){
+		float w = d2 / (d2 - d6);
+		return a + ac * w;
+	}
+
+	float va = d3*d6 - d5*d4;
+	if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f){
+		float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		return b + (c - b) * w;
+	}
+
+	float denom = va + vb + vc;
+	if(denom <= 0.0f){
+		// 縮退した三角形
+		// Degenerate triangle
+		return a;
+	}
+	float v = vb / denom;
+	float w = vc / denom;
+	return a + ab * v + ac * w;
+}
+
+//---------------------------------------------------------------------------
+//  MQBVH::GetNearestFace()
+//     Get the nearest point on faces within maxdis.
+//     Polygons are divided into a fan from the first vertex.
+//     maxdis以内で面上の最も近い点を取得する。
+//     多角形は最初の頂点からの扇形に分割する。
+//---------------------------------------------------------------------------
+int MQBVH::GetNearestFace(const MQPoint& p, float maxdis, MQPoint *nearest, float *distance) const
+{
+	if(m_nodes.empty())
+		return -1;
+
+	float best_dis2 = (maxdis < FLT_MAX) ? maxdis * maxdis : FLT_MAX;
+	int best_face = -1;
+	MQPoint best_pos(0,0,0);
+
+	int stack[MQBVH_STACK_SIZE];
+	int sp = 0;
+	if(GetBoxDistance2(m_nodes[0].box, p) <= best_dis2)
+		stack[sp++] = 0;
+	while(sp > 0){
+		const Node& node = m_nodes[stack[--sp]];
+		if(GetBoxDistance2(node.box, p) > best_dis2) continue;
+
+		if(node.isLeaf()){
+			for(int i=0; i<node.count; i++){
+				int face = m_leaf_face[node.index + i];
+				const int *vi = GetFacePointArray(face);
+				int num = GetFacePointCount(face);
+				for(int j=1; j+1<num; j++){
+					MQPoint q = GetNearestPointOnTriangle(p, m_pts[vi[0]], m_pts[vi[j]], m_pts[vi[j+1]]);
+					float dis2 = (q - p).norm();
+					if(dis2 < best_dis2 || (dis2 == best_dis2 && best_face < 0)){
+						best_dis2 = dis2;
+						best_face = face;
+						best_pos = q;
+					}
+				}
+			}
+		}else{
+			// 近い子を先に調べる
+			// Visit the nearer child first.
+			float dis0 = GetBoxDistance2(m_nodes[node.index].box, p);
+			float dis1 = GetBoxDistance2(m_nodes[node.index+1].box, p);
+			if(dis0 <= dis1){
+				if(dis1 <= best_dis2) stack[sp++] = node.index + 1;
+				if(dis0 <= best_dis2) stack[sp++] = node.index;
+			}else{
+				if(dis0 <= best_dis2) stack[sp++] = node.index;
+				if(dis1 <= best_dis2) stack[sp++] = node.index + 1;
+			}
+		}
+	}
+
+	if(best_face >= 0){
+		if(nearest != NULL) *nearest = best_pos;
+		if(distance != NULL) *distance = sqrtf(best_dis2);
+	}
+	return best_face;
+}
+
+// A ray prepared for slab tests against boxes
+// 箱とのスラブ判定のために準備したレイ
+struct MQBVHRayData {
+	float org[4];
+	float inv[4];
+	float tmin;
+	float tmax;
+
+	MQBVHRayData(const MQBVH::Ray& ray)
+	{
+		// 0除算で無限大やNaNが出ないように、0の成分は十分小さい値に置き換える
+		// Replace zero components with a tiny value to avoid infinity and NaN.
+		const float tiny = 1e-20f;
+		float d[3] = { ray.dir.x, ray.dir.y, ray.dir.z };
+		for(int i=0; i<3; i++){
+			if(fabsf(d[i]) < tiny)
+				d[i] = (d[i] < 0.0f) ? -tiny : tiny;
+			inv[i] = 1.0f / d[i];
+		}
+		inv[3] = 0.0f;
+		org[0] = ray.org.x;
+		org[1] = ray.org.y;
+		org[2] = ray.org.z;
+		org[3] = 0.0f;
+		tmin = ray.tmin;
+		tmax = ray.tmax;
+	}
+};
+
+// Get the distance along the ray where it enters the box, or return false if missed.
+// レイが箱に入る位置までの距離を求める。交差しなければfalseを返す。
+static bool IntersectBox(const MQBoundingBox& box, const MQBVHRayData& ray, float tmax, float& entry)
+{
+#ifdef MQBVH_USE_SSE
+	// minpとmaxpは連続しているので、箱の範囲内だけを読み込む
+	// minp and maxp are contiguous, so only the range of the box is loaded.
+	const float *f = &box.minp.x;
+	__m128 bmin = _mm_loadu_ps(f);
+	__m128 bmax = _mm_loadu_ps(f + 2);
+	bmax = _mm_shuffle_ps(bmax, bmax, _MM_SHUFFLE(3,3,2,1));
+	__m128 org = _mm_loadu_ps(ray.org);
+	__m128 inv = _mm_loadu_ps(ray.inv);
+	__m128 t0 = _mm_mul_ps(_mm_sub_ps(bmin, org), inv);
+	__m128 t1 = _mm_mul_ps(_mm_sub_ps(bmax, org), inv);
+	__m128 tn = _mm_min_ps(t0, t1);
+	__m128 tf = _mm_max_ps(t0, t1);
+
+	// 4番目の要素はレイの範囲に置き換える
+	// Replace the 4th element with the range of the ray.
+	const __m128 mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	tn = _mm_or_ps(_mm_and_ps(mask, tn), _mm_andnot_ps(mask, _mm_set1_ps(ray.tmin)));
+	tf = _mm_or_ps(_mm_and_ps(mask, tf), _mm_andnot_ps(mask, _mm_set1_ps(tmax)));
+	tn = _mm_max_ps(tn, _mm_shuffle_ps(tn, tn, _MM_SHUFFLE(1,0,3,2)));
+	tn = _mm_max_ps(tn, _mm_shuffle_ps(tn, tn, _MM_SHUFFLE(2,3,0,1)));
+	tf = _mm_min_ps(tf, _mm_shuffle_ps(tf, tf, _MM_SHUFFLE(1,0,3,2)));
+	tf = _mm_min_ps(tf, _mm_shuffle_ps(tf, tf, _MM_SHUFFLE(2,3,0,1)));
+	entry = _mm_cvtss_f32(tn);
+	return entry <= _mm_cvtss_f32(tf);
+#else
+	const float *bmin = &box.minp.x;
+	const float *bmax = &box.maxp.x;
+	float tn = ray.tmin;
+	float tf = tmax;
+	for(int i=0; i<3; i++){
+		float t0 = (bmin[i] - ray.org[i]) * ray.inv[i];
+		float t1 = (bmax[i] - ray.org[i]) * ray.inv[i];
+		tn = (std::max)(tn, (std::min)(t0, t1));
+		tf = (std::min)(tf, (std::max)(t0, t1));
+	}
+	entry = tn;
+	return tn <= tf;
+#endif
+}
+
+// Intersect a ray with a triangle in the Moller-Trumbore way. det < 0 means the front side.
+// Moller-Trumbore法でレイと三角形の交差を判定する。det < 0 なら表側。
+static bool IntersectTriangle(const MQPoint& org, const MQPoint& dir, const MQPoint& a, const MQPoint& b, const MQPoint& c,
+	float tmin, float tmax, float& t, float& u, float& v, float& det)
+{
+	MQPoint e1 = b - a;
+	MQPoint e2 = c - a;
+	MQPoint pv = GetCrossProduct(dir, e2);
+	det = GetInnerProduct(e1, pv);
+	if(det == 0.0f)
+		return false;
+	float inv_det = 1.0f / det;
+	MQPoint tv = org - a;
+	u = GetInnerProduct(tv, pv) * inv_det;
+	if(u < 0.0f || u > 1.0f)
+		return false;
+	MQPoint qv = GetCrossProduct(tv, e1);
+	v = GetInnerProduct(dir, qv) * inv_det;
+	if(v < 0.0f || u + v > 1.0f)
+		return false;
+	t = GetInnerProduct(e2, qv) * inv_det;
+	return (t >= tmin && t <= tmax);
+}
+
+//---------------------------------------------------------------------------
+//  MQBVH::RayCast()
+//     Cast a ray and get the nearest hit or any hit.
+//     レイを飛ばして最も近い交点か最初に見つかった交点を取得する。
+//---------------------------------------------------------------------------
+bool MQBVH::RayCast(const Ray& ray, Hit& hit, bool any_hit, bool front_only) const
+{
+	hit.face = -1;
+	hit.tri = 0;
+	hit.t = ray.tmax;
+	hit.u = hit.v = 0.0f;
+	hit.front = false;
+	if(m_nodes.empty() || !(ray.tmin <= ray.tmax))
+		return false;
+
+	MQBVHRayData data(ray);
+	struct Entry {
+		int node;
+		float t;
+	};
+	Entry stack[MQBVH_STACK_SIZE];
+	int sp = 0;
+	float entry;
+	if(!IntersectBox(m_nodes[0].box, data, hit.t, entry))
+		return false;
+	stack[sp].node = 0;
+	stack[sp].t = entry;
+	sp++;
+
+	while(sp > 0){
+		sp--;
+		// 既に見つかった交点より遠い箱は調べない
+		// Skip boxes farther than the hit already found.
+		if(stack[sp].t > hit.t) continue;
+		const Node& node = m_nodes[stack[sp].node];
+
+		if(node.isLeaf()){
+			for(int i=0; i<node.count; i++){
+				int face = m_leaf_face[node.index + i];
+				const int *vi = GetFacePointArray(face);
+				int num = GetFacePointCount(face);
+				for(int j=1; j+1<num; j++){
+					float t, u, v, det;
+					if(!IntersectTriangle(ray.org, ray.dir, m_pts[vi[0]], m_pts[vi[j]], m_pts[vi[j+1]], ray.tmin, hit.t, t, u, v, det))
+						continue;
+					if(front_only && det > 0.0f)
+						continue;
+					if(hit.face >= 0 && t >= hit.t)
+						continue;
+					hit.face = face;
+					hit.tri = j;
+					hit.t = t;
+					hit.u = u;
+					hit.v = v;
+					hit.front = (det < 0.0f);
+					if(any_hit)
+						return true;
+				}
+			}
+		}else{
+			// 近い子を後に積んで先に調べる
+			// Push the nearer child last to visit it first.
+			float entry0, entry1;
+			bool hit0 = IntersectBox(m_nodes[node.index].box, data, hit.t, entry0);
+			bool hit1 = IntersectBox(m_nodes[node.index+1].box, data, hit.t, entry1);
+			if(hit0 && hit1){
+				bool near0 = (entry0 <= entry1);
+				stack[sp].node = near0 ? node.index + 1 : node.index;
+				stack[sp].t = near0 ? entry1 : entry0;
+				sp++;
+				stack[sp].node = near0 ? node.index : node.index + 1;
+				stack[sp].t = near0 ? entry0 : entry1;
+				sp++;
+			}else if(hit0){
+				stack[sp].node = node.index;
+				stack[sp].t = entry0;
+				sp++;
+			}else if(hit1){
+				stack[sp].node = node.index + 1;
+				stack[sp].t = entry1;
+				sp++;
+			}
+		}
+	}
+
+	return (hit.face >= 0);
+}
+
+void MQBVH::RayCastArray(const Ray *rays, int num, Hit *hits, bool any_hit, bool front_only, int thread_num) const
+{
+	MQParallelRange(num, thread_num, MQBVH_MIN_RAYS_PER_THREAD, [&](int begin, int end) {
+		for(int i=begin; i<end; i++){
+			RayCast(rays[i], hits[i], any_hit, front_only);
+		}
+	});
+}
+
+MQPoint MQBVH::GetHitPosition(const Hit& hit) const
+{
+	const int *vi = GetFacePointArray(hit.face);
+	return m_pts[vi[0]] * (1.0f - hit.u - hit.v) + m_pts[vi[hit.tri]] * hit.u + m_pts[vi[hit.tri+1]] * hit.v;
+}
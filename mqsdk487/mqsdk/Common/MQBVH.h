@@ -0,0 +1,145 @@
+﻿//---------------------------------------------------------------------------
+//
+//   MQBVH.h
+//
+//		Bounding volume hierarchy over faces of an object
+//
+//    　オブジェクトの面のバウンディングボリューム階層
+//
+//---------------------------------------------------------------------------
+
+#ifndef _MQBVH_H_
+#define _MQBVH_H_
+
+#include <vector>
+#include "MQPlugin.h"
+#include "MQBoundingBox.h"
+
+// Number of bins to evaluate SAH
+// SAHを評価するビンの数
+#define MQBVH_BIN_NUM (16)
+// Maximum number of faces in a leaf
+// 葉の最大面数
+#define MQBVH_MAX_LEAF_SIZE (8)
+// Nodes deeper than this are split at the median, so the depth never exceeds
+// MQBVH_STACK_SIZE.
+// これより深いノードは中央で分割するので、深さはMQBVH_STACK_SIZEを超えない。
+#define MQBVH_MAX_DEPTH (32)
+#define MQBVH_STACK_SIZE (64)
+
+// Faces are divided by the surface area heuristic (SAH) when the tree is built.
+// Refit() updates only boxes after vertices are moved, and keeps the tree.
+// Faces with less than 3 vertices are not included.
+// 構築時は表面積ヒューリスティック(SAH)で面を分割する。
+// 頂点の移動後はRefit()で木を保ったまま箱だけを更新できる。
+// 3頂点未満の面は含まれない。
+class MQBVH
+{
+public:
+	struct Node {
+		MQBoundingBox box;
+		int index;	// first child if count is 0, or first position in GetLeafFaces()
+		int count;	// number of faces in a leaf, or 0 for an internal node
+
+		bool isLeaf() const { return count > 0; }
+	};
+	struct Ray {
+		MQPoint org;
+		MQPoint dir;	// t is measured in the length of dir
+		float tmin;
+		float tmax;
+	};
+	struct Hit {
+		int face;	// -1 if nothing is hit
+		int tri;	// the hit triangle consists of face vertices 0, tri and tri+1
+		float t;
+		float u, v;	// barycentric weights of face vertices tri and tri+1
+		bool front;	// the ray hits the front side of the face
+	};
+
+	MQBVH();
+
+	// Build the tree from faces of an object
+	// オブジェクトの面から木を構築
+	bool Build(MQObject obj);
+	// Build the tree from faces in CSR arrays. The arrays are copied.
+	// CSR形式の面の配列から木を構築。配列は複製される。
+	bool Build(const MQPoint *pts, int vert_count, const int *face_offset, const int *face_vert, int face_count);
+	// Update boxes for moved vertices. The number of vertices must not change.
+	// 頂点の移動に合わせて箱を更新。頂点数は変わってはいけない。
+	bool Refit(MQObject obj);
+	bool Refit(const MQPoint *pts, int vert_count);
+	void Clear();
+
+	bool IsValid() const { return !m_nodes.empty(); }
+	const MQBoundingBox& GetBoundingBox() const { return m_nodes[0].box; }
+	int GetNodeCount() const { return (int)m_nodes.size(); }
+	const Node& GetNode(int index) const { return m_nodes[index]; }
+	const std::vector<int>& GetLeafFaces() const { return m_leaf_face; }
+	int GetVertexCount() const { return (int)m_pts.size(); }
+	const MQPoint& GetVertex(int index) const { return m_pts[index]; }
+	int GetFaceCount() const { return (int)m_face_offset.size() - 1; }
+	int GetFacePointCount(int face) const { return m_face_offset[face+1] - m_face_offset[face]; }
+	const int *GetFacePointArray(int face) const { return &m_face_vert[m_face_offset[face]]; }
+
+	// Visit nodes from the root. node_func(const Node&) returns false to skip
+	// the node, and face_func(int face) is called for faces in visited leaves.
+	// 根からノードを巡る。node_func(const Node&)がfalseを返すとそのノードを飛ばし、
+	// 巡った葉の面についてface_func(int face)を呼ぶ。
+	template<typename NF, typename FF> void Traverse(NF node_func, FF face_func) const
+	{
+		if(m_nodes.empty()) return;
+		int stack[MQBVH_STACK_SIZE];
+		int sp = 0;
+		stack[sp++] = 0;
+		while(sp > 0){
+			const Node& node = m_nodes[stack[--sp]];
+			if(!node_func(node)) continue;
+			if(node.isLeaf()){
+				for(int i=0; i<node.count; i++){
+					face_func(m_leaf_face[node.index + i]);
+				}
+			}else{
+				stack[sp++] = node.index + 1;
+				stack[sp++] = node.index;
+			}
+		}
+	}
+
+	// Get faces whose boxes touch the box
+	// 箱が接する面を取得
+	void QueryBox(const MQBoundingBox& box, std::vector<int>& faces) const;
+	// Get the nearest point on faces within maxdis. Returns the face index or -1.
+	// maxdis以内で面上の最も近い点を取得。面のインデックスか-1を返す。
+	int GetNearestFace(const MQPoint& p, float maxdis, MQPoint *nearest = NULL, float *distance = NULL) const;
+
+	// Cast a ray and get the nearest hit, or any hit if any_hit is true.
+	// Back sides of faces are ignored if front_only is true.
+	// Polygons are divided into a fan from the first vertex.
+	// レイを飛ばして最も近い交点を取得する。any_hitがtrueなら最初に見つかった交点を返す。
+	// front_onlyがtrueなら面の裏側は無視する。多角形は最初の頂点からの扇形に分割する。
+	bool RayCast(const Ray& ray, Hit& hit, bool any_hit = false, bool front_only = false) const;
+	// Cast many rays with threads. thread_num = 0 uses all cores.
+	// 複数のレイをスレッドで飛ばす。thread_num = 0 で全コアを使う。
+	void RayCastArray(const Ray *rays, int num, Hit *hits, bool any_hit = false, bool front_only = false, int thread_num = 0) const;
+	// Get the hit position
+	// 交点の位置を取得
+	MQPoint GetHitPosition(const Hit& hit) const;
+
+	// Get the nearest point on a triangle
+	// 三角形上の最も近い点を取得
+	static MQPoint GetNearestPointOnTriangle(const MQPoint& p, const MQPoint& a, const MQPoint& b, const MQPoint& c);
+
+private:
+	std::vector<Node> m_nodes;
+	std::vector<int> m_leaf_face;
+	std::vector<MQPoint> m_pts;
+	std::vector<int> m_face_offset;
+	std::vector<int> m_face_vert;
+
+	void GetFaceBox(int face, MQBoundingBox& box) const;
+	bool BuildTree();
+};
+
+
+#endif //_MQBVH_H_
@@ -8,6 +8,11 @@
 #include <algorithm>
 #include "MQBoundingBox.h"
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MQBOUNDINGBOX_USE_SSE
+#include <emmintrin.h>
+#endif
+
 
 MQBoundingBox2::MQBoundingBox2()
 {
@@ -177,6 +182,55 @@ void MQBoundingBox::expand(const MQPoint& p)
 	if(maxp.z < p.z) maxp.z = p.z;
 }
 
+// Expand the box by an array of points. Points including NaN are ignored
+// in the same way as expand(const MQPoint&).
+// 点の配列で箱を広げる。NaNを含む点はexpand(const MQPoint&)と同じく無視される。
+void MQBoundingBox::expand(const MQPoint *p, size_t num)
+{
+#ifdef MQBOUNDINGBOX_USE_SSE
+	if(num == 0) return;
+
+	// 4要素で読み込むので、最後の点以外は次の点のxを4番目に含む。4番目は使わない
+	// Points are loaded as 4 floats, so the 4th element is x of the next point
+	// except for the last point. The 4th element is not used.
+	__m128 vmin0 = _mm_setr_ps(minp.x, minp.y, minp.z, 0.0f);
+	__m128 vmax0 = _mm_setr_ps(maxp.x, maxp.y, maxp.z, 0.0f);
+	__m128 vmin1 = vmin0;
+	__m128 vmax1 = vmax0;
+	size_t i = 0;
+	for(; i+2 < num; i+=2){
+		__m128 p0 = _mm_loadu_ps(&p[i].x);
+		__m128 p1 = _mm_loadu_ps(&p[i+1].x);
+		// _mm_min_ps(a,b)はaがNaNならbを返す
+		// _mm_min_ps(a,b) returns b if a is NaN.
+		vmin0 = _mm_min_ps(p0, vmin0);
+		vmax0 = _mm_max_ps(p0, vmax0);
+		vmin1 = _mm_min_ps(p1, vmin1);
+		vmax1 = _mm_max_ps(p1, vmax1);
+	}
+	for(; i+1 < num; i++){
+		__m128 p0 = _mm_loadu_ps(&p[i].x);
+		vmin0 = _mm_min_ps(p0, vmin0);
+		vmax0 = _mm_max_ps(p0, vmax0);
+	}
+	__m128 last = _mm_setr_ps(p[num-1].x, p[num-1].y, p[num-1].z, 0.0f);
+	vmin0 = _mm_min_ps(last, vmin0);
+	vmax0 = _mm_max_ps(last, vmax0);
+	vmin0 = _mm_min_ps(vmin1, vmin0);
+	vmax0 = _mm_max_ps(vmax1, vmax0);
+
+	float fmin[4], fmax[4];
+	_mm_storeu_ps(fmin, vmin0);
+	_mm_storeu_ps(fmax, vmax0);
+	minp = MQPoint(fmin[0], fmin[1], fmin[2]);
+	maxp = MQPoint(fmax[0], fmax[1], fmax[2]);
+#else
+	for(size_t i=0; i<num; i++){
+		expand(p[i]);
+	}
+#endif
+}
+
 void MQBoundingBox::combine(const MQBoundingBox& box)
 {
 	if(box.isEnabled()){
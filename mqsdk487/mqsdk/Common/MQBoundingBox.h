@@ -48,6 +48,7 @@ struct MQBoundingBox
 	bool			isOverlapped(const MQBoundingBox& box) const;
 	MQBoundingBox	getOverlappedBox(const MQBoundingBox& box) const;
 	void 			expand(const MQPoint& p);
+	void 			expand(const MQPoint *p, size_t num);
 	void			combine(const MQBoundingBox& box);
 	void			inflate(float dx, float dy, float dz);
 };
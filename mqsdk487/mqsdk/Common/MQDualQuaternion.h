@@ -0,0 +1,190 @@
+﻿#pragma once
+
+#ifndef _MQDUALQUATERNION_H_
+#define _MQDUALQUATERNION_H_
+
+#include "MQPlugin.h"
+#include <math.h>
+
+
+// Rigid transform as a dual quaternion (real: rotation, dual: translation).
+// 剛体変換のデュアルクォータニオン表現（実部が回転、双対部が平行移動）
+// Quaternions are stored as x,y,z,w. Matrices follow MQMatrix (row vectors, v*M).
+// クォータニオンは x,y,z,w の順。行列は MQMatrix と同じ行ベクトル形式
+struct MQDualQuaternion
+{
+	float real[4];
+	float dual[4];
+
+	MQDualQuaternion()	{ identify(); }
+	explicit MQDualQuaternion(const MQMatrix& mtx)	{ setMatrix(mtx); }
+
+	void 			identify(void);
+	// Ignores scaling and shearing in 'mtx'.
+	// 拡大縮小とせん断は無視する
+	void 			setMatrix(const MQMatrix& mtx);
+	MQMatrix 		getMatrix(void) const;
+	MQPoint 		getTranslation(void) const;
+	MQPoint 		transform(const MQPoint& p) const;
+	void 			normalize(void);
+
+	// Returns false if 'mtx' contains scaling or shearing beyond 'eps'.
+	// 拡大縮小やせん断を含む場合は false
+	static bool 	isRigid(const MQMatrix& mtx, float eps = 1e-3f);
+
+	// Convert matrices to a packed palette of 8 floats per joint.
+	// 行列を1関節あたり8floatのパレットに変換する
+	static void 	toPalette(const MQMatrix *matrices, size_t num, float *palette);
+};
+
+
+inline void MQDualQuaternion::identify(void)
+{
+	real[0] = real[1] = real[2] = 0.0f;
+	real[3] = 1.0f;
+	dual[0] = dual[1] = dual[2] = dual[3] = 0.0f;
+}
+
+inline void MQDualQuaternion::setMatrix(const MQMatrix& mtx)
+{
+	// Normalize the rows to remove scaling.
+	// 各行を正規化してスケールを取り除く
+	float a[3][3];
+	for(int r=0; r<3; r++){
+		float len = sqrtf(mtx(r,0)*mtx(r,0) + mtx(r,1)*mtx(r,1) + mtx(r,2)*mtx(r,2));
+		float inv = (len > 0.0f) ? 1.0f / len : 0.0f;
+		for(int c=0; c<3; c++)
+			a[r][c] = mtx(r,c) * inv;
+	}
+
+	// Row vector matrix: q rotates v as v*M, so use the transposed element order.
+	// 行ベクトル形式なので転置した添字で取り出す
+	float trace = a[0][0] + a[1][1] + a[2][2];
+	float *q = real;
+	if(trace > 0.0f){
+		float s = sqrtf(trace + 1.0f) * 2.0f;
+		q[3] = 0.25f * s;
+		q[0] = (a[1][2] - a[2][1]) / s;
+		q[1] = (a[2][0] - a[0][2]) / s;
+		q[2] = (a[0][1] - a[1][0]) / s;
+	}else if(a[0][0] > a[1][1] && a[0][0] > a[2][2]){
+		float s = sqrtf(1.0f + a[0][0] - a[1][1] - a[2][2]) * 2.0f;
+		q[3] = (a[1][2] - a[2][1]) / s;
+		q[0] = 0.25f * s;
+		q[1] = (a[1][0] + a[0][1]) / s;
+		q[2] = (a[2][0] + a[0][2]) / s;
+	}else if(a[1][1] > a[2][2]){
+		float s = sqrtf(1.0f + a[1][1] - a[0][0] - a[2][2]) * 2.0f;
+		q[3] = (a[2][0] - a[0][2]) / s;
+		q[0] = (a[1][0] + a[0][1]) / s;
+		q[1] = 0.25f * s;
+		q[2] = (a[2][1] + a[1][2]) / s;
+	}else{
+		float s = sqrtf(1.0f + a[2][2] - a[0][0] - a[1][1]) * 2.0f;
+		q[3] = (a[0][1] - a[1][0]) / s;
+		q[0] = (a[2][0] + a[0][2]) / s;
+		q[1] = (a[2][1] + a[1][2]) / s;
+		q[2] = 0.25f * s;
+	}
+	float len = sqrtf(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+	if(len > 0.0f){
+		q[0] /= len; q[1] /= len; q[2] /= len; q[3] /= len;
+	}
+
+	// dual = 0.5 * (t, 0) * real
+	float tx = mtx._41, ty = mtx._42, tz = mtx._43;
+	dual[0] = 0.5f * ( tx*q[3] + ty*q[2] - tz*q[1]);
+	dual[1] = 0.5f * (-tx*q[2] + ty*q[3] + tz*q[0]);
+	dual[2] = 0.5f * ( tx*q[1] - ty*q[0] + tz*q[3]);
+	dual[3] = 0.5f * (-tx*q[0] - ty*q[1] - tz*q[2]);
+}
+
+inline MQPoint MQDualQuaternion::getTranslation(void) const
+{
+	// t = 2 * dual * conj(real)
+	const float *r = real;
+	const float *d = dual;
+	return MQPoint(
+		2.0f * (-d[3]*r[0] + d[0]*r[3] - d[1]*r[2] + d[2]*r[1]),
+		2.0f * (-d[3]*r[1] + d[0]*r[2] + d[1]*r[3] - d[2]*r[0]),
+		2.0f * (-d[3]*r[2] - d[0]*r[1] + d[1]*r[0] + d[2]*r[3]));
+}
+
+inline MQMatrix MQDualQuaternion::getMatrix(void) const
+{
+	float x = real[0], y = real[1], z = real[2], w = real[3];
+	MQMatrix mtx;
+	mtx._11 = 1.0f - 2.0f*(y*y + z*z);
+	mtx._12 = 2.0f*(x*y + w*z);
+	mtx._13 = 2.0f*(x*z - w*y);
+	mtx._14 = 0.0f;
+	mtx._21 = 2.0f*(x*y - w*z);
+	mtx._22 = 1.0f - 2.0f*(x*x + z*z);
+	mtx._23 = 2.0f*(y*z + w*x);
+	mtx._24 = 0.0f;
+	mtx._31 = 2.0f*(x*z + w*y);
+	mtx._32 = 2.0f*(y*z - w*x);
+	mtx._33 = 1.0f - 2.0f*(x*x + y*y);
+	mtx._34 = 0.0f;
+	MQPoint t = getTranslation();
+	mtx._41 = t.x;
+	mtx._42 = t.y;
+	mtx._43 = t.z;
+	mtx._44 = 1.0f;
+	return mtx;
+}
+
+inline MQPoint MQDualQuaternion::transform(const MQPoint& p) const
+{
+	// p' = p + 2 * cross(r, cross(r, p) + w*p) + t
+	float rx = real[0], ry = real[1], rz = real[2], w = real[3];
+	float cx = ry*p.z - rz*p.y + w*p.x;
+	float cy = rz*p.x - rx*p.z + w*p.y;
+	float cz = rx*p.y - ry*p.x + w*p.z;
+	MQPoint t = getTranslation();
+	return MQPoint(
+		p.x + 2.0f*(ry*cz - rz*cy) + t.x,
+		p.y + 2.0f*(rz*cx - rx*cz) + t.y,
+		p.z + 2.0f*(rx*cy - ry*cx) + t.z);
+}
+
+inline void MQDualQuaternion::normalize(void)
+{
+	float len = sqrtf(real[0]*real[0] + real[1]*real[1] + real[2]*real[2] + real[3]*real[3]);
+	if(len <= 0.0f){
+		identify();
+		return;
+	}
+	float inv = 1.0f / len;
+	for(int i=0; i<4; i++){
+		real[i] *= inv;
+		dual[i] *= inv;
+	}
+}
+
+inline bool MQDualQuaternion::isRigid(const MQMatrix& mtx, float eps)
+{
+	MQPoint r0 = mtx.GetRow3(0);
+	MQPoint r1 = mtx.GetRow3(1);
+	MQPoint r2 = mtx.GetRow3(2);
+	return fabsf(r0.norm() - 1.0f) <= eps
+		&& fabsf(r1.norm() - 1.0f) <= eps
+		&& fabsf(r2.norm() - 1.0f) <= eps
+		&& fabsf(r0.x*r1.x + r0.y*r1.y + r0.z*r1.z) <= eps
+		&& fabsf(r1.x*r2.x + r1.y*r2.y + r1.z*r2.z) <= eps
+		&& fabsf(r2.x*r0.x + r2.y*r0.y + r2.z*r0.z) <= eps;
+}
+
+inline void MQDualQuaternion::toPalette(const MQMatrix *matrices, size_t num, float *palette)
+{
+	for(size_t i=0; i<num; i++){
+		MQDualQuaternion dq(matrices[i]);
+		for(int k=0; k<4; k++){
+			palette[i*8 + k] = dq.real[k];
+			palette[i*8 + 4 + k] = dq.dual[k];
+		}
+	}
+}
+
+
+#endif //_MQDUALQUATERNION_H_
@@ -21,129 +21,191 @@
 #include "MQBoundingBox.h"
 
 
+// Number of vertices in a cell of MQSymmetryGrid on average
+// MQSymmetryGridの1セル当たりの平均頂点数
+#define MQSYMMETRY_POINTS_PER_CELL (4)
+// Minimum number of vertices searched by one thread
+// 1スレッドで探索する頂点の最小数
+#define MQSYMMETRY_MIN_QUERIES_PER_THREAD (4096)
+
 //---------------------------------------------------------------------------
-//  class MQSymmetryLeaf
+//  class MQSymmetryGrid
+//     Hashed uniform grid of vertices folded to the plus side of the axis.
+//     The cell size is decided by the number of vertices and mindis,
+//     so that a cell holds a few vertices and a search looks at 3x3x3 cells at most.
+//     軸のプラス側に折り返した頂点のハッシュ格子。
+//     セルの大きさは頂点数とmindisから決め、1セルに数頂点が入り、
+//     探索では多くても3x3x3セルを調べるようにする。
 //---------------------------------------------------------------------------
-struct MQSymmetryIndex {
-	int index; //index of vertex
-};
-
-class MQSymmetryLeaf
+class MQSymmetryGrid
 {
 public:
-	std::vector<MQSymmetryIndex> tree;
+	MQSymmetryGrid() : m_axis(MQSymmetryTable::AxisX), m_mindis(0.0f), m_cell(1.0f), m_mask(0) { }
 
-	inline void Add(const MQSymmetryIndex& ntree) { tree.push_back(ntree); }
-	void DeleteByTreeIndex(int index);
-	void DeleteByVertexIndex(int index);
-	int Search(const std::vector<MQPoint>& points, const MQPoint& p, float &dis, int &treeindex);
-};
+	void Build(const std::vector<MQPoint>& points, const std::vector<MQSymmetryTable>& table, float mindis, MQSymmetryTable::SymmetryAxis axis);
 
-void MQSymmetryLeaf::DeleteByTreeIndex(int index)
-{
-	if(tree.size() > 0)
-		tree[index] = tree[tree.size()-1];
-	tree.resize(tree.size()-1);
-}
+	// Search the nearest vertex on the side from the mirrored position of v within mindis.
+	// If active is not null, only vertices whose flag is not 0 are searched.
+	// sideの頂点からvの鏡像位置に最も近いmindis以内のものを探す。
+	// activeがnullでなければフラグが0でない頂点だけを探す。
+	int Search(const MQPoint& v, MQSymmetryTable::SymmetrySide side, const std::vector<char> *active) const;
 
-void MQSymmetryLeaf::DeleteByVertexIndex(int index)
-{
-	for(size_t i=0; i<tree.size(); i++){
-		if (tree[i].index == index){
-			tree[i] = tree[tree.size()-1];
-			tree.resize(tree.size()-1);
-			break;
+private:
+	MQSymmetryTable::SymmetryAxis m_axis;
+	float m_mindis;
+	float m_cell;
+	unsigned int m_mask;
+	// A vertex in a bucket. The position and the side are copied for memory locality.
+	// バケット内の頂点。メモリの局所性のために位置と側も複製しておく
+	struct Item {
+		MQPoint p;
+		int index;
+		MQSymmetryTable::SymmetrySide side;
+	};
+	std::vector<int> m_offset; // CSR offsets of buckets
+	std::vector<Item> m_items; // vertices sorted by bucket
+
+	MQPoint Fold(const MQPoint& p) const {
+		switch(m_axis){
+		case MQSymmetryTable::AxisX: return MQPoint(fabsf(p.x), p.y, p.z);
+		case MQSymmetryTable::AxisY: return MQPoint(p.x, fabsf(p.y), p.z);
+		case MQSymmetryTable::AxisZ: return MQPoint(p.x, p.y, fabsf(p.z));
 		}
+		return p;
 	}
-}
+	long long GetCell(float v) const {
+		return (long long)floor((double)v / m_cell);
+	}
+	unsigned int GetBucket(long long ix, long long iy, long long iz) const {
+		unsigned long long h = (unsigned long long)ix * 73856093ULL
+			^ (unsigned long long)iy * 19349663ULL
+			^ (unsigned long long)iz * 83492791ULL;
+		return (unsigned int)(h ^ (h >> 32)) & m_mask;
+	}
+};
 
-int MQSymmetryLeaf::Search(const std::vector<MQPoint>& points, const MQPoint& p, float &dis, int &treeindex)
+void MQSymmetryGrid::Build(const std::vector<MQPoint>& points, const std::vector<MQSymmetryTable>& table, float mindis, MQSymmetryTable::SymmetryAxis axis)
 {
-	float dis2 = dis*dis;
-	int minvi = -1;
-	size_t count = tree.size();
+	m_axis = axis;
+	m_mindis = mindis;
 
-	for(size_t i=0; i<count; i++)
-	{
-		int cvi = tree[i].index;
-		if(cvi < 0) continue;
-		MQPoint dv = points[cvi] - p;
-		float cdis = dv.x*dv.x + dv.y*dv.y + dv.z*dv.z;
-		if(cdis <= dis2) {
-			treeindex = (int)i;
-			minvi = cvi;
-			dis2 = cdis;
-		}
+	int vc = (int)points.size();
+	int num = 0;
+	MQBoundingBox box;
+	box.init();
+	for(int i=0; i<vc; i++){
+		if(table[i].IsNoneOrCenter()) continue;
+		box.expand(Fold(points[i]));
+		num++;
 	}
 
-	if(minvi >= 0)
-		dis = sqrtf(dis2);
-	return minvi;
-}
-
-#define OVSEGX 4
-#define OVSEGY 8
-#define OVSEGZ 8
-
-//---------------------------------------------------------------------------
-//  class MQSymmetryTree
-//---------------------------------------------------------------------------
-class MQSymmetryTree {
-private:
-	MQSymmetryLeaf left[OVSEGX*OVSEGY*OVSEGZ];
-	MQSymmetryLeaf right[OVSEGX*OVSEGY*OVSEGZ];
-
-	inline int getIndex(int ix, int iy, int iz) {
-		return ix + iy*OVSEGX + iz*OVSEGX*OVSEGY;
-	}
-	inline MQSymmetryLeaf *GetLeft(int ix, int iy, int iz) {
-		return &left[getIndex(ix,iy,iz)];
+	// 平らな形状でも1セルの頂点数が変わらないように、幅のある軸だけで体積を求める
+	// Calculate the volume with only axes that have a width, so that flat shapes
+	// have the same number of vertices in a cell.
+	m_cell = mindis;
+	if(num > 0){
+		MQPoint size = box.maxp - box.minp;
+		float maxsize = std::max(size.x, std::max(size.y, size.z));
+		double volume = 1.0;
+		int dim = 0;
+		for(int k=0; k<3; k++){
+			float w = size.index(k);
+			if(w > maxsize * 1e-6f){
+				volume *= w;
+				dim++;
+			}
+		}
+		if(dim > 0){
+			double cells = std::max(1.0, (double)num / MQSYMMETRY_POINTS_PER_CELL);
+			m_cell = std::max(m_cell, (float)pow(volume / cells, 1.0 / dim));
+		}
+		m_cell = std::max(m_cell, maxsize * 1e-6f);
 	}
-	inline MQSymmetryLeaf *GetRight(int ix, int iy, int iz) {
-		return &right[getIndex(ix,iy,iz)];
+	if(!(m_cell > 0.0f))
+		m_cell = 1.0f;
+
+	unsigned int bucket_num = 1;
+	while(bucket_num < (unsigned int)num && bucket_num < 0x40000000u)
+		bucket_num <<= 1;
+	m_mask = bucket_num - 1;
+
+	// セルの計算は並列に、並べ替えは頂点番号順に行う
+	// Calculate cells in parallel, and sort in order of the vertex index.
+	std::vector<unsigned int> bucket(vc);
+	MQParallelRange(vc, 0, MQSYMMETRY_MIN_QUERIES_PER_THREAD, [&](int begin, int end) {
+		for(int i=begin; i<end; i++){
+			if(table[i].IsNoneOrCenter()) continue;
+			MQPoint f = Fold(points[i]);
+			bucket[i] = GetBucket(GetCell(f.x), GetCell(f.y), GetCell(f.z));
+		}
+	});
+	m_offset.assign(bucket_num+1, 0);
+	for(int i=0; i<vc; i++){
+		if(!table[i].IsNoneOrCenter())
+			m_offset[bucket[i]+1]++;
 	}
-	bool GetSymmetryBoundingBox(const std::vector<MQPoint>& points, MQBoundingBox& box, MQPoint& boxsize);
-
-public:
-
-	MQSymmetryTree() {
-		for(int i=0; i<OVSEGX*OVSEGY*OVSEGZ; i++) {
-			//left[i].tree.resize(16);
-			//right[i].tree.resize(16);
+	for(unsigned int n=0; n<bucket_num; n++)
+		m_offset[n+1] += m_offset[n];
+	m_items.resize(num);
+	std::vector<int> fill(m_offset.begin(), m_offset.end()-1);
+	for(int i=0; i<vc; i++){
+		if(!table[i].IsNoneOrCenter()){
+			Item& item = m_items[fill[bucket[i]]++];
+			item.p = points[i];
+			item.index = i;
+			item.side = table[i].side;
 		}
 	}
-	int CreateTable(const std::vector<MQPoint>& points, std::vector<MQSymmetryTable>& table, const std::vector<bool> *apply, float mindis, MQSymmetryTable::SymmetryAxis axis);
-};
-
+}
 
-bool MQSymmetryTree::GetSymmetryBoundingBox(const std::vector<MQPoint>& points, MQBoundingBox& box, MQPoint& boxsize)
+int MQSymmetryGrid::Search(const MQPoint& v, MQSymmetryTable::SymmetrySide side, const std::vector<char> *active) const
 {
-	float box_x;
+	if(m_items.empty())
+		return -1;
 
-	box.init();
+	MQPoint f = Fold(v);
+	MQPoint sv = MQSymmetryTable::Symmetry(v, m_axis);
+	long long ix1 = GetCell(f.x - m_mindis), ix2 = GetCell(f.x + m_mindis);
+	long long iy1 = GetCell(f.y - m_mindis), iy2 = GetCell(f.y + m_mindis);
+	long long iz1 = GetCell(f.z - m_mindis), iz2 = GetCell(f.z + m_mindis);
 
-	size_t num = points.size();
-	for(size_t i=0; i<num; i++){
-		if(points[i].x != FLT_MAX)
-			box.expand(points[i]);
+	float dis2 = m_mindis * m_mindis;
+	int minvi = -1;
+	for(long long z=iz1; z<=iz2; z++){
+		for(long long y=iy1; y<=iy2; y++){
+			for(long long x=ix1; x<=ix2; x++){
+				unsigned int bi = GetBucket(x, y, z);
+				for(int n=m_offset[bi]; n<m_offset[bi+1]; n++){
+					const Item& item = m_items[n];
+					if(item.side != side) continue;
+					int cvi = item.index;
+					if(active != nullptr && !(*active)[cvi]) continue;
+					MQPoint dv = item.p - sv;
+					float cdis = dv.x*dv.x + dv.y*dv.y + dv.z*dv.z;
+					// 同じ距離なら頂点番号の小さい方を選ぶ
+					// Select the smaller vertex index for the same distance.
+					if(cdis < dis2 || (cdis == dis2 && (minvi < 0 || cvi < minvi))){
+						minvi = cvi;
+						dis2 = cdis;
+					}
+				}
+			}
+		}
 	}
-	if(!box.isEnabled() || box.maxp.x<0 || box.minp.x>0)
-		return false;
-	box_x = std::max(box.maxp.x, -box.minp.x);
-	box.minp.x = -box_x;
-	box.maxp.x = box_x;
-	boxsize.x = box_x * 2;
-	boxsize.y = box.maxp.y - box.minp.y;
-	boxsize.z = box.maxp.z - box.minp.z;
-
-	return true;
+	return minvi;
 }
 
 
 //---------------------------------------------------------------------------
-//  MQSymmetryTree::CreateTable
+//  CreateSymmetryTable
+//     Vertices are paired in order of the vertex index with the nearest
+//     candidate on the other side. The nearest candidates in all vertices
+//     are searched in parallel first, and searched again only when the
+//     candidate has already been paired.
+//     頂点番号の順に反対側の最も近い候補と対にする。先に全頂点の最近傍を
+//     並列に探しておき、その候補が既に対になっていた場合だけ探し直す。
 //---------------------------------------------------------------------------
-int MQSymmetryTree::CreateTable(const std::vector<MQPoint>& points, std::vector<MQSymmetryTable>& table, const std::vector<bool> *apply, float mindis, MQSymmetryTable::SymmetryAxis axis)
+static int CreateSymmetryTable(const std::vector<MQPoint>& points, std::vector<MQSymmetryTable>& table, const std::vector<bool> *apply, float mindis, MQSymmetryTable::SymmetryAxis axis)
 // return: count of pair of symmetry vertices
 {
 	size_t vc = points.size();
@@ -156,216 +218,76 @@ int MQSymmetryTree::CreateTable(const std::vector<MQPoint>& points, std::vector<
 	}
 
 	const float zero_err = std::max(mindis * (float)1e-6, (float)1e-6);
-	switch(axis){
-	case MQSymmetryTable::AxisX:
-		for(i=0; i<vc; i++){
-			if(points[i].x == FLT_MAX){
-				table[i].side = MQSymmetryTable::SideNone;
-			}else{
-				if(points[i].x > zero_err)
-					table[i].side = MQSymmetryTable::SidePlus;
-				else if(points[i].x <-zero_err)
-					table[i].side = MQSymmetryTable::SideMinus;
-				else
-					table[i].side = MQSymmetryTable::SideCenter;
-			}
-		}
-		break;
-	case MQSymmetryTable::AxisY:
-		for(i=0; i<vc; i++){
-			if(points[i].x == FLT_MAX){
-				table[i].side = MQSymmetryTable::SideNone;
-			}else{
-				if(points[i].y > zero_err)
-					table[i].side = MQSymmetryTable::SidePlus;
-				else if(points[i].y <-zero_err)
-					table[i].side = MQSymmetryTable::SideMinus;
-				else
-					table[i].side = MQSymmetryTable::SideCenter;
-			}
+	bool plus_exists = false, minus_exists = false;
+	for(i=0; i<vc; i++){
+		if(points[i].x == FLT_MAX){
+			table[i].side = MQSymmetryTable::SideNone;
+			continue;
 		}
-		break;
-	case MQSymmetryTable::AxisZ:
-		for(i=0; i<vc; i++){
-			if(points[i].x == FLT_MAX){
-				table[i].side = MQSymmetryTable::SideNone;
-			}else{
-				if(points[i].z > zero_err)
-					table[i].side = MQSymmetryTable::SidePlus;
-				else if(points[i].z <-zero_err)
-					table[i].side = MQSymmetryTable::SideMinus;
-				else
-					table[i].side = MQSymmetryTable::SideCenter;
-			}
+		float d = points[i].index((int)axis);
+		if(d > zero_err){
+			table[i].side = MQSymmetryTable::SidePlus;
+			plus_exists = true;
+		}else if(d < -zero_err){
+			table[i].side = MQSymmetryTable::SideMinus;
+			minus_exists = true;
+		}else{
+			table[i].side = MQSymmetryTable::SideCenter;
 		}
-		break;
 	}
-
-	// get boundind-box
-	MQPoint boxsize;
-	MQBoundingBox box;
-	if( !GetSymmetryBoundingBox(points, box, boxsize) )
+	if(!plus_exists || !minus_exists)
 		return 0;
 
-	MQPoint axisboxsize;
-	switch(axis){
-	case MQSymmetryTable::AxisX: axisboxsize = MQPoint(box.maxp.x, boxsize.y, boxsize.z); break;
-	case MQSymmetryTable::AxisY: axisboxsize = MQPoint(boxsize.x, box.maxp.y, boxsize.z); break;
-	case MQSymmetryTable::AxisZ: axisboxsize = MQPoint(boxsize.x, boxsize.y, box.maxp.z); break;
-	}
+	MQSymmetryGrid grid;
+	grid.Build(points, table, mindis, axis);
 
-	float cdis;
-	int ix1,ix2,iy1,iy2,iz1,iz2;
+	// 候補: 選択されていない頂点(applyがnullなら全頂点)
+	// Candidates: unselected vertices (all vertices if apply is null)
+	std::vector<char> active(vc, 0);
+	std::vector<int> query;
+	for(i=0; i<vc; i++){
+		if(table[i].IsNoneOrCenter()) continue;
+		if(apply == nullptr || !(*apply)[i])
+			active[i] = 1;
+		if(apply == nullptr || (*apply)[i])
+			query.push_back((int)i);
+	}
 
-	// register unselected vertices
-	for(i=0; i<vc; i++)
-	{
-		if(points[i].x == FLT_MAX) continue;
-		if(apply != nullptr && (*apply)[i]) continue;
-
-		const MQPoint& v = points[i];
-		MQSymmetryIndex ot;
-		ot.index = (int)i;
-
-		MQPoint segp;
-		switch(axis){
-		case MQSymmetryTable::AxisX: segp = MQPoint(fabsf(v.x), v.y-box.minp.y, v.z-box.minp.z); break;
-		case MQSymmetryTable::AxisY: segp = MQPoint(v.x-box.minp.x, fabsf(v.y), v.z-box.minp.z); break;
-		case MQSymmetryTable::AxisZ: segp = MQPoint(v.x-box.minp.x, v.y-box.minp.y, fabsf(v.z)); break;
+	// 候補になり得る全頂点から最近傍をまとめて探す
+	// Search the nearest vertices from all possible candidates at once.
+	std::vector<int> nearest(query.size());
+	MQParallelRange((int)query.size(), 0, MQSYMMETRY_MIN_QUERIES_PER_THREAD, [&](int begin, int end) {
+		for(int n=begin; n<end; n++){
+			int vi = query[n];
+			MQSymmetryTable::SymmetrySide other = (table[vi].side == MQSymmetryTable::SidePlus) ? MQSymmetryTable::SideMinus : MQSymmetryTable::SidePlus;
+			nearest[n] = grid.Search(points[vi], other, nullptr);
 		}
-		switch(table[i].side){
-		case MQSymmetryTable::SidePlus:
-			ix1 = (axisboxsize.x > 0) ? std::max(0,std::min(OVSEGX-1,(int)(segp.x/axisboxsize.x*(float)OVSEGX))) : 0;
-			iy1 = (axisboxsize.y > 0) ? std::max(0,std::min(OVSEGY-1,(int)(segp.y/axisboxsize.y*(float)OVSEGY))) : 0;
-			iz1 = (axisboxsize.z > 0) ? std::max(0,std::min(OVSEGZ-1,(int)(segp.z/axisboxsize.z*(float)OVSEGZ))) : 0;
-			GetLeft(ix1,iy1,iz1)->Add(ot);
-			break;
-		case MQSymmetryTable::SideMinus:
-			ix1 = (axisboxsize.x > 0) ? std::max(0,std::min(OVSEGX-1,(int)(segp.x/axisboxsize.x*(float)OVSEGX))) : 0;
-			iy1 = (axisboxsize.y > 0) ? std::max(0,std::min(OVSEGY-1,(int)(segp.y/axisboxsize.y*(float)OVSEGY))) : 0;
-			iz1 = (axisboxsize.z > 0) ? std::max(0,std::min(OVSEGZ-1,(int)(segp.z/axisboxsize.z*(float)OVSEGZ))) : 0;
-			GetRight(ix1,iy1,iz1)->Add(ot);
-			break;
-		}
-	}
+	});
 
-	for(i=0; i<vc; i++)
+	for(size_t n=0; n<query.size(); n++)
 	{
-		if(points[i].x == FLT_MAX) continue;
-
-		if((apply != nullptr && !(*apply)[i]) || table[i].IsNoneOrCenter() || table[i].index!=-1)
+		int vi = query[n];
+		if(table[vi].index != -1)
 			continue;
 
-		const MQPoint& v = points[i];
-		MQPoint segp;
-		switch(axis){
-		case MQSymmetryTable::AxisX: segp = MQPoint(fabs(v.x), v.y-box.minp.y, v.z-box.minp.z); break;
-		case MQSymmetryTable::AxisY: segp = MQPoint(v.x-box.minp.x, fabs(v.y), v.z-box.minp.z); break;
-		case MQSymmetryTable::AxisZ: segp = MQPoint(v.x-box.minp.x, v.y-box.minp.y, fabs(v.z)); break;
-		}
-
-		if(axisboxsize.x > 0){
-			ix1 = std::max(0, (int)((segp.x-mindis)/axisboxsize.x*(float)OVSEGX));
-			ix2 = std::min(OVSEGX-1, (int)((segp.x+mindis)/axisboxsize.x*(float)OVSEGX));
-		}else{
-			ix1 = ix2 = 0;
-		}
-		if(axisboxsize.y > 0){
-			iy1 = std::max(0, (int)((segp.y-mindis)/axisboxsize.y*(float)OVSEGY));
-			iy2 = std::min(OVSEGY-1, (int)((segp.y+mindis)/axisboxsize.y*(float)OVSEGY));
-		}else{
-			iy1 = iy2 = 0;
-		}
-		if(axisboxsize.z > 0){
-			iz1 = std::max(0, (int)((segp.z-mindis)/axisboxsize.z*(float)OVSEGZ));
-			iz2 = std::min(OVSEGZ-1, (int)((segp.z+mindis)/axisboxsize.z*(float)OVSEGZ));
-		}else{
-			iz1 = iz2 = 0;
+		// 最近傍が候補から外れていれば、残っている候補から探し直す
+		// Search again from the remaining candidates if the nearest one was removed.
+		int minvi = nearest[n];
+		if(minvi >= 0 && !active[minvi]){
+			MQSymmetryTable::SymmetrySide other = (table[vi].side == MQSymmetryTable::SidePlus) ? MQSymmetryTable::SideMinus : MQSymmetryTable::SidePlus;
+			minvi = grid.Search(points[vi], other, &active);
 		}
 
-		cdis = mindis;
-		int minvi = -1;
-		int mintreeindex = -1;
-		MQSymmetryLeaf *mintree = nullptr;
-
-		switch(table[i].side) {
-		case MQSymmetryTable::SidePlus:
-			for(int z=iz1; z<=iz2; z++){
-				for(int y=iy1; y<=iy2; y++){
-					for(int x=ix1; x<=ix2; x++){
-						int treeindex;
-						int cvi = GetRight(x,y,z)->Search(points, MQSymmetryTable::Symmetry(v, axis), cdis, treeindex);
-						if(cvi >= 0){
-							minvi = cvi;
-							mintreeindex = treeindex;
-							mintree = GetRight(x,y,z);
-						}
-					}
-				}
-			}
-			if(minvi >= 0){
-				// 対が見つかった
-				table[i].index = minvi;
-				table[minvi].index = (int)i;
-				mintree->DeleteByTreeIndex(mintreeindex);
-				if(apply == nullptr){
-					ix1 = (axisboxsize.x > 0) ? std::max(0,std::min(OVSEGX-1,(int)(segp.x/axisboxsize.x*(float)OVSEGX))) : 0;
-					iy1 = (axisboxsize.y > 0) ? std::max(0,std::min(OVSEGY-1,(int)(segp.y/axisboxsize.y*(float)OVSEGY))) : 0;
-					iz1 = (axisboxsize.z > 0) ? std::max(0,std::min(OVSEGZ-1,(int)(segp.z/axisboxsize.z*(float)OVSEGZ))) : 0;
-					GetLeft(ix1,iy1,iz1)->DeleteByVertexIndex((int)i);
-				}
-				pairc++;
-			}else{
-				// 見つからないので候補に登録しておく
-				if(apply != nullptr){
-					MQSymmetryIndex ot;
-					ot.index = (int)i;
-					ix1 = (axisboxsize.x > 0) ? std::max(0,std::min(OVSEGX-1,(int)(segp.x/axisboxsize.x*(float)OVSEGX))) : 0;
-					iy1 = (axisboxsize.y > 0) ? std::max(0,std::min(OVSEGY-1,(int)(segp.y/axisboxsize.y*(float)OVSEGY))) : 0;
-					iz1 = (axisboxsize.z > 0) ? std::max(0,std::min(OVSEGZ-1,(int)(segp.z/axisboxsize.z*(float)OVSEGZ))) : 0;
-					GetLeft(ix1,iy1,iz1)->Add(ot);
-				}
-			}
-			break;
-
-		case MQSymmetryTable::SideMinus:
-			for(int z=iz1; z<=iz2; z++){
-				for(int y=iy1; y<=iy2; y++){
-					for(int x=ix1; x<=ix2; x++){
-						int treeindex;
-						int cvi = GetLeft(x,y,z)->Search(points, MQSymmetryTable::Symmetry(v, axis), cdis, treeindex);
-						if(cvi >= 0){
-							minvi = cvi;
-							mintreeindex = treeindex;
-							mintree = GetLeft(x,y,z);
-						}
-					}
-				}
-			}
-			if(minvi >= 0){
-				// 対が見つかった
-				table[i].index = minvi;
-				table[minvi].index = (int)i;
-				mintree->DeleteByTreeIndex(mintreeindex);
-				if(apply == nullptr){
-					ix1 = (axisboxsize.x > 0) ? std::max(0,std::min(OVSEGX-1,(int)(segp.x/axisboxsize.x*(float)OVSEGX))) : 0;
-					iy1 = (axisboxsize.y > 0) ? std::max(0,std::min(OVSEGY-1,(int)(segp.y/axisboxsize.y*(float)OVSEGY))) : 0;
-					iz1 = (axisboxsize.z > 0) ? std::max(0,std::min(OVSEGZ-1,(int)(segp.z/axisboxsize.z*(float)OVSEGZ))) : 0;
-					GetRight(ix1,iy1,iz1)->DeleteByVertexIndex((int)i);
-				}
-				pairc++;
-			}else{
-				// 見つからないので候補に登録しておく
-				if(apply != nullptr){
-					MQSymmetryIndex ot;
-					ot.index = (int)i;
-					ix1 = (axisboxsize.x > 0) ? std::max(0,std::min(OVSEGX-1,(int)(segp.x/axisboxsize.x*(float)OVSEGX))) : 0;
-					iy1 = (axisboxsize.y > 0) ? std::max(0,std::min(OVSEGY-1,(int)(segp.y/axisboxsize.y*(float)OVSEGY))) : 0;
-					iz1 = (axisboxsize.z > 0) ? std::max(0,std::min(OVSEGZ-1,(int)(segp.z/axisboxsize.z*(float)OVSEGZ))) : 0;
-					GetRight(ix1,iy1,iz1)->Add(ot);
-				}
-			}
-			break;
+		if(minvi >= 0){
+			// 対が見つかった
+			table[vi].index = minvi;
+			table[minvi].index = vi;
+			active[minvi] = 0;
+			active[vi] = 0;
+			pairc++;
+		}else if(apply != nullptr){
+			// 見つからないので候補に登録しておく
+			active[vi] = 1;
 		}
 	}
 
@@ -381,34 +303,95 @@ int MQSymmetryTable::InitVertexTable(MQObject obj, std::vector<MQSymmetryTable>&
 {
 	int num = obj->GetVertexCount();
 	std::vector<MQPoint> points(num);
+	if(num > 0)
+		obj->GetVertexArray(points.data());
 	for(int i=0; i<num; i++){
-		if(obj->GetVertexRefCount(i) > 0)
-			points[i] = obj->GetVertex(i);
-		else
+		if(obj->GetVertexRefCount(i) <= 0)
 			points[i] = MQPoint(FLT_MAX,FLT_MAX,FLT_MAX);
 	}
 
-	MQSymmetryTree sym;
-	int count = sym.CreateTable(points, table, apply, mindis, axis);
-	return count;
+	return CreateSymmetryTable(points, table, apply, mindis, axis);
 }
 
 int MQSymmetryTable::InitVertexTable(const std::vector<MQPoint>& points, std::vector<MQSymmetryTable>& table, const std::vector<bool> *apply, float mindis, MQSymmetryTable::SymmetryAxis axis)
 // return: count of pair of symmetry vertices
 {
-	MQSymmetryTree sym;
-	int count = sym.CreateTable(points, table, apply, mindis, axis);
-	return count;
+	return CreateSymmetryTable(points, table, apply, mindis, axis);
+}
+
+
+//---------------------------------------------------------------------------
+//  GetCycleHash
+//     Hash of a vertex-index cycle that does not depend on the first apex.
+//     The cycle is rotated to start at the lexicographically smallest position.
+//     最初の面頂点によらない頂点インデックスの循環列のハッシュ。
+//     辞書順で最小になる位置から始まるように回転してから計算する。
+//---------------------------------------------------------------------------
+static unsigned long long GetCycleHash(const int *vi, int count)
+{
+	int start = 0;
+	for(int r=1; r<count; r++){
+		for(int k=0; k<count; k++){
+			int a = vi[(r+k)%count];
+			int b = vi[(start+k)%count];
+			if(a != b){
+				if(a < b) start = r;
+				break;
+			}
+		}
+	}
+
+	unsigned long long h = 14695981039346656037ULL ^ (unsigned long long)count;
+	for(int k=0; k<count; k++){
+		h ^= (unsigned int)vi[(start+k)%count];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+//---------------------------------------------------------------------------
+//  GetSymmetryFaceVertex
+//     Get vertices mirrored from a face. All vertices must have a pair or be
+//     on the center.
+//     面の頂点を反対側の頂点に置き換える。すべての頂点が対称または中心のものでなければならない。
+// return: side of the face, or SideNone if the face has no mirrored face
+//---------------------------------------------------------------------------
+static MQSymmetryTable::SymmetrySide GetSymmetryFaceVertex(const int *vi, int count, const std::vector<MQSymmetryTable>& vert_table, int *symvert)
+{
+	MQSymmetryTable::SymmetrySide side = MQSymmetryTable::SideNone;
+	for(int j=0; j<count; j++){
+		const MQSymmetryTable& vt = vert_table[vi[j]];
+		switch(vt.side){
+		case MQSymmetryTable::SideNone:
+			return MQSymmetryTable::SideNone;
+		case MQSymmetryTable::SidePlus:
+		case MQSymmetryTable::SideMinus:
+			if(vt.index == -1)
+				return MQSymmetryTable::SideNone;
+			symvert[j] = vt.index;
+			if(side == MQSymmetryTable::SideNone)
+				side = vt.side;
+			break;
+		case MQSymmetryTable::SideCenter:
+			symvert[j] = vi[j];
+			break;
+		}
+	}
+	return side;
 }
 
 
 //---------------------------------------------------------------------------
 //  InitSymmetryFaceTable
+//     A mirrored face has the mirrored vertices in the reverse order.
+//     Each face is keyed on the hash of its vertex cycle, and each face is
+//     matched with faces that have the hash of its reversed mirrored cycle.
+//     対となる面は反対側の頂点を逆順に持つ。各面の頂点の循環列のハッシュと、
+//     反対側の頂点を逆順にした循環列のハッシュを突き合わせて対を探す。
 //---------------------------------------------------------------------------
 // return: count of pair of symmetry faces
 int MQSymmetryTable::InitFaceTable(MQObject obj, std::vector<MQSymmetryFaceTable>& face_table, const std::vector<bool> *face_apply, const std::vector<MQSymmetryTable>& vert_table, float mindis)
 {
-	std::vector<int> related_faces, face1_vert, face2_vert;
 	int count = 0;
 	int face_num = obj->GetFaceCount();
 
@@ -418,55 +401,64 @@ int MQSymmetryTable::InitFaceTable(MQObject obj, std::vector<MQSymmetryFaceTable
 		face_table[i].index = -1;
 	}
 
+	// 全面の頂点を圧縮行形式でまとめて取得する
+	// Get vertices of all faces in a CSR layout.
+	std::vector<int> face_offset(face_num+1);
+	face_offset[0] = 0;
+	for(int i=0; i<face_num; i++){
+		face_offset[i+1] = face_offset[i] + obj->GetFacePointCount(i);
+	}
+	std::vector<int> face_vert(face_offset[face_num]);
+	for(int i=0; i<face_num; i++){
+		if(face_offset[i+1] > face_offset[i])
+			obj->GetFacePointArray(i, &face_vert[face_offset[i]]);
+	}
+
+	// 各面の循環列のハッシュと、反対側の頂点を逆順にした循環列のハッシュ
+	// Hashes of the vertex cycle and of the reversed mirrored cycle of each face
+	std::vector<std::pair<unsigned long long,int> > face_hash(face_num);
+	std::vector<unsigned long long> sym_hash(face_num);
+	std::vector<MQSymmetryTable::SymmetrySide> face_side(face_num);
+	MQParallelRange(face_num, 0, MQSYMMETRY_MIN_QUERIES_PER_THREAD, [&](int begin, int end) {
+		std::vector<int> symvert, revvert;
+		for(int i=begin; i<end; i++){
+			const int *vi = face_vert.data() + face_offset[i];
+			int num = face_offset[i+1] - face_offset[i];
+			face_hash[i] = std::make_pair(GetCycleHash(vi, num), i);
+			face_side[i] = MQSymmetryTable::SideNone;
+			if(num == 0)
+				continue;
+			symvert.resize(num);
+			face_side[i] = GetSymmetryFaceVertex(vi, num, vert_table, symvert.data());
+			if(face_side[i] == MQSymmetryTable::SideNone)
+				continue;
+			revvert.resize(num);
+			for(int m=0; m<num; m++)
+				revvert[m] = symvert[(num - m) % num];
+			sym_hash[i] = GetCycleHash(revvert.data(), num);
+		}
+	});
+	std::sort(face_hash.begin(), face_hash.end());
+
+	std::vector<int> symvert;
 	for(int fi1=0; fi1<face_num; fi1++)
 	{
 		if(face_table[fi1].side != MQSymmetryTable::SideNone) 
 			continue;
-		int count1 = obj->GetFacePointCount(fi1);
-		if(count1 == 0)
-			continue;
-
-		face1_vert.resize(count1);
-		obj->GetFacePointArray(fi1, face1_vert.data());
-
-		// すべての頂点が対称または中心のものでなければならない
-		std::vector<int> symvert(count1);
-		MQSymmetryTable::SymmetrySide side = MQSymmetryTable::SideNone;
-		bool nosym = false;
-		for(int vi1=0; vi1<count1 && !nosym; vi1++){
-			MQSymmetryTable::SymmetrySide temp_side = vert_table[face1_vert[vi1]].side;
-			switch(temp_side){
-			case MQSymmetryTable::SideNone:
-				nosym = true;
-				break;
-			case MQSymmetryTable::SidePlus:
-			case MQSymmetryTable::SideMinus:
-				symvert[vi1] = vert_table[face1_vert[vi1]].index;
-				if (symvert[vi1] == -1){
-					nosym = true;
-					break;
-				}
-				if (side == MQSymmetryTable::SideNone)
-					side = temp_side;
-				break;
-			case MQSymmetryTable::SideCenter:
-				symvert[vi1] = face1_vert[vi1];
-				break;
-			}
-		}
-		if (nosym || side == MQSymmetryTable::SideNone)
+		MQSymmetryTable::SymmetrySide side = face_side[fi1];
+		if(side == MQSymmetryTable::SideNone)
 			continue;
+		int count1 = face_offset[fi1+1] - face_offset[fi1];
+		symvert.resize(count1);
+		GetSymmetryFaceVertex(face_vert.data() + face_offset[fi1], count1, vert_table, symvert.data());
 
 		// 対となる面を探す
-		int related_num = obj->GetVertexRelatedFaces(symvert[0], nullptr);
-		related_faces.resize(face_num);
-		obj->GetVertexRelatedFaces(symvert[0], related_faces.data());
-		for(int n=0; n<related_num; n++){
-			int fi2 = related_faces[n];
-			if(fi2 <= fi1) continue;
+		auto it = std::lower_bound(face_hash.begin(), face_hash.end(), std::make_pair(sym_hash[fi1], fi1+1));
+		for(; it != face_hash.end() && it->first == sym_hash[fi1]; ++it){
+			int fi2 = it->second;
 			if(face_table[fi2].side != MQSymmetryTable::SideNone) continue;
 
-			int count2 = obj->GetFacePointCount(fi2);
+			int count2 = face_offset[fi2+1] - face_offset[fi2];
 			if(count1 != count2) continue;
 
 			if(face_apply != nullptr){
@@ -474,30 +466,31 @@ int MQSymmetryTable::InitFaceTable(MQObject obj, std::vector<MQSymmetryFaceTable
 					continue;
 			}
 
-			face2_vert.resize(count2);
-			obj->GetFacePointArray(fi2, face2_vert.data());
-
-			for(int i=0; i<count1; i++){
+			// ハッシュの衝突に備えて頂点を比べ、apex0を求める
+			// Compare vertices in case of a hash collision, and get apex0.
+			const int *face2_vert = face_vert.data() + face_offset[fi2];
+			int i;
+			for(i=0; i<count1; i++){
 				int j;
 				for(j=0; j<count1; j++){
 					if(face2_vert[(count1+i-j)%count1] != symvert[j])
 						break;
 				}
-				if(j == count1){
-					face_table[fi1].index = fi2;
-					face_table[fi2].index = fi1;
-					face_table[fi1].side = side;
-					face_table[fi2].side = (side == MQSymmetryTable::SideMinus) ? MQSymmetryTable::SidePlus : MQSymmetryTable::SideMinus;
-					face_table[fi1].apex0 = i;
-					face_table[fi2].apex0 = i;
-					count++;
+				if(j == count1)
 					break;
-				}
+			}
+			if(i < count1){
+				face_table[fi1].index = fi2;
+				face_table[fi2].index = fi1;
+				face_table[fi1].side = side;
+				face_table[fi2].side = (side == MQSymmetryTable::SideMinus) ? MQSymmetryTable::SidePlus : MQSymmetryTable::SideMinus;
+				face_table[fi1].apex0 = i;
+				face_table[fi2].apex0 = i;
+				count++;
+				break;
 			}
 		}
 	}
 
 	return count;
 }
-
-
@@ -15,9 +15,19 @@
 #include <float.h>
 #include <vector>
 #include <cmath>
+#include <algorithm>
 #include "MQPlugin.h"
 #include "MQ3DLib.h"
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MQ3DLIB_USE_SSE
+#include <emmintrin.h>
+#endif
+
+// Minimum number of faces or vertices processed by one thread
+// 1スレッドで処理する面や頂点の最小数
+#define MQ3DLIB_MIN_ITEMS_PER_THREAD (8192)
+
 
 //---------------------------------------------------------------------------
 //  GetNormal()
@@ -151,6 +161,198 @@ MQPoint GetPolyNormal(const MQPoint *pts, int num)
 	return Normalize(nv);
 }
 
+#ifdef MQ3DLIB_USE_SSE
+// Four points in SoA layout
+// SoA形式の4点
+struct MQPoint4
+{
+	__m128 x, y, z;
+};
+
+static inline MQPoint4 LoadPoint4(const MQPoint *pts, const int *vi, int stride)
+{
+	const MQPoint& p0 = pts[vi[0]];
+	const MQPoint& p1 = pts[vi[stride]];
+	const MQPoint& p2 = pts[vi[stride*2]];
+	const MQPoint& p3 = pts[vi[stride*3]];
+	MQPoint4 r;
+	r.x = _mm_setr_ps(p0.x, p1.x, p2.x, p3.x);
+	r.y = _mm_setr_ps(p0.y, p1.y, p2.y, p3.y);
+	r.z = _mm_setr_ps(p0.z, p1.z, p2.z, p3.z);
+	return r;
+}
+
+// Same operations as GetNormal() for four faces
+// 4面分のGetNormal()と同じ演算
+static inline MQPoint4 GetNormal4(const MQPoint4& p0, const MQPoint4& p1, const MQPoint4& p2)
+{
+	__m128 ax = _mm_sub_ps(p1.x, p2.x);
+	__m128 ay = _mm_sub_ps(p1.y, p2.y);
+	__m128 az = _mm_sub_ps(p1.z, p2.z);
+	__m128 bx = _mm_sub_ps(p0.x, p1.x);
+	__m128 by = _mm_sub_ps(p0.y, p1.y);
+	__m128 bz = _mm_sub_ps(p0.z, p1.z);
+	MQPoint4 c;
+	c.x = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+	c.y = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+	c.z = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 is_zero = _mm_and_ps(_mm_and_ps(_mm_cmpeq_ps(c.x, zero), _mm_cmpeq_ps(c.y, zero)), _mm_cmpeq_ps(c.z, zero));
+	__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c.x, c.x), _mm_mul_ps(c.y, c.y)), _mm_mul_ps(c.z, c.z)));
+	c.x = _mm_andnot_ps(is_zero, _mm_div_ps(c.x, len));
+	c.y = _mm_andnot_ps(is_zero, _mm_div_ps(c.y, len));
+	c.z = _mm_andnot_ps(is_zero, _mm_div_ps(c.z, len));
+	return c;
+}
+
+static inline __m128 GetInnerProduct4(const MQPoint4& a, const MQPoint4& b)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+static inline __m128 Select4(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Same operations as GetQuadNormal() for four faces
+// 4面分のGetQuadNormal()と同じ演算
+static inline MQPoint4 GetQuadNormal4(const MQPoint4& p0, const MQPoint4& p1, const MQPoint4& p2, const MQPoint4& p3)
+{
+	MQPoint4 n1a = GetNormal4(p0, p1, p2);
+	MQPoint4 n1b = GetNormal4(p0, p2, p3);
+	MQPoint4 n2a = GetNormal4(p1, p2, p3);
+	MQPoint4 n2b = GetNormal4(p1, p3, p0);
+
+	__m128 sel = _mm_cmpgt_ps(GetInnerProduct4(n1a, n1b), GetInnerProduct4(n2a, n2b));
+	MQPoint4 n;
+	n.x = Select4(sel, _mm_add_ps(n1a.x, n1b.x), _mm_add_ps(n2a.x, n2b.x));
+	n.y = Select4(sel, _mm_add_ps(n1a.y, n1b.y), _mm_add_ps(n2a.y, n2b.y));
+	n.z = Select4(sel, _mm_add_ps(n1a.z, n1b.z), _mm_add_ps(n2a.z, n2b.z));
+
+	// Normalize()
+	__m128 len = _mm_sqrt_ps(GetInnerProduct4(n, n));
+	__m128 is_zero = _mm_cmpeq_ps(len, _mm_setzero_ps());
+	n.x = _mm_andnot_ps(is_zero, _mm_div_ps(n.x, len));
+	n.y = _mm_andnot_ps(is_zero, _mm_div_ps(n.y, len));
+	n.z = _mm_andnot_ps(is_zero, _mm_div_ps(n.z, len));
+	return n;
+}
+
+static inline void StorePoint4(const MQPoint4& n, const int *faces, int num, MQPoint *face_n)
+{
+	float x[4], y[4], z[4];
+	_mm_storeu_ps(x, n.x);
+	_mm_storeu_ps(y, n.y);
+	_mm_storeu_ps(z, n.z);
+	for(int k=0; k<num; k++){
+		face_n[faces[k]] = MQPoint(x[k], y[k], z[k]);
+	}
+}
+
+// Calculate normals for up to 4 triangles or quadrangles
+// 最大4つの三角形か四角形の法線を計算する
+static void GetFaceNormalBatch(const MQPoint *pts, const int *face_offset, const int *face_vert,
+	const int *faces, int num, int count, MQPoint *face_n)
+{
+	// Fill the rest with the last face.
+	// 端数は最後の面で埋める
+	int vi[16];
+	for(int k=0; k<4; k++){
+		const int *src = face_vert + face_offset[faces[std::min(k, num-1)]];
+		for(int j=0; j<count; j++){
+			vi[j*4+k] = src[j];
+		}
+	}
+	MQPoint4 p0 = LoadPoint4(pts, vi, 1);
+	MQPoint4 p1 = LoadPoint4(pts, vi+4, 1);
+	MQPoint4 p2 = LoadPoint4(pts, vi+8, 1);
+	if(count == 3){
+		StorePoint4(GetNormal4(p0, p1, p2), faces, num, face_n);
+	}else{
+		MQPoint4 p3 = LoadPoint4(pts, vi+12, 1);
+		StorePoint4(GetQuadNormal4(p0, p1, p2, p3), faces, num, face_n);
+	}
+}
+#endif
+
+// Calculate normals for faces[begin] to faces[end-1], or faces begin to end-1 if faces is NULL
+// faces[begin]からfaces[end-1]まで、facesがNULLならbeginからend-1までの面の法線を計算する
+static void GetFaceNormalRange(const MQPoint *pts, const int *face_offset, const int *face_vert,
+	const int *faces, int begin, int end, MQPoint *face_n)
+{
+#ifdef MQ3DLIB_USE_SSE
+	int tri[4], quad[4];
+	int tri_num = 0, quad_num = 0;
+#endif
+	std::vector<MQPoint> poly;
+	for(int k=begin; k<end; k++){
+		int i = (faces != NULL) ? faces[k] : k;
+		const int *vi = face_vert + face_offset[i];
+		int count = face_offset[i+1] - face_offset[i];
+		switch(count){
+		case 3:
+#ifdef MQ3DLIB_USE_SSE
+			tri[tri_num++] = i;
+			if(tri_num == 4){
+				GetFaceNormalBatch(pts, face_offset, face_vert, tri, 4, 3, face_n);
+				tri_num = 0;
+			}
+#else
+			face_n[i] = GetNormal(pts[vi[0]], pts[vi[1]], pts[vi[2]]);
+#endif
+			break;
+		case 4:
+#ifdef MQ3DLIB_USE_SSE
+			quad[quad_num++] = i;
+			if(quad_num == 4){
+				GetFaceNormalBatch(pts, face_offset, face_vert, quad, 4, 4, face_n);
+				quad_num = 0;
+			}
+#else
+			face_n[i] = GetQuadNormal(pts[vi[0]], pts[vi[1]], pts[vi[2]], pts[vi[3]]);
+#endif
+			break;
+		default:
+			if(count < 3){
+				face_n[i].zero();
+				break;
+			}
+			poly.resize(count);
+			for(int j=0; j<count; j++){
+				poly[j] = pts[vi[j]];
+			}
+			face_n[i] = GetPolyNormal(poly.data(), count);
+			break;
+		}
+	}
+#ifdef MQ3DLIB_USE_SSE
+	if(tri_num > 0){
+		GetFaceNormalBatch(pts, face_offset, face_vert, tri, tri_num, 3, face_n);
+	}
+	if(quad_num > 0){
+		GetFaceNormalBatch(pts, face_offset, face_vert, quad, quad_num, 4, face_n);
+	}
+#endif
+}
+
+//---------------------------------------------------------------------------
+//  GetFaceNormalArray()
+//     Get normal vectors for many faces at once.
+//     Triangles and quadrangles are calculated four at a time with SSE,
+//     and the faces are divided among threads.
+//     多数の面の法線をまとめて得る。
+//     三角形と四角形はSSEで4面ずつ計算し、面をスレッドに分けて処理する。
+//---------------------------------------------------------------------------
+void GetFaceNormalArray(const MQPoint *pts, const int *face_offset, const int *face_vert,
+	int face_count, MQPoint *face_n, int thread_num)
+{
+	MQParallelRange(face_count, thread_num, MQ3DLIB_MIN_ITEMS_PER_THREAD, [&](int begin, int end) {
+		GetFaceNormalRange(pts, face_offset, face_vert, NULL, begin, end, face_n);
+	});
+}
+
 //---------------------------------------------------------------------------
 //  GetTriangleArea()
 //     Get an area of a triangle constituted by three points
@@ -623,11 +825,142 @@ public:
 //       }
 //       delete normal;
 //---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//  GetObjectFaceArray()
+//     Get vertex indices of all faces in an object in a CSR layout.
+//     オブジェクトの全面の頂点インデックスを圧縮行形式で得る。
+//---------------------------------------------------------------------------
+static void GetObjectFaceArray(MQObject obj, int face_count, std::vector<int>& face_offset, std::vector<int>& face_vert)
+{
+	face_offset.resize(face_count+1);
+	face_offset[0] = 0;
+	for(int i=0; i<face_count; i++){
+		face_offset[i+1] = face_offset[i] + obj->GetFacePointCount(i);
+	}
+	face_vert.resize(face_offset[face_count]);
+	for(int i=0; i<face_count; i++){
+		if(face_offset[i+1] > face_offset[i]){
+			obj->GetFacePointArray(i, &face_vert[face_offset[i]]);
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+//  MakeVertexApexTable()
+//     Make a CSR table from a vertex to apexes of faces with 3 or more points.
+//     Apexes of a vertex are sorted in order of the face index.
+//     頂点から3点以上の面の面頂点を引く圧縮行形式の表を作る。
+//     頂点ごとの面頂点は面番号の順に並ぶ。
+//---------------------------------------------------------------------------
+static void MakeVertexApexTable(const int *face_offset, const int *face_vert, int face_count, int vert_count,
+	std::vector<int>& apex_face, std::vector<int>& vert_offset, std::vector<int>& vert_apex)
+{
+	int apex_count = face_offset[face_count];
+	apex_face.resize(apex_count);
+	vert_offset.assign(vert_count+1, 0);
+	for(int i=0; i<face_count; i++){
+		bool valid = (face_offset[i+1] - face_offset[i] >= 3);
+		for(int a=face_offset[i]; a<face_offset[i+1]; a++){
+			apex_face[a] = i;
+			if(valid) vert_offset[face_vert[a]+1]++;
+		}
+	}
+	for(int v=0; v<vert_count; v++){
+		vert_offset[v+1] += vert_offset[v];
+	}
+	vert_apex.resize(vert_offset[vert_count]);
+	std::vector<int> fill(vert_offset.begin(), vert_offset.end()-1);
+	for(int i=0; i<face_count; i++){
+		if(face_offset[i+1] - face_offset[i] < 3) continue;
+		for(int a=face_offset[i]; a<face_offset[i+1]; a++){
+			vert_apex[fill[face_vert[a]]++] = a;
+		}
+	}
+}
+
+// Work buffers for SmoothVertexNormal()
+// SmoothVertexNormal()の作業領域
+struct MQSmoothWork
+{
+	std::vector<MQPoint> group_n;
+	std::vector<int> group_count;
+	std::vector<int> apex_group;
+};
+
+//---------------------------------------------------------------------------
+//  SmoothVertexNormal()
+//     Smooth face normals around a vertex by the smoothing angle.
+//     As MQGouraudHash does, each face is added to the first group whose
+//     normal is within the angle in order of the face index.
+//     頂点の周りの面の法線をスムージング角度によって平滑化する。
+//     MQGouraudHashと同じく、面番号の順に角度内にある最初のグループへ加える。
+//---------------------------------------------------------------------------
+static void SmoothVertexNormal(int v, const int *vert_offset, const int *vert_apex, const int *apex_face,
+	const MQPoint *face_n, float facet, MQPoint *apex_n, MQSmoothWork& work)
+{
+	work.group_n.clear();
+	work.group_count.clear();
+	work.apex_group.clear();
+	for(int k=vert_offset[v]; k<vert_offset[v+1]; k++){
+		const MQPoint& pa = face_n[apex_face[vert_apex[k]]];
+		float da = pa.norm();
+		int g;
+		for(g=0; g<(int)work.group_n.size(); g++){
+			// ２面の角度をチェック
+			// Check the angle between the two faces
+			float c = 0.0f;
+			if(da > 0.0f){
+				float db = work.group_n[g].norm();
+				if(db > 0.0f)
+					c = GetInnerProduct(pa, work.group_n[g]) / sqrtf(da*db);
+			}
+			if(c >= facet) break;
+		}
+		if(g == (int)work.group_n.size()){
+			work.group_n.push_back(pa);
+			work.group_count.push_back(1);
+		}else{
+			work.group_n[g] += pa;
+			work.group_count[g]++;
+		}
+		work.apex_group.push_back(g);
+	}
+	for(size_t g=0; g<work.group_n.size(); g++){
+		if(work.group_count[g] > 1)
+			work.group_n[g].normalize();
+	}
+	for(int k=vert_offset[v]; k<vert_offset[v+1]; k++){
+		apex_n[vert_apex[k]] = work.group_n[work.apex_group[k - vert_offset[v]]];
+	}
+}
+
+//---------------------------------------------------------------------------
+//  SmoothFaceNormals()
+//     Smooth face normals around all vertices by the smoothing angle.
+//     Vertices are independent, so they are divided among threads.
+//     全頂点の周りの面の法線をスムージング角度によって平滑化する。
+//     頂点ごとに独立しているので頂点をスレッドに分けて処理する。
+//---------------------------------------------------------------------------
+static void SmoothFaceNormals(const int *face_offset, const int *face_vert, int face_count, int vert_count,
+	const MQPoint *face_n, float facet, MQPoint *apex_n)
+{
+	std::vector<int> apex_face, vert_offset, vert_apex;
+	MakeVertexApexTable(face_offset, face_vert, face_count, vert_count, apex_face, vert_offset, vert_apex);
+
+	MQParallelRange(vert_count, 0, MQ3DLIB_MIN_ITEMS_PER_THREAD, [&](int begin, int end) {
+		MQSmoothWork work;
+		for(int v=begin; v<end; v++){
+			SmoothVertexNormal(v, &(*vert_offset.begin()), vert_apex.empty() ? NULL : &(*vert_apex.begin()),
+				&(*apex_face.begin()), face_n, facet, apex_n, work);
+		}
+	});
+}
+
 MQObjNormal::~MQObjNormal()
 {
 }
 
-MQObjNormal::MQObjNormal(MQObject obj)
+MQObjNormal::MQObjNormal(MQObject obj, bool calc_smooth)
 {
 	int i,j;
 	int face_count, vert_count;
@@ -635,7 +968,7 @@ MQObjNormal::MQObjNormal(MQObject obj)
 	face_count = obj->GetFaceCount();
 	vert_count = obj->GetVertexCount();
 
-	normal.resize(face_count);
+	normal.allocPacked(obj);
 #if 0
 	MQPoint *face_n = new MQPoint[face_count];
 
@@ -823,59 +1156,8 @@ MQObjNormal::MQObjNormal(MQObject obj)
 
 	delete[] face_n;
 #else
-	switch(obj->GetShading()) {
-	case MQOBJECT_SHADE_FLAT:
-		for(i=0; i<face_count; i++)
-		{
-			// 三角形・四角形・多角形それぞれに対する法線の計算
-			// Calculate a normal vector for a triangle, a quadrangle or a polygon.
-			int count = obj->GetFacePointCount(i);
-			if(count < 3)continue;
-			normal.resizeItem(i, count);
-			MQPoint n;
-			switch(count) {
-			case 3:
-			{
-				int vi[3];
-				obj->GetFacePointArray(i, vi);
-				n = GetNormal(
-					obj->GetVertex(vi[0]), obj->GetVertex(vi[1]), obj->GetVertex(vi[2]));
-			}
-			break;
-			case 4:
-			{
-				int vi[4];
-				obj->GetFacePointArray(i, vi);
-				n = GetQuadNormal(
-					obj->GetVertex(vi[0]), obj->GetVertex(vi[1]), 
-					obj->GetVertex(vi[2]), obj->GetVertex(vi[3]));
-			}
-			break;
-			default:
-			{
-				if(count < 3){
-					n.zero();
-				}
-				std::vector<int> vi(count);
-				obj->GetFacePointArray(i, &(*vi.begin()));
-
-				std::vector<MQPoint> pts(count);
-				for(j=0; j<count; j++){
-					pts[j] = obj->GetVertex(vi[j]);
-				}
-				n = GetPolyNormal(&(*pts.begin()), count);
-			}
-			break;
-			}
-			normal.resizeItem(i, count);
-			for(j=0; j<count; j++)
-				normal[i][j] = n;
-			for(; j<4; j++)
-				normal[i][j].zero();
-		}
-		break;
-
-	case MQOBJECT_SHADE_GOURAUD:
+	int shading = obj->GetShading();
+	if(shading == MQOBJECT_SHADE_GOURAUD && !calc_smooth){
 		for(i=0; i<face_count; i++)
 		{
 			int count = obj->GetFacePointCount(i);
@@ -887,11 +1169,215 @@ MQObjNormal::MQObjNormal(MQObject obj)
 			for(; j<4; j++)
 				normal[i][j].zero();
 		}
+		return;
+	}
+	if(shading != MQOBJECT_SHADE_FLAT && shading != MQOBJECT_SHADE_GOURAUD)
+		return;
+
+	// 頂点と面をまとめて取得し、面の法線をまとめて計算する
+	// Get vertices and faces at once, and calculate normals for all faces.
+	std::vector<MQPoint> pts(vert_count);
+	if(vert_count > 0)
+		obj->GetVertexArray(&(*pts.begin()));
+	std::vector<int> face_offset, face_vert;
+	GetObjectFaceArray(obj, face_count, face_offset, face_vert);
+	std::vector<MQPoint> face_n(face_count);
+	if(face_count > 0)
+		GetFaceNormalArray(pts.empty() ? NULL : &(*pts.begin()), &(*face_offset.begin()), face_vert.empty() ? NULL : &(*face_vert.begin()), face_count, &(*face_n.begin()));
+
+	std::vector<MQPoint> apex_n;
+	if(shading == MQOBJECT_SHADE_GOURAUD){
+		// スムージング角度の取得
+		// Get a smooth angle.
+		float facet = cosf( RAD(obj->GetSmoothAngle()) );
+		apex_n.resize(face_vert.size());
+		if(!apex_n.empty())
+			SmoothFaceNormals(&(*face_offset.begin()), &(*face_vert.begin()), face_count, vert_count, &(*face_n.begin()), facet, &(*apex_n.begin()));
+	}
+
+	// 法線をバッファにセット
+	// Set the normal vector.
+	for(i=0; i<face_count; i++)
+	{
+		int count = face_offset[i+1] - face_offset[i];
+		if(count < 3)continue;
+		normal.resizeItem(i, count);
+		for(j=0; j<count; j++)
+			normal[i][j] = apex_n.empty() ? face_n[i] : apex_n[face_offset[i]+j];
+		for(; j<4; j++)
+			normal[i][j].zero();
 	}
 #endif
 }
 
 
+
+//---------------------------------------------------------------------------
+//  class MQObjNormalCache
+//     Keeps normal vectors of an object and updates only the normals around
+//     moved vertices. Normals for Gouraud shading are smoothed by the
+//     smoothing angle in this class, as MQObjNormal(obj, true) does.
+//     Please refer the following example:
+//     オブジェクト中の法線を保持し、移動した頂点の周りの法線だけを更新する。
+//     グーローシェーディングの法線はMQObjNormal(obj, true)と同じく
+//     このクラス内でスムージング角度によって平滑化する。
+//     使用例は以下のような感じ。
+//
+//       MQObjNormalCache cache;
+//       cache.Build(obj);
+//       // 頂点を移動する Move some vertices
+//       obj->SetVertex(vi[0], p0);
+//       obj->SetVertex(vi[1], p1);
+//       cache.Update(obj, vi, 2);
+//       MQPoint nv = cache.Get(face, vert);
+//---------------------------------------------------------------------------
+MQObjNormalCache::MQObjNormalCache()
+{
+	m_shading = MQOBJECT_SHADE_FLAT;
+	m_facet = 1.0f;
+	m_stamp = 0;
+}
+
+MQObjNormalCache::~MQObjNormalCache()
+{
+}
+
+void MQObjNormalCache::Clear()
+{
+	m_pts.clear();
+	m_face_offset.clear();
+	m_face_vert.clear();
+	m_face_n.clear();
+	m_apex_n.clear();
+	m_apex_face.clear();
+	m_vert_offset.clear();
+	m_vert_apex.clear();
+	m_face_stamp.clear();
+	m_vert_stamp.clear();
+	m_dirty_face.clear();
+	m_dirty_vert.clear();
+	m_stamp = 0;
+}
+
+bool MQObjNormalCache::IsValid(MQObject obj) const
+{
+	return !m_face_offset.empty()
+		&& (int)m_pts.size() == obj->GetVertexCount()
+		&& GetFaceCount() == obj->GetFaceCount()
+		&& m_shading == obj->GetShading()
+		&& m_facet == cosf( RAD(obj->GetSmoothAngle()) );
+}
+
+void MQObjNormalCache::Build(MQObject obj)
+{
+	Clear();
+
+	int face_count = obj->GetFaceCount();
+	int vert_count = obj->GetVertexCount();
+	m_shading = obj->GetShading();
+	m_facet = cosf( RAD(obj->GetSmoothAngle()) );
+
+	m_pts.resize(vert_count);
+	if(vert_count > 0)
+		obj->GetVertexArray(&(*m_pts.begin()));
+	GetObjectFaceArray(obj, face_count, m_face_offset, m_face_vert);
+	MakeVertexApexTable(&(*m_face_offset.begin()), m_face_vert.empty() ? NULL : &(*m_face_vert.begin()),
+		face_count, vert_count, m_apex_face, m_vert_offset, m_vert_apex);
+
+	m_face_n.assign(face_count, MQPoint(0,0,0));
+	m_apex_n.assign(m_face_vert.size(), MQPoint(0,0,0));
+	m_face_stamp.assign(face_count, 0);
+	m_vert_stamp.assign(vert_count, 0);
+	if(face_count == 0)
+		return;
+
+	GetFaceNormalArray(m_pts.empty() ? NULL : &(*m_pts.begin()), &(*m_face_offset.begin()),
+		m_face_vert.empty() ? NULL : &(*m_face_vert.begin()), face_count, &(*m_face_n.begin()));
+	if(m_apex_n.empty())
+		return;
+	if(m_shading == MQOBJECT_SHADE_GOURAUD){
+		SmoothFaceNormals(&(*m_face_offset.begin()), &(*m_face_vert.begin()), face_count, vert_count,
+			&(*m_face_n.begin()), m_facet, &(*m_apex_n.begin()));
+	}else{
+		for(int i=0; i<face_count; i++){
+			for(int a=m_face_offset[i]; a<m_face_offset[i+1]; a++)
+				m_apex_n[a] = m_face_n[i];
+		}
+	}
+}
+
+void MQObjNormalCache::Update(MQObject obj, const int *vert_index, int num)
+{
+	if(!IsValid(obj)){
+		Build(obj);
+		return;
+	}
+
+	// 印の世代を進める。一周したら印を消す
+	// Advance the stamp. Clear stamps when it wraps around.
+	if(++m_stamp == 0){
+		std::fill(m_face_stamp.begin(), m_face_stamp.end(), 0);
+		std::fill(m_vert_stamp.begin(), m_vert_stamp.end(), 0);
+		m_stamp = 1;
+	}
+
+	// 移動した頂点を取得し、その頂点を使う面を集める
+	// Get the moved vertices and collect faces using them.
+	int vert_count = (int)m_pts.size();
+	m_dirty_face.clear();
+	for(int n=0; n<num; n++){
+		int v = vert_index[n];
+		if(v < 0 || v >= vert_count) continue;
+		m_pts[v] = obj->GetVertex(v);
+		for(int k=m_vert_offset[v]; k<m_vert_offset[v+1]; k++){
+			int f = m_apex_face[m_vert_apex[k]];
+			if(m_face_stamp[f] != m_stamp){
+				m_face_stamp[f] = m_stamp;
+				m_dirty_face.push_back(f);
+			}
+		}
+	}
+	if(m_dirty_face.empty())
+		return;
+
+	int dirty_face_num = (int)m_dirty_face.size();
+	MQParallelRange(dirty_face_num, 0, MQ3DLIB_MIN_ITEMS_PER_THREAD, [&](int begin, int end) {
+		GetFaceNormalRange(&(*m_pts.begin()), &(*m_face_offset.begin()), &(*m_face_vert.begin()),
+			&(*m_dirty_face.begin()), begin, end, &(*m_face_n.begin()));
+	});
+
+	if(m_shading != MQOBJECT_SHADE_GOURAUD){
+		for(int n=0; n<dirty_face_num; n++){
+			int f = m_dirty_face[n];
+			for(int a=m_face_offset[f]; a<m_face_offset[f+1]; a++)
+				m_apex_n[a] = m_face_n[f];
+		}
+		return;
+	}
+
+	// 法線が変わった面の全頂点で平滑化をやり直す
+	// Smooth again at all vertices of the faces whose normal was changed.
+	m_dirty_vert.clear();
+	for(int n=0; n<dirty_face_num; n++){
+		int f = m_dirty_face[n];
+		for(int a=m_face_offset[f]; a<m_face_offset[f+1]; a++){
+			int v = m_face_vert[a];
+			if(m_vert_stamp[v] != m_stamp){
+				m_vert_stamp[v] = m_stamp;
+				m_dirty_vert.push_back(v);
+			}
+		}
+	}
+	MQParallelRange((int)m_dirty_vert.size(), 0, MQ3DLIB_MIN_ITEMS_PER_THREAD, [&](int begin, int end) {
+		MQSmoothWork work;
+		for(int n=begin; n<end; n++){
+			SmoothVertexNormal(m_dirty_vert[n], &(*m_vert_offset.begin()), &(*m_vert_apex.begin()),
+				&(*m_apex_face.begin()), &(*m_face_n.begin()), m_facet, &(*m_apex_n.begin()), work);
+		}
+	});
+}
+
+
 MQObjIndexedNormal::~MQObjIndexedNormal()
 {
 }
@@ -904,7 +1390,7 @@ MQObjIndexedNormal::MQObjIndexedNormal(MQObject obj)
 	face_count = obj->GetFaceCount();
 	vert_count = obj->GetVertexCount();
 
-	index.resize(face_count);
+	index.allocPacked(obj);
 #if 0
 	MQPoint *face_n = new MQPoint[face_count];
 
@@ -1170,6 +1656,139 @@ MQObjIndexedNormal::MQObjIndexedNormal(MQObject obj)
 }
 
 
+//---------------------------------------------------------------------------
+//  class MQObjHalfEdge
+//     オブジェクト中の3点以上の面のハーフエッジ構造
+//     Half-edge structure of faces with 3 or more points in an object
+//---------------------------------------------------------------------------
+MQObjHalfEdge::MQObjHalfEdge()
+{
+}
+
+MQObjHalfEdge::MQObjHalfEdge(MQObject obj, int thread_num)
+{
+	Build(obj, thread_num);
+}
+
+MQObjHalfEdge::~MQObjHalfEdge()
+{
+}
+
+void MQObjHalfEdge::Clear()
+{
+	m_face_offset.clear();
+	m_face_vert.clear();
+	m_he_face.clear();
+	m_twin.clear();
+	m_vert_offset.clear();
+	m_vert_he.clear();
+}
+
+void MQObjHalfEdge::Build(MQObject obj, int thread_num)
+{
+	Clear();
+	int vert_count = obj->GetVertexCount();
+	int face_count = obj->GetFaceCount();
+	GetObjectFaceArray(obj, face_count, m_face_offset, m_face_vert);
+	MakeVertexApexTable(m_face_offset.data(), m_face_vert.data(), face_count, vert_count, m_he_face, m_vert_offset, m_vert_he);
+	MakeTwin(thread_num);
+}
+
+void MQObjHalfEdge::Build(const int *face_offset, const int *face_vert, int face_count, int vert_count, int thread_num)
+{
+	Clear();
+	m_face_offset.resize(face_count+1);
+	for(int i=0; i<=face_count; i++){
+		m_face_offset[i] = face_offset[i] - face_offset[0];
+	}
+	m_face_vert.assign(face_vert + face_offset[0], face_vert + face_offset[face_count]);
+	MakeVertexApexTable(m_face_offset.data(), m_face_vert.data(), face_count, vert_count, m_he_face, m_vert_offset, m_vert_he);
+	MakeTwin(thread_num);
+}
+
+//---------------------------------------------------------------------------
+//  MQObjHalfEdge::MakeTwin()
+//     Pair half-edges. Half-edges are sorted by the smaller vertex with a
+//     counting sort, and each vertex is processed in parallel. A half-edge is
+//     paired with the first unpaired opposite half-edge in order of the face
+//     and line index, in the same way as the former MQObjEdge.
+//     ハーフエッジの対を求める。小さい方の頂点で計数ソートし、頂点ごとに
+//     並列に処理する。各ハーフエッジは、面と辺の順で最初の対になっていない
+//     反対向きのハーフエッジと対にする。以前のMQObjEdgeと同じ結果になる。
+//---------------------------------------------------------------------------
+void MQObjHalfEdge::MakeTwin(int thread_num)
+{
+	int he_count = GetHalfEdgeCount();
+	int vert_count = GetVertexCount();
+	m_twin.assign(he_count, -1);
+
+	std::vector<int> key_offset(vert_count+1, 0);
+	for(int he=0; he<he_count; he++){
+		if(GetFacePointCount(m_he_face[he]) < 3) continue;
+		int lo = (std::min)(GetStartVertex(he), GetEndVertex(he));
+		key_offset[lo+1]++;
+	}
+	for(int v=0; v<vert_count; v++){
+		key_offset[v+1] += key_offset[v];
+	}
+	std::vector<int> key_he(key_offset[vert_count]);
+	std::vector<int> fill(key_offset.begin(), key_offset.end()-1);
+	for(int he=0; he<he_count; he++){
+		if(GetFacePointCount(m_he_face[he]) < 3) continue;
+		int lo = (std::min)(GetStartVertex(he), GetEndVertex(he));
+		key_he[fill[lo]++] = he;
+	}
+
+	MQParallelRange(vert_count, thread_num, MQ3DLIB_MIN_ITEMS_PER_THREAD, [&](int begin, int end) {
+		std::vector<std::pair<int,int>> group;
+		for(int v=begin; v<end; v++){
+			int num = key_offset[v+1] - key_offset[v];
+			if(num < 2) continue;
+
+			// 反対側の頂点、ハーフエッジ番号の順に並べる
+			// Sort by the other vertex, and then by the half-edge index.
+			group.resize(num);
+			for(int i=0; i<num; i++){
+				int he = key_he[key_offset[v] + i];
+				group[i] = std::make_pair(GetStartVertex(he) + GetEndVertex(he) - v, he);
+			}
+			std::sort(group.begin(), group.end());
+
+			for(int i=0; i<num; ){
+				int j = i+1;
+				while(j < num && group[j].first == group[i].first) j++;
+				for(int k=i+1; k<j; k++){
+					int he = group[k].second;
+					for(int l=i; l<k; l++){
+						int prev = group[l].second;
+						if(m_twin[prev] < 0 && GetStartVertex(prev) == GetEndVertex(he)){
+							m_twin[prev] = he;
+							m_twin[he] = prev;
+							break;
+						}
+					}
+				}
+				i = j;
+			}
+		}
+	});
+}
+
+bool MQObjHalfEdge::GetPair(int face_index, int line_index, int& pair_face, int& pair_line) const
+{
+	if(face_index < 0 || face_index >= GetFaceCount())
+		return false;
+
+	int twin = m_twin[GetHalfEdge(face_index, line_index)];
+	if(twin < 0)
+		return false;
+
+	pair_face = m_he_face[twin];
+	pair_line = GetLine(twin);
+	return true;
+}
+
+
 //---------------------------------------------------------------------------
 //  class MQObjEdge
 //     オブジェクト中のエッジ対を管理する
@@ -1185,94 +1804,28 @@ MQObjIndexedNormal::MQObjIndexedNormal(MQObject obj)
 //---------------------------------------------------------------------------
 MQObjEdge::MQObjEdge(MQObject obj)
 {
-	int vert_count = obj->GetVertexCount();
 	int face_count = obj->GetFaceCount();
 
 	m_obj = obj;
 	m_face = face_count;
-	if(!m_pair.resize(face_count)){
+	if(!m_pair.allocPacked(obj)){
 		m_face = 0;
 		return;
 	}
 
-	int tree_size = vert_count;
+	MQObjHalfEdge half_edge(obj);
 	for(int cf=0; cf<face_count; cf++)
 	{
-		int cfc = obj->GetFacePointCount(cf);
-
-		if(cfc >= 3){
-			m_pair.resizeItem(cf, cfc);
-			tree_size += cfc;
-		}
-	}
-
-class MRelTree
-{
-public:
-	MQObjEdgePair pair;
-	int next;
-
-	inline MRelTree() { next = -1; }
-	inline MRelTree& operator = (const MRelTree& r)
-		{pair=r.pair; next=r.next; return *this;}
-};
-
-	MRelTree *tree = new MRelTree[tree_size];
-
-	int regvc = vert_count;
-	std::vector<int> cvi, dvi;
-	for(int cf=0; cf<face_count; cf++)
-	{
-		int cfc = obj->GetFacePointCount(cf);
-
+		int cfc = half_edge.GetFacePointCount(cf);
 		if(cfc < 3)
 			continue;
 
-		m_pair.resizeItem(cf, cfc);
-
-		cvi.resize(cfc);
-		obj->GetFacePointArray(cf, &(*cvi.begin()));
-
-		cfc--; // decrement to be faster
-		for(int j=0; j<=cfc; j++)
-		{
-			// check tree
-			int v1 = cvi[j];
-			int v2 = cvi[j<cfc? j+1 : 0];
-			for(MRelTree drel=tree[v2]; drel.pair.face>=0; drel=tree[drel.next])
-			{
-				int df = drel.pair.face;
-				int dfc = obj->GetFacePointCount(df);
-				dvi.resize(dfc);
-				obj->GetFacePointArray(df, &(*dvi.begin()));
-				if(m_pair[df][drel.pair.line].face < 0)
-				{
-					if(/*v2 == dvi[drel.pair.line]
-					&&*/ v1 == dvi[drel.pair.line<dfc-1 ? drel.pair.line+1 : 0])
-					{
-						// set relation
-						m_pair[df][drel.pair.line] = MQObjEdgePair(cf,j);
-						m_pair[cf][j] = drel.pair;
-						goto CR_REG_END;
-					}
-				}
-				if(drel.next < 0) break;
-			}
-			// not find in tree, so regist vertex1
-			MRelTree *ctr;
-			for(ctr=&tree[v1]; ctr->pair.face>=0; ctr=&tree[ctr->next]){
-				if(ctr->next < 0){
-					ctr->next = regvc;
-					ctr = &tree[regvc++];
-					break;
-				}
-			}
-			ctr->pair = MQObjEdgePair(cf,j);
-CR_REG_END:;
+		for(int j=0; j<cfc; j++){
+			int twin = half_edge.GetTwin(half_edge.GetHalfEdge(cf, j));
+			if(twin >= 0)
+				m_pair[cf][j] = MQObjEdgePair(half_edge.GetFace(twin), half_edge.GetLine(twin));
 		}
 	}
-
-	delete[] tree;
 }
 
 MQObjEdge::~MQObjEdge()
@@ -1315,3 +1868,276 @@ void MQObjEdge::addFace(int vert_num)
 	}
 }
 
+
+
+//---------------------------------------------------------------------------
+//  class MQScreenProjector
+//---------------------------------------------------------------------------
+// Minimum number of points projected by one thread
+// 1スレッドで投影する点の最小数
+#define MQSCREENPROJECTOR_MIN_POINTS_PER_THREAD (16384)
+// Allowed relative error of the sampled matrix
+// 標本から求めた行列の許容相対誤差
+#define MQSCREENPROJECTOR_TOLERANCE (1e-3)
+
+MQScreenProjector::MQScreenProjector()
+{
+	m_scene = NULL;
+	m_valid = false;
+	m_divide_z = true;
+	m_use_rect = false;
+	for(int i=0; i<16; i++) m_matrix.t[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+	for(int i=0; i<4; i++) m_rect[i] = 0.0f;
+}
+
+MQScreenProjector::MQScreenProjector(MQScene scene)
+{
+	m_scene = NULL;
+	m_valid = false;
+	m_divide_z = true;
+	m_use_rect = false;
+	for(int i=0; i<16; i++) m_matrix.t[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+	for(int i=0; i<4; i++) m_rect[i] = 0.0f;
+	Init(scene);
+}
+
+//---------------------------------------------------------------------------
+//  MQScreenProjector::Init()
+//     Get the matrix by sampling Convert3DToScreen() around the look-at
+//     position. X, Y and W are fitted from 4 points, and 2 more points check
+//     whether the screen z is divided by w or not.
+//     注視点の周囲でConvert3DToScreen()を標本化して行列を求める。
+//     4点からX,Y,Wを求め、さらに2点でスクリーンのzがwで割られるかどうかを確かめる。
+//---------------------------------------------------------------------------
+bool MQScreenProjector::Init(MQScene scene)
+{
+	m_scene = scene;
+	m_valid = false;
+	if(scene == NULL)
+		return false;
+
+	MQPoint org = scene->GetLookAtPosition();
+	float size = (std::max)(GetSize(scene->GetCameraPosition() - org) * 0.25f, 1.0f);
+	float half = size * 0.5f;
+	const MQPoint pos[6] = {
+		org,
+		org + MQPoint(size, 0, 0),
+		org + MQPoint(0, size, 0),
+		org + MQPoint(0, 0, size),
+		org + MQPoint(half, -half, half),
+		org + MQPoint(-half, half, -half),
+	};
+
+	// X=sx*w, Y=sy*w, Z=sz*w, Z'=sz, W=w
+	double val[6][5];
+	for(int i=0; i<6; i++){
+		float w = 0.0f;
+		MQPoint sp = scene->Convert3DToScreen(pos[i], &w);
+		if(!(w > 0.0f) || !std::isfinite(sp.x) || !std::isfinite(sp.y) || !std::isfinite(sp.z))
+			return false;
+		val[i][0] = (double)sp.x * w;
+		val[i][1] = (double)sp.y * w;
+		val[i][2] = (double)sp.z * w;
+		val[i][3] = (double)sp.z;
+		val[i][4] = (double)w;
+	}
+
+	double m[4][5];
+	for(int c=0; c<5; c++){
+		for(int r=0; r<3; r++){
+			m[r][c] = (val[r+1][c] - val[0][c]) / size;
+		}
+		m[3][c] = val[0][c] - (m[0][c] * org.x + m[1][c] * org.y + m[2][c] * org.z);
+	}
+
+	// Check the fitted matrix with the other points
+	// 求めた行列を他の点で確かめる
+	bool match_x = true, match_zw = true, match_z = true;
+	for(int i=4; i<6; i++){
+		double p[5];
+		for(int c=0; c<5; c++){
+			p[c] = m[0][c] * pos[i].x + m[1][c] * pos[i].y + m[2][c] * pos[i].z + m[3][c];
+		}
+		if(!(p[4] > 0.0))
+			return false;
+		double sx = val[i][0] / val[i][4];
+		double sy = val[i][1] / val[i][4];
+		double sz = val[i][3];
+		if(fabs(p[0] / p[4] - sx) > MQSCREENPROJECTOR_TOLERANCE * (1.0 + fabs(sx))) match_x = false;
+		if(fabs(p[1] / p[4] - sy) > MQSCREENPROJECTOR_TOLERANCE * (1.0 + fabs(sy))) match_x = false;
+		if(fabs(p[2] / p[4] - sz) > MQSCREENPROJECTOR_TOLERANCE * (1.0 + fabs(sz))) match_zw = false;
+		if(fabs(p[3] - sz) > MQSCREENPROJECTOR_TOLERANCE * (1.0 + fabs(sz))) match_z = false;
+	}
+	if(!match_x || (!match_zw && !match_z))
+		return false;
+
+	m_divide_z = match_zw;
+	int zc = m_divide_z ? 2 : 3;
+	for(int r=0; r<4; r++){
+		m_matrix.d[r][0] = (float)m[r][0];
+		m_matrix.d[r][1] = (float)m[r][1];
+		m_matrix.d[r][2] = (float)m[r][zc];
+		m_matrix.d[r][3] = (float)m[r][4];
+	}
+	m_valid = true;
+	return true;
+}
+
+void MQScreenProjector::SetMatrix(const MQMatrix& matrix, bool divide_z)
+{
+	m_matrix = matrix;
+	m_divide_z = divide_z;
+	m_valid = true;
+}
+
+void MQScreenProjector::SetScreenRect(float left, float top, float right, float bottom)
+{
+	m_rect[0] = left;
+	m_rect[1] = top;
+	m_rect[2] = right;
+	m_rect[3] = bottom;
+	m_use_rect = true;
+}
+
+BYTE MQScreenProjector::GetFlag(const MQPoint& sp, float w) const
+{
+	BYTE flag = 0;
+	if(w <= 0.0f || sp.z <= 0.0f) flag |= CLIP_NEAR;
+	if(m_use_rect){
+		if(sp.x < m_rect[0]) flag |= CLIP_LEFT;
+		if(sp.x > m_rect[2]) flag |= CLIP_RIGHT;
+		if(sp.y < m_rect[1]) flag |= CLIP_TOP;
+		if(sp.y > m_rect[3]) flag |= CLIP_BOTTOM;
+	}
+	return flag;
+}
+
+MQPoint MQScreenProjector::Project(const MQPoint& p, BYTE *flag) const
+{
+	MQPoint sp;
+	float w;
+	if(m_valid){
+		const float *m = m_matrix.t;
+		w = (p.x * m[3] + p.y * m[7]) + (p.z * m[11] + m[15]);
+		sp.x = ((p.x * m[0] + p.y * m[4]) + (p.z * m[8] + m[12])) / w;
+		sp.y = ((p.x * m[1] + p.y * m[5]) + (p.z * m[9] + m[13])) / w;
+		sp.z = (p.x * m[2] + p.y * m[6]) + (p.z * m[10] + m[14]);
+		if(m_divide_z) sp.z /= w;
+	}else if(m_scene != NULL){
+		w = 0.0f;
+		sp = m_scene->Convert3DToScreen(p, &w);
+	}else{
+		w = 0.0f;
+		sp.zero();
+	}
+	if(flag != NULL)
+		*flag = GetFlag(sp, w);
+	return sp;
+}
+
+#ifdef MQ3DLIB_USE_SSE
+// (x,y,z,1) * column c of the matrix for 4 points, in the same order of
+// operations as MQScreenProjector::Project(const MQPoint&)
+// 4点について(x,y,z,1)と行列のc列の積。MQScreenProjector::Project(const MQPoint&)と同じ演算順序
+static inline __m128 TransformColumnSSE(__m128 x, __m128 y, __m128 z, const __m128 *col)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, col[0]), _mm_mul_ps(y, col[1])),
+		_mm_add_ps(_mm_mul_ps(z, col[2]), col[3]));
+}
+#endif
+
+void MQScreenProjector::ProjectRange(const MQPoint *pts, int begin, int end, MQPoint *screen, BYTE *flags) const
+{
+	int i = begin;
+#ifdef MQ3DLIB_USE_SSE
+	__m128 col[4][4];
+	for(int c=0; c<4; c++){
+		for(int r=0; r<4; r++){
+			col[c][r] = _mm_set1_ps(m_matrix.d[r][c]);
+		}
+	}
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 rect_l = _mm_set1_ps(m_rect[0]);
+	const __m128 rect_t = _mm_set1_ps(m_rect[1]);
+	const __m128 rect_r = _mm_set1_ps(m_rect[2]);
+	const __m128 rect_b = _mm_set1_ps(m_rect[3]);
+	for(; i+4<=end; i+=4){
+		const MQPoint *p = pts + i;
+		__m128 x = _mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x);
+		__m128 y = _mm_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y);
+		__m128 z = _mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z);
+		__m128 w = TransformColumnSSE(x, y, z, col[3]);
+		__m128 sx = _mm_div_ps(TransformColumnSSE(x, y, z, col[0]), w);
+		__m128 sy = _mm_div_ps(TransformColumnSSE(x, y, z, col[1]), w);
+		__m128 sz = TransformColumnSSE(x, y, z, col[2]);
+		if(m_divide_z) sz = _mm_div_ps(sz, w);
+
+		float ax[4], ay[4], az[4];
+		_mm_storeu_ps(ax, sx);
+		_mm_storeu_ps(ay, sy);
+		_mm_storeu_ps(az, sz);
+		for(int k=0; k<4; k++){
+			screen[i+k].x = ax[k];
+			screen[i+k].y = ay[k];
+			screen[i+k].z = az[k];
+		}
+
+		if(flags != NULL){
+			int near_mask = _mm_movemask_ps(_mm_or_ps(_mm_cmple_ps(w, zero), _mm_cmple_ps(sz, zero)));
+			int left_mask = 0, top_mask = 0, right_mask = 0, bottom_mask = 0;
+			if(m_use_rect){
+				left_mask = _mm_movemask_ps(_mm_cmplt_ps(sx, rect_l));
+				top_mask = _mm_movemask_ps(_mm_cmplt_ps(sy, rect_t));
+				right_mask = _mm_movemask_ps(_mm_cmpgt_ps(sx, rect_r));
+				bottom_mask = _mm_movemask_ps(_mm_cmpgt_ps(sy, rect_b));
+			}
+			for(int k=0; k<4; k++){
+				BYTE flag = 0;
+				if(near_mask & (1 << k)) flag |= CLIP_NEAR;
+				if(left_mask & (1 << k)) flag |= CLIP_LEFT;
+				if(right_mask & (1 << k)) flag |= CLIP_RIGHT;
+				if(top_mask & (1 << k)) flag |= CLIP_TOP;
+				if(bottom_mask & (1 << k)) flag |= CLIP_BOTTOM;
+				flags[i+k] = flag;
+			}
+		}
+	}
+#endif
+	for(; i<end; i++){
+		screen[i] = Project(pts[i], flags != NULL ? &flags[i] : NULL);
+	}
+}
+
+//---------------------------------------------------------------------------
+//  MQScreenProjector::Project()
+//     Project points in threads. Without the matrix, Convert3DToScreen() is
+//     called in the calling thread because the host is not thread-safe.
+//     スレッドで点を投影する。行列がなければ、ホストはスレッドセーフでないので
+//     呼び出し元のスレッドでConvert3DToScreen()を呼ぶ。
+//---------------------------------------------------------------------------
+void MQScreenProjector::Project(const MQPoint *pts, int num, MQPoint *screen, BYTE *flags, int thread_num) const
+{
+	if(!m_valid){
+		for(int i=0; i<num; i++){
+			screen[i] = Project(pts[i], flags != NULL ? &flags[i] : NULL);
+		}
+		return;
+	}
+
+	MQParallelRange(num, thread_num, MQSCREENPROJECTOR_MIN_POINTS_PER_THREAD, [&](int begin, int end){
+		ProjectRange(pts, begin, end, screen, flags);
+	});
+}
+
+void MQScreenProjector::Project(MQObject obj, std::vector<MQPoint>& screen, std::vector<BYTE>& flags, int thread_num) const
+{
+	int num = obj->GetVertexCount();
+	screen.resize(num);
+	flags.resize(num);
+	if(num == 0)
+		return;
+
+	std::vector<MQPoint> pts(num);
+	obj->GetVertexArray(pts.data());
+	Project(pts.data(), num, screen.data(), flags.data(), thread_num);
+}
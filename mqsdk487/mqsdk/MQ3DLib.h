@@ -15,6 +15,8 @@
 #include <assert.h>
 #include <vector>
 #include <new>
+#include <thread>
+#include <algorithm>
 
 
 // Ratio of the circumference of a circle to its diameter
@@ -108,6 +110,48 @@ MQPoint GetQuadNormal(const MQPoint& p0, const MQPoint& p1, const MQPoint& p2, c
 // 多角形面の法線を得る
 MQPoint GetPolyNormal(const MQPoint *pts, int num);
 
+// Get normal vectors for many faces at once. Vertex indices of the face i are
+// stored in face_vert[face_offset[i]] to face_vert[face_offset[i+1]-1].
+// The results are the same as GetNormal(), GetQuadNormal() and GetPolyNormal().
+// If thread_num is 0, the number of threads is decided automatically.
+// 多数の面の法線をまとめて得る。面iの頂点インデックスは
+// face_vert[face_offset[i]]からface_vert[face_offset[i+1]-1]に格納する。
+// 結果はGetNormal(),GetQuadNormal(),GetPolyNormal()と同じ。
+// thread_numが0ならスレッド数を自動で決める。
+void GetFaceNormalArray(const MQPoint *pts, const int *face_offset, const int *face_vert,
+	int face_count, MQPoint *face_n, int thread_num = 0);
+
+// Divide [0, num) into ranges and call func(begin, end) in threads.
+// If thread_num is 0, the number of threads is decided automatically.
+// Each thread processes min_per_thread items at least.
+// The first range is processed in the calling thread.
+// [0, num)を区間に分けてスレッドでfunc(begin, end)を呼ぶ。
+// thread_numが0ならスレッド数を自動で決める。
+// 1スレッドで少なくともmin_per_thread個を処理する。先頭の区間は呼び出し元のスレッドで処理する。
+template<typename F> void MQParallelRange(int num, int thread_num, int min_per_thread, F func)
+{
+	if(num <= 0)
+		return;
+	if(thread_num <= 0)
+		thread_num = (std::max)(1, (int)std::thread::hardware_concurrency());
+	thread_num = (std::min)(thread_num, (std::max)(1, num / (std::max)(1, min_per_thread)));
+	if(thread_num <= 1){
+		func(0, num);
+		return;
+	}
+
+	int chunk = (num + thread_num - 1) / thread_num;
+	std::vector<std::thread> threads;
+	for(int begin=chunk; begin<num; begin+=chunk){
+		int end = (std::min)(begin + chunk, num);
+		threads.emplace_back([&func, begin, end]() { func(begin, end); });
+	}
+	func(0, (std::min)(chunk, num));
+	for(size_t i=0; i<threads.size(); i++){
+		threads[i].join();
+	}
+}
+
 // Get an area of a triangle constituted by three points
 // 3点からなる三角形の面積を得る
 float GetTriangleArea(const MQPoint& p1, const MQPoint& p2, const MQPoint& p3);
@@ -196,6 +240,13 @@ template<typename T> void MQApexValueBaseSetter<T>::clear()
 
 //---------------------------------------------------------------------------
 //  MQApexValueBase class
+//     Values for each apex of faces. Normally each face has a slot of N values
+//     in a shared buffer, and faces with more points are allocated separately.
+//     After allocPacked(), all faces are placed in one contiguous arena at the
+//     prefix sum of their point counts.
+//     面の頂点ごとの値。通常は各面が共有バッファ内にN個分の枠を持ち、
+//     それより点数の多い面は個別に確保する。allocPacked()の後は、全ての面が
+//     点数の累積和の位置で1つの連続した領域に置かれる。
 //---------------------------------------------------------------------------
 
 template<typename T, typename S = MQApexValueBaseSetter<T>, int N = 4> class MQApexValueBase
@@ -209,6 +260,11 @@ public:
 
 	template<typename F> bool alloc(F *faces, size_t num);
 	template<typename F> bool alloc(F *faces, size_t num, size_t capacity_size, T init_value = T());
+	// Allocate all faces in one arena. Each face has the larger of its point count and N values.
+	// 全ての面を1つの領域に確保する。各面は点数とNの大きい方の数の値を持つ。
+	bool allocPacked(const int *point_counts, size_t num, T init_value = T());
+	bool allocPacked(MQObject obj, T init_value = T());
+	bool isPacked() const { return !offsets.empty(); }
 	bool resize(size_t capacity_size, T init_value = T());
 	size_t size() const { return pointers.size(); }
 	void clear();
@@ -224,7 +280,19 @@ public:
 protected:
 	S pointers;
 	std::vector<T> buffer;
+	std::vector<size_t> offsets;
 	int itemarray_num;
+
+	T *getSlot(size_t index) {
+		T *buf = !buffer.empty() ? &(*buffer.begin()) : NULL;
+		return buf + (offsets.empty() ? index*N : offsets[index]) * itemarray_num;
+	}
+	size_t getSlotCapacity(size_t index) const {
+		return offsets.empty() ? N : offsets[index+1] - offsets[index];
+	}
+	bool isInBuffer(const T *p) const {
+		return !buffer.empty() && p >= &(*buffer.begin()) && p < &(*buffer.begin()) + buffer.size();
+	}
 };
 
 
@@ -301,22 +369,70 @@ template<typename T, typename S, int N> template<typename F> bool MQApexValueBas
 	return true;
 }
 
+template<typename T, typename S, int N> bool MQApexValueBase<T,S,N>::allocPacked(const int *point_counts, size_t num, T init_value)
+{
+	clear();
+
+	try{
+		offsets.resize(num+1);
+		offsets[0] = 0;
+		for(size_t i=0; i<num; i++){
+			size_t count = (point_counts[i] > 0) ? (size_t)point_counts[i] : 0;
+			offsets[i+1] = offsets[i] + ((count > N) ? count : N);
+		}
+		buffer.resize(offsets[num]*itemarray_num, init_value);
+		pointers.resize(num);
+	}catch(std::bad_alloc&){
+		offsets.clear();
+		buffer.clear();
+		pointers.clear();
+		return false;
+	}
+
+	for(size_t i=0; i<num; i++){
+		pointers[i] = getSlot(i);
+	}
+	return true;
+}
+
+template<typename T, typename S, int N> bool MQApexValueBase<T,S,N>::allocPacked(MQObject obj, T init_value)
+{
+	int face_count = obj->GetFaceCount();
+	std::vector<int> point_counts(face_count);
+	for(int i=0; i<face_count; i++){
+		point_counts[i] = obj->GetFacePointCount(i);
+	}
+	return allocPacked(point_counts.empty() ? NULL : &(*point_counts.begin()), face_count, init_value);
+}
+
 template<typename T, typename S, int N> bool MQApexValueBase<T,S,N>::resize(size_t capacity_size, T init_value)
 {
 	size_t oldptcap = pointers.size();
 	T *oldbuf = !buffer.empty() ? &(*buffer.begin()) : NULL;
+	size_t oldbufsize = buffer.size();
 
 	if(oldptcap > capacity_size){
 		for(size_t i=capacity_size; i<oldptcap; i++){
-			if(pointers[i] != oldbuf + i*itemarray_num*N){
+			if(!isInBuffer(pointers[i])){
 				delete[] pointers[i];
-				pointers[i] = oldbuf + i*itemarray_num*N;
+				pointers[i] = getSlot(i);
 			}
 		}
 	}
 
 	try{
-		buffer.resize(capacity_size*itemarray_num*N, init_value);
+		if(isPacked()){
+			// 追加した面はN個分の枠を持つ
+			// Added faces have slots of N values.
+			size_t keep = (capacity_size < oldptcap) ? capacity_size : oldptcap;
+			offsets.resize(capacity_size+1);
+			for(size_t i=keep; i<capacity_size; i++){
+				offsets[i+1] = offsets[i] + N;
+			}
+			buffer.resize(offsets[capacity_size]*itemarray_num, init_value);
+		}else{
+			buffer.resize(capacity_size*itemarray_num*N, init_value);
+		}
 		pointers.resize(capacity_size);
 	}catch(std::bad_alloc&){
 		return false;
@@ -327,13 +443,13 @@ template<typename T, typename S, int N> bool MQApexValueBase<T,S,N>::resize(size
 	if(oldbuf != newbuf){
 		size_t num = (capacity_size < oldptcap) ? capacity_size : oldptcap;
 		for(size_t i=0; i<num; i++){
-			if(pointers[i] == oldbuf + i*itemarray_num*N){
-				pointers[i] = newbuf + i*itemarray_num*N;
+			if(pointers[i] >= oldbuf && pointers[i] < oldbuf + oldbufsize){
+				pointers[i] = newbuf + (pointers[i] - oldbuf);
 			}
 		}
 	}
 	for(size_t i=oldptcap; i<capacity_size; i++){
-		pointers[i] = newbuf + i*itemarray_num*N;
+		pointers[i] = getSlot(i);
 	}
 
 	return true;
@@ -341,44 +457,32 @@ template<typename T, typename S, int N> bool MQApexValueBase<T,S,N>::resize(size
 
 template<typename T, typename S, int N> void MQApexValueBase<T,S,N>::clear()
 {
-	T *buf = !buffer.empty() ? &(*buffer.begin()) : NULL;
-
 	size_t faceNum = pointers.size();
 	for(size_t i=0; i<faceNum; i++){
-		if(pointers[i] != buf + i*itemarray_num*N){
+		if(!isInBuffer(pointers[i])){
 			delete[] pointers[i];
 		}
 	}
 
 	buffer.clear();
 	pointers.clear();
+	offsets.clear();
 }
 
 template<typename T, typename S, int N> bool MQApexValueBase<T,S,N>::resizeItem(int index, int vert_num)
 {
 	assert(index < (int)pointers.size());
 
-	T *buf = !buffer.empty() ? &(*buffer.begin()) : NULL;
-	
-	if(pointers[index] == buf + index*itemarray_num*N){
-		if(vert_num > N){
-			T *p = new(std::nothrow) T[vert_num * itemarray_num];
-			if(p == NULL){
-				return false;
-			}
-			pointers[index] = p;
-		}
-	}else{
+	if(!isInBuffer(pointers[index])){
 		delete[] pointers[index];
-		if(vert_num > N){
-			T *p = new(std::nothrow) T[vert_num * itemarray_num];
-			if(p == NULL){
-				return false;
-			}
-			pointers[index] = p;
-		}else{
-			pointers[index] = buf + index*itemarray_num*N;
+		pointers[index] = getSlot(index);
+	}
+	if(vert_num > (int)getSlotCapacity(index)){
+		T *p = new(std::nothrow) T[vert_num * itemarray_num];
+		if(p == NULL){
+			return false;
 		}
+		pointers[index] = p;
 	}
 	return true;
 }
@@ -391,7 +495,11 @@ class MQObjNormal
 protected:
 	MQApexValueBase<MQPoint> normal;
 public:
-	MQObjNormal(MQObject obj);
+	// If calc_smooth is true, normals for Gouraud shading are smoothed by the
+	// smoothing angle in this class instead of being got from the host.
+	// calc_smoothがtrueの場合、グーローシェーディングの法線をホストから取得せず、
+	// スムージング角度によってこのクラス内で平滑化する。
+	MQObjNormal(MQObject obj, bool calc_smooth = false);
 	~MQObjNormal();
 
 	MQPoint& Get(int face_index, int pt_index) {
@@ -399,6 +507,51 @@ public:
 	}
 };
 
+// Class for keeping normal vectors in an object and updating them partially
+// オブジェクト中の法線を保持して部分的に更新するクラス
+class MQObjNormalCache
+{
+public:
+	MQObjNormalCache();
+	~MQObjNormalCache();
+
+	// Calculate all normals.
+	// 全ての法線を計算する
+	void Build(MQObject obj);
+	// Recalculate normals around the moved vertices. If the numbers of vertices
+	// or faces, the shading or the smoothing angle was changed, Build() is called.
+	// Changes of face composition with the same face count are not detected.
+	// 移動した頂点の周りの法線を計算し直す。頂点数や面数、シェーディング、
+	// スムージング角度が変わっていればBuild()を呼ぶ。
+	// 面数が同じままの面の構成の変更は検出しない。
+	void Update(MQObject obj, const int *vert_index, int num);
+	bool IsValid(MQObject obj) const;
+	void Clear();
+
+	int GetFaceCount() const { return m_face_offset.empty() ? 0 : (int)m_face_offset.size()-1; }
+	const MQPoint& GetFaceNormal(int face_index) const { return m_face_n[face_index]; }
+	const MQPoint& Get(int face_index, int pt_index) const {
+		return m_apex_n[m_face_offset[face_index] + pt_index];
+	}
+
+protected:
+	int m_shading;
+	float m_facet;
+	std::vector<MQPoint> m_pts;
+	std::vector<int> m_face_offset;
+	std::vector<int> m_face_vert;
+	std::vector<MQPoint> m_face_n;
+	std::vector<MQPoint> m_apex_n;
+	std::vector<int> m_apex_face;
+	std::vector<int> m_vert_offset;
+	std::vector<int> m_vert_apex;
+	unsigned int m_stamp;
+	std::vector<unsigned int> m_face_stamp;
+	std::vector<unsigned int> m_vert_stamp;
+	std::vector<int> m_dirty_face;
+	std::vector<int> m_dirty_vert;
+};
+
 // Class for calculating normal vectors with indices in an object
 // オブジェクト中の法線を計算するクラス
 class MQObjIndexedNormal
@@ -434,6 +587,60 @@ public:
 };
 
 
+// Half-edge structure of faces with 3 or more points in an object
+// Half-edge index is face_offset[face] + line, and the line goes from the line-th
+// vertex to the next one. Lines (faces with 2 points) have no twins and are not
+// included in vertex rings.
+// オブジェクト中の3点以上の面のハーフエッジ構造
+// ハーフエッジ番号は face_offset[face] + line で、line番目の頂点から次の頂点へ向かう。
+// 線(2点の面)は対を持たず、頂点の周囲にも含まれない。
+class MQObjHalfEdge
+{
+public:
+	MQObjHalfEdge();
+	MQObjHalfEdge(MQObject obj, int thread_num = 0);
+	~MQObjHalfEdge();
+
+	// Build from an object, or from faces in CSR arrays. thread_num = 0 uses all cores.
+	// オブジェクトか、圧縮行形式の面の配列から構築する。thread_num = 0 で全コアを使う。
+	void Build(MQObject obj, int thread_num = 0);
+	void Build(const int *face_offset, const int *face_vert, int face_count, int vert_count, int thread_num = 0);
+	void Clear();
+
+	int GetFaceCount() const { return m_face_offset.empty() ? 0 : (int)m_face_offset.size()-1; }
+	int GetVertexCount() const { return m_vert_offset.empty() ? 0 : (int)m_vert_offset.size()-1; }
+	int GetHalfEdgeCount() const { return (int)m_face_vert.size(); }
+	int GetFacePointCount(int face) const { return m_face_offset[face+1] - m_face_offset[face]; }
+	const int *GetFacePointArray(int face) const { return &m_face_vert[m_face_offset[face]]; }
+
+	int GetHalfEdge(int face, int line) const { return m_face_offset[face] + line; }
+	int GetFace(int he) const { return m_he_face[he]; }
+	int GetLine(int he) const { return he - m_face_offset[m_he_face[he]]; }
+	// The opposite half-edge, or -1 on a border
+	// 反対向きのハーフエッジ。境界では-1
+	int GetTwin(int he) const { return m_twin[he]; }
+	int GetNext(int he) const { int f = m_he_face[he]; return (he+1 < m_face_offset[f+1]) ? he+1 : m_face_offset[f]; }
+	int GetPrev(int he) const { int f = m_he_face[he]; return (he > m_face_offset[f]) ? he-1 : m_face_offset[f+1]-1; }
+	int GetStartVertex(int he) const { return m_face_vert[he]; }
+	int GetEndVertex(int he) const { return m_face_vert[GetNext(he)]; }
+	// Half-edges going out of a vertex in order of the face index
+	// 頂点から出るハーフエッジ。面番号の順に並ぶ
+	int GetVertexHalfEdgeCount(int vert) const { return m_vert_offset[vert+1] - m_vert_offset[vert]; }
+	const int *GetVertexHalfEdgeArray(int vert) const { return m_vert_he.data() + m_vert_offset[vert]; }
+
+	bool GetPair(int face_index, int line_index, int& pair_face, int& pair_line) const;
+
+protected:
+	std::vector<int> m_face_offset;
+	std::vector<int> m_face_vert;
+	std::vector<int> m_he_face;
+	std::vector<int> m_twin;
+	std::vector<int> m_vert_offset;
+	std::vector<int> m_vert_he;
+
+	void MakeTwin(int thread_num);
+};
+
 // Class for managing pairs of edges
 // オブジェクトのエッジ対管理クラス
 class MQObjEdge
@@ -453,4 +660,63 @@ public:
 };
 
 
+// Projection of many points from 3D to the screen of a scene
+// The matrix of the scene is got once by sampling Convert3DToScreen(), and
+// points are projected with SIMD in threads. If the matrix cannot be got,
+// Convert3DToScreen() is called for each point instead.
+// シーンのスクリーンへの多数の点の投影
+// シーンの行列はConvert3DToScreen()の標本から一度だけ求め、点はスレッドでSIMDにより投影する。
+// 行列が求められない場合は各点についてConvert3DToScreen()を呼ぶ。
+class MQScreenProjector
+{
+public:
+	enum CLIP_FLAG {
+		CLIP_NEAR   = 0x01,	// in front of the near plane (the same as z <= 0 in IsFrontFace())
+		CLIP_LEFT   = 0x02,	// the following flags are set only after SetScreenRect()
+		CLIP_RIGHT  = 0x04,
+		CLIP_TOP    = 0x08,
+		CLIP_BOTTOM = 0x10,
+	};
+
+	MQScreenProjector();
+	MQScreenProjector(MQScene scene);
+
+	// Get the matrix from a scene. Returns false if the conversion is not projective.
+	// シーンから行列を取得する。変換が射影でなければfalseを返す。
+	bool Init(MQScene scene);
+	// Set the matrix directly. (x,y,z,1)*matrix gives (sx*w, sy*w, Z, w), and the
+	// screen z is Z/w if divide_z is true, or Z if not.
+	// 行列を直接設定する。(x,y,z,1)*matrixが(sx*w, sy*w, Z, w)となり、
+	// スクリーンのzはdivide_zがtrueならZ/w、falseならZとなる。
+	void SetMatrix(const MQMatrix& matrix, bool divide_z);
+	// Set the visible rectangle on the screen to get CLIP_LEFT to CLIP_BOTTOM flags
+	// CLIP_LEFTからCLIP_BOTTOMのフラグを得るためにスクリーン上の表示範囲を設定する
+	void SetScreenRect(float left, float top, float right, float bottom);
+	void ResetScreenRect() { m_use_rect = false; }
+
+	bool IsValid() const { return m_valid; }
+	const MQMatrix& GetMatrix() const { return m_matrix; }
+	bool IsDividingZ() const { return m_divide_z; }
+
+	MQPoint Project(const MQPoint& p, BYTE *flag = NULL) const;
+	// Project points. flags can be NULL. thread_num = 0 uses all cores.
+	// 点を投影する。flagsはNULLでもよい。thread_num = 0 で全コアを使う。
+	void Project(const MQPoint *pts, int num, MQPoint *screen, BYTE *flags = NULL, int thread_num = 0) const;
+	// Project all vertices of an object
+	// オブジェクトの全頂点を投影する
+	void Project(MQObject obj, std::vector<MQPoint>& screen, std::vector<BYTE>& flags, int thread_num = 0) const;
+
+protected:
+	MQScene m_scene;
+	MQMatrix m_matrix;
+	bool m_valid;
+	bool m_divide_z;
+	bool m_use_rect;
+	float m_rect[4];
+
+	BYTE GetFlag(const MQPoint& sp, float w) const;
+	void ProjectRange(const MQPoint *pts, int begin, int end, MQPoint *screen, BYTE *flags) const;
+};
+
+
 #endif //MQ3DLIB_H
@@ -13,6 +13,7 @@
 #include <windows.h>
 #endif
 #include "MQBoneManager.h"
+#include <algorithm>
 
 static const DWORD bone_plugin_product = 0x56A31D20;
 static const DWORD bone_plugin_id = 0x71F282AB;
@@ -641,6 +642,183 @@ void MQBoneManager::SetMovable(UINT bone_id, bool movable)
 	array[4] = nullptr;
 	m_Plugin->SendUserMessage(m_Doc, bone_plugin_product, bone_plugin_id, "SetBone", array);
 }
+
+void MQBoneManager::SetDeformArray(const DEFORM_PARAM *params, size_t num, bool update)
+{
+	if(!m_Verified) return;
+
+	for(size_t i=0; i<num; i++){
+		const DEFORM_PARAM& param = params[i];
+		UINT bone_id = param.bone_id;
+
+		void *array[9];
+		int n = 0;
+		array[n++] = (void*)"id";
+		array[n++] = &bone_id;
+		if(param.set_flags & DEFORM_PARAM::SET_TRANSLATE){
+			array[n++] = (void*)"translate";
+			array[n++] = (void*)&param.translate;
+		}
+		if(param.set_flags & DEFORM_PARAM::SET_ROTATE){
+			array[n++] = (void*)"rotate";
+			array[n++] = (void*)&param.rotate;
+		}
+		if(param.set_flags & DEFORM_PARAM::SET_SCALE){
+			array[n++] = (void*)"scale";
+			array[n++] = (void*)&param.scale;
+		}
+		array[n] = nullptr;
+		if(n > 2){
+			m_Plugin->SendUserMessage(m_Doc, bone_plugin_product, bone_plugin_id, "SetBone", array);
+		}
+	}
+
+	if(update){
+		Update();
+	}
+}
+
+void MQBoneManager::BONE_SNAPSHOT::clear()
+{
+	id.clear();
+	parent.clear();
+	child_num.clear();
+	base_pos.clear();
+	base_matrix.clear();
+	deform_pos.clear();
+	deform_matrix.clear();
+	deform_scale.clear();
+	name.clear();
+	dummy.clear();
+	sorted_index.clear();
+	flags = 0;
+}
+
+void MQBoneManager::BONE_SNAPSHOT::resize(size_t num)
+{
+	MQMatrix identity;
+	identity.Identify();
+
+	id.resize(num, 0);
+	parent.resize(num, 0);
+	child_num.resize(num, 0);
+	base_pos.resize(num, MQPoint(0,0,0));
+	base_matrix.resize(num, identity);
+	deform_pos.resize(num, MQPoint(0,0,0));
+	deform_matrix.resize(num, identity);
+	deform_scale.resize(num, MQPoint(1,1,1));
+	name.resize(num);
+	dummy.resize(num, 0);
+}
+
+void MQBoneManager::BONE_SNAPSHOT::buildIndex()
+{
+	sorted_index.resize(id.size());
+	for(size_t i=0; i<id.size(); i++){
+		sorted_index[i] = std::pair<UINT,int>(id[i], (int)i);
+	}
+	std::sort(sorted_index.begin(), sorted_index.end());
+}
+
+int MQBoneManager::BONE_SNAPSHOT::indexOf(UINT bone_id) const
+{
+	auto it = std::lower_bound(sorted_index.begin(), sorted_index.end(), std::pair<UINT,int>(bone_id, -1));
+	if(it == sorted_index.end() || it->first != bone_id)
+		return -1;
+	return it->second;
+}
+
+int MQBoneManager::GetBoneSnapshot(BONE_SNAPSHOT& snapshot, DWORD flags)
+{
+	snapshot.clear();
+	if(!m_Verified) return 0;
+
+	int num = EnumBoneID(snapshot.id);
+	snapshot.resize(num);
+	snapshot.buildIndex();
+
+	return QueryBoneSnapshot(snapshot, flags);
+}
+
+int MQBoneManager::RefreshBoneSnapshot(BONE_SNAPSHOT& snapshot, DWORD flags, bool *rebuilt)
+{
+	if(rebuilt != nullptr) *rebuilt = false;
+	if(!m_Verified) return 0;
+
+	// Rebuild all if bones have been added, deleted or replaced.
+	// Comparing only the number misses a bone deleted and another one added.
+	std::vector<UINT> bone_id_array;
+	EnumBoneID(bone_id_array);
+	if(bone_id_array != snapshot.id){
+		DWORD all_flags = flags | snapshot.flags;
+		snapshot.clear();
+		snapshot.id.swap(bone_id_array);
+		snapshot.resize(snapshot.id.size());
+		snapshot.buildIndex();
+		if(rebuilt != nullptr) *rebuilt = true;
+		return QueryBoneSnapshot(snapshot, all_flags);
+	}
+	return QueryBoneSnapshot(snapshot, flags);
+}
+
+int MQBoneManager::QueryBoneSnapshot(BONE_SNAPSHOT& snapshot, DWORD flags)
+{
+	int num = (int)snapshot.size();
+	if(flags == 0)
+		return num;
+
+	for(int i=0; i<num; i++){
+		UINT bone_id = snapshot.id[i];
+		const wchar_t *name = nullptr;
+		bool dummy = false;
+
+		// Request all attributes of the bone at once.
+		void *array[21];
+		int n = 0;
+		array[n++] = (void*)"id";
+		array[n++] = &bone_id;
+		if(flags & SNAPSHOT_HIERARCHY){
+			array[n++] = (void*)"parent";
+			array[n++] = &snapshot.parent[i];
+			array[n++] = (void*)"child_num";
+			array[n++] = &snapshot.child_num[i];
+		}
+		if(flags & SNAPSHOT_BASE){
+			array[n++] = (void*)"org_pos";
+			array[n++] = &snapshot.base_pos[i];
+			array[n++] = (void*)"base_matrix";
+			array[n++] = snapshot.base_matrix[i].t;
+		}
+		if(flags & SNAPSHOT_DEFORM){
+			array[n++] = (void*)"def_pos";
+			array[n++] = &snapshot.deform_pos[i];
+			array[n++] = (void*)"matrix";
+			array[n++] = snapshot.deform_matrix[i].t;
+			array[n++] = (void*)"scale";
+			array[n++] = &snapshot.deform_scale[i];
+		}
+		if(flags & SNAPSHOT_NAME){
+			array[n++] = (void*)"name";
+			array[n++] = &name;
+			array[n++] = (void*)"dummy";
+			array[n++] = &dummy;
+		}
+		array[n] = nullptr;
+		int ret = m_Plugin->SendUserMessage(m_Doc, bone_plugin_product, bone_plugin_id, "GetBone", array);
+		if(!ret)
+			continue;
+
+		if(flags & SNAPSHOT_NAME){
+			if(name != nullptr)
+				snapshot.name[i] = std::wstring(name);
+			else
+				snapshot.name[i].clear();
+			snapshot.dummy[i] = dummy ? 1 : 0;
+		}
+	}
+	snapshot.flags |= flags;
+	return num;
+}
 /*
 bool MQBoneManager::GetTipBone(UINT bone_id, UINT& tip_bone_id)
 {
@@ -1976,6 +2154,126 @@ bool MQBoneManager::NormalizeVertexWeight(MQObject obj, UINT vertex_id)
 	return (ret != 0);
 }
 
+int MQBoneManager::GetVertexWeightTable(MQObject obj, VERTEX_WEIGHT_TABLE& table, int max_weight_num)
+{
+	table.clear();
+	if(!m_Verified) return 0;
+
+	if(obj == nullptr)
+		return 0;
+	int vert_num = obj->GetVertexCount();
+	table.offsets.resize(vert_num + 1, 0);
+	if(vert_num == 0)
+		return 0;
+
+	// A query per bone needs two messages, and a query per vertex needs one.
+	int bone_num = GetBoneNum();
+	if(bone_num * 2 + 1 < vert_num){
+		std::vector<UINT> bone_id_array;
+		EnumBoneID(bone_id_array);
+
+		std::vector<std::vector<UINT>> bone_vertex_ids(bone_num);
+		std::vector<std::vector<float>> bone_weights(bone_num);
+		for(int bi=0; bi<bone_num; bi++){
+			int num = GetWeightedVertexArray(bone_id_array[bi], obj, bone_vertex_ids[bi], bone_weights[bi]);
+			// Convert unique IDs to indices in place.
+			for(int i=0; i<num; i++){
+				int vi = obj->GetVertexIndexFromUniqueID(bone_vertex_ids[bi][i]);
+				bone_vertex_ids[bi][i] = (UINT)vi;
+				if(vi >= 0 && vi < vert_num)
+					table.offsets[vi+1]++;
+			}
+		}
+
+		for(int vi=0; vi<vert_num; vi++){
+			table.offsets[vi+1] += table.offsets[vi];
+		}
+		table.bone_ids.resize(table.offsets[vert_num]);
+		table.weights.resize(table.offsets[vert_num]);
+
+		std::vector<int> cursor(table.offsets.begin(), table.offsets.end() - 1);
+		for(int bi=0; bi<bone_num; bi++){
+			size_t num = bone_vertex_ids[bi].size();
+			for(size_t i=0; i<num; i++){
+				int vi = (int)bone_vertex_ids[bi][i];
+				if(vi < 0 || vi >= vert_num)
+					continue;
+				int pos = cursor[vi]++;
+				table.bone_ids[pos] = bone_id_array[bi];
+				table.weights[pos] = bone_weights[bi][i];
+			}
+		}
+	}else{
+		std::vector<UINT> vert_bone_ids(max_weight_num);
+		std::vector<float> vert_weights(max_weight_num);
+		table.bone_ids.reserve(vert_num);
+		table.weights.reserve(vert_num);
+		for(int vi=0; vi<vert_num; vi++){
+			UINT vert_id = obj->GetVertexUniqueID(vi);
+			int num = GetVertexWeightArray(obj, vert_id, max_weight_num, vert_bone_ids.data(), vert_weights.data());
+			if(num > max_weight_num)
+				num = max_weight_num;
+			for(int i=0; i<num; i++){
+				table.bone_ids.push_back(vert_bone_ids[i]);
+				table.weights.push_back(vert_weights[i]);
+			}
+			table.offsets[vi+1] = (int)table.bone_ids.size();
+		}
+	}
+
+	return table.offsets[vert_num];
+}
+
+int MQBoneManager::SetVertexWeightTable(MQObject obj, const VERTEX_WEIGHT_TABLE& table)
+{
+	if(!m_Verified) return 0;
+
+	if(obj == nullptr)
+		return 0;
+	int vert_num = obj->GetVertexCount();
+	if(table.GetVertexCount() < vert_num)
+		vert_num = table.GetVertexCount();
+	if(vert_num == 0)
+		return 0;
+
+	AddSkinObject(obj);
+
+	// The message array is built once and only the values are changed per weight.
+	UINT obj_id = obj->GetUniqueID();
+	UINT bone_id = 0;
+	UINT vertex_id = 0;
+	float weight = 0.f;
+	void *array[9];
+	array[0] = (void*)"bone";
+	array[1] = &bone_id;
+	array[2] = (void*)"object";
+	array[3] = &obj_id;
+	array[4] = (void*)"vertex";
+	array[5] = &vertex_id;
+	array[6] = (void*)"weight";
+	array[7] = &weight;
+	array[8] = nullptr;
+
+	int count = 0;
+	for(int vi=0; vi<vert_num; vi++){
+		int num = table.GetWeightNum(vi);
+		if(num == 0)
+			continue;
+		const UINT *bone_ids = table.GetBoneIDs(vi);
+		const float *weights = table.GetWeights(vi);
+		vertex_id = obj->GetVertexUniqueID(vi);
+		for(int i=0; i<num; i++){
+			if(weights[i] == 0.f)
+				continue;
+			bone_id = bone_ids[i];
+			weight = weights[i];
+			if(m_Plugin->SendUserMessage(m_Doc, bone_plugin_product, bone_plugin_id, "SetWeight", array) != 0)
+				count++;
+		}
+	}
+	return count;
+}
+
 int MQBoneManager::GetEffectLimitNum()
 {
 	if(!m_Verified) return 0;
@@ -118,6 +118,68 @@ public:
 	void SetIKChain(UINT bone_id, int chain);
 	void SetMovable(UINT bone_id, bool movable);
 	
+	// Batched deformation
+	// 複数ボーンの変形を一括で設定
+	struct DEFORM_PARAM {
+		enum {
+			SET_TRANSLATE = 0x01,
+			SET_ROTATE    = 0x02,
+			SET_SCALE     = 0x04,
+			SET_ALL       = 0x07,
+		};
+		UINT bone_id = 0;
+		DWORD set_flags = SET_ALL;
+		MQPoint translate = MQPoint(0,0,0);
+		MQAngle rotate = MQAngle(0,0,0);
+		MQPoint scale = MQPoint(1,1,1);
+	};
+	// Set the deformation of each bone with a single message, and call Update() once if 'update' is true.
+	void SetDeformArray(const DEFORM_PARAM *params, size_t num, bool update = true);
+
+	// Bone snapshot
+	// ボーン情報の一括取得
+	// Attributes of all bones stored as separate arrays (index is not a bone ID).
+	// Every bone is queried with a single message, instead of one message per attribute.
+	enum BONE_SNAPSHOT_FLAG {
+		SNAPSHOT_HIERARCHY = 0x01, // parent, child_num
+		SNAPSHOT_BASE      = 0x02, // base_pos, base_matrix
+		SNAPSHOT_DEFORM    = 0x04, // deform_pos, deform_matrix, deform_scale
+		SNAPSHOT_NAME      = 0x08, // name, dummy
+		SNAPSHOT_ALL       = 0x0F,
+	};
+	struct BONE_SNAPSHOT {
+		std::vector<UINT> id;
+		std::vector<UINT> parent;
+		std::vector<int> child_num;
+		std::vector<MQPoint> base_pos;
+		std::vector<MQMatrix> base_matrix;
+		std::vector<MQPoint> deform_pos;
+		std::vector<MQMatrix> deform_matrix;
+		std::vector<MQPoint> deform_scale;
+		std::vector<std::wstring> name;
+		std::vector<BYTE> dummy;
+		// Attributes which have been acquired (BONE_SNAPSHOT_FLAG)
+		DWORD flags = 0;
+
+		size_t size() const { return id.size(); }
+		void clear();
+		void resize(size_t num);
+		// Returns an index in the arrays, or -1 if not found.
+		int indexOf(UINT bone_id) const;
+
+	private:
+		friend class MQBoneManager;
+		std::vector<std::pair<UINT,int>> sorted_index;
+		void buildIndex();
+	};
+	// Enumerate all bones and acquire the specified attributes.
+	int GetBoneSnapshot(BONE_SNAPSHOT& snapshot, DWORD flags = SNAPSHOT_ALL);
+	// Re-acquire the specified attributes for the cached bones.
+	// The whole snapshot is rebuilt when the list of bone IDs has been changed,
+	// and 'rebuilt' receives whether it has been rebuilt.
+	// Call clear() for the snapshot when the document is switched.
+	int RefreshBoneSnapshot(BONE_SNAPSHOT& snapshot, DWORD flags = SNAPSHOT_DEFORM, bool *rebuilt = nullptr);
+
 	// Skin object
 	int GetSkinObjectNum();
 	int EnumSkinObjectID(std::vector<UINT>& obj_id_array);
@@ -128,6 +190,29 @@ public:
 	int GetWeightedVertexArray(UINT bone_id, MQObject obj, std::vector<UINT>& vertex_ids, std::vector<float>& weights);
 	bool NormalizeVertexWeight(MQObject obj, UINT vertex_id);
 
+	// Vertex weights of all vertices in an object (CSR layout)
+	// オブジェクト中の全頂点のウェイト
+	// Weights of the vertex index 'v' are stored in [offsets[v], offsets[v+1]).
+	struct VERTEX_WEIGHT_TABLE {
+		std::vector<int> offsets;
+		std::vector<UINT> bone_ids;
+		std::vector<float> weights;
+
+		int GetVertexCount() const { return offsets.empty() ? 0 : (int)offsets.size() - 1; }
+		int GetWeightNum(int vertex_index) const { return offsets[vertex_index+1] - offsets[vertex_index]; }
+		const UINT *GetBoneIDs(int vertex_index) const { return bone_ids.data() + offsets[vertex_index]; }
+		const float *GetWeights(int vertex_index) const { return weights.data() + offsets[vertex_index]; }
+		void clear() { offsets.clear(); bone_ids.clear(); weights.clear(); }
+	};
+	// Acquire weights of all vertices in 'obj'.
+	// Queries bone by bone when it needs fewer messages than querying vertex by vertex.
+	// 'max_weight_num' limits the number of weights per vertex in the vertex by vertex query.
+	int GetVertexWeightTable(MQObject obj, VERTEX_WEIGHT_TABLE& table, int max_weight_num = 16);
+	// Set weights of all vertices in 'obj' from a table in the same layout.
+	// Zero weights are skipped. Returns the number of weights set.
+	// 同じ形式の表から全頂点のウェイトを設定する
+	int SetVertexWeightTable(MQObject obj, const VERTEX_WEIGHT_TABLE& table);
+
 	// for PMD
 	//bool GetTipBone(UINT bone_id, UINT& tip_bone_id);
 	bool GetIKName(UINT bone_id, std::wstring& ik_name, std::wstring& ik_tip_name);
@@ -390,6 +475,8 @@ private:
 	MQBasePlugin *m_Plugin;
 	MQDocument m_Doc;
 	bool m_Verified;
+
+	int QueryBoneSnapshot(BONE_SNAPSHOT& snapshot, DWORD flags);
 };
 
 
@@ -296,6 +296,11 @@ MQPLUGIN_EXPORT DWORD MQCheckVersion(DWORD exe_version)
 	*(void**)&proc = CFBundleGetFunctionPointerForName(bundleRef, CFSTR(#proc)); \
 	if(proc == NULL) goto MQINIT_EXIT;
 #endif
+#if __linux__
+// The function pointers are assigned by MQMockHost::Install() in mockhost/.
+// 関数ポインタはmockhost/のMQMockHost::Install()で設定される
+#define GPA(proc)
+#endif
 
 //---------------------------------------------------------------------------
 //  MQInit
@@ -23,6 +23,10 @@
 #include <CoreFoundation/CFString.h>
 #include <CoreFoundation/CFByteOrder.h>
 #endif
+#if __linux__
+#include <codecvt>
+#include <locale>
+#endif
 #include "MQPlugin.h"
 #include <cmath>
 
@@ -321,6 +325,10 @@ std::wstring MQEncoding::Utf8ToWide(const char *ptr)
 	free(buffer);
 	return ret;
 #endif
+#if __linux__
+	std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> conv;
+	return conv.from_bytes(ptr);
+#endif
 }
 
 std::string MQEncoding::AnsiToUtf8(const char *ptr)
@@ -358,8 +366,12 @@ std::wstring MQEncoding::AnsiToWide(const char *ptr)
 	std::wstring str(strw);
 	free(strw);
 	return str;
-#else
+#elif __APPLE__
 	return StringUtil::CodePageStringToWide(ptr, StringUtil::kCodePage_Default);
+#else
+	// ANSI is treated as UTF-8 on Linux.
+	// LinuxではANSIをUTF-8として扱う
+	return Utf8ToWide(ptr);
 #endif
 }
 
@@ -375,8 +387,10 @@ std::wstring MQEncoding::AnsiToWideWithCodePage(const char *ptr, int codepage)
 	std::wstring str(strw);
 	free(strw);
 	return str;
-#else
+#elif __APPLE__
 	return StringUtil::CodePageStringToWide(ptr, codepage);
+#else
+	return Utf8ToWide(ptr);
 #endif
 }
 
@@ -392,8 +406,10 @@ std::string MQEncoding::WideToAnsi(const wchar_t *ptr)
 	std::string str(stru);
 	free(stru);
 	return str;
-#else
+#elif __APPLE__
 	return StringUtil::WideToCodePageString(ptr, StringUtil::kCodePage_Default);
+#else
+	return WideToUtf8(ptr);
 #endif
 }
 
@@ -409,8 +425,10 @@ std::string MQEncoding::WideToAnsiWithCodePage(const wchar_t *ptr, int codepage)
 	std::string str(stru);
 	free(stru);
 	return str;
-#else
+#elif __APPLE__
 	return StringUtil::WideToCodePageString(ptr, codepage);
+#else
+	return WideToUtf8(ptr);
 #endif
 }
 
@@ -440,6 +458,10 @@ std::string MQEncoding::WideToUtf8(const wchar_t *ptr)
 	free(buffer);
 	return ret;
 #endif
+#if __linux__
+	std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> conv;
+	return conv.to_bytes(ptr);
+#endif
 }
 
 #endif //MQPLUGIN_VERSION >= 0x0240
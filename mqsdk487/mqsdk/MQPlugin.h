@@ -16,6 +16,13 @@
 #include <math.h>
 #include <stdlib.h>
 #include <string>
+#if __linux__
+// Linux is not a host platform. It is used to build plug-ins against the mock host in mockhost/.
+// Linuxはホストではない。mockhost/の模擬ホストでビルドするために使う
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#endif
 
 // It treats as the latest revision if MQPLUGIN_VERSION is not defined in preprocessor.
 // プリプロセッサでMQPLUGIN_VERSIONが定義されていなければ最新として扱う
@@ -52,7 +59,7 @@ template<typename T> inline T min(T a, T b) { return (a < b) ? a : b; }
 template<typename T> inline T max(T a, T b) { return (a > b) ? a : b; }
 #endif
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 typedef char BOOL;
 typedef int INT;
 typedef unsigned int UINT;
@@ -101,7 +108,7 @@ inline POINT operator - (const POINT& a, const POINT& b) { POINT p = {a.x-b.x, a
 #define MQAPICALL __stdcall
 #endif
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 #define MQPLUGIN_EXPORT extern "C" __attribute__((visibility("default")))
 #define MQAPICALL
 #endif
@@ -109,11 +116,13 @@ inline POINT operator - (const POINT& a, const POINT& b) { POINT p = {a.x-b.x, a
 #if __APPLE__
 #include <sys/syslimits.h>
 #define MQ_MAX_PATH PATH_MAX
+#elif __linux__
+#define MQ_MAX_PATH PATH_MAX
 #else
 #define MQ_MAX_PATH MAX_PATH
 #endif
 
-#if __APPLE__
+#if __APPLE__ || __linux__
 #define MK_LBUTTON 0x01
 #define MK_RBUTTON 0x02
 #define MK_SHIFT   0x04
@@ -13,10 +13,21 @@
 #define NOMINMAX
 #include <windows.h>
 #endif
+#include <math.h>
 #include <algorithm>
 #include "MQSelectOperation.h"
 #include "MQ3DLib.h"
 
+// Maximum number of cells in the mask of a rope
+// 投げ縄のマスクの最大セル数
+#define MQSELECT_MAX_MASK_CELLS (1<<20)
+// Margin in pixels to put cells near the rope on the border
+// 投げ縄に近いセルを境界とする余裕(ピクセル)
+#define MQSELECT_MASK_MARGIN (0.01f)
+// Minimum number of points tested by one thread
+// 1スレッドで判定する点の最小数
+#define MQSELECT_MIN_POINTS_PER_THREAD (8192)
+
 
 MQSelectOperation::MQSelectOperation()
 {
@@ -27,6 +38,7 @@ void MQSelectOperation::Clear()
 {
 	Type = SELECT_NONE;
 	RopePoints.clear();
+	Mask.Valid = false;
 }
 
 void MQSelectOperation::Begin(SELECT_TYPE type, POINT mousePos)
@@ -35,6 +47,7 @@ void MQSelectOperation::Begin(SELECT_TYPE type, POINT mousePos)
 	DownPos = mousePos;
 	PrevPos = mousePos;
 	RopePoints.clear();
+	Mask.Valid = false;
 
 	switch(Type){
 	case SELECT_RECT:
@@ -56,6 +69,7 @@ void MQSelectOperation::Move(POINT mousePos)
 		if(!RopePoints.empty()){
 			if(RopePoints.back().x != mousePos.x || RopePoints.back().y != mousePos.y){
 				RopePoints.push_back(mousePos);
+				Mask.Valid = false;
 			}
 		}
 		break;
@@ -94,33 +108,195 @@ bool MQSelectOperation::IsInside(const MQPoint& pos) const
 		}
 		break;
 	case SELECT_ROPE:
-		if(RopePoints.size() >= 3)
+		if(Mask.Valid){
+			return IsInsideMask(pos);
+		}
+		return IsInsideRope(pos);
+	}
+	return false;
+}
+
+void MQSelectOperation::IsInside(const MQPoint *pts, size_t num, BYTE *out, int thread_num) const
+{
+	if(Type == SELECT_ROPE && !Mask.Valid){
+		BuildMask();
+	}
+
+	MQParallelRange((int)num, thread_num, MQSELECT_MIN_POINTS_PER_THREAD, [&](int begin, int end) {
+		for(int i=begin; i<end; i++){
+			out[i] = IsInside(pts[i]) ? 1 : 0;
+		}
+	});
+}
+
+bool MQSelectOperation::IsInsideRope(const MQPoint& pos) const
+{
+	if(RopePoints.size() >= 3)
+	{
+		int count = 0;
+		for(size_t j=0; j<RopePoints.size(); j++)
 		{
-			int count = 0;
-			for(size_t j=0; j<RopePoints.size(); j++)
+			size_t j1 = (j+1) % RopePoints.size();
+			size_t j2 = (j+2) % RopePoints.size();
+			if((pos.y > RopePoints[j].y && pos.y < RopePoints[j1].y)
+			|| (pos.y < RopePoints[j].y && pos.y > RopePoints[j1].y))
 			{
+				float t = (pos.y - RopePoints[j].y) / (RopePoints[j1].y - RopePoints[j].y);
+				if(pos.x < RopePoints[j].x*(1-t) + RopePoints[j1].x*t)
+					count++;
+			}
+			else if(pos.x < RopePoints[j1].x && pos.y == RopePoints[j1].y)
+			{
+				if((pos.y > RopePoints[j].y && pos.y < RopePoints[j2].y)
+				|| (pos.y < RopePoints[j].y && pos.y > RopePoints[j2].y))
+					count++;
+			}
+		}
+
+		return (count & 1);
+	}
+	return false;
+}
+
+//---------------------------------------------------------------------------
+//  MQSelectOperation::IsInsideMask()
+//     Test a point with the cell mask. Points in border cells or on rows of
+//     rope vertices are tested with IsInsideRope(), so the result is the same.
+//     セルのマスクで点を判定する。境界のセルや投げ縄の頂点と同じ行にある点は
+//     IsInsideRope()で判定するので、結果は変わらない。
+//---------------------------------------------------------------------------
+bool MQSelectOperation::IsInsideMask(const MQPoint& pos) const
+{
+	// 投げ縄の上下と右の外側は交差しない。NaNも外側になる
+	// Nothing crosses above, below or right of the rope. NaN is also outside.
+	if(!(pos.y >= Mask.Top && pos.y <= Mask.Bottom && pos.x <= Mask.Right + 1)){
+		return false;
+	}
+	float fy = floorf(pos.y);
+	if(fy == pos.y && Mask.VertexRows[(int)fy - Mask.Top]){
+		return IsInsideRope(pos);
+	}
+	// 左の外側では交差の数が偶数になる
+	// The number of crossings is even on the left of the rope.
+	if(pos.x < Mask.Left - 1){
+		return false;
+	}
+	if(pos.x < Mask.Left || pos.x > Mask.Right){
+		return IsInsideRope(pos);
+	}
+
+	int cx = std::min((int)((pos.x - Mask.Left) / Mask.CellSize), Mask.Width-1);
+	int cy = std::min((int)((pos.y - Mask.Top) / Mask.CellSize), Mask.Height-1);
+	switch(Mask.Cells[cy * Mask.Width + cx]){
+	case RopeMask::CELL_INSIDE:
+		return true;
+	case RopeMask::CELL_OUTSIDE:
+		return false;
+	}
+	return IsInsideRope(pos);
+}
+
+//---------------------------------------------------------------------------
+//  MQSelectOperation::BuildMask()
+//     Make the cell mask of the rope. Cells which the rope passes through are
+//     borders, and the others are filled by scanlines through their centers.
+//     投げ縄のセルのマスクを作る。投げ縄が通るセルは境界とし、
+//     それ以外はセルの中心を通る走査線で塗る。
+//---------------------------------------------------------------------------
+void MQSelectOperation::BuildMask() const
+{
+	Mask.Valid = false;
+	Mask.Cells.clear();
+	Mask.VertexRows.clear();
+	if(Type != SELECT_ROPE || RopePoints.size() < 3){
+		return;
+	}
+
+	Mask.Left = Mask.Right = RopePoints[0].x;
+	Mask.Top = Mask.Bottom = RopePoints[0].y;
+	for(size_t i=1; i<RopePoints.size(); i++){
+		Mask.Left = std::min(Mask.Left, (int)RopePoints[i].x);
+		Mask.Right = std::max(Mask.Right, (int)RopePoints[i].x);
+		Mask.Top = std::min(Mask.Top, (int)RopePoints[i].y);
+		Mask.Bottom = std::max(Mask.Bottom, (int)RopePoints[i].y);
+	}
+	int w = Mask.Right - Mask.Left;
+	int h = Mask.Bottom - Mask.Top;
+	double area = (double)std::max(w, 1) * std::max(h, 1);
+	Mask.CellSize = std::max(1, (int)ceil(sqrt(area / MQSELECT_MAX_MASK_CELLS)));
+	Mask.Width = w / Mask.CellSize + 1;
+	Mask.Height = h / Mask.CellSize + 1;
+	Mask.Cells.assign((size_t)Mask.Width * Mask.Height, RopeMask::CELL_OUTSIDE);
+	Mask.VertexRows.assign(h + 1, 0);
+	for(size_t i=0; i<RopePoints.size(); i++){
+		Mask.VertexRows[RopePoints[i].y - Mask.Top] = 1;
+	}
+
+	// 投げ縄が通るセルを境界にする
+	// Mark cells which the rope passes through as borders.
+	float cell = (float)Mask.CellSize;
+	for(size_t j=0; j<RopePoints.size(); j++){
+		const POINT& a = RopePoints[j];
+		const POINT& b = RopePoints[(j+1) % RopePoints.size()];
+		int ya = std::min(a.y, b.y);
+		int yb = std::max(a.y, b.y);
+		int cy0 = (ya - Mask.Top) / Mask.CellSize;
+		int cy1 = (yb - Mask.Top) / Mask.CellSize;
+		for(int cy=cy0; cy<=cy1; cy++){
+			float y0 = std::max((float)ya, Mask.Top + cy * cell);
+			float y1 = std::min((float)yb, Mask.Top + (cy+1) * cell);
+			float x0, x1;
+			if(a.y == b.y){
+				x0 = (float)a.x;
+				x1 = (float)b.x;
+			}else{
+				x0 = a.x + (b.x - a.x) * (y0 - a.y) / (float)(b.y - a.y);
+				x1 = a.x + (b.x - a.x) * (y1 - a.y) / (float)(b.y - a.y);
+			}
+			float xlo = std::min(x0, x1) - MQSELECT_MASK_MARGIN;
+			float xhi = std::max(x0, x1) + MQSELECT_MASK_MARGIN;
+			int cx0 = std::max((int)floorf((xlo - Mask.Left) / cell), 0);
+			int cx1 = std::min((int)floorf((xhi - Mask.Left) / cell), Mask.Width-1);
+			BYTE *row = &Mask.Cells[(size_t)cy * Mask.Width];
+			for(int cx=cx0; cx<=cx1; cx++){
+				row[cx] = RopeMask::CELL_BORDER;
+			}
+		}
+	}
+
+	// 各行でセルの中心を通る走査線と投げ縄の交点を求め、内外を塗る。
+	// 中心は整数でないので、頂点と同じ高さにはならない
+	// Fill inside and outside with crossings of the scanline through centers of
+	// cells in each row. Centers are not integers, so they never meet vertices.
+	MQParallelRange(Mask.Height, 0, 64, [&](int begin, int end) {
+		std::vector<float> xs;
+		for(int cy=begin; cy<end; cy++){
+			float sy = Mask.Top + cy * cell + 0.5f;
+			xs.clear();
+			for(size_t j=0; j<RopePoints.size(); j++){
 				size_t j1 = (j+1) % RopePoints.size();
-				size_t j2 = (j+2) % RopePoints.size();
-				if((pos.y > RopePoints[j].y && pos.y < RopePoints[j1].y)
-				|| (pos.y < RopePoints[j].y && pos.y > RopePoints[j1].y))
-				{
-					float t = (pos.y - RopePoints[j].y) / (RopePoints[j1].y - RopePoints[j].y);
-					if(pos.x < RopePoints[j].x*(1-t) + RopePoints[j1].x*t)
-						count++;
-				}
-				else if(pos.x < RopePoints[j1].x && pos.y == RopePoints[j1].y)
+				if((sy > RopePoints[j].y && sy < RopePoints[j1].y)
+				|| (sy < RopePoints[j].y && sy > RopePoints[j1].y))
 				{
-					if((pos.y > RopePoints[j].y && pos.y < RopePoints[j2].y)
-					|| (pos.y < RopePoints[j].y && pos.y > RopePoints[j2].y))
-						count++;
+					float t = (sy - RopePoints[j].y) / (RopePoints[j1].y - RopePoints[j].y);
+					xs.push_back(RopePoints[j].x*(1-t) + RopePoints[j1].x*t);
 				}
 			}
+			std::sort(xs.begin(), xs.end());
 
-			return (count & 1);
+			BYTE *row = &Mask.Cells[(size_t)cy * Mask.Width];
+			size_t k = 0;
+			for(int cx=0; cx<Mask.Width; cx++){
+				float sx = Mask.Left + cx * cell + 0.5f;
+				while(k < xs.size() && !(sx < xs[k])) k++;
+				if(row[cx] != RopeMask::CELL_BORDER && ((xs.size() - k) & 1)){
+					row[cx] = RopeMask::CELL_INSIDE;
+				}
+			}
 		}
-		break;
-	}
-	return false;
+	});
+
+	Mask.Valid = true;
 }
 
 void MQSelectOperation::Finish()
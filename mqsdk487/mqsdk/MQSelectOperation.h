@@ -30,6 +30,11 @@ public:
 	bool IsValid() const;
 	bool IsInside(POINT p) const { return IsInside(MQPoint((float)p.x, (float)p.y, 0.0f)); }
 	bool IsInside(const MQPoint& p) const;
+	// Test many points at once. out[i] is set to 1 if inside, or 0 if not.
+	// For a rope, a cell mask is made on the first call after the rope changed.
+	// 複数の点をまとめて判定する。内側ならout[i]に1、外側なら0をセットする。
+	// 投げ縄の場合、投げ縄が変わってから最初の呼び出しでセルのマスクを作る。
+	void IsInside(const MQPoint *pts, size_t num, BYTE *out, int thread_num = 0) const;
 	void Finish();
 
 	void Draw(MQCommandPlugin *plugin, MQDocument doc, MQScene scene);
@@ -37,9 +42,33 @@ public:
 	SELECT_TYPE GetType() const { return Type; }
 
 private:
+	// Cells over the bounding box of the rope. Each cell is outside, inside, or
+	// on the border which needs the exact test.
+	// 投げ縄の外接矩形を覆うセル。各セルは外側、内側、または正確な判定が必要な境界のいずれか。
+	struct RopeMask {
+		enum CELL {
+			CELL_OUTSIDE = 0,
+			CELL_INSIDE = 1,
+			CELL_BORDER = 2,
+		};
+		bool Valid;
+		int Left, Top, Right, Bottom;
+		int CellSize;
+		int Width, Height;
+		std::vector<BYTE> Cells;
+		std::vector<BYTE> VertexRows;	// rows with rope vertices need the exact test
+
+		RopeMask() { Valid = false; }
+	};
+
 	SELECT_TYPE Type;
 	POINT PrevPos, DownPos;
 	std::vector<POINT> RopePoints;
+	mutable RopeMask Mask;
+
+	bool IsInsideRope(const MQPoint& p) const;
+	bool IsInsideMask(const MQPoint& p) const;
+	void BuildMask() const;
 };
 
 
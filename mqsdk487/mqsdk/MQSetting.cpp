@@ -22,6 +22,7 @@
 #endif
 #include "MQPlugin.h"
 #include "MQSetting.h"
+#include <stdexcept>
 
 
 // Constructor
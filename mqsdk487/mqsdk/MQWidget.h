@@ -101,7 +101,7 @@ class MQCanvas;
 namespace MQKeyCode {
 enum KEY_CODE
 {
-#ifdef _WINDOWS
+#if defined(_WINDOWS) || __linux__
 	KEY_NONE = 0,
 	KEY_BACK = 8,
 	KEY_TAB = 9,
@@ -50,9 +50,9 @@ static int _matrixToGpb(const MQMatrix& src, float dst[16]) {
 }
 
 
-static bool	MQPointFuzzyEqual(MQPoint A, MQPoint B)
+static bool	MQPointFuzzyEqual(MQPoint A, MQPoint B, float eps = EPS)
 {
-	return ((fabs(A.x - B.x) < EPS) && (fabs(A.y - B.y) < EPS) && (fabs(A.z - B.z) < EPS));
+	return ((fabs(A.x - B.x) < eps) && (fabs(A.y - B.y) < eps) && (fabs(A.z - B.z) < eps));
 }
 
 static MAnsiString getMultiBytesSubstring(const MAnsiString& str, size_t maxlen)
@@ -231,6 +231,51 @@ int GPBOptionDialog::addUIs(int parent_frame_id, MLanguage& language)
 		this->combo_materialconv = w;
 	}
 
+	{
+		hframe = CreateHorizontalFrame(&parent);
+		CreateLabel(hframe, language.Search("MaterialMerge"));
+		auto w = CreateComboBox(hframe);
+		w->AddItem(language.Search("Disable"));
+		w->AddItem(language.Search("Enable"));
+		w->SetHintSizeRateX(8);
+		w->SetFillBeforeRate(1);
+		this->combo_materialmerge = w;
+	}
+
+	{
+		hframe = CreateHorizontalFrame(&parent);
+		CreateLabel(hframe, language.Search("TextureAtlas"));
+		auto w = CreateComboBox(hframe);
+		w->AddItem(language.Search("Disable"));
+		w->AddItem(language.Search("AtlasSelected"));
+		w->AddItem(language.Search("AtlasAll"));
+		w->SetHintSizeRateX(8);
+		w->SetFillBeforeRate(1);
+		this->combo_textureatlas = w;
+	}
+
+	{
+		hframe = CreateHorizontalFrame(&parent);
+		CreateLabel(hframe, language.Search("Weld"));
+		auto w = CreateComboBox(hframe);
+		w->AddItem(language.Search("Disable"));
+		w->AddItem(language.Search("Enable"));
+		w->SetHintSizeRateX(8);
+		w->SetFillBeforeRate(1);
+		this->combo_weld = w;
+	}
+
+	{
+		hframe = CreateHorizontalFrame(&parent);
+		CreateLabel(hframe, language.Search("ProfileLog"));
+		auto w = CreateComboBox(hframe);
+		w->AddItem(language.Search("Disable"));
+		w->AddItem(language.Search("Enable"));
+		w->SetHintSizeRateX(8);
+		w->SetFillBeforeRate(1);
+		this->combo_profilelog = w;
+	}
+
 	{
 		hframe = CreateHorizontalFrame(&parent);
 		CreateLabel(hframe, language.Search("Bone"));
@@ -259,6 +304,17 @@ int GPBOptionDialog::addUIs(int parent_frame_id, MLanguage& language)
 		w->SetFillBeforeRate(1);
 		this->combo_bonescalerot = w;
 	}
+	{
+		hframe = CreateHorizontalFrame(group);
+		CreateLabel(hframe, language.Search("SkinningMode"));
+
+		auto w = CreateComboBox(hframe);
+		w->AddItem(language.Search("SkinningLinear"));
+		w->AddItem(language.Search("SkinningDualQuat"));
+		w->SetHintSizeRateX(8);
+		w->SetFillBeforeRate(1);
+		this->combo_skinning = w;
+	}
 #if (USEEXTENDEDUI!=0)
 	{
 		hframe = CreateHorizontalFrame(group);
@@ -318,6 +374,8 @@ int GPBOptionDialog::setValues(CreateDialogOptionParam *option)
 
 		this->combo_bonescalerot->SetEnabled(boneui);
 		this->combo_bonescalerot->SetCurrentIndex(option->bone_scale_rot);
+		this->combo_skinning->SetEnabled(boneui);
+		this->combo_skinning->SetCurrentIndex(option->skinning_mode);
 #if (USEEXTENDEDUI!=0)
 		this->combo_boneconv->SetEnabled(boneui);
 		this->combo_boneconv->SetCurrentIndex(option->bone_conv);
@@ -327,6 +385,18 @@ int GPBOptionDialog::setValues(CreateDialogOptionParam *option)
 	this->combo_materialconv->SetEnabled(true);
 	this->combo_materialconv->SetCurrentIndex(option->material_conv);
 
+	this->combo_materialmerge->SetEnabled(true);
+	this->combo_materialmerge->SetCurrentIndex(option->material_merge);
+
+	this->combo_textureatlas->SetEnabled(true);
+	this->combo_textureatlas->SetCurrentIndex(option->texture_atlas);
+
+	this->combo_weld->SetEnabled(true);
+	this->combo_weld->SetCurrentIndex(option->weld);
+
+	this->combo_profilelog->SetEnabled(true);
+	this->combo_profilelog->SetCurrentIndex(option->profile_log);
+
 
 	return 0;
 }
@@ -345,8 +415,13 @@ int GPBOptionDialog::getValues(CreateDialogOptionParam *option)
 	option->input_xmlanim = this->combo_xmlanimfile->GetCurrentIndex();
 
 	option->material_conv = this->combo_materialconv->GetCurrentIndex();
+	option->material_merge = this->combo_materialmerge->GetCurrentIndex();
+	option->texture_atlas = this->combo_textureatlas->GetCurrentIndex();
+	option->weld = this->combo_weld->GetCurrentIndex();
+	option->profile_log = this->combo_profilelog->GetCurrentIndex();
 
 	option->bone_scale_rot = this->combo_bonescalerot->GetCurrentIndex();
+	option->skinning_mode = this->combo_skinning->GetCurrentIndex();
 #if (USEEXTENDEDUI!=0)
 	option->bone_conv = this->combo_boneconv->GetCurrentIndex();
 #else
@@ -364,6 +439,7 @@ BOOL GPBOptionDialog::ComboBoneChanged(MQWidgetBase *sender, MQDocument doc)
 	auto enable = this->combo_bone->GetCurrentIndex() != 0;
 
 	this->combo_bonescalerot->SetEnabled(enable);
+	this->combo_skinning->SetEnabled(enable);
 #if (USEEXTENDEDUI!=0)
 	this->combo_boneconv->SetEnabled(enable);
 #endif
@@ -535,6 +611,9 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 #ifdef _WIN32
 	// DLLフォルダ
 	MString dir = MFileUtil::extractDirectory(s_DllPath);
+#elif __linux__
+	// リソースフォルダが無いのでカレントフォルダ
+	MString dir = MFileUtil::getCurrentDirectory();
 #else
 	MString dir = GetResourceDir();
 #endif
@@ -562,87 +641,11 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 		}
 	}
 
-	MString keepName = L"unknown";
-
-	MQBoneManager bone_manager(this, doc);
-	std::vector<GPBMaterial> materials;
-
-	// ボーン処理をトータルで有効にするかどうか
-	bool outputBone = false;
-
-
-	int indexMesh = 0;
-	int indexScene = 1;
-	int indexAnimations = 2;
-	int indexNode = 3;
-	std::vector<GPBRef> refTable;
-	for (int i = 0; i < 4; ++i) {
-		GPBRef ref;
-		ref.offset = 0x00363534; // for check
-		switch (i) {
-		case 0:
-			ref.type = REF_MESH;
-			ref.name = MString(L"n0_Mesh");
-			break;
-		case 1:
-			ref.type = REF_SCENE;
-			ref.name = MString(L"__SCENE__");
-			break;
-		case 2:
-			ref.type = REF_ANIMATIONS;
-			ref.name = MString(L"__Animations__");
-			break;
-		case 3:
-			ref.type = REF_NODE;
-			ref.name = MString(L"n0");
-			break;
-		}
-		refTable.push_back(ref);
-	}
-
-
-
-	GPBScene scene;
-
-	// Query a number of bones ボーン数
-	int bone_num = bone_manager.GetBoneNum();
-	int bone_object_num = bone_manager.GetSkinObjectNum();
-
-	// Enum bones ボーンのIDリスト
-	std::vector<UINT> bone_id;
-	std::vector<GPBBoneParam> bone_param;
-	if (bone_num > 0) {
-		bone_id.resize(bone_num); // 領域確保する
-		bone_manager.EnumBoneID(bone_id); // IDリストを取得
-
-		bone_param.resize(bone_num); // 領域確保する
-		for (int i = 0; i < bone_num; i++) {
-			bone_param[i].id = bone_id[i];
-
-			std::wstring name;
-			// ボーンID指定して受け取り変数を指定する
-			bone_manager.GetParent(bone_id[i], bone_param[i].parent);
-			// 子ボーン個数
-			bone_manager.GetChildNum(bone_id[i], bone_param[i].child_num);
-
-			// 位置(相対?global?)
-			bone_manager.GetBasePos(bone_id[i], bone_param[i].org_pos);
-			// 変形後位置(相対?global?)
-			bone_manager.GetDeformPos(bone_id[i], bone_param[i].def_pos);
-
-			bone_manager.GetBaseMatrix(bone_id[i], bone_param[i].base_mtx);
-			bone_manager.GetDeformMatrix(bone_id[i], bone_param[i].mtx);
-
-			//bone_manager.GetBaseScale();
-			bone_manager.GetDeformScale(bone_id[i], bone_param[i].scale);
-
-			bone_manager.GetName(bone_id[i], name);
-			bone_manager.GetDummy(bone_id[i], bone_param[i].dummy);
-
-			bone_param[i].name = MString(name);
-			//std::vector<UINT> children;
-			//bone_manager.GetChildren(bone_id[i], children);
-		}
+	// ボーンの有無だけ先に調べる
+	int bone_num = 0;
+	{
+		MQBoneManager bone_manager(this, doc);
+		bone_num = bone_manager.GetBoneNum();
 	}
 
 
@@ -656,11 +659,16 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 	option.visible_only = false;
 	option.mtlfile = FILEOUT_CONFIRM;
 	option.material_conv = 0;
+	option.material_merge = 0;
+	option.texture_atlas = ATLAS_NO;
+	option.weld = 0;
 
 	option.bone_exists = (bone_num > 0);
 	option.output_bone = 0;
 	option.bone_scale_rot = 0;
 	option.bone_conv = 0;
+	option.skinning_mode = 0;
+	option.profile_log = 0;
 
 	option.hspfile = FILEOUT_CONFIRM;
 	// ファイル名だけ取り出して20文字に制限
@@ -677,9 +685,14 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 		setting->Load("HspFile", option.hspfile, option.hspfile);
 		setting->Load("TexturePrefix", option.texture_prefix, option.texture_prefix);
 		setting->Load("MaterialConv", option.material_conv, option.material_conv);
+		setting->Load("MaterialMerge", option.material_merge, option.material_merge);
+		setting->Load("TextureAtlas", option.texture_atlas, option.texture_atlas);
+		setting->Load("Weld", option.weld, option.weld);
 		setting->Load("BoneConv", option.bone_conv, option.bone_conv);
 		setting->Load("OutputBone", option.output_bone, option.output_bone);
 		setting->Load("BoneScaleRot", option.bone_scale_rot, option.bone_scale_rot);
+		setting->Load("SkinningMode", option.skinning_mode, option.skinning_mode);
+		setting->Load("ProfileLog", option.profile_log, option.profile_log);
 		setting->Load("InputXmlAnimFile", option.input_xmlanim, option.input_xmlanim);
 	}
 	MQFileDialogInfo dlginfo;
@@ -712,15 +725,152 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 		setting->Save("HspFile", option.hspfile);
 		setting->Save("TexturePrefix", option.texture_prefix);
 		setting->Save("MaterialConv", option.material_conv);
+		setting->Save("MaterialMerge", option.material_merge);
+		setting->Save("TextureAtlas", option.texture_atlas);
+		setting->Save("Weld", option.weld);
 		setting->Save("BoneConv", option.bone_conv);
 		if (option.bone_exists) {
 			setting->Save("OutputBone", option.output_bone);
 		}
 		setting->Save("BoneScaleRot", option.bone_scale_rot);
+		setting->Save("SkinningMode", option.skinning_mode);
+		setting->Save("ProfileLog", option.profile_log);
 		setting->Save("InputXmlAnimFile", option.input_xmlanim);
 		CloseSetting(setting);
 	}
 
+	GPBExportProfile profile;
+	if (!exportDocument(filename, doc, option, scaling, language, outputFiles, &profile)) {
+		return FALSE;
+	}
+
+	if (option.profile_log) {
+		MString profilePath = MFileUtil::changeExtension(filename, L".profile.json");
+		FILE* fp = nullptr;
+		errno_t err = _wfopen_s(&fp, profilePath.c_str(), L"w");
+		if (err == 0 && fp != nullptr) {
+			profile.writeJson(fp, MString(filename).toUtf8String().c_str());
+			fclose(fp);
+			outputFiles += L"\n" + profilePath;
+		}
+	}
+
+	{
+		MQWindow mainwin = MQWindow::GetMainWindow();
+		MString message = MString(language.Search("DoneOutput")) + L"\n" + outputFiles
+			+ L"\n\n" + MString::fromUtf8String(profile.toString().c_str());
+		const auto result = MQDialog::MessageInformationBox(mainwin,
+			message.c_str(),
+			language.Search("Option"));
+	}
+
+	return TRUE;
+}
+
+/// <summary>
+/// ダイアログを出さずに書き出す
+/// </summary>
+/// <param name="filename">書き出しファイル名</param>
+/// <param name="doc"></param>
+/// <param name="option">書き出しオプション</param>
+/// <param name="scaling">スケーリング倍率</param>
+/// <param name="language">エラーメッセージ用</param>
+/// <param name="outputFiles">書き出したファイル名を追記する</param>
+/// <param name="profile">nullptr 以外なら段階ごとの所要時間とメモリ確保量を記録する</param>
+/// <returns></returns>
+BOOL ExportGPBPlugin::exportDocument(const wchar_t *filename, MQDocument doc,
+	const CreateDialogOptionParam& option,
+	float scaling,
+	MLanguage& language,
+	MString& outputFiles,
+	GPBExportProfile *profile)
+{
+	if (profile != nullptr) {
+		profile->begin();
+		profile->stage("bone_snapshot");
+	}
+
+	MString onlyName = MFileUtil::extractFileNameOnly(filename);
+
+	MString keepName = L"unknown";
+
+	MQBoneManager bone_manager(this, doc);
+	std::vector<GPBMaterial> materials;
+
+	// ボーン処理をトータルで有効にするかどうか
+	bool outputBone = false;
+
+
+	int indexMesh = 0;
+	int indexScene = 1;
+	int indexAnimations = 2;
+	int indexNode = 3;
+	std::vector<GPBRef> refTable;
+	for (int i = 0; i < 4; ++i) {
+		GPBRef ref;
+		ref.offset = 0x00363534; // for check
+		switch (i) {
+		case 0:
+			ref.type = REF_MESH;
+			ref.name = MString(L"n0_Mesh");
+			break;
+		case 1:
+			ref.type = REF_SCENE;
+			ref.name = MString(L"__SCENE__");
+			break;
+		case 2:
+			ref.type = REF_ANIMATIONS;
+			ref.name = MString(L"__Animations__");
+			break;
+		case 3:
+			ref.type = REF_NODE;
+			ref.name = MString(L"n0");
+			break;
+		}
+		refTable.push_back(ref);
+	}
+
+
+
+	GPBScene scene;
+
+	// Query a number of bones ボーン数
+	int bone_num = bone_manager.GetBoneNum();
+	int bone_object_num = bone_manager.GetSkinObjectNum();
+
+	// Enum bones ボーンのIDリスト
+	std::vector<GPBBoneParam> bone_param;
+	if (bone_num > 0) {
+		// 全ボーンの属性を一括で取得する
+		MQBoneManager::BONE_SNAPSHOT snapshot;
+		bone_num = bone_manager.GetBoneSnapshot(snapshot);
+
+		bone_param.resize(bone_num); // 領域確保する
+		for (int i = 0; i < bone_num; i++) {
+			bone_param[i].id = snapshot.id[i];
+			bone_param[i].parent = snapshot.parent[i];
+			// 子ボーン個数
+			bone_param[i].child_num = snapshot.child_num[i];
+
+			// 位置(相対?global?)
+			bone_param[i].org_pos = snapshot.base_pos[i];
+			// 変形後位置(相対?global?)
+			bone_param[i].def_pos = snapshot.deform_pos[i];
+
+			bone_param[i].base_mtx = snapshot.base_matrix[i];
+			bone_param[i].mtx = snapshot.deform_matrix[i];
+
+			bone_param[i].scale = snapshot.deform_scale[i];
+
+			bone_param[i].name = MString(snapshot.name[i]);
+			bone_param[i].dummy = (snapshot.dummy[i] != 0);
+		}
+	}
+
+	if (profile != nullptr) {
+		profile->stage("separate");
+	}
+
 	outputBone = (option.output_bone != 0);
 	if (!outputBone) { // 無効化する
 		bone_num = 0;
@@ -730,6 +880,9 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 	// ボーンのスケールと回転を有効にするか
 	bool useScaleRot = (option.bone_scale_rot != 0);
 
+	// デュアルクォータニオンでスキニングするか
+	bool useDualQuat = (option.skinning_mode != 0);
+
 	//// 処理後半
 
 	// サブパスは取れる
@@ -790,6 +943,12 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 		}
 	}
 
+	if (profile != nullptr) {
+		profile->setCount("objects", (long long)expobjs.size());
+		profile->setCount("vertices", total_vert_num);
+		profile->stage("bone_hierarchy");
+	}
+
 	// ID から bone_num の index を引く
 	std::map<UINT, int> bone_id_index;
 	// Initialize bones.
@@ -889,13 +1048,18 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 		}
 
 		{
-			keepName += MString::format(L", refTable, %d, %d, %s",
-				refTable.size(),
-				bone_param.size(),
-				outputBone ? L"true" : L"false");
+			keepName += MString::format(L", refTable, %d, %d, ",
+				(int)refTable.size(),
+				(int)bone_param.size())
+				+ (outputBone ? L"true" : L"false");
 		}
 	}
 
+	if (profile != nullptr) {
+		profile->setCount("bones", bone_num);
+		profile->stage("materials");
+	}
+
 	for (int m = 0; m <= numMat; ++m) {
 		GPBMaterial material;
 		material.orgIndex = m;
@@ -1006,6 +1170,10 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 	}
 
 
+	if (profile != nullptr) {
+		profile->stage("triangulate");
+	}
+
 	// Face's vertices list 面頂点リストを生成する
 	DWORD face_vert_count = 0;
 	std::vector<int> material_used(numMat + 1, 0);
@@ -1087,6 +1255,65 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 	}
 	assert(face_vert_count == output_face_vert_count);
 
+	if (option.material_merge) {
+		int mergedNum = this->mergeMaterials(materials);
+		if (mergedNum > 0) {
+			keepName += MString::format(L", merged materials %d", mergedNum);
+		}
+		if (profile != nullptr) {
+			profile->setCount("merged_materials", mergedNum);
+		}
+	}
+
+	// アトラス画像は .gpb の後に並べるので、.gpb を閉じるまで別に持っておく
+	MString atlasFiles;
+	int atlasUnchangedNum = 0;
+	if (option.texture_atlas != ATLAS_NO) {
+		if (profile != nullptr) {
+			profile->stage("texture_atlas");
+		}
+		int atlasMergedNum = this->packTextureAtlas(doc, filename, option, materials,
+			vert_orgobj, vert_expvert, vert_normal, vert_coord,
+			language, atlasFiles, atlasUnchangedNum);
+		// 共有頂点を複製した分だけ増える
+		total_vert_num = (int)vert_coord.size();
+		if (atlasMergedNum > 0) {
+			keepName += MString::format(L", atlas materials %d", atlasMergedNum);
+		}
+		if (profile != nullptr) {
+			profile->setCount("atlas_materials", atlasMergedNum);
+			profile->setCount("vertices", total_vert_num);
+		}
+	}
+
+	if (option.weld) {
+		if (profile != nullptr) {
+			profile->stage("weld");
+		}
+		// ボーンがあるとウェイトが元の頂点ごとなので、同じ元の頂点だけを溶接する
+		int droppedNum = 0;
+		int weldedNum = this->weldVertices(doc, expobjs, materials,
+			vert_orgobj, vert_expvert, vert_normal, vert_coord,
+			outputBone && bone_num > 0, droppedNum);
+		total_vert_num = (int)vert_coord.size();
+		output_face_vert_count -= droppedNum * 3;
+		if (weldedNum > 0) {
+			keepName += MString::format(L", welded vertices %d", weldedNum);
+		}
+		if (droppedNum > 0) {
+			keepName += MString::format(L", dropped triangles %d", droppedNum);
+		}
+		if (profile != nullptr) {
+			profile->setCount("welded_vertices", weldedNum);
+			profile->setCount("dropped_triangles", droppedNum);
+			profile->setCount("vertices", total_vert_num);
+		}
+	}
+	if (profile != nullptr) {
+		profile->setCount("triangles", output_face_vert_count / 3);
+		profile->stage("validate");
+	}
+
 	// ジョイント名リスト
 	int rootJointNum = 0;
 	std::vector<MString> jointNames;
@@ -1176,16 +1403,24 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 	}
 
 
+	if (profile != nullptr) {
+		profile->setCount("materials", enableMaterialNum);
+		profile->stage("open_files");
+	}
+
 	//// Open a file.
-	FILE *fh;
-	errno_t err = _wfopen_s(&fh, filename, L"wb");
-	if(err != 0) {
+	// 一時ファイルに書き出して、内容が変わったときだけ置き換える
+	GPBFileWriter gpbFile;
+	if (!gpbFile.open(filename, L"wb")) {
 		for(size_t i=0; i<expobjs.size(); i++) {
 			delete expobjs[i];
 		}
 		return FALSE;
 	}
+	FILE *fh = gpbFile.fp();
+	errno_t err = 0;
 
+	GPBFileWriter materialFile;
 	FILE* fhMaterial = nullptr;
 	if (option.mtlfile != FILEOUT_NO) {
 		bool tryWrite = false;
@@ -1221,17 +1456,13 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 		}
 
 		if (tryWrite) {
-			err = _wfopen_s(&fhMaterial, materialPath.c_str(), L"w");
-			if (err != 0) {
-				fhMaterial = nullptr;
-			}
-
-			if (fhMaterial) {
-				outputFiles += L"\n" + materialPath;
+			if (materialFile.open(materialPath, L"w")) {
+				fhMaterial = materialFile.fp();
 			}
 		}
 	}
 
+	GPBFileWriter hspFile;
 	FILE* fhHsp = nullptr;
 	if (option.hspfile != FILEOUT_NO) {
 		bool tryWrite = false;
@@ -1267,21 +1498,20 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 		}
 
 		if (tryWrite) {
-			err = _wfopen_s(&fhHsp, hspPath.c_str(), L"w");
-			if (err != 0) {
-				fhHsp = nullptr;
-			}
-
-			if (fhHsp) {
-				outputFiles += L"\n" + hspPath;
+			if (hspFile.open(hspPath, L"w")) {
+				fhHsp = hspFile.fp();
 			}
 		}
 	}
 
+	if (profile != nullptr) {
+		profile->stage("vertex_weights");
+	}
+
 	//// Headerの書き出し
 	BYTE major = 1;
 	BYTE minor = 5;
-	fwrite("\xabGPB\xbb\x0d\x0a\x1a\x0a", 9, 1, fh);
+	fwrite(GPB_IDENTIFIER, GPB_IDENTIFIER_SIZE, 1, fh);
 	fwrite(&major, sizeof(BYTE), 1, fh);
 	fwrite(&minor, sizeof(BYTE), 1, fh);
 
@@ -1308,6 +1538,30 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 		fwrite(&offset, sizeof(DWORD), 1, fh);
 	}
 
+	//// スキンウェイトをオブジェクトごとにまとめて取得する
+	std::vector<MQBoneManager::VERTEX_WEIGHT_TABLE> obj_weights(numObj);
+	if (outputBone && bone_num > 0) {
+		for (int i = 0; i < numObj; i++) {
+			if (expobjs[i] == nullptr)
+				continue;
+			bone_manager.GetVertexWeightTable(doc->GetObject(i), obj_weights[i]);
+		}
+	}
+
+	if (profile != nullptr) {
+		profile->stage("write_mesh");
+	}
+
+	//// 出力する位置をまとめて求めて、バウンディングは配列でまとめて広げる
+	std::vector<MQPoint> vert_pos(total_vert_num);
+	for (int j = 0; j < total_vert_num; ++j) {
+		MQObject obj = doc->GetObject(vert_orgobj[j]);
+		MQExportObject* eobj = expobjs[vert_orgobj[j]];
+		vert_pos[j] = obj->GetVertex(eobj->GetOriginalVertex(vert_expvert[j])) * scaling;
+	}
+	MQBoundingBox vert_box;
+	vert_box.expand(vert_pos.data(), vert_pos.size());
+
 	//// メッシュ
 	GPBBounding wholeBounding;
 
@@ -1318,6 +1572,14 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 		refTable[indexMesh].offset = ftell(fh);
 
 		GPBBounding bounding;
+		if (vert_box.isEnabled()) {
+			bounding.min[0] = vert_box.minp.x;
+			bounding.min[1] = vert_box.minp.y;
+			bounding.min[2] = vert_box.minp.z;
+			bounding.max[0] = vert_box.maxp.x;
+			bounding.max[1] = vert_box.maxp.y;
+			bounding.max[2] = vert_box.maxp.z;
+		}
 
 		// 属性タイプと数値数の配列 position, 3 など
 		DWORD attrNum = outputBone ? 5 : 3;
@@ -1340,12 +1602,9 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 			float nrm[3];
 			float uv[2];
 
-			MQObject obj = doc->GetObject(vert_orgobj[j]);
-			MQExportObject* eobj = expobjs[vert_orgobj[j]];
-			MQPoint v = obj->GetVertex(eobj->GetOriginalVertex(vert_expvert[j]));
-			pos[0] = v.x * scaling;
-			pos[1] = v.y * scaling;
-			pos[2] = v.z * scaling;
+			pos[0] = vert_pos[j].x;
+			pos[1] = vert_pos[j].y;
+			pos[2] = vert_pos[j].z;
 
 			nrm[0] = vert_normal[j].x;
 			nrm[1] = vert_normal[j].y;
@@ -1409,11 +1668,6 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 			weight[0] = bone_weight;
 			*/
 
-			for (int index = 0; index < 3; ++index) {
-				bounding.max[index] = fmaxf(bounding.max[index], pos[index]);
-				bounding.min[index] = fminf(bounding.min[index], pos[index]);
-			}
-
 			fwrite(&pos, sizeof(float), 3, fh);
 			fwrite(&nrm, sizeof(float), 3, fh);
 			fwrite(&uv, sizeof(float), 2, fh);
@@ -1423,25 +1677,33 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 				std::vector<INDEXWEIGHT> iws;
 				iws.resize(16);
 
-				// 受け取り用(最大16個まで)
-				UINT vert_bone_id[16];
-				// 受け取り用
-				float weights[16];
 				// ウエイトの個数
 				int weight_num = 0;
 				if (bone_num > 0) { // ボーンが1個以上存在する場合
-					UINT vert_id = obj->GetVertexUniqueID(eobj->GetOriginalVertex(vert_expvert[j]));
-					// 1頂点にたいして最大16個まで要求する
-					int max_num = 16;
-					weight_num = bone_manager.GetVertexWeightArray(obj, vert_id, max_num, vert_bone_id, weights);
+					const auto& table = obj_weights[vert_orgobj[j]];
+					int org_vi = expobjs[vert_orgobj[j]]->GetOriginalVertex(vert_expvert[j]);
+					const UINT* vert_bone_id = nullptr;
+					const float* weights = nullptr;
+					if (org_vi >= 0 && org_vi < table.GetVertexCount()) {
+						// 1頂点にたいして最大16個まで採用する
+						weight_num = std::min(table.GetWeightNum(org_vi), 16);
+						vert_bone_id = table.GetBoneIDs(org_vi);
+						weights = table.GetWeights(org_vi);
+					}
 
 					for (int k = 0; k < weight_num; ++k) {
 						int bi = bone_id_index[vert_bone_id[k]];
 						iws[k].sortedIndex = bone_param[bi].sortedIndex;
 						iws[k].weight = weights[k];
 					}
+					// 同じウェイトの並びが実装によって変わらないようにインデックスでも比べる
 					std::sort(iws.begin(), iws.end(),
-						[](auto const& a, auto const& b) { return (a.weight > b.weight); });
+						[](auto const& a, auto const& b) {
+							if (a.weight != b.weight) {
+								return (a.weight > b.weight);
+							}
+							return (a.sortedIndex < b.sortedIndex);
+						});
 					if (weight_num == 0) {
 						iws[0].weight = 1.0f;
 					}
@@ -1451,7 +1713,7 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 				float weight[4] = { 1.0, 0.0, 0.0, 0.0 };
 				for (int k = 0; k < 4; ++k) {
 					indices[k] = (float)iws[k].sortedIndex;
-					weights[k] = iws[k].weight;
+					weight[k] = iws[k].weight;
 				}
 
 				fwrite(&weight, sizeof(float), 4, fh);
@@ -1491,6 +1753,9 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 	}
 
 	calcRadius(wholeBounding);
+	if (profile != nullptr) {
+		profile->stage("write_scene");
+	}
 
 
 	DWORD elementNum = 2;
@@ -1633,16 +1898,29 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 
 
 	//// バイナリ出力ここまで
+	if (profile != nullptr) {
+		profile->endStage();
+	}
 
 		//// 材質の書き出し
 	if (fhMaterial) {
+		GPBProfileScope scope(profile, "make_material");
 		//keepName = L"";
-		std::vector<MString> defs;
+		// DQS はスケールを表せないので、スケールを含むボーンがあれば LBS に戻す
+		bool dualQuat = useDualQuat && bone_num > 0;
+		for (int i = 0; dualQuat && i < bone_num; ++i) {
+			if (!MQDualQuaternion::isRigid(bone_param[i].base_mtx)) {
+				dualQuat = false;
+				keepName += L", DQS disabled by scaled bone " + bone_param[i].name_en;
+			}
+		}
 		this->makeMaterial(fhMaterial, materials,
 			keepName,
-			bone_num);
+			bone_num,
+			dualQuat);
 	}
 	if (fhHsp) {
+		GPBProfileScope scope(profile, "make_hsp");
 		MString name = MString(L"res/") + MFileUtil::extractFileNameOnly(filename);
 		if (!outputBone) {
 			jointNames.clear();
@@ -1656,29 +1934,40 @@ BOOL ExportGPBPlugin::ExportFile(int index, const wchar_t *filename, MQDocument
 	}
 
 
+	if (profile != nullptr) {
+		profile->stage("close");
+	}
+
 	for(size_t i=0; i<expobjs.size(); i++) {
 		delete expobjs[i];
 	}
 
-	if (fhMaterial) {
-		err = fclose(fhMaterial);
+	if(!gpbFile.commit()){
+		return FALSE;
 	}
-	if (fhHsp) {
-		err = fclose(fhHsp);
+	int unchangedNum = gpbFile.isUnchanged() ? 1 : 0;
+	if (gpbFile.isUnchanged()) {
+		outputFiles += MString(L" ") + language.Search("Unchanged");
 	}
-
-	if(fclose(fh) != 0){
-		return FALSE;
+	outputFiles += atlasFiles;
+	unchangedNum += atlasUnchangedNum;
+	for (GPBFileWriter* file : { &materialFile, &hspFile }) {
+		if (file->fp() == nullptr) {
+			continue;
+		}
+		if (!file->commit()) {
+			continue;
+		}
+		outputFiles += L"\n" + file->getPath();
+		if (file->isUnchanged()) {
+			outputFiles += MString(L" ") + language.Search("Unchanged");
+			unchangedNum += 1;
+		}
 	}
-	
-	{
-		MQWindow mainwin = MQWindow::GetMainWindow();
-		MString message = MString(language.Search("DoneOutput")) + L"\n" + outputFiles;
-		const auto result = MQDialog::MessageInformationBox(mainwin,
-			message.c_str(),
-			language.Search("Option"));
+	if (profile != nullptr) {
+		profile->setCount("unchanged_files", unchangedNum);
+		profile->end();
 	}
-
 	return TRUE;
 }
 
@@ -1780,6 +2069,9 @@ bool ExportGPBPlugin::LoadBoneSettingFile()
 {
 #ifdef _WIN32
 	MString dir = MFileUtil::extractDirectory(s_DllPath);
+#elif __linux__
+	// リソースフォルダが無いのでカレントフォルダ
+	MString dir = MFileUtil::getCurrentDirectory();
 #else
 	MString dir = GetResourceDir();
 #endif
@@ -1813,7 +2105,7 @@ bool ExportGPBPlugin::LoadBoneSettingFile()
 
 				m_BoneNameSetting.push_back(setting);
 
-				if(root != nullptr && MAnsiString(root).toInt() != 0){
+				if(!root.empty() && MAnsiString(root.c_str()).toInt() != 0){
 					m_RootBoneName = setting;
 				}
 
@@ -1982,10 +2274,413 @@ int ExportGPBPlugin::loadAnimation(MString& animationFile, ANIMATIONS& animation
 }
 
 
+int ExportGPBPlugin::mergeMaterials(std::vector<GPBMaterial>& materials) {
+	// ハッシュ -> 代表の材質インデックス. 衝突に備えて sameRenderState() でも比べる
+	std::map<size_t, std::vector<int>> buckets;
+	int mergedNum = 0;
+	for (int m = 0; m < (int)materials.size(); ++m) {
+		GPBMaterial& material = materials[m];
+		if (!material.enable) {
+			continue;
+		}
+
+		auto& bucket = buckets[material.renderStateHash()];
+		int found = -1;
+		for (int rep : bucket) {
+			if (materials[rep].sameRenderState(material)) {
+				found = rep;
+				break;
+			}
+		}
+		if (found < 0) {
+			bucket.push_back(m);
+			continue;
+		}
+
+		auto& dst = materials[found].faceIndices;
+		dst.insert(dst.end(), material.faceIndices.begin(), material.faceIndices.end());
+		material.faceIndices.clear();
+		material.enable = false;
+		mergedNum += 1;
+	}
+	return mergedNum;
+}
+
+int ExportGPBPlugin::packTextureAtlas(MQDocument doc,
+	const MString& filename,
+	const CreateDialogOptionParam& option,
+	std::vector<GPBMaterial>& materials,
+	std::vector<int>& vert_orgobj,
+	std::vector<int>& vert_expvert,
+	std::vector<MQPoint>& vert_normal,
+	std::vector<MQCoordinate>& vert_coord,
+	MLanguage& language,
+	MString& outputFiles,
+	int& unchangedNum) {
+
+	// テクスチャ以外の描画状態が同じ材質だけ同じアトラスにする
+	auto sameAtlasState = [](const GPBMaterial& a, const GPBMaterial& b) {
+		return (a.useLighting == b.useLighting
+			&& (a.isDouble != FALSE) == (b.isDouble != FALSE)
+			&& a.spc_pow == b.spc_pow
+			&& (!a.useLighting || a.useSpecular() == b.useSpecular())
+			&& a.filter == b.filter);
+	};
+
+	struct AtlasGroup {
+		GPBTextureAtlas atlas;
+		std::vector<int> materials;
+		std::vector<int> images;
+		std::map<std::wstring, int> pathImage;
+		MString name;
+		AtlasGroup() : atlas(ATLAS_MAX_SIZE, ATLAS_PADDING) {}
+	};
+	std::vector<AtlasGroup> groups;
+
+	int numMat = doc->GetMaterialCount();
+	for (int m = 0; m < (int)materials.size(); ++m) {
+		const GPBMaterial& material = materials[m];
+		if (!material.enable || !material.useTexture || material.orgIndex >= numMat) {
+			continue;
+		}
+		MQMaterial mat = doc->GetMaterial(material.orgIndex);
+		if (mat == NULL) {
+			continue;
+		}
+		if (option.texture_atlas == ATLAS_SELECTED && !mat->GetSelected()) {
+			continue;
+		}
+
+		// アトラスの中では繰り返せないので、実際に 0～1 の外を使う繰り返しは除く
+		float umin = 0.0f, umax = 0.0f, vmin = 0.0f, vmax = 0.0f;
+		for (size_t i = 0; i < material.faceIndices.size(); ++i) {
+			const MQCoordinate& uv = vert_coord[material.faceIndices[i]];
+			umin = (i == 0) ? uv.u : std::min(umin, uv.u);
+			umax = (i == 0) ? uv.u : std::max(umax, uv.u);
+			vmin = (i == 0) ? uv.v : std::min(vmin, uv.v);
+			vmax = (i == 0) ? uv.v : std::max(vmax, uv.v);
+		}
+		const float eps = 1.0f / 4096.0f;
+		if (material.wrapU != MQMATERIAL_WRAP_CLAMP && (umin < -eps || umax > 1.0f + eps)) {
+			continue;
+		}
+		if (material.wrapV != MQMATERIAL_WRAP_CLAMP && (vmin < -eps || vmax > 1.0f + eps)) {
+			continue;
+		}
+
+		size_t gi = 0;
+		for (; gi < groups.size(); ++gi) {
+			if (sameAtlasState(materials[groups[gi].materials[0]], material)) {
+				break;
+			}
+		}
+
+		std::wstring path = mat->GetTextureNameW();
+		int image = -1;
+		if (gi < groups.size()) {
+			auto it = groups[gi].pathImage.find(path);
+			if (it != groups[gi].pathImage.end()) {
+				image = it->second;
+			}
+		}
+		if (image < 0) {
+			int width = 0;
+			int height = 0;
+			std::vector<unsigned char> rgba;
+			if (!GPBTextureAtlas::loadMappingImage(doc, path.c_str(), width, height, rgba)) {
+				continue;
+			}
+			if (width > ATLAS_ENTRY_MAX_SIZE || height > ATLAS_ENTRY_MAX_SIZE) {
+				continue;
+			}
+			if (gi == groups.size()) {
+				groups.push_back(AtlasGroup());
+			}
+			image = groups[gi].atlas.add(width, height, rgba);
+			groups[gi].pathImage[path] = image;
+		}
+		groups[gi].materials.push_back(m);
+		groups[gi].images.push_back(image);
+	}
+
+	// 配置してアトラス画像を書き出す. 材質ごとにアトラスと画像番号を記録する
+	std::vector<int> materialGroup(materials.size(), -1);
+	std::vector<int> materialImage(materials.size(), -1);
+	int atlasNum = 0;
+	for (size_t gi = 0; gi < groups.size(); ++gi) {
+		AtlasGroup& group = groups[gi];
+		if (group.materials.size() < 2 || !group.atlas.pack()) {
+			continue;
+		}
+		int placedNum = 0;
+		for (int image : group.images) {
+			if (group.atlas.isPlaced(image)) {
+				placedNum += 1;
+			}
+		}
+		if (placedNum < 2) {
+			continue;
+		}
+
+		group.name = MFileUtil::extractFileNameOnly(filename) + MString::format(L"_atlas%d.png", atlasNum);
+		MString path = MFileUtil::changeExtension(filename, MString::format(L"_atlas%d.png", atlasNum));
+		GPBFileWriter writer;
+		if (!writer.open(path, L"wb")) {
+			continue;
+		}
+		if (!group.atlas.writePNG(writer.fp()) || !writer.commit()) {
+			continue;
+		}
+		outputFiles += L"\n" + path;
+		if (writer.isUnchanged()) {
+			outputFiles += MString(L" ") + language.Search("Unchanged");
+			unchangedNum += 1;
+		}
+		atlasNum += 1;
+
+		for (size_t i = 0; i < group.materials.size(); ++i) {
+			if (group.atlas.isPlaced(group.images[i])) {
+				materialGroup[group.materials[i]] = (int)gi;
+				materialImage[group.materials[i]] = group.images[i];
+			}
+		}
+	}
+	if (atlasNum == 0) {
+		return 0;
+	}
+
+	// UV を付け替える. アトラスに入らない材質や別の画像と共有している頂点は複製する
+	std::vector<int> vert_owner(vert_coord.size(), -1);
+	for (int m = 0; m < (int)materials.size(); ++m) {
+		if (!materials[m].enable || materialGroup[m] >= 0) {
+			continue;
+		}
+		for (int vi : materials[m].faceIndices) {
+			vert_owner[vi] = -2;
+		}
+	}
+	for (int m = 0; m < (int)materials.size(); ++m) {
+		if (materialGroup[m] < 0) {
+			continue;
+		}
+		const GPBTextureAtlas& atlas = groups[materialGroup[m]].atlas;
+		std::map<int, int> dup;
+		for (int& vi : materials[m].faceIndices) {
+			if (vert_owner[vi] == m) {
+				continue;
+			}
+			int dst = vi;
+			if (vert_owner[vi] != -1) {
+				auto it = dup.find(vi);
+				if (it != dup.end()) {
+					vi = it->second;
+					continue;
+				}
+				dst = (int)vert_coord.size();
+				vert_orgobj.push_back(vert_orgobj[vi]);
+				vert_expvert.push_back(vert_expvert[vi]);
+				vert_normal.push_back(vert_normal[vi]);
+				vert_coord.push_back(vert_coord[vi]);
+				vert_owner.push_back(m);
+				dup[vi] = dst;
+			}
+			vert_owner[dst] = m;
+
+			// 範囲外は端のピクセルになるのでクランプしてから移す
+			MQCoordinate& uv = vert_coord[dst];
+			uv.u = std::min(std::max(uv.u, 0.0f), 1.0f);
+			uv.v = std::min(std::max(uv.v, 0.0f), 1.0f);
+			atlas.remap(materialImage[m], uv.u, uv.v);
+			vi = dst;
+		}
+	}
+
+	// アトラスごとに最初の材質へまとめる
+	int mergedNum = 0;
+	for (size_t gi = 0; gi < groups.size(); ++gi) {
+		int first = -1;
+		for (int m : groups[gi].materials) {
+			if (materialGroup[m] != (int)gi) {
+				continue;
+			}
+			if (first < 0) {
+				first = m;
+				GPBMaterial& material = materials[m];
+				material.orgDiffuseTexture = groups[gi].name;
+				material.convDiffuseTexture = MString(option.texture_prefix) + groups[gi].name;
+				material.wrapU = MQMATERIAL_WRAP_CLAMP;
+				material.wrapV = MQMATERIAL_WRAP_CLAMP;
+				continue;
+			}
+			auto& dst = materials[first].faceIndices;
+			dst.insert(dst.end(), materials[m].faceIndices.begin(), materials[m].faceIndices.end());
+			materials[m].faceIndices.clear();
+			materials[m].enable = false;
+			mergedNum += 1;
+		}
+	}
+	return mergedNum;
+}
+
+int ExportGPBPlugin::weldVertices(MQDocument doc,
+	const std::vector<MQExportObject*>& expobjs,
+	std::vector<GPBMaterial>& materials,
+	std::vector<int>& vert_orgobj,
+	std::vector<int>& vert_expvert,
+	std::vector<MQPoint>& vert_normal,
+	std::vector<MQCoordinate>& vert_coord,
+	bool sameOriginal,
+	int& droppedNum) {
+
+	int vertNum = (int)vert_coord.size();
+	std::vector<MQPoint> vert_pos(vertNum);
+	std::vector<int> vert_orgvert(vertNum);
+	// 法線は長さが1とは限らないので向きだけで比べる
+	std::vector<MQPoint> vert_dir(vertNum);
+	for (int j = 0; j < vertNum; ++j) {
+		MQObject obj = doc->GetObject(vert_orgobj[j]);
+		vert_orgvert[j] = expobjs[vert_orgobj[j]]->GetOriginalVertex(vert_expvert[j]);
+		vert_pos[j] = obj->GetVertex(vert_orgvert[j]);
+		vert_dir[j] = Normalize(vert_normal[j]);
+	}
+
+	// 許容誤差の2倍の格子で、周りの27マスだけを調べる
+	const float cellSize = WELD_POSITION_TOLERANCE * 2.0f;
+	auto cellOf = [cellSize](float value) {
+		return (long long)floor(value / cellSize);
+	};
+	auto cellKey = [](long long x, long long y, long long z) {
+		return (unsigned long long)x * 73856093ULL
+			^ (unsigned long long)y * 19349663ULL
+			^ (unsigned long long)z * 83492791ULL;
+	};
+
+	std::vector<int> weldTo(vertNum, -1);
+	std::vector<int> touched;
+	for (auto& material : materials) {
+		if (!material.enable) {
+			continue;
+		}
+
+		std::unordered_map<unsigned long long, std::vector<int>> grid;
+		for (int& vi : material.faceIndices) {
+			if (weldTo[vi] >= 0) {
+				vi = weldTo[vi];
+				continue;
+			}
+
+			const MQPoint& p = vert_pos[vi];
+			long long cx = cellOf(p.x);
+			long long cy = cellOf(p.y);
+			long long cz = cellOf(p.z);
+			int found = -1;
+			for (long long dz = -1; dz <= 1 && found < 0; ++dz) {
+				for (long long dy = -1; dy <= 1 && found < 0; ++dy) {
+					for (long long dx = -1; dx <= 1 && found < 0; ++dx) {
+						auto it = grid.find(cellKey(cx + dx, cy + dy, cz + dz));
+						if (it == grid.end()) {
+							continue;
+						}
+						for (int ri : it->second) {
+							if (sameOriginal
+								&& (vert_orgobj[ri] != vert_orgobj[vi] || vert_orgvert[ri] != vert_orgvert[vi])) {
+								continue;
+							}
+							if (!MQPointFuzzyEqual(vert_pos[ri], p, WELD_POSITION_TOLERANCE)) {
+								continue;
+							}
+							if (GetInnerProduct(vert_dir[ri], vert_dir[vi]) < WELD_NORMAL_TOLERANCE
+								&& !(vert_dir[ri] == vert_dir[vi])) {
+								continue;
+							}
+							if (fabs(vert_coord[ri].u - vert_coord[vi].u) >= WELD_UV_TOLERANCE
+								|| fabs(vert_coord[ri].v - vert_coord[vi].v) >= WELD_UV_TOLERANCE) {
+								continue;
+							}
+							found = ri;
+							break;
+						}
+					}
+				}
+			}
+
+			touched.push_back(vi);
+			if (found < 0) {
+				weldTo[vi] = vi;
+				grid[cellKey(cx, cy, cz)].push_back(vi);
+			} else {
+				weldTo[vi] = found;
+				vi = found;
+			}
+		}
+
+		// 他の材質では別の頂点に溶接し直せるように戻す
+		for (int vi : touched) {
+			weldTo[vi] = -1;
+		}
+		touched.clear();
+
+		// 2つの角が同じ頂点になった三角形は面積が無いので消す
+		auto& indices = material.faceIndices;
+		size_t keepNum = 0;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			int i0 = indices[i];
+			int i1 = indices[i + 1];
+			int i2 = indices[i + 2];
+			if (i0 == i1 || i1 == i2 || i2 == i0) {
+				droppedNum += 1;
+				continue;
+			}
+			indices[keepNum++] = i0;
+			indices[keepNum++] = i1;
+			indices[keepNum++] = i2;
+		}
+		indices.resize(keepNum);
+	}
+
+	// 使われている頂点だけを元の順に詰める
+	std::vector<int> newIndex(vertNum, -1);
+	for (const auto& material : materials) {
+		if (!material.enable) {
+			continue;
+		}
+		for (int vi : material.faceIndices) {
+			newIndex[vi] = 0;
+		}
+	}
+	int newNum = 0;
+	for (int j = 0; j < vertNum; ++j) {
+		if (newIndex[j] < 0) {
+			continue;
+		}
+		newIndex[j] = newNum;
+		vert_orgobj[newNum] = vert_orgobj[j];
+		vert_expvert[newNum] = vert_expvert[j];
+		vert_normal[newNum] = vert_normal[j];
+		vert_coord[newNum] = vert_coord[j];
+		newNum += 1;
+	}
+	vert_orgobj.resize(newNum);
+	vert_expvert.resize(newNum);
+	vert_normal.resize(newNum);
+	vert_coord.resize(newNum);
+
+	for (auto& material : materials) {
+		if (!material.enable) {
+			continue;
+		}
+		for (int& vi : material.faceIndices) {
+			vi = newIndex[vi];
+		}
+	}
+	return vertNum - newNum;
+}
+
 int ExportGPBPlugin::makeMaterial(FILE* f,
 	const std::vector<GPBMaterial>& materials,
 	const MString& option,
-	int jointNum) {
+	int jointNum,
+	bool dualQuat) {
 
 	std::vector<MString> wraps;
 	wraps.push_back(L"REPEAT");
@@ -2024,12 +2719,15 @@ material textured\n\
 			continue;
 		}
 
-		bool use_spc = !(material.specular[0] <= 0.0f && material.specular[1] <= 0.0f && material.specular[2] <= 0.0f);
+		bool use_spc = material.useSpecular();
 
 		std::vector<MString> defs;
 		if (jointNum > 0) {
 			defs.push_back(L"SKINNING");
 			defs.push_back(MString::format(L"SKINNING_JOINT_COUNT %d", jointNum));
+			if (dualQuat) {
+				defs.push_back(L"SKINNING_DUAL_QUATERNION");
+			}
 		}
 		if (material.useLighting) {
 			defs.push_back(L"DIRECTIONAL_LIGHT_COUNT 1");
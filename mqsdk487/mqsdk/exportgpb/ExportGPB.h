@@ -39,23 +39,25 @@
 #include "MQBoneManager.h"
 #include "MQMorphManager.h"
 #include "Language.h"
+#include "MQDualQuaternion.h"
+#include "MQBoundingBox.h"
 //#include "Edition.h"
 #include <vector>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <list>
 #include <algorithm>
 #include <assert.h>
+#include <string.h>
 #include "MFileUtil.h"
 #include "datastruct.h"
+#include "GPBFormat.h"
 #include <iostream>
 #include <sstream>
-
-#define GL_TRIANGLE (0x0004)
-#define GL_LINES (0x0001)
-#define GL_UNSIGNED_BYTE (0x1401)
-#define GL_UNSIGNED_SHORT (0x1403)
-#define GL_UNSIGNED_INT (0x1405)
+#include "GPBProfile.h"
+#include "GPBFileWriter.h"
+#include "GPBTextureAtlas.h"
 
 enum {
 	FILEOUT_NO = 0,
@@ -69,6 +71,26 @@ enum {
 	FILEIN_USE = 1,
 };
 
+enum {
+	ATLAS_NO = 0,
+	ATLAS_SELECTED = 1,
+	ATLAS_ALL = 2,
+};
+
+// テクスチャアトラスの一辺の最大ピクセル数
+#define ATLAS_MAX_SIZE (2048)
+// これより大きいテクスチャはアトラスに入れない
+#define ATLAS_ENTRY_MAX_SIZE (512)
+// アトラス内の画像の周りに複製する縁のピクセル数
+#define ATLAS_PADDING (4)
+
+// 頂点を溶接する位置の許容誤差
+#define WELD_POSITION_TOLERANCE (0.0001f)
+// 頂点を溶接する法線の内積の下限. 約1度
+#define WELD_NORMAL_TOLERANCE (0.99985f)
+// 頂点を溶接する UV の許容誤差
+#define WELD_UV_TOLERANCE (0.0001f)
+
 
 #define EPS	0.00001
 
@@ -86,17 +108,6 @@ struct INDEXWEIGHT {
 };
 
 
-// @see Node.h#L58
-enum GPBNodeType {
-	GPBNODE_NODE = 1,
-	GPBNODE_JOINT = 2,
-};
-
-// @see Transform.h#L89
-enum AnimationAttr {
-	ANIMATE_ROTATE_TRANSLATE = 16,
-	ANIMATE_SCALE_ROTATE_TRANSLATE = 17,
-};
 
 struct GPBBounding {
 	float min[3];
@@ -169,6 +180,75 @@ struct GPBMaterial {
 		specular[2] = 0.0f;
 		spc_pow = 5.0f;
 	}
+
+	/// <summary>
+	/// .material に書き出す描画状態が同じかどうか. 名前と面は比べない
+	/// </summary>
+	bool sameRenderState(const GPBMaterial& other) const {
+		if (useTexture != other.useTexture
+			|| useLighting != other.useLighting
+			|| (isDouble != FALSE) != (other.isDouble != FALSE)
+			|| spc_pow != other.spc_pow) {
+			return false;
+		}
+		if (useLighting && useSpecular() != other.useSpecular()) {
+			return false;
+		}
+		if (useTexture) {
+			return (convDiffuseTexture == other.convDiffuseTexture
+				&& wrapU == other.wrapU
+				&& wrapV == other.wrapV
+				&& filter == other.filter);
+		}
+		for (int i = 0; i < 4; ++i) {
+			if (diffuse[i] != other.diffuse[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// sameRenderState() が真になる材質同士で同じ値になるハッシュ
+	/// </summary>
+	size_t renderStateHash() const {
+		unsigned long long h = 14695981039346656037ULL;
+		auto mix = [&h](unsigned long long v) {
+			h ^= v;
+			h *= 1099511628211ULL;
+		};
+		auto mixFloat = [&mix](float f) {
+			f += 0.0f; // -0 を +0 にそろえる
+			unsigned int bits;
+			memcpy(&bits, &f, sizeof(bits));
+			mix(bits);
+		};
+		mix(useTexture ? 1 : 0);
+		mix(useLighting ? 1 : 0);
+		mix(isDouble ? 1 : 0);
+		mix((useLighting && useSpecular()) ? 1 : 0);
+		mixFloat(spc_pow);
+		if (useTexture) {
+			for (const wchar_t* p = convDiffuseTexture.c_str(); *p != L'\0'; ++p) {
+				mix((unsigned long long)*p);
+			}
+			mix(wrapU);
+			mix(wrapV);
+			mix(filter);
+		} else {
+			for (int i = 0; i < 4; ++i) {
+				mixFloat(diffuse[i]);
+			}
+		}
+		return (size_t)h;
+	}
+
+	/// <summary>
+	/// SPECULAR を define するかどうか
+	/// </summary>
+	bool useSpecular() const {
+		return !(specular[0] <= 0.0f && specular[1] <= 0.0f && specular[2] <= 0.0f);
+	}
 };
 
 
@@ -262,6 +342,8 @@ struct GPBBoneParam {
 };
 
 
+struct CreateDialogOptionParam;
+
 
 class ExportGPBPlugin : public MQExportPlugin
 {
@@ -289,6 +371,17 @@ public:
 	// ファイルの読み込み
 	BOOL ExportFile(int index, const wchar_t *filename, MQDocument doc) override;
 
+	/// <summary>
+	/// ダイアログを出さずに option の内容で書き出す。
+	/// ExportFile() とベンチマークから呼ぶ。
+	/// </summary>
+	BOOL exportDocument(const wchar_t *filename, MQDocument doc,
+		const CreateDialogOptionParam& option,
+		float scaling,
+		MLanguage& language,
+		MString& outputFiles,
+		GPBExportProfile *profile);
+
 
 private:
 	struct BoneNameSetting {
@@ -300,10 +393,57 @@ private:
 	std::vector<BoneNameSetting> m_BoneNameSetting;
 	bool LoadBoneSettingFile();
 
+	/// <summary>
+	/// 描画状態が同じ材質の面を最初の材質にまとめて、残りを無効にする
+	/// </summary>
+	/// <returns>無効にした材質の個数</returns>
+	int mergeMaterials(std::vector<GPBMaterial>& materials);
+
+	/// <summary>
+	/// テクスチャを描画状態ごとにアトラスにまとめ、UV を付け替えて材質を1つにする.
+	/// 他の材質と共有している頂点は複製する
+	/// </summary>
+	/// <param name="outputFiles">書き出したアトラス画像を1行ずつ追記する</param>
+	/// <param name="unchangedNum">内容が変わらず置き換えなかったアトラス画像の数を足す</param>
+	/// <returns>無効にした材質の個数</returns>
+	int packTextureAtlas(MQDocument doc,
+		const MString& filename,
+		const CreateDialogOptionParam& option,
+		std::vector<GPBMaterial>& materials,
+		std::vector<int>& vert_orgobj,
+		std::vector<int>& vert_expvert,
+		std::vector<MQPoint>& vert_normal,
+		std::vector<MQCoordinate>& vert_coord,
+		MLanguage& language,
+		MString& outputFiles,
+		int& unchangedNum);
+
+	/// <summary>
+	/// 材質ごとに全オブジェクトをまたいで、位置、法線、UV が許容誤差内の頂点を1つにする.
+	/// 溶接で角が重なって面積の無くなった三角形は消し、使われなくなった頂点は詰める
+	/// </summary>
+	/// <param name="sameOriginal">true なら元の頂点が同じものだけ溶接する(スキンウェイトを保つ)</param>
+	/// <param name="droppedNum">消した三角形の数を足す</param>
+	/// <returns>減った頂点数</returns>
+	int weldVertices(MQDocument doc,
+		const std::vector<MQExportObject*>& expobjs,
+		std::vector<GPBMaterial>& materials,
+		std::vector<int>& vert_orgobj,
+		std::vector<int>& vert_expvert,
+		std::vector<MQPoint>& vert_normal,
+		std::vector<MQCoordinate>& vert_coord,
+		bool sameOriginal,
+		int& droppedNum);
+
+	/// <summary>
+	/// .material を書き出す
+	/// </summary>
+	/// <param name="dualQuat">DQS 用の define を出力する</param>
 	int makeMaterial(FILE* fhMaterial,
 		const std::vector<GPBMaterial>& materials,
 		const MString& option,
-		int jointNum);
+		int jointNum,
+		bool dualQuat);
 
 	/// <summary>
 	/// プレビューコードを書き出す。
@@ -375,6 +515,18 @@ struct CreateDialogOptionParam
 	/// </summary>
 	int material_conv;
 	/// <summary>
+	/// 1: 描画状態が同じ材質をまとめる
+	/// </summary>
+	int material_merge = 0;
+	/// <summary>
+	/// ATLAS_NO, ATLAS_SELECTED, ATLAS_ALL
+	/// </summary>
+	int texture_atlas = 0;
+	/// <summary>
+	/// 1: 許容誤差内の頂点を溶接する
+	/// </summary>
+	int weld = 0;
+	/// <summary>
 	/// 1: スケールと回転も採用する
 	/// </summary>
 	int bone_scale_rot = 0;
@@ -384,7 +536,17 @@ struct CreateDialogOptionParam
 	/// </summary>
 	int bone_conv = 0;
 
+	/// <summary>
+	/// 0: 線形ブレンド(LBS), 1: デュアルクォータニオン(DQS)
+	/// </summary>
+	int skinning_mode = 0;
+
 	int additive_info = 0;
+
+	/// <summary>
+	/// 1: 計測結果を .profile.json に書き出す
+	/// </summary>
+	int profile_log = 0;
 };
 
 
@@ -404,8 +566,13 @@ public:
 	MQComboBox* combo_xmlanimfile;
 
 	MQComboBox* combo_materialconv;
+	MQComboBox* combo_materialmerge;
+	MQComboBox* combo_textureatlas;
+	MQComboBox* combo_weld;
 
 	MQComboBox* combo_bonescalerot;
+	MQComboBox* combo_skinning;
+	MQComboBox* combo_profilelog;
 #if (USEEXTENDEDUI!=0)
 	MQComboBox* combo_boneconv;
 #endif
@@ -473,33 +640,5 @@ enum CodeType
 	CODE_SJIS,
 };
 
-enum RefType
-{
-	REF_SCENE = 1,
-	REF_NODE = 2,
-	REF_ANIMATIONS = 3,
-	REF_MESH = 34, // 0x22
-};
 
-/// <summary>
-/// from VertexFormat.h
-/// </summary>
-enum AttrType
-{
-	ATTR_POSITION = 1,
-	ATTR_NORMAL = 2,
-	ATTR_COLOR = 3,
-	ATTR_TANGENT = 4,
-	ATTR_BINORMAL = 5,
-	ATTR_BLENDWEIGHTS = 6,
-	ATTR_BLENDINDICES = 7,
-	ATTR_TEXCOORD0 = 8,
-	ATTR_TEXCOORD1 = 9,
-	ATTR_TEXCOORD2 = 10,
-	ATTR_TEXCOORD3 = 11,
-	ATTR_TEXCOORD4 = 12,
-	ATTR_TEXCOORD5 = 13,
-	ATTR_TEXCOORD6 = 14,
-	ATTR_TEXCOORD7 = 15,
-};
 
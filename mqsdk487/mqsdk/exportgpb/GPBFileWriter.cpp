@@ -0,0 +1,75 @@
+﻿#include "GPBFileWriter.h"
+#include "MFileUtil.h"
+
+
+GPBFileWriter::GPBFileWriter()
+{
+	m_Fp = nullptr;
+	m_Hash = 0;
+	m_Unchanged = false;
+}
+
+GPBFileWriter::~GPBFileWriter()
+{
+	discard();
+}
+
+bool GPBFileWriter::open(const MString& path, const wchar_t* mode)
+{
+	discard();
+
+	m_Path = path;
+	m_TempPath = path + L".tmp";
+	m_Hash = 0;
+	m_Unchanged = false;
+
+	errno_t err = _wfopen_s(&m_Fp, m_TempPath.c_str(), mode);
+	if (err != 0) {
+		m_Fp = nullptr;
+		return false;
+	}
+	return true;
+}
+
+bool GPBFileWriter::commit()
+{
+	if (m_Fp == nullptr) {
+		return false;
+	}
+	int err = fclose(m_Fp);
+	m_Fp = nullptr;
+	if (err != 0) {
+		MFileUtil::deleteFile(m_TempPath);
+		return false;
+	}
+
+	long long size = 0;
+	if (!MFileUtil::hashFile(m_TempPath, m_Hash, size)) {
+		MFileUtil::deleteFile(m_TempPath);
+		return false;
+	}
+
+	// 既存のファイルと中身が同じなら置き換えない.
+	// ハッシュの一致だけでは衝突したときに変更を失うので、バイト単位で比べる
+	if (MFileUtil::isSameFileContent(m_Path, m_TempPath)) {
+		m_Unchanged = true;
+		MFileUtil::deleteFile(m_TempPath);
+		return true;
+	}
+
+	if (!MFileUtil::replaceFile(m_Path, m_TempPath)) {
+		MFileUtil::deleteFile(m_TempPath);
+		return false;
+	}
+	return true;
+}
+
+void GPBFileWriter::discard()
+{
+	if (m_Fp == nullptr) {
+		return;
+	}
+	fclose(m_Fp);
+	m_Fp = nullptr;
+	MFileUtil::deleteFile(m_TempPath);
+}
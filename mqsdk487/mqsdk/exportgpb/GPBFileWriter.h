@@ -0,0 +1,65 @@
+﻿#pragma once
+
+// 一時ファイルに書き出してから置き換える.
+// 内容が既存のファイルと同じなら置き換えずに一時ファイルを消すので、
+// 既存のファイルの更新日時が変わらない
+
+#include <stdio.h>
+#include "MString.h"
+
+
+/// <summary>
+/// 出力ファイル1つ分
+/// </summary>
+class GPBFileWriter
+{
+public:
+	GPBFileWriter();
+	/// <summary>
+	/// commit() していなければ一時ファイルを消す
+	/// </summary>
+	~GPBFileWriter();
+
+	/// <summary>
+	/// path と同じフォルダの一時ファイルを開く
+	/// </summary>
+	/// <param name="path">最終的な出力先</param>
+	/// <param name="mode">_wfopen_s() のモード</param>
+	bool open(const MString& path, const wchar_t* mode);
+
+	/// <summary>
+	/// 書き込み先. 開いていなければ nullptr
+	/// </summary>
+	FILE* fp() const { return m_Fp; }
+
+	/// <summary>
+	/// 一時ファイルを閉じてハッシュを計算し、
+	/// 既存のファイルと中身が違えば置き換える
+	/// </summary>
+	bool commit();
+
+	/// <summary>
+	/// 一時ファイルを閉じて消す
+	/// </summary>
+	void discard();
+
+	const MString& getPath() const { return m_Path; }
+	/// <summary>
+	/// 内容の FNV-1a 64bit ハッシュ. commit() 後に有効
+	/// </summary>
+	unsigned long long getHash() const { return m_Hash; }
+	/// <summary>
+	/// 既存のファイルと同じ内容だったので置き換えなかった
+	/// </summary>
+	bool isUnchanged() const { return m_Unchanged; }
+
+private:
+	GPBFileWriter(const GPBFileWriter&) = delete;
+	GPBFileWriter& operator=(const GPBFileWriter&) = delete;
+
+	FILE* m_Fp;
+	MString m_Path;
+	MString m_TempPath;
+	unsigned long long m_Hash;
+	bool m_Unchanged;
+};
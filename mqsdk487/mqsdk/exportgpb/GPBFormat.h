@@ -0,0 +1,59 @@
+﻿#pragma once
+
+// .gpb の定数. ExportGPB と GPBReader で共有する
+// https://github.com/gameplay3d/gameplay/blob/master/gameplay/src/Bundle.cpp
+
+/// <summary>
+/// 先頭の識別子 9 バイト
+/// </summary>
+#define GPB_IDENTIFIER "\xabGPB\xbb\x0d\x0a\x1a\x0a"
+#define GPB_IDENTIFIER_SIZE (9)
+
+#define GL_TRIANGLE (0x0004)
+#define GL_LINES (0x0001)
+#define GL_UNSIGNED_BYTE (0x1401)
+#define GL_UNSIGNED_SHORT (0x1403)
+#define GL_UNSIGNED_INT (0x1405)
+
+
+// @see Node.h#L58
+enum GPBNodeType {
+	GPBNODE_NODE = 1,
+	GPBNODE_JOINT = 2,
+};
+
+// @see Transform.h#L89
+enum AnimationAttr {
+	ANIMATE_ROTATE_TRANSLATE = 16,
+	ANIMATE_SCALE_ROTATE_TRANSLATE = 17,
+};
+
+enum RefType
+{
+	REF_SCENE = 1,
+	REF_NODE = 2,
+	REF_ANIMATIONS = 3,
+	REF_MESH = 34, // 0x22
+};
+
+/// <summary>
+/// from VertexFormat.h
+/// </summary>
+enum AttrType
+{
+	ATTR_POSITION = 1,
+	ATTR_NORMAL = 2,
+	ATTR_COLOR = 3,
+	ATTR_TANGENT = 4,
+	ATTR_BINORMAL = 5,
+	ATTR_BLENDWEIGHTS = 6,
+	ATTR_BLENDINDICES = 7,
+	ATTR_TEXCOORD0 = 8,
+	ATTR_TEXCOORD1 = 9,
+	ATTR_TEXCOORD2 = 10,
+	ATTR_TEXCOORD3 = 11,
+	ATTR_TEXCOORD4 = 12,
+	ATTR_TEXCOORD5 = 13,
+	ATTR_TEXCOORD6 = 14,
+	ATTR_TEXCOORD7 = 15,
+};
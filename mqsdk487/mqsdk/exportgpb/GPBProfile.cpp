@@ -0,0 +1,268 @@
+﻿#include "GPBProfile.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+
+//---------------------------------------------------------------------------
+//  メモリ確保量の計数
+//---------------------------------------------------------------------------
+
+static std::atomic<long long> s_LiveBytes(0);
+static std::atomic<long long> s_PeakBytes(0);
+static std::atomic<long long> s_AllocCount(0);
+
+#if (USEALLOCPROFILE != 0)
+
+// 解放時にサイズが分かるように先頭にサイズを置く. 後ろの領域の整列を保つ大きさにする
+static const size_t ALLOC_HEADER_SIZE = alignof(std::max_align_t);
+
+static void* countedAlloc(size_t size)
+{
+	void* base = malloc(size + ALLOC_HEADER_SIZE);
+	if (base == nullptr) {
+		return nullptr;
+	}
+	*(size_t*)base = size;
+
+	long long live = s_LiveBytes.fetch_add((long long)size, std::memory_order_relaxed) + (long long)size;
+	s_AllocCount.fetch_add(1, std::memory_order_relaxed);
+	long long peak = s_PeakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !s_PeakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+	}
+	return (char*)base + ALLOC_HEADER_SIZE;
+}
+
+static void countedFree(void* ptr)
+{
+	if (ptr == nullptr) {
+		return;
+	}
+	void* base = (char*)ptr - ALLOC_HEADER_SIZE;
+	s_LiveBytes.fetch_sub((long long)*(size_t*)base, std::memory_order_relaxed);
+	free(base);
+}
+
+void* operator new(size_t size)
+{
+	void* p = countedAlloc(size);
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	void* p = countedAlloc(size);
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAlloc(size);
+}
+
+void operator delete(void* ptr) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { countedFree(ptr); }
+
+#endif
+
+
+//---------------------------------------------------------------------------
+//  GPBExportProfile
+//---------------------------------------------------------------------------
+
+GPBExportProfile::GPBExportProfile()
+{
+	m_TotalMsec = 0.0;
+	m_TotalPeakBytes = 0;
+	m_InStage = false;
+	m_StartLiveBytes = 0;
+	m_StageLiveBytes = 0;
+	m_StageAllocCount = 0;
+}
+
+GPBExportProfile::~GPBExportProfile()
+{
+}
+
+bool GPBExportProfile::isAllocCounted()
+{
+	return (USEALLOCPROFILE != 0);
+}
+
+void GPBExportProfile::begin()
+{
+	m_Stages.clear();
+	m_Counts.clear();
+	m_TotalMsec = 0.0;
+	m_TotalPeakBytes = 0;
+	m_InStage = false;
+	m_Start = std::chrono::steady_clock::now();
+	m_StartLiveBytes = s_LiveBytes.load();
+	s_PeakBytes.store(m_StartLiveBytes);
+}
+
+void GPBExportProfile::stage(const char* name)
+{
+	endStage();
+
+	// 段階の最大値を測るために最大値を今の量に戻す. その前に全体の最大値に反映する
+	long long live = s_LiveBytes.load();
+	long long peak = s_PeakBytes.exchange(live);
+	if (peak - m_StartLiveBytes > m_TotalPeakBytes) {
+		m_TotalPeakBytes = peak - m_StartLiveBytes;
+	}
+
+	Stage stage;
+	stage.name = name;
+	stage.msec = 0.0;
+	stage.peakBytes = 0;
+	stage.deltaBytes = 0;
+	stage.allocCount = 0;
+	m_Stages.push_back(stage);
+
+	m_InStage = true;
+	m_StageLiveBytes = live;
+	m_StageAllocCount = s_AllocCount.load();
+	m_StageStart = std::chrono::steady_clock::now();
+}
+
+void GPBExportProfile::endStage()
+{
+	if (!m_InStage) {
+		return;
+	}
+	auto now = std::chrono::steady_clock::now();
+	Stage& stage = m_Stages.back();
+	stage.msec = std::chrono::duration<double, std::milli>(now - m_StageStart).count();
+	long long peak = s_PeakBytes.load();
+	stage.peakBytes = peak - m_StageLiveBytes;
+	stage.deltaBytes = s_LiveBytes.load() - m_StageLiveBytes;
+	stage.allocCount = s_AllocCount.load() - m_StageAllocCount;
+	if (peak - m_StartLiveBytes > m_TotalPeakBytes) {
+		m_TotalPeakBytes = peak - m_StartLiveBytes;
+	}
+	m_InStage = false;
+}
+
+void GPBExportProfile::end()
+{
+	endStage();
+	long long peak = s_PeakBytes.load();
+	if (peak - m_StartLiveBytes > m_TotalPeakBytes) {
+		m_TotalPeakBytes = peak - m_StartLiveBytes;
+	}
+	auto now = std::chrono::steady_clock::now();
+	m_TotalMsec = std::chrono::duration<double, std::milli>(now - m_Start).count();
+}
+
+void GPBExportProfile::setCount(const char* name, long long value)
+{
+	for (auto& count : m_Counts) {
+		if (strcmp(count.first, name) == 0) {
+			count.second = value;
+			return;
+		}
+	}
+	m_Counts.push_back(std::make_pair(name, value));
+}
+
+std::string GPBExportProfile::toString() const
+{
+	std::string ret;
+	char buf[256];
+
+	for (size_t i = 0; i < m_Counts.size(); ++i) {
+		snprintf(buf, sizeof(buf), "%s%s %lld", (i > 0) ? ", " : "", m_Counts[i].first, m_Counts[i].second);
+		ret += buf;
+	}
+	if (!m_Counts.empty()) {
+		ret += "\n";
+	}
+
+	bool mem = isAllocCounted();
+	for (const auto& stage : m_Stages) {
+		if (mem) {
+			snprintf(buf, sizeof(buf), "%s: %.1f ms, peak %.1f MB\n",
+				stage.name, stage.msec, stage.peakBytes / (1024.0 * 1024.0));
+		} else {
+			snprintf(buf, sizeof(buf), "%s: %.1f ms\n", stage.name, stage.msec);
+		}
+		ret += buf;
+	}
+	if (mem) {
+		snprintf(buf, sizeof(buf), "total: %.1f ms, peak %.1f MB", m_TotalMsec, m_TotalPeakBytes / (1024.0 * 1024.0));
+	} else {
+		snprintf(buf, sizeof(buf), "total: %.1f ms", m_TotalMsec);
+	}
+	ret += buf;
+	return ret;
+}
+
+static std::string escapeJson(const char* text)
+{
+	std::string ret;
+	for (const char* p = text; *p != '\0'; ++p) {
+		switch (*p) {
+		case '"': ret += "\\\""; break;
+		case '\\': ret += "\\\\"; break;
+		case '\n': ret += "\\n"; break;
+		case '\r': ret += "\\r"; break;
+		case '\t': ret += "\\t"; break;
+		default:
+			if ((unsigned char)*p < 0x20) {
+				char buf[8];
+				snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)*p);
+				ret += buf;
+			} else {
+				ret += *p;
+			}
+			break;
+		}
+	}
+	return ret;
+}
+
+bool GPBExportProfile::writeJson(FILE* fp, const char* target) const
+{
+	if (fp == nullptr) {
+		return false;
+	}
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"target\": \"%s\",\n", escapeJson(target).c_str());
+	fprintf(fp, "  \"alloc_counted\": %s,\n", isAllocCounted() ? "true" : "false");
+	fprintf(fp, "  \"total_msec\": %.3f,\n", m_TotalMsec);
+	fprintf(fp, "  \"peak_bytes\": %lld,\n", m_TotalPeakBytes);
+	fprintf(fp, "  \"counts\": {");
+	for (size_t i = 0; i < m_Counts.size(); ++i) {
+		fprintf(fp, "%s\"%s\": %lld", (i > 0) ? ", " : " ", m_Counts[i].first, m_Counts[i].second);
+	}
+	fprintf(fp, "%s},\n", m_Counts.empty() ? "" : " ");
+	fprintf(fp, "  \"stages\": [\n");
+	for (size_t i = 0; i < m_Stages.size(); ++i) {
+		const auto& stage = m_Stages[i];
+		fprintf(fp, "    { \"name\": \"%s\", \"msec\": %.3f, \"peak_bytes\": %lld, \"delta_bytes\": %lld, \"alloc_count\": %lld }%s\n",
+			stage.name, stage.msec, stage.peakBytes, stage.deltaBytes, stage.allocCount,
+			(i + 1 < m_Stages.size()) ? "," : "");
+	}
+	fprintf(fp, "  ]\n");
+	fprintf(fp, "}\n");
+	return (ferror(fp) == 0);
+}
@@ -0,0 +1,137 @@
+﻿#pragma once
+
+// ExportFile() の段階ごとの所要時間とメモリ確保量を記録する.
+// MQ の API には依存しないので、ベンチマークからも使える
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+// 1 だと operator new/delete を置き換えてメモリ確保量を数える.
+// プラグインと同じプロセスの確保がすべて置き換わるので、既定では無効にして
+// 計測するビルドでだけ定義する (CMake では -DGPB_ALLOC_PROFILE=ON)
+#ifndef USEALLOCPROFILE
+#define USEALLOCPROFILE (0)
+#endif
+
+
+/// <summary>
+/// 書き出しの段階ごとの計測結果
+/// </summary>
+class GPBExportProfile
+{
+public:
+	struct Stage {
+		/// <summary>
+		/// 段階名
+		/// </summary>
+		const char* name;
+		/// <summary>
+		/// 段階の所要ミリ秒
+		/// </summary>
+		double msec;
+		/// <summary>
+		/// 段階開始時点からの確保量の最大値(バイト)
+		/// </summary>
+		long long peakBytes;
+		/// <summary>
+		/// 段階開始時点から終了時点までの確保量の増減(バイト)
+		/// </summary>
+		long long deltaBytes;
+		/// <summary>
+		/// 確保回数
+		/// </summary>
+		long long allocCount;
+	};
+
+	GPBExportProfile();
+	~GPBExportProfile();
+
+	/// <summary>
+	/// 計測を始める. 記録はクリアする
+	/// </summary>
+	void begin();
+
+	/// <summary>
+	/// 今の段階を閉じて新しい段階を始める
+	/// </summary>
+	void stage(const char* name);
+
+	/// <summary>
+	/// 今の段階を閉じる. 次の stage() までの時間はどの段階にも含まれない
+	/// </summary>
+	void endStage();
+
+	/// <summary>
+	/// 計測を終える
+	/// </summary>
+	void end();
+
+	/// <summary>
+	/// 頂点数などの件数を記録する. 同じ名前なら上書きする
+	/// </summary>
+	void setCount(const char* name, long long value);
+
+	const std::vector<Stage>& getStages() const { return m_Stages; }
+	const std::vector<std::pair<const char*, long long>>& getCounts() const { return m_Counts; }
+	double getTotalMsec() const { return m_TotalMsec; }
+	/// <summary>
+	/// begin() から end() までの確保量の最大値(バイト)
+	/// </summary>
+	long long getPeakBytes() const { return m_TotalPeakBytes; }
+
+	/// <summary>
+	/// メッセージボックス用の複数行テキスト
+	/// </summary>
+	std::string toString() const;
+
+	/// <summary>
+	/// JSON で書き出す
+	/// </summary>
+	/// <param name="target">対象ファイル名(UTF-8)</param>
+	bool writeJson(FILE* fp, const char* target) const;
+
+	/// <summary>
+	/// メモリ確保量を数えているかどうか
+	/// </summary>
+	static bool isAllocCounted();
+
+private:
+	std::vector<Stage> m_Stages;
+	std::vector<std::pair<const char*, long long>> m_Counts;
+	double m_TotalMsec;
+	long long m_TotalPeakBytes;
+
+	bool m_InStage;
+	std::chrono::steady_clock::time_point m_Start;
+	std::chrono::steady_clock::time_point m_StageStart;
+	long long m_StartLiveBytes;
+	long long m_StageLiveBytes;
+	long long m_StageAllocCount;
+};
+
+
+/// <summary>
+/// スコープの間を1つの段階として記録する. profile が nullptr なら何もしない
+/// </summary>
+class GPBProfileScope
+{
+public:
+	GPBProfileScope(GPBExportProfile* profile, const char* name) : m_Profile(profile) {
+		if (m_Profile != nullptr) {
+			m_Profile->stage(name);
+		}
+	}
+	~GPBProfileScope() {
+		if (m_Profile != nullptr) {
+			m_Profile->endStage();
+		}
+	}
+
+	GPBProfileScope(const GPBProfileScope&) = delete;
+	GPBProfileScope& operator=(const GPBProfileScope&) = delete;
+
+private:
+	GPBExportProfile* m_Profile;
+};
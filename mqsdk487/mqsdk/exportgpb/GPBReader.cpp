@@ -0,0 +1,913 @@
+﻿#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "GPBReader.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <set>
+
+// ジョイントの入れ子の上限. 壊れたファイルで再帰が深くなりすぎないように
+#define GPB_MAX_NODE_DEPTH (256)
+
+// 検証の許容誤差
+#define GPB_WEIGHT_EPS (1e-3f)
+#define GPB_BOUNDS_EPS (1e-4f)
+// 1属性あたりの最大 float 数. 行列(16)まで
+#define GPB_MAX_ATTR_SIZE (16)
+
+
+GPBMappedFile::GPBMappedFile()
+{
+	m_Data = nullptr;
+	m_Size = 0;
+#ifdef _WIN32
+	m_File = INVALID_HANDLE_VALUE;
+	m_Mapping = nullptr;
+#else
+	m_Fd = -1;
+#endif
+}
+
+GPBMappedFile::~GPBMappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+bool GPBMappedFile::open(const char* path)
+{
+	// UTF-8 として扱う
+	int len = MultiByteToWideChar(CP_UTF8, 0, path, -1, nullptr, 0);
+	if (len <= 0) {
+		return false;
+	}
+	std::wstring wpath(len, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, path, -1, &wpath[0], len);
+	return open(wpath.c_str());
+}
+
+bool GPBMappedFile::open(const wchar_t* path)
+{
+	close();
+	HANDLE file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	m_File = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		close();
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		close();
+		return false;
+	}
+	m_Mapping = mapping;
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr) {
+		close();
+		return false;
+	}
+	m_Data = static_cast<const uint8_t*>(view);
+	m_Size = (size_t)size.QuadPart;
+	return true;
+}
+
+void GPBMappedFile::close()
+{
+	if (m_Data != nullptr) {
+		UnmapViewOfFile(m_Data);
+		m_Data = nullptr;
+	}
+	if (m_Mapping != nullptr) {
+		CloseHandle(m_Mapping);
+		m_Mapping = nullptr;
+	}
+	if (m_File != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+	}
+	m_Size = 0;
+}
+#else
+bool GPBMappedFile::open(const char* path)
+{
+	close();
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	m_Fd = fd;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close();
+		return false;
+	}
+	void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED) {
+		close();
+		return false;
+	}
+	m_Data = static_cast<const uint8_t*>(view);
+	m_Size = (size_t)st.st_size;
+	return true;
+}
+
+void GPBMappedFile::close()
+{
+	if (m_Data != nullptr) {
+		munmap(const_cast<uint8_t*>(m_Data), m_Size);
+		m_Data = nullptr;
+	}
+	if (m_Fd >= 0) {
+		::close(m_Fd);
+		m_Fd = -1;
+	}
+	m_Size = 0;
+}
+#endif
+
+
+static uint32_t _readU32(const uint8_t* p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static float _readF32(const uint8_t* p) {
+	float v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static std::string _format(const char* fmt, ...) {
+	char buf[512];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	return std::string(buf);
+}
+
+
+int GPBReadPart::getIndexSize() const
+{
+	switch (format) {
+	case GL_UNSIGNED_BYTE: return 1;
+	case GL_UNSIGNED_SHORT: return 2;
+	case GL_UNSIGNED_INT: return 4;
+	}
+	return 0;
+}
+
+uint32_t GPBReadPart::getIndexCount() const
+{
+	int size = getIndexSize();
+	return (size > 0) ? byteNum / size : 0;
+}
+
+uint32_t GPBReadPart::getIndex(uint32_t i) const
+{
+	switch (format) {
+	case GL_UNSIGNED_BYTE:
+		return indices[i];
+	case GL_UNSIGNED_SHORT: {
+		uint16_t v;
+		memcpy(&v, indices + i * 2, sizeof(v));
+		return v;
+	}
+	case GL_UNSIGNED_INT:
+		return _readU32(indices + i * 4);
+	}
+	return 0;
+}
+
+int GPBReadMesh::findAttr(uint32_t usage) const
+{
+	int pos = 0;
+	for (const auto& attr : attrs) {
+		if (attr.usage == usage) {
+			return pos;
+		}
+		pos += attr.size;
+	}
+	return -1;
+}
+
+int GPBReadMesh::findAttr(uint32_t usage, uint32_t minSize, uint32_t maxSize) const
+{
+	int pos = 0;
+	for (const auto& attr : attrs) {
+		if (attr.usage == usage) {
+			return (attr.size >= minSize && attr.size <= maxSize) ? pos : -1;
+		}
+		pos += attr.size;
+	}
+	return -1;
+}
+
+float GPBReadMesh::getFloat(uint32_t vertex, uint32_t element) const
+{
+	return _readF32(vertices + ((size_t)vertex * vertexStride + element) * 4);
+}
+
+
+/// <summary>
+/// 範囲チェック付きの読み取り位置
+/// </summary>
+struct GPBReader::Cursor {
+	const uint8_t* begin;
+	const uint8_t* p;
+	const uint8_t* end;
+	std::string* error;
+
+	uint32_t tell() const { return (uint32_t)(p - begin); }
+
+	bool fail(const char* what) {
+		if (error->empty()) {
+			*error = _format("unexpected end of file at 0x%08x (%s)", tell(), what);
+		}
+		return false;
+	}
+
+	bool skip(size_t n, const char* what) {
+		if ((size_t)(end - p) < n) {
+			return fail(what);
+		}
+		p += n;
+		return true;
+	}
+
+	/// <summary>
+	/// n バイト先へ進めて、元の位置を返す. コピーはしない
+	/// </summary>
+	bool view(size_t n, const uint8_t*& out, const char* what) {
+		out = p;
+		return skip(n, what);
+	}
+
+	bool u8(uint8_t& v, const char* what) {
+		if (p >= end) {
+			return fail(what);
+		}
+		v = *p++;
+		return true;
+	}
+
+	bool u32(uint32_t& v, const char* what) {
+		if ((size_t)(end - p) < 4) {
+			return fail(what);
+		}
+		v = _readU32(p);
+		p += 4;
+		return true;
+	}
+
+	bool f32(float* v, int n, const char* what) {
+		if ((size_t)(end - p) < (size_t)n * 4) {
+			return fail(what);
+		}
+		memcpy(v, p, (size_t)n * 4);
+		p += (size_t)n * 4;
+		return true;
+	}
+
+	bool str(std::string& s, const char* what) {
+		uint32_t len;
+		const uint8_t* q;
+		if (!u32(len, what) || !view(len, q, what)) {
+			return false;
+		}
+		s.assign((const char*)q, len);
+		return true;
+	}
+
+	/// <summary>
+	/// 個数付きの配列. 個数 * elem_size がファイルに収まるか先に調べる
+	/// </summary>
+	bool array(uint32_t& num, size_t elem_size, const uint8_t*& out, const char* what) {
+		if (!u32(num, what)) {
+			return false;
+		}
+		if ((size_t)(end - p) / elem_size < num) {
+			return fail(what);
+		}
+		return view(num * elem_size, out, what);
+	}
+};
+
+
+GPBReader::GPBReader()
+{
+	major = 0;
+	minor = 0;
+	ambient[0] = ambient[1] = ambient[2] = 0.0f;
+	m_Data = nullptr;
+	m_Size = 0;
+	m_SceneOffset = 0;
+	m_AnimationsOffset = 0;
+}
+
+bool GPBReader::open(const char* path)
+{
+	if (!m_File.open(path)) {
+		m_Error = _format("cannot open '%s'", path);
+		return false;
+	}
+	return parse(m_File.data(), m_File.size());
+}
+
+#ifdef _WIN32
+bool GPBReader::open(const wchar_t* path)
+{
+	if (!m_File.open(path)) {
+		m_Error = "cannot open file";
+		return false;
+	}
+	return parse(m_File.data(), m_File.size());
+}
+#endif
+
+const GPBReadRef* GPBReader::findRef(const std::string& name, uint32_t type) const
+{
+	for (const auto& ref : refs) {
+		if (ref.type == type && ref.name == name) {
+			return &ref;
+		}
+	}
+	return nullptr;
+}
+
+int GPBReader::findNodeByOffset(uint32_t offset) const
+{
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		if (nodes[i].offset == offset) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+int GPBReader::findMeshByOffset(uint32_t offset) const
+{
+	for (size_t i = 0; i < m_MeshOffsets.size(); ++i) {
+		if (m_MeshOffsets[i] == offset) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+bool GPBReader::parse(const uint8_t* data, size_t size)
+{
+	m_Data = data;
+	m_Size = size;
+	m_Error.clear();
+	refs.clear();
+	meshes.clear();
+	nodes.clear();
+	roots.clear();
+	animations.clear();
+	m_MeshOffsets.clear();
+
+	Cursor c = { data, data, data + size, &m_Error };
+
+	//// ヘッダ
+	const uint8_t* ident;
+	if (!c.view(GPB_IDENTIFIER_SIZE, ident, "identifier")) {
+		return false;
+	}
+	if (memcmp(ident, GPB_IDENTIFIER, GPB_IDENTIFIER_SIZE) != 0) {
+		m_Error = "not a gpb file";
+		return false;
+	}
+	if (!c.u8(major, "version") || !c.u8(minor, "version")) {
+		return false;
+	}
+
+	//// 参照テーブル
+	uint32_t refNum;
+	if (!c.u32(refNum, "ref count")) {
+		return false;
+	}
+	for (uint32_t i = 0; i < refNum; ++i) {
+		GPBReadRef ref;
+		if (!c.str(ref.name, "ref name") || !c.u32(ref.type, "ref type") || !c.u32(ref.offset, "ref offset")) {
+			return false;
+		}
+		refs.push_back(ref);
+	}
+
+	//// メッシュ
+	uint32_t meshNum;
+	if (!c.u32(meshNum, "mesh count")) {
+		return false;
+	}
+	for (uint32_t i = 0; i < meshNum; ++i) {
+		m_MeshOffsets.push_back(c.tell());
+
+		GPBReadMesh mesh;
+		uint32_t attrNum;
+		if (!c.u32(attrNum, "attribute count")) {
+			return false;
+		}
+		// ファイルの値をそのまま足すと桁あふれするので 64bit で数えて上限を設ける
+		uint64_t stride = 0;
+		for (uint32_t j = 0; j < attrNum; ++j) {
+			GPBReadAttr attr;
+			if (!c.u32(attr.usage, "attribute") || !c.u32(attr.size, "attribute")) {
+				return false;
+			}
+			if (attr.size == 0 || attr.size > GPB_MAX_ATTR_SIZE) {
+				m_Error = _format("attribute size %u at 0x%08x is out of range", attr.size, c.tell() - 4);
+				return false;
+			}
+			mesh.attrs.push_back(attr);
+			stride += attr.size;
+			if (stride * 4 > UINT32_MAX) {
+				m_Error = _format("vertex stride at 0x%08x is too large", c.tell() - 4);
+				return false;
+			}
+		}
+		mesh.vertexStride = (uint32_t)stride;
+		if (!c.array(mesh.vertexByteCount, 1, mesh.vertices, "vertices")) {
+			return false;
+		}
+		if (!c.f32(mesh.min, 3, "bounding") || !c.f32(mesh.max, 3, "bounding")
+			|| !c.f32(mesh.center, 3, "bounding") || !c.f32(&mesh.radius, 1, "bounding")) {
+			return false;
+		}
+
+		uint32_t partNum;
+		if (!c.u32(partNum, "part count")) {
+			return false;
+		}
+		for (uint32_t j = 0; j < partNum; ++j) {
+			GPBReadPart part;
+			if (!c.u32(part.primitive, "part") || !c.u32(part.format, "part")
+				|| !c.array(part.byteNum, 1, part.indices, "indices")) {
+				return false;
+			}
+			mesh.parts.push_back(part);
+		}
+		meshes.push_back(mesh);
+	}
+
+	//// シーン
+	uint32_t elementNum;
+	if (!c.u32(elementNum, "element count")) {
+		return false;
+	}
+	m_SceneOffset = c.tell();
+	uint32_t nodeNum;
+	if (!c.u32(nodeNum, "node count")) {
+		return false;
+	}
+	for (uint32_t i = 0; i < nodeNum; ++i) {
+		roots.push_back((int)nodes.size());
+		if (!parseNode(c, -1, 0)) {
+			return false;
+		}
+	}
+	if (!c.str(cameraName, "camera") || !c.f32(ambient, 3, "ambient")) {
+		return false;
+	}
+
+	//// アニメーション
+	m_AnimationsOffset = c.tell();
+	uint32_t animationNum;
+	if (!c.u32(animationNum, "animation count")) {
+		return false;
+	}
+	for (uint32_t i = 0; i < animationNum; ++i) {
+		GPBReadAnimation anim;
+		uint32_t channelNum;
+		if (!c.str(anim.id, "animation id") || !c.u32(channelNum, "channel count")) {
+			return false;
+		}
+		for (uint32_t j = 0; j < channelNum; ++j) {
+			GPBReadChannel ch;
+			const uint8_t* tangents;
+			uint32_t interpolationNum;
+			const uint8_t* interpolations;
+			if (!c.str(ch.target, "channel target") || !c.u32(ch.attrib, "channel attrib")
+				|| !c.array(ch.keyNum, 4, ch.keytimes, "key times")
+				|| !c.array(ch.valueNum, 4, ch.values, "key values")
+				|| !c.array(ch.tangentInNum, 4, tangents, "tangents in")
+				|| !c.array(ch.tangentOutNum, 4, tangents, "tangents out")
+				|| !c.array(interpolationNum, 4, interpolations, "interpolations")) {
+				return false;
+			}
+			for (uint32_t k = 0; k < interpolationNum; ++k) {
+				ch.interpolations.push_back(_readU32(interpolations + k * 4));
+			}
+			anim.channels.push_back(ch);
+		}
+		animations.push_back(anim);
+	}
+
+	return true;
+}
+
+bool GPBReader::parseNode(Cursor& c, int parent, int depth)
+{
+	if (depth > GPB_MAX_NODE_DEPTH) {
+		m_Error = _format("node nesting too deep at 0x%08x", c.tell());
+		return false;
+	}
+
+	int index = (int)nodes.size();
+	nodes.push_back(GPBReadNode());
+	{
+		GPBReadNode& node = nodes[index];
+		node.offset = c.tell();
+		node.parent = parent;
+		node.hasSkin = false;
+		node.inverseBindNum = 0;
+		node.inverseBind = nullptr;
+		if (!c.u32(node.type, "node type") || !c.f32(node.transform, 16, "node transform")
+			|| !c.str(node.parentName, "node parent")) {
+			return false;
+		}
+	}
+	if (parent >= 0) {
+		nodes[parent].children.push_back(index);
+	}
+
+	// 子ノードはこのノードの途中に入れ子で並ぶ. nodes は再確保されるので添字で触る
+	uint32_t childNum;
+	if (!c.u32(childNum, "child count")) {
+		return false;
+	}
+	for (uint32_t i = 0; i < childNum; ++i) {
+		if (!parseNode(c, index, depth + 1)) {
+			return false;
+		}
+	}
+
+	GPBReadNode& node = nodes[index];
+	uint8_t camera, light;
+	if (!c.u8(camera, "camera") || !c.u8(light, "light")) {
+		return false;
+	}
+	if (camera != 0 || light != 0) {
+		m_Error = _format("camera/light node at 0x%08x is not supported", node.offset);
+		return false;
+	}
+
+	if (!c.str(node.meshName, "model")) {
+		return false;
+	}
+	if (node.meshName.empty()) {
+		return true;
+	}
+
+	uint8_t hasSkin;
+	if (!c.u8(hasSkin, "skin")) {
+		return false;
+	}
+	node.hasSkin = (hasSkin != 0);
+	if (node.hasSkin) {
+		uint32_t jointNum;
+		if (!c.f32(node.bindShape, 16, "bind shape") || !c.u32(jointNum, "joint count")) {
+			return false;
+		}
+		for (uint32_t i = 0; i < jointNum; ++i) {
+			std::string name;
+			if (!c.str(name, "joint name")) {
+				return false;
+			}
+			node.jointNames.push_back(name);
+		}
+		if (!c.array(node.inverseBindNum, 4, node.inverseBind, "inverse bind")) {
+			return false;
+		}
+	}
+
+	uint32_t materialNum;
+	if (!c.u32(materialNum, "material count")) {
+		return false;
+	}
+	for (uint32_t i = 0; i < materialNum; ++i) {
+		std::string name;
+		if (!c.str(name, "material name")) {
+			return false;
+		}
+		node.materialNames.push_back(name);
+	}
+	return true;
+}
+
+
+std::string GPBValidationReport::toString() const
+{
+	std::string ret;
+	for (const auto& e : errors) {
+		ret += "error: " + e + "\n";
+	}
+	for (const auto& w : warnings) {
+		ret += "warning: " + w + "\n";
+	}
+	if (errors.empty() && warnings.empty()) {
+		ret = "ok\n";
+	}
+	return ret;
+}
+
+int GPBReader::validate(GPBValidationReport& report) const
+{
+	auto& errors = report.errors;
+	auto& warnings = report.warnings;
+
+	//// 参照テーブル
+	for (const auto& ref : refs) {
+		if (ref.offset >= m_Size) {
+			errors.push_back(_format("ref '%s' offset 0x%08x is out of file", ref.name.c_str(), ref.offset));
+			continue;
+		}
+		switch (ref.type) {
+		case REF_MESH:
+			if (std::find(m_MeshOffsets.begin(), m_MeshOffsets.end(), ref.offset) == m_MeshOffsets.end()) {
+				errors.push_back(_format("mesh ref '%s' does not point to a mesh", ref.name.c_str()));
+			}
+			break;
+		case REF_SCENE:
+			if (ref.offset != m_SceneOffset) {
+				errors.push_back(_format("scene ref '%s' does not point to the scene", ref.name.c_str()));
+			}
+			break;
+		case REF_ANIMATIONS:
+			if (ref.offset != m_AnimationsOffset) {
+				errors.push_back(_format("animations ref '%s' does not point to the animations", ref.name.c_str()));
+			}
+			break;
+		case REF_NODE:
+			if (findNodeByOffset(ref.offset) < 0) {
+				errors.push_back(_format("node ref '%s' does not point to a node", ref.name.c_str()));
+			}
+			break;
+		default:
+			warnings.push_back(_format("ref '%s' has unknown type %u", ref.name.c_str(), ref.type));
+			break;
+		}
+	}
+
+	//// メッシュ
+	// 後でジョイント数と比べるためにウェイトの最大インデックスを覚えておく
+	std::vector<int> maxJointIndex(meshes.size(), -1);
+	for (size_t mi = 0; mi < meshes.size(); ++mi) {
+		const GPBReadMesh& mesh = meshes[mi];
+		const uint32_t vert_num = mesh.getVertexCount();
+		if (mesh.vertexStride == 0 || mesh.vertexByteCount % ((uint64_t)mesh.vertexStride * 4) != 0) {
+			errors.push_back(_format("mesh %d: vertex byte count %u does not match stride %u", (int)mi, mesh.vertexByteCount, mesh.vertexStride));
+			continue;
+		}
+
+		// 属性の大きさ. 合わない属性は以降で読まない
+		for (const auto& attr : mesh.attrs) {
+			bool bad = false;
+			if (attr.usage == ATTR_POSITION) {
+				bad = (attr.size != 3);
+			}
+			else if (attr.usage >= ATTR_TEXCOORD0 && attr.usage <= ATTR_TEXCOORD7) {
+				bad = (attr.size < 2);
+			}
+			else if (attr.usage == ATTR_BLENDWEIGHTS || attr.usage == ATTR_BLENDINDICES) {
+				bad = (attr.size != 4);
+			}
+			if (bad) {
+				errors.push_back(_format("mesh %d: attribute %u has unexpected size %u", (int)mi, attr.usage, attr.size));
+			}
+		}
+
+		// 境界
+		int posAttr = mesh.findAttr(ATTR_POSITION, 3, 3);
+		if (mesh.findAttr(ATTR_POSITION) < 0) {
+			errors.push_back(_format("mesh %d: no position attribute", (int)mi));
+		}
+		else if (posAttr >= 0 && vert_num > 0) {
+			float bmin[3] = { mesh.getFloat(0, posAttr), mesh.getFloat(0, posAttr + 1), mesh.getFloat(0, posAttr + 2) };
+			float bmax[3] = { bmin[0], bmin[1], bmin[2] };
+			float maxDist2 = 0.0f;
+			for (uint32_t v = 0; v < vert_num; ++v) {
+				float d2 = 0.0f;
+				for (int k = 0; k < 3; ++k) {
+					float f = mesh.getFloat(v, posAttr + k);
+					bmin[k] = std::min(bmin[k], f);
+					bmax[k] = std::max(bmax[k], f);
+					float d = f - mesh.center[k];
+					d2 += d * d;
+				}
+				maxDist2 = std::max(maxDist2, d2);
+			}
+			for (int k = 0; k < 3; ++k) {
+				float tol = GPB_BOUNDS_EPS * std::max(1.0f, fabsf(bmax[k] - bmin[k]));
+				if (fabsf(bmin[k] - mesh.min[k]) > tol || fabsf(bmax[k] - mesh.max[k]) > tol) {
+					errors.push_back(_format("mesh %d: bounding box axis %d [%g, %g] differs from vertices [%g, %g]",
+						(int)mi, k, mesh.min[k], mesh.max[k], bmin[k], bmax[k]));
+				}
+			}
+			float maxDist = sqrtf(maxDist2);
+			if (maxDist > mesh.radius * (1.0f + GPB_BOUNDS_EPS) + GPB_BOUNDS_EPS) {
+				errors.push_back(_format("mesh %d: bounding radius %g is smaller than %g", (int)mi, mesh.radius, maxDist));
+			}
+		}
+
+		// インデックス範囲
+		for (size_t pi = 0; pi < mesh.parts.size(); ++pi) {
+			const GPBReadPart& part = mesh.parts[pi];
+			int indexSize = part.getIndexSize();
+			if (indexSize == 0) {
+				errors.push_back(_format("mesh %d part %d: unknown index format 0x%x", (int)mi, (int)pi, part.format));
+				continue;
+			}
+			if (part.byteNum % indexSize != 0) {
+				errors.push_back(_format("mesh %d part %d: byte count %u is not a multiple of %d", (int)mi, (int)pi, part.byteNum, indexSize));
+			}
+			uint32_t count = part.getIndexCount();
+			if (part.primitive == GL_TRIANGLE && count % 3 != 0) {
+				errors.push_back(_format("mesh %d part %d: %u indices is not a multiple of 3", (int)mi, (int)pi, count));
+			}
+			uint32_t outOfRange = 0;
+			uint32_t first = 0;
+			for (uint32_t i = 0; i < count; ++i) {
+				uint32_t index = part.getIndex(i);
+				if (index >= vert_num) {
+					if (outOfRange++ == 0) {
+						first = i;
+					}
+				}
+			}
+			if (outOfRange > 0) {
+				errors.push_back(_format("mesh %d part %d: %u indices out of range (first at %u, value %u, vertices %u)",
+					(int)mi, (int)pi, outOfRange, first, part.getIndex(first), vert_num));
+			}
+		}
+
+		// ウェイト合計
+		int weightAttr = mesh.findAttr(ATTR_BLENDWEIGHTS, 4, 4);
+		int indexAttr = mesh.findAttr(ATTR_BLENDINDICES, 4, 4);
+		if (weightAttr >= 0) {
+			uint32_t badSum = 0, negative = 0;
+			uint32_t firstBad = 0;
+			for (uint32_t v = 0; v < vert_num; ++v) {
+				float sum = 0.0f;
+				for (uint32_t k = 0; k < 4; ++k) {
+					float w = mesh.getFloat(v, weightAttr + k);
+					if (w < 0.0f) {
+						negative++;
+					}
+					sum += w;
+				}
+				if (fabsf(sum - 1.0f) > GPB_WEIGHT_EPS) {
+					if (badSum++ == 0) {
+						firstBad = v;
+					}
+				}
+			}
+			if (badSum > 0) {
+				// 4つを超えるウェイトは切り捨てているので合計が1にならないことがある
+				warnings.push_back(_format("mesh %d: %u vertices have weight sums != 1 (first vertex %u)", (int)mi, badSum, firstBad));
+			}
+			if (negative > 0) {
+				errors.push_back(_format("mesh %d: %u negative weights", (int)mi, negative));
+			}
+		}
+		if (indexAttr >= 0) {
+			uint32_t fractional = 0;
+			for (uint32_t v = 0; v < vert_num; ++v) {
+				for (uint32_t k = 0; k < 4; ++k) {
+					float f = mesh.getFloat(v, indexAttr + k);
+					if (f < 0.0f || f != floorf(f)) {
+						fractional++;
+						continue;
+					}
+					maxJointIndex[mi] = std::max(maxJointIndex[mi], (int)f);
+				}
+			}
+			if (fractional > 0) {
+				errors.push_back(_format("mesh %d: %u blend indices are not non-negative integers", (int)mi, fractional));
+			}
+		}
+	}
+
+	//// ノードとジョイント参照
+	std::map<std::string, int> nodeByName;
+	for (const auto& ref : refs) {
+		if (ref.type == REF_NODE) {
+			int ni = findNodeByOffset(ref.offset);
+			if (ni >= 0) {
+				nodeByName[ref.name] = ni;
+			}
+		}
+	}
+	for (size_t ni = 0; ni < nodes.size(); ++ni) {
+		const GPBReadNode& node = nodes[ni];
+		if (node.type != GPBNODE_NODE && node.type != GPBNODE_JOINT) {
+			errors.push_back(_format("node at 0x%08x: unknown type %u", node.offset, node.type));
+		}
+		if (node.parent >= 0) {
+			auto it = nodeByName.find(node.parentName);
+			if (it == nodeByName.end() || it->second != node.parent) {
+				errors.push_back(_format("node at 0x%08x: parent name '%s' does not match the enclosing node",
+					node.offset, node.parentName.c_str()));
+			}
+		}
+		else if (!node.parentName.empty()) {
+			warnings.push_back(_format("root node at 0x%08x has parent name '%s'", node.offset, node.parentName.c_str()));
+		}
+
+		if (node.meshName.empty()) {
+			continue;
+		}
+		// "#" はこのファイル内の参照
+		int meshIndex = -1;
+		if (node.meshName[0] == '#') {
+			const GPBReadRef* ref = findRef(node.meshName.substr(1), REF_MESH);
+			if (ref != nullptr) {
+				auto it = std::find(m_MeshOffsets.begin(), m_MeshOffsets.end(), ref->offset);
+				if (it != m_MeshOffsets.end()) {
+					meshIndex = (int)(it - m_MeshOffsets.begin());
+				}
+			}
+		}
+		if (meshIndex < 0) {
+			errors.push_back(_format("node at 0x%08x: mesh '%s' not found", node.offset, node.meshName.c_str()));
+			continue;
+		}
+		if (node.materialNames.size() != meshes[meshIndex].parts.size()) {
+			errors.push_back(_format("node at 0x%08x: %d materials for %d parts",
+				node.offset, (int)node.materialNames.size(), (int)meshes[meshIndex].parts.size()));
+		}
+
+		if (!node.hasSkin) {
+			if (meshes[meshIndex].findAttr(ATTR_BLENDINDICES) >= 0) {
+				warnings.push_back(_format("node at 0x%08x: mesh has blend indices but no skin", node.offset));
+			}
+			continue;
+		}
+		const int jointNum = (int)node.jointNames.size();
+		if (node.inverseBindNum != (uint32_t)jointNum * 16) {
+			errors.push_back(_format("node at 0x%08x: %u inverse bind floats for %d joints", node.offset, node.inverseBindNum, jointNum));
+		}
+		std::set<std::string> seen;
+		for (const auto& name : node.jointNames) {
+			if (!seen.insert(name).second) {
+				errors.push_back(_format("node at 0x%08x: joint '%s' is listed twice", node.offset, name.c_str()));
+			}
+			auto it = (name.size() > 1 && name[0] == '#') ? nodeByName.find(name.substr(1)) : nodeByName.end();
+			if (it == nodeByName.end()) {
+				errors.push_back(_format("node at 0x%08x: joint '%s' not found", node.offset, name.c_str()));
+			}
+			else if (nodes[it->second].type != GPBNODE_JOINT) {
+				errors.push_back(_format("node at 0x%08x: '%s' is not a joint", node.offset, name.c_str()));
+			}
+		}
+		if (jointNum > 0 && maxJointIndex[meshIndex] >= jointNum) {
+			errors.push_back(_format("node at 0x%08x: blend index %d exceeds %d joints", node.offset, maxJointIndex[meshIndex], jointNum));
+		}
+	}
+
+	//// アニメーション
+	for (const auto& anim : animations) {
+		for (const auto& ch : anim.channels) {
+			if (nodeByName.find(ch.target) == nodeByName.end()) {
+				errors.push_back(_format("animation '%s': target '%s' not found", anim.id.c_str(), ch.target.c_str()));
+			}
+			uint32_t per = (ch.attrib == ANIMATE_SCALE_ROTATE_TRANSLATE) ? 10 : (ch.attrib == ANIMATE_ROTATE_TRANSLATE) ? 7 : 0;
+			if (per == 0) {
+				warnings.push_back(_format("animation '%s': target '%s' has unknown attribute %u", anim.id.c_str(), ch.target.c_str(), ch.attrib));
+			}
+			else if (ch.valueNum != ch.keyNum * per) {
+				errors.push_back(_format("animation '%s': target '%s' has %u values for %u keys",
+					anim.id.c_str(), ch.target.c_str(), ch.valueNum, ch.keyNum));
+			}
+			for (uint32_t k = 1; k < ch.keyNum; ++k) {
+				if (_readU32(ch.keytimes + k * 4) < _readU32(ch.keytimes + (k - 1) * 4)) {
+					errors.push_back(_format("animation '%s': target '%s' key times are not sorted", anim.id.c_str(), ch.target.c_str()));
+					break;
+				}
+			}
+		}
+	}
+
+	return (int)errors.size();
+}
@@ -0,0 +1,225 @@
+﻿#pragma once
+
+// ExportFile() が書き出す .gpb を読み戻す.
+// MQ の API には依存しないので、プラグイン外(Linux のテストなど)からも使える
+
+#include "GPBFormat.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+
+/// <summary>
+/// ファイルを読み取り専用でメモリにマップする
+/// </summary>
+class GPBMappedFile
+{
+public:
+	GPBMappedFile();
+	~GPBMappedFile();
+
+	GPBMappedFile(const GPBMappedFile&) = delete;
+	GPBMappedFile& operator=(const GPBMappedFile&) = delete;
+
+	bool open(const char* path);
+#ifdef _WIN32
+	bool open(const wchar_t* path);
+#endif
+	void close();
+
+	const uint8_t* data() const { return m_Data; }
+	size_t size() const { return m_Size; }
+
+private:
+	const uint8_t* m_Data;
+	size_t m_Size;
+#ifdef _WIN32
+	void* m_File;
+	void* m_Mapping;
+#else
+	int m_Fd;
+#endif
+};
+
+
+/// <summary>
+/// 頂点属性. usage は ATTR_POSITION など
+/// </summary>
+struct GPBReadAttr {
+	uint32_t usage;
+	uint32_t size;
+};
+
+/// <summary>
+/// 面頂点の並び1つ分. indices はマップ上を指す
+/// </summary>
+struct GPBReadPart {
+	uint32_t primitive;
+	uint32_t format;
+	uint32_t byteNum;
+	const uint8_t* indices;
+
+	/// <summary>
+	/// format に応じた1要素のバイト数. 不明なら 0
+	/// </summary>
+	int getIndexSize() const;
+	uint32_t getIndexCount() const;
+	uint32_t getIndex(uint32_t i) const;
+};
+
+struct GPBReadMesh {
+	std::vector<GPBReadAttr> attrs;
+	/// <summary>
+	/// 1頂点あたりの float 数
+	/// </summary>
+	uint32_t vertexStride;
+	uint32_t vertexByteCount;
+	/// <summary>
+	/// マップ上の頂点データ. 4バイト境界とは限らないので getFloat() で読む
+	/// </summary>
+	const uint8_t* vertices;
+
+	float min[3];
+	float max[3];
+	float center[3];
+	float radius;
+
+	std::vector<GPBReadPart> parts;
+
+	uint32_t getVertexCount() const { return vertexStride ? (uint32_t)(vertexByteCount / ((uint64_t)vertexStride * 4)) : 0; }
+	/// <summary>
+	/// usage の属性の頂点内の先頭 float 位置. 無ければ -1
+	/// </summary>
+	int findAttr(uint32_t usage) const;
+	/// <summary>
+	/// usage の属性の float 数が [minSize, maxSize] なら先頭 float 位置. 無いか範囲外なら -1
+	/// </summary>
+	int findAttr(uint32_t usage, uint32_t minSize, uint32_t maxSize) const;
+	float getFloat(uint32_t vertex, uint32_t element) const;
+};
+
+struct GPBReadNode {
+	uint32_t offset;
+	uint32_t type;
+	float transform[16];
+	std::string parentName;
+	/// <summary>
+	/// 親ノードの nodes 上のインデックス. ルートは -1
+	/// </summary>
+	int parent;
+	std::vector<int> children;
+
+	std::string meshName;
+	bool hasSkin;
+	float bindShape[16];
+	std::vector<std::string> jointNames;
+	uint32_t inverseBindNum;
+	/// <summary>
+	/// マップ上の逆バインド行列 (inverseBindNum 個の float)
+	/// </summary>
+	const uint8_t* inverseBind;
+	std::vector<std::string> materialNames;
+};
+
+struct GPBReadChannel {
+	std::string target;
+	uint32_t attrib;
+	uint32_t keyNum;
+	const uint8_t* keytimes;
+	uint32_t valueNum;
+	const uint8_t* values;
+	uint32_t tangentInNum;
+	uint32_t tangentOutNum;
+	std::vector<uint32_t> interpolations;
+};
+
+struct GPBReadAnimation {
+	std::string id;
+	std::vector<GPBReadChannel> channels;
+};
+
+struct GPBReadRef {
+	std::string name;
+	uint32_t type;
+	uint32_t offset;
+};
+
+
+/// <summary>
+/// 検証結果
+/// </summary>
+struct GPBValidationReport {
+	std::vector<std::string> errors;
+	std::vector<std::string> warnings;
+
+	bool isValid() const { return errors.empty(); }
+	std::string toString() const;
+};
+
+
+/// <summary>
+/// .gpb のパーサ. 頂点やインデックスはコピーせずマップ上を指す
+/// </summary>
+class GPBReader
+{
+public:
+	GPBReader();
+
+	bool open(const char* path);
+#ifdef _WIN32
+	bool open(const wchar_t* path);
+#endif
+
+	/// <summary>
+	/// メモリ上の .gpb を読む. data は GPBReader より長く生存している必要がある
+	/// </summary>
+	bool parse(const uint8_t* data, size_t size);
+
+	/// <summary>
+	/// 境界、インデックス範囲、ウェイト合計、ジョイント参照を調べる
+	/// </summary>
+	/// <returns>エラー数</returns>
+	int validate(GPBValidationReport& report) const;
+
+	const std::string& getError() const { return m_Error; }
+
+	uint8_t major;
+	uint8_t minor;
+	std::vector<GPBReadRef> refs;
+	std::vector<GPBReadMesh> meshes;
+	/// <summary>
+	/// シーンの全ノード. 子は親の後に並ぶ
+	/// </summary>
+	std::vector<GPBReadNode> nodes;
+	std::vector<int> roots;
+	std::string cameraName;
+	float ambient[3];
+	std::vector<GPBReadAnimation> animations;
+
+	/// <summary>
+	/// 名前と種類で参照を探す. 無ければ nullptr
+	/// </summary>
+	const GPBReadRef* findRef(const std::string& name, uint32_t type) const;
+	/// <summary>
+	/// オフセットからノードを探す. 無ければ -1
+	/// </summary>
+	int findNodeByOffset(uint32_t offset) const;
+	/// <summary>
+	/// オフセットからメッシュを探す. 無ければ -1
+	/// </summary>
+	int findMeshByOffset(uint32_t offset) const;
+
+private:
+	GPBMappedFile m_File;
+	const uint8_t* m_Data;
+	size_t m_Size;
+	std::string m_Error;
+	std::vector<uint32_t> m_MeshOffsets;
+	uint32_t m_SceneOffset;
+	uint32_t m_AnimationsOffset;
+
+	struct Cursor;
+	bool parseNode(Cursor& c, int parent, int depth);
+};
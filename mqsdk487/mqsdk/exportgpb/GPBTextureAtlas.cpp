@@ -0,0 +1,308 @@
+﻿#include "GPBTextureAtlas.h"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+
+GPBTextureAtlas::GPBTextureAtlas(int maxSize, int padding)
+{
+	m_MaxSize = maxSize;
+	m_Padding = padding;
+	m_Width = 0;
+	m_Height = 0;
+}
+
+int GPBTextureAtlas::add(int width, int height, const std::vector<unsigned char>& rgba)
+{
+	Entry entry;
+	entry.width = width;
+	entry.height = height;
+	entry.rgba = rgba;
+	entry.placed = false;
+	entry.x = 0;
+	entry.y = 0;
+	m_Entries.push_back(entry);
+	return (int)m_Entries.size() - 1;
+}
+
+bool GPBTextureAtlas::tryPack(int width, int height, bool all)
+{
+	// 高さの順に棚へ並べる
+	std::vector<int> order;
+	for (int i = 0; i < (int)m_Entries.size(); ++i) {
+		Entry& entry = m_Entries[i];
+		entry.placed = false;
+		if (entry.width + m_Padding * 2 <= width && entry.height + m_Padding * 2 <= height) {
+			order.push_back(i);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+		const Entry& ea = m_Entries[a];
+		const Entry& eb = m_Entries[b];
+		if (ea.height != eb.height) {
+			return (ea.height > eb.height);
+		}
+		return (ea.width > eb.width);
+	});
+
+	int shelfY = 0;
+	int shelfHeight = 0;
+	int x = 0;
+	int placedNum = 0;
+	for (int i : order) {
+		Entry& entry = m_Entries[i];
+		int w = entry.width + m_Padding * 2;
+		int h = entry.height + m_Padding * 2;
+		if (x + w > width) {
+			shelfY += shelfHeight;
+			shelfHeight = 0;
+			x = 0;
+		}
+		if (shelfY + h > height) {
+			if (all) {
+				return false;
+			}
+			continue;
+		}
+		entry.placed = true;
+		entry.x = x + m_Padding;
+		entry.y = shelfY + m_Padding;
+		x += w;
+		shelfHeight = std::max(shelfHeight, h);
+		placedNum += 1;
+	}
+	if (all && placedNum != (int)m_Entries.size()) {
+		return false;
+	}
+	return (placedNum > 0);
+}
+
+bool GPBTextureAtlas::pack()
+{
+	double area = 0.0;
+	for (const auto& entry : m_Entries) {
+		area += (double)(entry.width + m_Padding * 2) * (entry.height + m_Padding * 2);
+	}
+
+	// 全部入る最小の2のべき乗サイズを探す
+	int side = 16;
+	while (side < m_MaxSize && (double)side * side < area) {
+		side *= 2;
+	}
+	m_Width = side;
+	m_Height = side;
+	while (m_Width <= m_MaxSize && m_Height <= m_MaxSize) {
+		if (tryPack(m_Width, m_Height, true)) {
+			return true;
+		}
+		if (m_Width <= m_Height) {
+			m_Width *= 2;
+		} else {
+			m_Height *= 2;
+		}
+	}
+
+	// 入る分だけ入れる
+	m_Width = m_MaxSize;
+	m_Height = m_MaxSize;
+	return tryPack(m_Width, m_Height, false);
+}
+
+void GPBTextureAtlas::remap(int index, float& u, float& v) const
+{
+	const Entry& entry = m_Entries[index];
+	u = (entry.x + u * entry.width) / (float)m_Width;
+	v = (entry.y + v * entry.height) / (float)m_Height;
+}
+
+void GPBTextureAtlas::compose(std::vector<unsigned char>& rgba) const
+{
+	rgba.assign((size_t)m_Width * m_Height * 4, 0);
+	for (const auto& entry : m_Entries) {
+		if (!entry.placed) {
+			continue;
+		}
+		// 縁は端のピクセルを複製して、フィルタで隣の画像が混ざらないようにする
+		for (int y = -m_Padding; y < entry.height + m_Padding; ++y) {
+			int sy = std::min(std::max(y, 0), entry.height - 1);
+			unsigned char* dst = &rgba[((size_t)(entry.y + y) * m_Width + (entry.x - m_Padding)) * 4];
+			for (int x = -m_Padding; x < entry.width + m_Padding; ++x) {
+				int sx = std::min(std::max(x, 0), entry.width - 1);
+				memcpy(dst, &entry.rgba[((size_t)sy * entry.width + sx) * 4], 4);
+				dst += 4;
+			}
+		}
+	}
+}
+
+
+//---------------------------------------------------------------------------
+//  PNG
+//---------------------------------------------------------------------------
+
+static unsigned int crc32Update(unsigned int crc, const unsigned char* data, size_t size)
+{
+	static unsigned int table[256];
+	static bool initialized = false;
+	if (!initialized) {
+		for (unsigned int n = 0; n < 256; ++n) {
+			unsigned int c = n;
+			for (int k = 0; k < 8; ++k) {
+				c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+			}
+			table[n] = c;
+		}
+		initialized = true;
+	}
+	for (size_t i = 0; i < size; ++i) {
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+static void putBE32(std::vector<unsigned char>& out, unsigned int value)
+{
+	out.push_back((unsigned char)(value >> 24));
+	out.push_back((unsigned char)(value >> 16));
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)value);
+}
+
+static bool writeChunk(FILE* fp, const char* type, const std::vector<unsigned char>& data)
+{
+	std::vector<unsigned char> head;
+	putBE32(head, (unsigned int)data.size());
+	head.insert(head.end(), type, type + 4);
+	unsigned int crc = crc32Update(0xffffffffu, head.data() + 4, 4);
+	crc = crc32Update(crc, data.data(), data.size()) ^ 0xffffffffu;
+	std::vector<unsigned char> tail;
+	putBE32(tail, crc);
+
+	fwrite(head.data(), 1, head.size(), fp);
+	if (!data.empty()) {
+		fwrite(data.data(), 1, data.size(), fp);
+	}
+	fwrite(tail.data(), 1, tail.size(), fp);
+	return (ferror(fp) == 0);
+}
+
+// 圧縮しない deflate(格納ブロック)で書く. 展開側の互換性を優先する
+bool GPBTextureAtlas::writePNG(FILE* fp) const
+{
+	std::vector<unsigned char> rgba;
+	compose(rgba);
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	fwrite(signature, 1, sizeof(signature), fp);
+
+	std::vector<unsigned char> ihdr;
+	putBE32(ihdr, (unsigned int)m_Width);
+	putBE32(ihdr, (unsigned int)m_Height);
+	ihdr.push_back(8); // bit depth
+	ihdr.push_back(6); // RGBA
+	ihdr.push_back(0);
+	ihdr.push_back(0);
+	ihdr.push_back(0);
+	if (!writeChunk(fp, "IHDR", ihdr)) {
+		return false;
+	}
+
+	// 各行の先頭にフィルタ無し(0)を付ける
+	size_t rowBytes = (size_t)m_Width * 4;
+	std::vector<unsigned char> raw;
+	raw.reserve((rowBytes + 1) * m_Height);
+	for (int y = 0; y < m_Height; ++y) {
+		raw.push_back(0);
+		raw.insert(raw.end(), rgba.begin() + rowBytes * y, rgba.begin() + rowBytes * (y + 1));
+	}
+
+	std::vector<unsigned char> zlib;
+	zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+	zlib.push_back(0x78);
+	zlib.push_back(0x01);
+	size_t pos = 0;
+	do {
+		size_t len = std::min(raw.size() - pos, (size_t)65535);
+		bool last = (pos + len == raw.size());
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back((unsigned char)(len & 0xff));
+		zlib.push_back((unsigned char)(len >> 8));
+		zlib.push_back((unsigned char)(~len & 0xff));
+		zlib.push_back((unsigned char)((~len >> 8) & 0xff));
+		zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+		pos += len;
+	} while (pos < raw.size());
+
+	unsigned int a = 1;
+	unsigned int b = 0;
+	for (unsigned char c : raw) {
+		a = (a + c) % 65521;
+		b = (b + a) % 65521;
+	}
+	putBE32(zlib, (b << 16) | a);
+
+	if (!writeChunk(fp, "IDAT", zlib)) {
+		return false;
+	}
+	return writeChunk(fp, "IEND", std::vector<unsigned char>());
+}
+
+
+//---------------------------------------------------------------------------
+//  画像の読み込み
+//---------------------------------------------------------------------------
+
+bool GPBTextureAtlas::loadMappingImage(MQDocument doc, const wchar_t* filename,
+	int& width, int& height, std::vector<unsigned char>& rgba)
+{
+	int bpp = 0;
+	const RGBQUAD* colors = nullptr;
+	const BYTE* buffer = nullptr;
+	if (!doc->GetMappingImage(filename, MQMAPPING_TEXTURE, width, height, bpp, colors, buffer)) {
+		return false;
+	}
+	if (width <= 0 || height <= 0 || buffer == nullptr) {
+		return false;
+	}
+	if (bpp != 8 && bpp != 24 && bpp != 32) {
+		return false;
+	}
+	if (bpp == 8 && colors == nullptr) {
+		return false;
+	}
+
+	// DIB なので下の行から並び、1行は4バイト境界
+	size_t stride = (((size_t)width * bpp + 31) / 32) * 4;
+	rgba.resize((size_t)width * height * 4);
+	for (int y = 0; y < height; ++y) {
+		const BYTE* src = buffer + stride * (height - 1 - y);
+		unsigned char* dst = &rgba[(size_t)y * width * 4];
+		for (int x = 0; x < width; ++x) {
+			switch (bpp) {
+			case 8: {
+				const RGBQUAD& c = colors[src[x]];
+				dst[0] = c.rgbRed;
+				dst[1] = c.rgbGreen;
+				dst[2] = c.rgbBlue;
+				dst[3] = 255;
+				break;
+			}
+			case 24:
+				dst[0] = src[x * 3 + 2];
+				dst[1] = src[x * 3 + 1];
+				dst[2] = src[x * 3];
+				dst[3] = 255;
+				break;
+			case 32:
+				dst[0] = src[x * 4 + 2];
+				dst[1] = src[x * 4 + 1];
+				dst[2] = src[x * 4];
+				dst[3] = src[x * 4 + 3];
+				break;
+			}
+			dst += 4;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,76 @@
+﻿#pragma once
+
+// 複数の小さいテクスチャを1枚のアトラス画像に詰める.
+// 画像の読み込みは MQDocument::GetMappingImage() を使う
+
+#include <stdio.h>
+#include <vector>
+#include "MQPlugin.h"
+
+
+/// <summary>
+/// テクスチャアトラス1枚分
+/// </summary>
+class GPBTextureAtlas
+{
+public:
+	/// <param name="maxSize">アトラスの一辺の最大ピクセル数</param>
+	/// <param name="padding">画像の周りに複製する縁のピクセル数</param>
+	GPBTextureAtlas(int maxSize, int padding);
+
+	/// <summary>
+	/// 画像を追加する
+	/// </summary>
+	/// <param name="rgba">上の行から並んだ RGBA</param>
+	/// <returns>画像番号</returns>
+	int add(int width, int height, const std::vector<unsigned char>& rgba);
+
+	/// <summary>
+	/// 配置を決める. 最大サイズに入らなかった画像は isPlaced() が false になる
+	/// </summary>
+	/// <returns>1つ以上配置できたら true</returns>
+	bool pack();
+
+	bool isPlaced(int index) const { return m_Entries[index].placed; }
+	int getWidth() const { return m_Width; }
+	int getHeight() const { return m_Height; }
+	int getImageNum() const { return (int)m_Entries.size(); }
+
+	/// <summary>
+	/// 画像内の UV をアトラス内の UV に変換する. MQ と同じく v=0 が画像の上端
+	/// </summary>
+	void remap(int index, float& u, float& v) const;
+
+	/// <summary>
+	/// アトラス画像を PNG で書き出す
+	/// </summary>
+	bool writePNG(FILE* fp) const;
+
+	/// <summary>
+	/// ドキュメントが読み込んでいるテクスチャを RGBA で取得する
+	/// </summary>
+	static bool loadMappingImage(MQDocument doc, const wchar_t* filename,
+		int& width, int& height, std::vector<unsigned char>& rgba);
+
+private:
+	struct Entry {
+		int width;
+		int height;
+		std::vector<unsigned char> rgba;
+		bool placed;
+		/// <summary>
+		/// 縁を除いた画像の左上
+		/// </summary>
+		int x;
+		int y;
+	};
+
+	bool tryPack(int width, int height, bool all);
+	void compose(std::vector<unsigned char>& rgba) const;
+
+	int m_MaxSize;
+	int m_Padding;
+	int m_Width;
+	int m_Height;
+	std::vector<Entry> m_Entries;
+};
@@ -58,7 +58,7 @@ MAnsiString::MAnsiString(const MAnsiString& str)
 	*this = str;
 }
 
-#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__
+#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__ || __linux__
 MAnsiString::MAnsiString(MAnsiString&& str)
 {
 	mStr = str.mStr;
@@ -1134,7 +1134,7 @@ MAnsiString& MAnsiString::operator = (const std::string& str)
 }
 #endif
 
-#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__
+#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__ || __linux__
 MAnsiString& MAnsiString::operator = (MAnsiString&& str)
 {
 	if(mStr == str.c_str()){
@@ -1215,7 +1215,7 @@ MAnsiString MAnsiString::operator + (char character) const
 	return ret;
 }
 
-#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__
+#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__ || __linux__
 MAnsiString operator + (MAnsiString&& str1, const MAnsiString& str2)
 {
 	str1 += str2;
@@ -25,7 +25,7 @@ public:
 	MAnsiString(const std::string& str);
 #endif
 	MAnsiString(const MAnsiString& str);
-#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__
+#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__ || __linux__
 	MAnsiString(MAnsiString&& str);
 #endif
 	// Destroctor
@@ -172,7 +172,7 @@ public:
 #ifndef MSTRING_DISABLE_STDSRING
 	MAnsiString& operator = (const std::string& str);
 #endif
-#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__
+#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__ || __linux__
 	MAnsiString& operator = (MAnsiString&& str);
 #endif
 
@@ -183,7 +183,7 @@ public:
 	MAnsiString operator + (const char *str) const;
 	MAnsiString operator + (char character) const;
 
-#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__
+#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__ || __linux__
 	friend MLIBS_API MAnsiString operator + (MAnsiString&& str1, const MAnsiString& str2);
 	friend MLIBS_API MAnsiString operator + (MAnsiString&& str1, const char *str2);
 #endif
@@ -4,15 +4,23 @@
 #include <shlwapi.h>
 #include <ShlObj.h>
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <dirent.h>
 #include <deque>
+#endif
+#if __APPLE__
 #include "osx/MStringUtil.h"
 #endif
+#if __linux__
+#include "linux/MStringUtil.h"
+#endif
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
 #include "MFileUtil.h"
 #include "MString.h"
 #include "MAnsiString.h"
@@ -45,7 +53,7 @@ bool MFileUtil::fileExists(const MString& filename)
 #ifdef WIN32
 	return ::PathFileExistsW(filename.c_str()) && !::PathIsDirectoryW(filename.c_str());
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 	struct stat st;
 	int ret = stat(filename.toUtf8String().c_str(), &st);
 	if(ret != 0) return false;
@@ -61,7 +69,7 @@ bool MFileUtil::directoryExists(const MString& path)
 #ifdef WIN32
 	return ::PathIsDirectoryW(path.c_str()) ? true : false;
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 	struct stat st;
 	int ret = stat(path.toUtf8String().c_str(), &st);
 	if(ret != 0) return false;
@@ -100,7 +108,7 @@ MString MFileUtil::getCurrentDirectory()
 	}
 	return MString(path);
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 	char *buf = getcwd(nullptr, 0);
 	if(buf != nullptr){
 		MString ret = MString::fromUtf8String(buf);
@@ -117,7 +125,7 @@ void MFileUtil::setCurrentDirectory(const MString& dir)
 #ifdef WIN32
 	::SetCurrentDirectory(dir.c_str());
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 	chdir(dir.toUtf8String().c_str());
 #endif
 }
@@ -150,7 +158,7 @@ std::vector<MString> MFileUtil::enumFilesInDirectory(const MString& dir_path, co
 	} while(::FindNextFileW(handle, &fd));
 	::FindClose(handle);
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 	DIR *dp;
 	struct dirent *ep;
 	dp = opendir(dir_path.toUtf8String().c_str());
@@ -214,7 +222,7 @@ std::vector<MString> MFileUtil::enumDirectoriesInDirectory(const MString& dir_pa
 	} while(::FindNextFileW(handle, &fd));
 	::FindClose(handle);
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 	DIR *dp;
 	struct dirent *ep;
 	dp = opendir(dir_path.toUtf8String().c_str());
@@ -274,7 +282,7 @@ bool MFileUtil::createDirectory(const MString& dst_path)
 	return ret == ERROR_SUCCESS;
 #endif
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 	BOOL ret = MStringUtil::CreateDirectory(dst_path);
 	return ret;
 #endif
@@ -286,7 +294,7 @@ bool MFileUtil::copyFile(const MString& dst_file, const MString& src_file, bool
 #ifdef WIN32
 	return ::CopyFileW(src_file.c_str(), dst_file.c_str(), can_overwrite ? FALSE : TRUE) ? true : false;
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 	if(!can_overwrite){
 		if(MFileUtil::fileExists(dst_file))
 			return false;
@@ -323,12 +331,86 @@ bool MFileUtil::deleteFile(const MString& path)
 #ifdef WIN32
 	return ::DeleteFile(path.c_str()) ? true : false;
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 	int ret = unlink(path.toUtf8String().c_str());
 	return (ret == 0);
 #endif
 }
 
+// Move a file to the destination, replacing an existing file atomically
+bool MFileUtil::replaceFile(const MString& dst_file, const MString& src_file)
+{
+#ifdef WIN32
+	return ::MoveFileExW(src_file.c_str(), dst_file.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? true : false;
+#endif
+#if __APPLE__ || __linux__
+	int ret = rename(src_file.toUtf8String().c_str(), dst_file.toUtf8String().c_str());
+	return (ret == 0);
+#endif
+}
+
+// Calculate a 64-bit FNV-1a hash of the file contents
+bool MFileUtil::hashFile(const MString& filename, unsigned long long& hash, long long& size)
+{
+	hash = 14695981039346656037ULL;
+	size = 0;
+
+#ifdef WIN32
+	FILE *fp = _wfopen(filename.c_str(), L"rb");
+#endif
+#if __APPLE__ || __linux__
+	FILE *fp = fopen(filename.toUtf8String().c_str(), "rb");
+#endif
+	if(fp == NULL){
+		return false;
+	}
+
+	unsigned char buf[65536];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), fp)) > 0){
+		for(size_t i = 0; i < n; i++){
+			hash ^= buf[i];
+			hash *= 1099511628211ULL;
+		}
+		size += (long long)n;
+	}
+	bool ret = (ferror(fp) == 0);
+	fclose(fp);
+	return ret;
+}
+
+// Compare the contents of two files byte by byte
+bool MFileUtil::isSameFileContent(const MString& file1, const MString& file2)
+{
+#ifdef WIN32
+	FILE *fp1 = _wfopen(file1.c_str(), L"rb");
+	FILE *fp2 = _wfopen(file2.c_str(), L"rb");
+#endif
+#if __APPLE__ || __linux__
+	FILE *fp1 = fopen(file1.toUtf8String().c_str(), "rb");
+	FILE *fp2 = fopen(file2.toUtf8String().c_str(), "rb");
+#endif
+	bool ret = (fp1 != NULL && fp2 != NULL);
+
+	static const size_t BUF_SIZE = 65536;
+	std::vector<unsigned char> buf1(ret ? BUF_SIZE : 0), buf2(ret ? BUF_SIZE : 0);
+	while(ret){
+		size_t n1 = fread(buf1.data(), 1, BUF_SIZE, fp1);
+		size_t n2 = fread(buf2.data(), 1, BUF_SIZE, fp2);
+		if(n1 != n2 || memcmp(buf1.data(), buf2.data(), n1) != 0){
+			ret = false;
+		}else if(n1 < BUF_SIZE){
+			// Both reached the end, unless either failed
+			ret = (ferror(fp1) == 0 && ferror(fp2) == 0);
+			break;
+		}
+	}
+
+	if(fp1 != NULL) fclose(fp1);
+	if(fp2 != NULL) fclose(fp2);
+	return ret;
+}
+
 // Return a path that extension is changed
 MString MFileUtil::changeExtension(const MString& src_path, const MString& extension)
 {
@@ -493,7 +575,7 @@ MString MFileUtil::combinePath(const MString& base_dir, const MString& cat_dir)
 	::PathCombineW(buf, base_dir, cat_dir);
 	return MString(buf);
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 	MString ret;
 	if(base_dir.length() > 0){
 		ret += base_dir;
@@ -519,7 +601,7 @@ MString MFileUtil::extractFullPath(const MString& src_path)
 	_wfullpath(buf, src_path.c_str(), _countof(buf));
 	return MString(buf);
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 	MString path;
 	if(src_path[0] == L'/')
 		path = src_path;
@@ -553,7 +635,7 @@ MString MFileUtil::extractRelativePath(const MString& base_dir, const MString& s
 	}
 	return MString();
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 	std::deque<MString> base_level, src_level;
 	MString dir = base_dir;
 	if(dir.length() > 0 && !isPathSeparator(dir[dir.length()-1]))
@@ -592,7 +674,7 @@ bool MFileUtil::isPathRelative(const MString& path)
 #ifdef WIN32
 	return ::PathIsRelative(path.c_str()) != FALSE;
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 	if(path.length() > 0 && path[0] != L'/'){
 		return true;
 	}
@@ -622,7 +704,7 @@ MString MFileUtil::getSystemDirectory(DirectoryType type)
 		break;
 	}
 #endif
-#if __APPLE__
+#if __APPLE__ || __linux__
 	switch(type){
 	case kMyDocuments:
 		return MStringUtil::GetMyDocumentDir();
@@ -54,6 +54,15 @@ public:
 	// Delete a file
 	static bool deleteFile(const MString& path);
 
+	// Move a file to the destination, replacing an existing file atomically
+	static bool replaceFile(const MString& dst_file, const MString& src_file);
+
+	// Calculate a 64-bit FNV-1a hash of the file contents
+	static bool hashFile(const MString& filename, unsigned long long& hash, long long& size);
+
+	// Compare the contents of two files byte by byte
+	static bool isSameFileContent(const MString& file1, const MString& file2);
+
 	// Return a path that extension is changed
 	//   ex. "c:\temp\test.bmp", ".jpg" -> "c:\temp\test.jpg"
 	static MString changeExtension(const MString& src_path, const MString& extension);
@@ -14,13 +14,20 @@ typedef unsigned __int64 __uint64;
 
 #endif // WIN32
 
-#if __APPLE__
+#if __APPLE__ || __linux__
 
 #include <cstdint>
 #include <cstring>
+#include <cstdio>
+#include <climits>
+#include <strings.h>
 #include <string>
 #include <errno.h>
+#if __APPLE__
 #include <sys/_types/_errno_t.h>
+#else
+typedef int errno_t;
+#endif
 
 #define MLIBS_API
 
@@ -58,6 +65,10 @@ template<size_t size> inline errno_t strcpy_s(char (&dst)[size], const char *src
 errno_t memcpy_s(void *dst, size_t nelems, const void *src, size_t n);
 #define _stricmp strcasecmp
 #define sscanf_s sscanf
+#define fprintf_s fprintf
+#ifndef _MAX_PATH
+#define _MAX_PATH PATH_MAX
+#endif
 
 int _wtoi(const wchar_t *s);
 double _wtof(const wchar_t *s);
@@ -75,7 +86,7 @@ errno_t _wfopen_s(FILE** fh, const wchar_t *filename, const wchar_t *mode);
 
 BOOL IsDBCSLeadByte(BYTE ch);
 
-#endif // __APPLE__
+#endif // __APPLE__ || __linux__
 
 #if defined(_DEBUG) || defined(DEBUG)
 #include <assert.h>
@@ -10,14 +10,12 @@ MQExportObject::MQExportObject(MQObject obj, const MSeparateParam& separate_para
 	m_fc = obj->GetFaceCount();
 	m_f = new (std::nothrow) MTexFace[m_fc];
 
-	m_vi.resize(m_fc);
+	m_vi.allocPacked(obj);
 
 	// allocate vertices
 	int hashsize = 0;
 	for(i=0; i<m_fc; i++){
-		int pn = obj->GetFacePointCount(i);
 		hashsize += obj->GetFacePointCount(i);
-		m_vi.resizeItem(i, pn);
 	}
 	m_v = new(std::nothrow) MExportVertex[hashsize];
 	m_vc = 0;
@@ -15,6 +15,11 @@
 #include <locale>
 #include "osx/MStringUtil.h"
 #endif
+#if __linux__
+#include <codecvt>
+#include <locale>
+#include "linux/MStringUtil.h"
+#endif
 
 static const wchar_t *null_str = L"";
 
@@ -80,7 +85,7 @@ MString::MString(const MString& str)
 	*this = str;
 }
 
-#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__
+#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__ || __linux__
 MString::MString(MString&& str)
 {
 	mStr = str.mStr;
@@ -1177,7 +1182,7 @@ MString& MString::operator = (const std::wstring& str)
 }
 #endif
 
-#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__
+#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__ || __linux__
 MString& MString::operator = (MString&& str)
 {
 	if(mStr == str.c_str()){
@@ -1258,7 +1263,7 @@ MString MString::operator + (wchar_t character) const
 	return ret;
 }
 
-#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__
+#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__ || __linux__
 MString operator + (MString&& str1, const MString& str2)
 {
 	str1 += str2;
@@ -26,7 +26,7 @@ public:
 	MString(const std::wstring& str);
 #endif
 	MString(const MString& str);
-#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__
+#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__ || __linux__
 	MString(MString&& str);
 #endif
 	// Destroctor
@@ -175,7 +175,7 @@ public:
 #ifndef MSTRING_DISABLE_STDSRING
 	MString& operator = (const std::wstring& str);
 #endif
-#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__
+#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__ || __linux__
 	MString& operator = (MString&& str);
 #endif
 
@@ -186,7 +186,7 @@ public:
 	MString operator + (const wchar_t *str) const;
 	MString operator + (wchar_t character) const;
 
-#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__
+#if _MSC_VER >= 1600 || __BORLAND_C__ >= 0x0630 || __APPLE__ || __linux__
 	friend MLIBS_API MString operator + (MString&& str1, const MString& str2);
 	friend MLIBS_API MString operator + (MString&& str1, const wchar_t *str2);
 #endif
@@ -0,0 +1,784 @@
+﻿//---------------------------------------------------------------------------
+// ExportGPB のベンチマーク
+//    　mockhost の模擬ホスト上で合成シーンを生成し、
+//    ExportGPBPlugin::exportDocument() の段階ごとの所要時間を計測して
+//    JSON で出力する。
+//---------------------------------------------------------------------------
+
+#include "ExportGPB.h"
+#include "MQMockHost.h"
+#include "GPBReader.h"
+#include <random>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+
+/// <summary>
+/// 合成シーンのパラメータ
+/// </summary>
+struct BenchSceneParam {
+	const char* name;
+	/// <summary>
+	/// オブジェクト数
+	/// </summary>
+	int objects;
+	/// <summary>
+	/// オブジェクトあたりの面数
+	/// </summary>
+	int facesPerObject;
+	/// <summary>
+	/// 四角形の代わりに五角形にする面の割合 0～1
+	/// </summary>
+	float ngonRatio;
+	/// <summary>
+	/// UV を島としてずらす面の割合 0～1. UV の継ぎ目で頂点が分割される
+	/// </summary>
+	float seamDensity;
+	/// <summary>
+	/// 材質数. 0 なら材質無し
+	/// </summary>
+	int materials;
+	/// <summary>
+	/// ボーン数. 0 ならボーン無し
+	/// </summary>
+	int bones;
+	/// <summary>
+	/// 頂点あたりのウェイト数
+	/// </summary>
+	int weightsPerVertex;
+	/// <summary>
+	/// 材質の描画状態の種類数. 0 なら全ての材質が異なる
+	/// </summary>
+	int materialVariants;
+};
+
+static const BenchSceneParam s_Presets[] = {
+	// name, objects, faces, ngon, seam, materials, bones, weights, variants
+	{ "small",      4,   1000, 0.1f, 0.05f,  2,   0, 0, 0 },
+	{ "medium",    16,  10000, 0.2f, 0.10f,  8,   0, 0, 0 },
+	{ "large",     32,  50000, 0.2f, 0.10f, 16,   0, 0, 0 },
+	{ "ngon",       8,  20000, 1.0f, 0.00f,  4,   0, 0, 0 },
+	{ "seams",      8,  20000, 0.0f, 0.50f,  4,   0, 0, 0 },
+	{ "materials",  8,  20000, 0.1f, 0.05f, 64,   0, 0, 0 },
+	{ "skinned",    8,  20000, 0.1f, 0.05f,  4,  64, 4, 0 },
+	{ "many_bones", 4,  20000, 0.1f, 0.05f,  4, 256, 4, 0 },
+	{ "kitbash",    8,  20000, 0.1f, 0.05f, 64,   0, 0, 8 },
+};
+
+
+//---------------------------------------------------------------------------
+//  ボーンプラグインの代わり
+//---------------------------------------------------------------------------
+
+/// <summary>
+/// MQBoneManager が送るメッセージに応答する。
+/// 頂点は一意IDで参照する。
+/// </summary>
+struct BenchBonePlugin {
+	struct Bone {
+		UINT id;
+		UINT parent;
+		int childNum;
+		MQPoint pos;
+		std::wstring name;
+	};
+	struct Weight {
+		UINT vertexID;
+		float weight;
+	};
+	std::vector<Bone> bones;
+	/// <summary>
+	/// オブジェクトID -> ボーンのインデックス -> 頂点とウェイト
+	/// </summary>
+	std::map<UINT, std::vector<std::vector<Weight>>> objectWeights;
+	/// <summary>
+	/// オブジェクトID -> 頂点ID -> (ボーンID, ウェイト)
+	/// </summary>
+	std::map<UINT, std::map<UINT, std::vector<std::pair<UINT, float>>>> vertexWeights;
+
+	void clear() {
+		bones.clear();
+		objectWeights.clear();
+		vertexWeights.clear();
+	}
+
+	int findBone(UINT id) const {
+		if (id >= 1 && id <= bones.size() && bones[id - 1].id == id) {
+			return (int)id - 1;
+		}
+		return -1;
+	}
+};
+
+static BenchBonePlugin s_BonePlugin;
+
+static void* findArg(void** args, const char* key)
+{
+	if (args == nullptr) {
+		return nullptr;
+	}
+	for (int i = 0; args[i] != nullptr; i += 2) {
+		if (strcmp((const char*)args[i], key) == 0) {
+			return args[i + 1];
+		}
+	}
+	return nullptr;
+}
+
+static int boneMessage(const char* description, void* message)
+{
+	BenchBonePlugin& bp = s_BonePlugin;
+	if (strcmp(description, "QueryAPIVersion") == 0) {
+		return 1;
+	}
+	if (strcmp(description, "QueryBoneNum") == 0) {
+		return (int)bp.bones.size();
+	}
+	if (strcmp(description, "EnumBoneID") == 0) {
+		UINT* ids = (UINT*)message;
+		for (size_t i = 0; i < bp.bones.size(); ++i) {
+			ids[i] = bp.bones[i].id;
+		}
+		return 1;
+	}
+	if (strcmp(description, "QueryObjectNum") == 0) {
+		return (int)bp.objectWeights.size();
+	}
+	if (strcmp(description, "EnumObjectID") == 0) {
+		UINT* ids = (UINT*)message;
+		for (const auto& it : bp.objectWeights) {
+			*ids++ = it.first;
+		}
+		return 1;
+	}
+	if (strcmp(description, "GetBone") == 0) {
+		void** args = (void**)message;
+		UINT* id = (UINT*)findArg(args, "id");
+		int bi = (id != nullptr) ? bp.findBone(*id) : -1;
+		if (bi < 0) {
+			return 0;
+		}
+		const auto& bone = bp.bones[bi];
+		MQMatrix mtx;
+		mtx.Identify();
+		mtx.t[12] = bone.pos.x;
+		mtx.t[13] = bone.pos.y;
+		mtx.t[14] = bone.pos.z;
+		for (int i = 0; args[i] != nullptr; i += 2) {
+			const char* key = (const char*)args[i];
+			void* value = args[i + 1];
+			if (strcmp(key, "parent") == 0) {
+				*(UINT*)value = bone.parent;
+			} else if (strcmp(key, "child_num") == 0) {
+				*(int*)value = bone.childNum;
+			} else if (strcmp(key, "org_pos") == 0 || strcmp(key, "def_pos") == 0) {
+				*(MQPoint*)value = bone.pos;
+			} else if (strcmp(key, "base_matrix") == 0 || strcmp(key, "matrix") == 0) {
+				memcpy(value, mtx.t, sizeof(float) * 16);
+			} else if (strcmp(key, "scale") == 0) {
+				*(MQPoint*)value = MQPoint(1.0f, 1.0f, 1.0f);
+			} else if (strcmp(key, "name") == 0) {
+				*(const wchar_t**)value = bone.name.c_str();
+			} else if (strcmp(key, "dummy") == 0) {
+				*(bool*)value = false;
+			}
+		}
+		return 1;
+	}
+	if (strcmp(description, "GetBoneWeight") == 0) {
+		void** args = (void**)message;
+		UINT obj_id = *(UINT*)args[0];
+		int bi = bp.findBone(*(UINT*)args[1]);
+		auto it = bp.objectWeights.find(obj_id);
+		if (it == bp.objectWeights.end() || bi < 0) {
+			return 0;
+		}
+		const auto& list = it->second[bi];
+		if (args[2] != nullptr && args[3] != nullptr) {
+			UINT* vertex_ids = (UINT*)args[2];
+			float* weights = (float*)args[3];
+			for (size_t i = 0; i < list.size(); ++i) {
+				vertex_ids[i] = list[i].vertexID;
+				weights[i] = list[i].weight;
+			}
+		}
+		return (int)list.size();
+	}
+	if (strcmp(description, "GetVertexWeight") == 0) {
+		void** args = (void**)message;
+		UINT obj_id = *(UINT*)args[0];
+		UINT vertex_id = *(UINT*)args[1];
+		int array_num = *(int*)args[2];
+		auto oit = bp.vertexWeights.find(obj_id);
+		if (oit == bp.vertexWeights.end()) {
+			return 0;
+		}
+		auto vit = oit->second.find(vertex_id);
+		if (vit == oit->second.end()) {
+			return 0;
+		}
+		int num = std::min((int)vit->second.size(), array_num);
+		for (int i = 0; i < num; ++i) {
+			((UINT*)args[3])[i] = vit->second[i].first;
+			((float*)args[4])[i] = vit->second[i].second;
+		}
+		return (int)vit->second.size();
+	}
+	return 0;
+}
+
+static BOOL benchMessageHandler(int message_type, MQSendMessageInfo* info)
+{
+	if (message_type != MQMESSAGE_USER_MESSAGE || info == nullptr) {
+		return FALSE;
+	}
+	void** args = (void**)info->option;
+	DWORD* product = (DWORD*)findArg(args, "target_product");
+	DWORD* id = (DWORD*)findArg(args, "target_id");
+	const char* description = (const char*)findArg(args, "description");
+	int* result = (int*)findArg(args, "result");
+	if (product == nullptr || id == nullptr || description == nullptr || result == nullptr) {
+		return FALSE;
+	}
+	if (*product != MQBoneManager::GetProductID() || *id != MQBoneManager::GetPluginID()) {
+		return FALSE;
+	}
+	*result = boneMessage(description, findArg(args, "message"));
+	return TRUE;
+}
+
+
+//---------------------------------------------------------------------------
+//  シーン生成
+//---------------------------------------------------------------------------
+
+struct BenchSceneStat {
+	int vertices = 0;
+	int faces = 0;
+	double generateMsec = 0.0;
+};
+
+/// <summary>
+/// 格子状のオブジェクトを作る. 一部のセルは下辺に頂点を足した
+/// 凹五角形にする (tool/script/addobj1.py の星形のような非凸の面)。
+/// </summary>
+static MQObject createGridObject(const BenchSceneParam& param, int objIndex, std::mt19937& rng, int& outVertNum)
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	MQObject obj = MQ_CreateObject();
+	obj->SetName(MString::format(L"obj%d", objIndex).toAnsiString().c_str());
+
+	int cols = std::max(1, (int)sqrtf((float)param.facesPerObject));
+	int rows = std::max(1, (param.facesPerObject + cols - 1) / cols);
+	float ox = objIndex * (cols + 2.0f);
+
+	std::vector<int> grid((cols + 1) * (rows + 1));
+	for (int y = 0; y <= rows; ++y) {
+		for (int x = 0; x <= cols; ++x) {
+			float h = 0.25f * sinf(x * 0.3f) * cosf(y * 0.2f);
+			grid[y * (cols + 1) + x] = obj->AddVertex(MQPoint(ox + x, h, (float)y));
+		}
+	}
+
+	int face_num = 0;
+	for (int y = 0; y < rows && face_num < param.facesPerObject; ++y) {
+		for (int x = 0; x < cols && face_num < param.facesPerObject; ++x, ++face_num) {
+			int v00 = grid[y * (cols + 1) + x];
+			int v10 = grid[y * (cols + 1) + x + 1];
+			int v11 = grid[(y + 1) * (cols + 1) + x + 1];
+			int v01 = grid[(y + 1) * (cols + 1) + x];
+
+			float u0 = (float)x / cols, u1 = (float)(x + 1) / cols;
+			float t0 = (float)y / rows, t1 = (float)(y + 1) / rows;
+			// 島としてずらすと隣の面と UV がつながらなくなる
+			if (unit(rng) < param.seamDensity) {
+				u0 += 0.5f;
+				u1 += 0.5f;
+			}
+
+			int fi;
+			if (unit(rng) < param.ngonRatio) {
+				// 面頂点は左ねじ
+				int mid = obj->AddVertex(MQPoint(ox + x + 0.5f, 0.1f, y + 0.3f));
+				int vi[5] = { v00, v01, v11, v10, mid };
+				fi = obj->AddFace(5, vi);
+				MQCoordinate uv[5] = {
+					MQCoordinate(u0, t0), MQCoordinate(u0, t1), MQCoordinate(u1, t1),
+					MQCoordinate(u1, t0), MQCoordinate((u0 + u1) * 0.5f, t0 + (t1 - t0) * 0.3f),
+				};
+				obj->SetFaceCoordinateArray(fi, uv);
+			} else {
+				int vi[4] = { v00, v01, v11, v10 };
+				fi = obj->AddFace(4, vi);
+				MQCoordinate uv[4] = {
+					MQCoordinate(u0, t0), MQCoordinate(u0, t1), MQCoordinate(u1, t1), MQCoordinate(u1, t0),
+				};
+				obj->SetFaceCoordinateArray(fi, uv);
+			}
+			if (param.materials > 0) {
+				obj->SetFaceMaterial(fi, (int)(unit(rng) * param.materials) % param.materials);
+			}
+		}
+	}
+	outVertNum = obj->GetVertexCount();
+	return obj;
+}
+
+/// <summary>
+/// Y 方向に伸びるボーン列を作り、各頂点に近いボーンからウェイトを割り当てる
+/// </summary>
+static void createBones(const BenchSceneParam& param, MQDocument doc, std::mt19937& rng)
+{
+	s_BonePlugin.clear();
+	if (param.bones <= 0) {
+		return;
+	}
+
+	// 2本ずつ枝分かれする木
+	for (int i = 0; i < param.bones; ++i) {
+		BenchBonePlugin::Bone bone;
+		bone.id = i + 1;
+		bone.parent = (i == 0) ? 0 : (UINT)((i - 1) / 2 + 1);
+		bone.childNum = 0;
+		bone.pos = MQPoint((float)(i % 7), (float)i * 0.1f, (float)(i / 7));
+		bone.name = MString::format(L"bone%d", i).c_str();
+		s_BonePlugin.bones.push_back(bone);
+		if (bone.parent != 0) {
+			s_BonePlugin.bones[bone.parent - 1].childNum++;
+		}
+	}
+
+	int weight_num = std::max(1, std::min(param.weightsPerVertex, param.bones));
+	std::uniform_int_distribution<int> pick(0, param.bones - 1);
+	for (int oi = 0; oi < doc->GetObjectCount(); ++oi) {
+		MQObject obj = doc->GetObject(oi);
+		UINT obj_id = obj->GetUniqueID();
+		auto& per_bone = s_BonePlugin.objectWeights[obj_id];
+		auto& per_vertex = s_BonePlugin.vertexWeights[obj_id];
+		per_bone.resize(param.bones);
+
+		int vert_num = obj->GetVertexCount();
+		for (int vi = 0; vi < vert_num; ++vi) {
+			UINT vert_id = obj->GetVertexUniqueID(vi);
+			int base = pick(rng);
+			float total = 0.0f;
+			std::vector<std::pair<UINT, float>> list;
+			for (int k = 0; k < weight_num; ++k) {
+				int bi = (base + k) % param.bones;
+				float w = 1.0f / (k + 1);
+				list.push_back(std::make_pair((UINT)(bi + 1), w));
+				total += w;
+			}
+			for (auto& it : list) {
+				it.second /= total;
+				per_bone[it.first - 1].push_back({ vert_id, it.second });
+			}
+			per_vertex[vert_id] = list;
+		}
+	}
+}
+
+/// <summary>
+/// シーンによらない書き出しの設定
+/// </summary>
+struct BenchOption {
+	/// <summary>
+	/// 書き出したファイルを GPBReader で検証する
+	/// </summary>
+	bool validate = false;
+	/// <summary>
+	/// 同じ材質の統合を有効にする
+	/// </summary>
+	bool mergeMaterials = false;
+	/// <summary>
+	/// テクスチャアトラスを有効にする. テクスチャはクランプにする
+	/// </summary>
+	bool atlas = false;
+	/// <summary>
+	/// 頂点の溶接を有効にする
+	/// </summary>
+	bool weld = false;
+};
+
+static MQDocument createScene(const BenchSceneParam& param, const BenchOption& benchOption,
+	unsigned int seed, BenchSceneStat& stat)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::mt19937 rng(seed);
+
+	MQDocument doc = MQMockHost::CreateDocument();
+	for (int mi = 0; mi < param.materials; ++mi) {
+		MQMaterial mat = MQ_CreateMaterial();
+		mat->SetName(MString::format(L"mat%d", mi).toAnsiString().c_str());
+		// 種類数の指定があれば同じ描画状態の材質を繰り返す
+		int state = (param.materialVariants > 0) ? (mi % param.materialVariants) : mi;
+		MQColor col((state % 3) / 2.0f, (state % 5) / 4.0f, (state % 7) / 6.0f);
+		mat->SetColor(col);
+		mat->SetPower(5.0f);
+		// 半分の材質にテクスチャを設定する
+		if (state % 2 == 0) {
+			MString texture = MString::format(L"tex%d.png", state);
+			mat->SetTextureName(texture.toAnsiString().c_str());
+			if (benchOption.atlas) {
+				mat->SetWrapModeU(MQMATERIAL_WRAP_CLAMP);
+				mat->SetWrapModeV(MQMATERIAL_WRAP_CLAMP);
+			}
+
+			// 32x32 の市松模様. 24bit の DIB なので1行は 96 バイト
+			const int size = 32;
+			std::vector<BYTE> pixels(size * size * 3);
+			for (int y = 0; y < size; ++y) {
+				for (int x = 0; x < size; ++x) {
+					bool odd = ((x / 4 + y / 4) % 2) != 0;
+					BYTE* p = &pixels[(y * size + x) * 3];
+					p[0] = (BYTE)((odd ? 1.0f - col.b : col.b) * 255.0f);
+					p[1] = (BYTE)((odd ? 1.0f - col.g : col.g) * 255.0f);
+					p[2] = (BYTE)((odd ? 1.0f - col.r : col.r) * 255.0f);
+				}
+			}
+			MQMockHost::AddMappingImage(doc, texture.c_str(), MQMAPPING_TEXTURE, size, size, 24, pixels.data());
+		}
+		doc->AddMaterial(mat);
+	}
+
+	for (int oi = 0; oi < param.objects; ++oi) {
+		int vert_num = 0;
+		MQObject obj = createGridObject(param, oi, rng, vert_num);
+		stat.vertices += vert_num;
+		stat.faces += obj->GetFaceCount();
+		doc->AddObject(obj);
+	}
+
+	createBones(param, doc, rng);
+
+	stat.generateMsec = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return doc;
+}
+
+
+//---------------------------------------------------------------------------
+//  計測
+//---------------------------------------------------------------------------
+
+struct BenchStage {
+	std::string name;
+	/// <summary>
+	/// 各回のミリ秒
+	/// </summary>
+	std::vector<double> msec;
+	/// <summary>
+	/// 各回の段階中の確保量の最大値(バイト)
+	/// </summary>
+	std::vector<double> peakBytes;
+};
+
+struct BenchResult {
+	BenchSceneParam param;
+	BenchSceneStat stat;
+	std::vector<BenchStage> stages;
+	std::vector<double> totals;
+	std::vector<double> peaks;
+	long long gpbBytes = 0;
+	bool succeeded = true;
+	/// <summary>
+	/// GPBReader::validate() のエラー数. -1 なら未検証
+	/// </summary>
+	int validationErrors = -1;
+	/// <summary>
+	/// 最後の回の件数
+	/// </summary>
+	std::vector<std::pair<std::string, long long>> counts;
+};
+
+static double minOf(const std::vector<double>& values)
+{
+	return values.empty() ? 0.0 : *std::min_element(values.begin(), values.end());
+}
+
+static double medianOf(std::vector<double> values)
+{
+	if (values.empty()) {
+		return 0.0;
+	}
+	std::sort(values.begin(), values.end());
+	size_t n = values.size();
+	return (n % 2) ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) * 0.5;
+}
+
+static BenchResult runBench(ExportGPBPlugin& plugin, const BenchSceneParam& param,
+	int repeat, unsigned int seed, const MString& outDir, const BenchOption& benchOption)
+{
+	BenchResult result;
+	result.param = param;
+
+	MQDocument doc = createScene(param, benchOption, seed, result.stat);
+
+	CreateDialogOptionParam option;
+	option.visible_only = false;
+	option.bone_exists = (param.bones > 0);
+	option.output_bone = (param.bones > 0) ? 1 : 0;
+	option.mtlfile = FILEOUT_FORCE;
+	option.hspfile = FILEOUT_FORCE;
+	// "/" は checkOver() で不正文字扱いになるので付けない
+	option.texture_prefix = L"";
+	option.input_xmlanim = FILEIN_NOTUSE;
+	option.material_conv = 0;
+	option.material_merge = benchOption.mergeMaterials ? 1 : 0;
+	option.texture_atlas = benchOption.atlas ? ATLAS_ALL : ATLAS_NO;
+	option.weld = benchOption.weld ? 1 : 0;
+
+	MString path = MFileUtil::combinePath(outDir, MString::fromUtf8String(param.name) + L".gpb");
+	MLanguage language;
+	for (int r = 0; r < repeat; ++r) {
+		MString outputFiles;
+		GPBExportProfile profile;
+		BOOL ok = plugin.exportDocument(path.c_str(), doc, option, 1.0f, language, outputFiles, &profile);
+		if (!ok) {
+			result.succeeded = false;
+			break;
+		}
+		const auto& stages = profile.getStages();
+		for (size_t i = 0; i < stages.size(); ++i) {
+			if (result.stages.size() <= i) {
+				BenchStage stage;
+				stage.name = stages[i].name;
+				result.stages.push_back(stage);
+			}
+			result.stages[i].msec.push_back(stages[i].msec);
+			result.stages[i].peakBytes.push_back((double)stages[i].peakBytes);
+		}
+		result.totals.push_back(profile.getTotalMsec());
+		result.peaks.push_back((double)profile.getPeakBytes());
+		result.counts.clear();
+		for (const auto& count : profile.getCounts()) {
+			result.counts.push_back(std::make_pair(std::string(count.first), count.second));
+		}
+	}
+
+	FILE* fp = nullptr;
+	if (_wfopen_s(&fp, path.c_str(), L"rb") == 0) {
+		fseek(fp, 0, SEEK_END);
+		result.gpbBytes = ftell(fp);
+		fclose(fp);
+	}
+
+	if (benchOption.validate && result.succeeded) {
+		GPBReader reader;
+		GPBValidationReport report;
+		if (reader.open(path.toUtf8String().c_str())) {
+			result.validationErrors = reader.validate(report);
+		} else {
+			result.validationErrors = 1;
+		}
+		if (result.validationErrors != 0) {
+			fprintf(stderr, "%s: %s%s\n", param.name, reader.getError().c_str(), report.toString().c_str());
+		}
+	}
+
+	MQMockHost::DeleteDocument(doc);
+	return result;
+}
+
+static void writeJson(FILE* fp, const std::vector<BenchResult>& results, int repeat, unsigned int seed, const BenchOption& benchOption)
+{
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"benchmark\": \"exportgpb\",\n");
+	fprintf(fp, "  \"version\": \"%s\",\n", IDENVER);
+	fprintf(fp, "  \"repeat\": %d,\n", repeat);
+	fprintf(fp, "  \"seed\": %u,\n", seed);
+	fprintf(fp, "  \"alloc_counted\": %s,\n", GPBExportProfile::isAllocCounted() ? "true" : "false");
+	fprintf(fp, "  \"merge_materials\": %s,\n", benchOption.mergeMaterials ? "true" : "false");
+	fprintf(fp, "  \"texture_atlas\": %s,\n", benchOption.atlas ? "true" : "false");
+	fprintf(fp, "  \"weld\": %s,\n", benchOption.weld ? "true" : "false");
+	fprintf(fp, "  \"runs\": [\n");
+	for (size_t i = 0; i < results.size(); ++i) {
+		const auto& r = results[i];
+		const auto& p = r.param;
+		fprintf(fp, "    {\n");
+		fprintf(fp, "      \"name\": \"%s\",\n", p.name);
+		fprintf(fp, "      \"succeeded\": %s,\n", r.succeeded ? "true" : "false");
+		fprintf(fp, "      \"params\": { \"objects\": %d, \"faces_per_object\": %d, \"ngon_ratio\": %g, \"seam_density\": %g, \"materials\": %d, \"bones\": %d, \"weights_per_vertex\": %d, \"material_variants\": %d },\n",
+			p.objects, p.facesPerObject, p.ngonRatio, p.seamDensity, p.materials, p.bones, p.weightsPerVertex, p.materialVariants);
+		fprintf(fp, "      \"scene\": { \"vertices\": %d, \"faces\": %d, \"generate_msec\": %.3f },\n",
+			r.stat.vertices, r.stat.faces, r.stat.generateMsec);
+		fprintf(fp, "      \"gpb_bytes\": %lld,\n", r.gpbBytes);
+		fprintf(fp, "      \"counts\": {");
+		for (size_t c = 0; c < r.counts.size(); ++c) {
+			fprintf(fp, "%s\"%s\": %lld", (c > 0) ? ", " : " ", r.counts[c].first.c_str(), r.counts[c].second);
+		}
+		fprintf(fp, "%s},\n", r.counts.empty() ? "" : " ");
+		if (r.validationErrors >= 0) {
+			fprintf(fp, "      \"validation_errors\": %d,\n", r.validationErrors);
+		}
+		fprintf(fp, "      \"stages\": {\n");
+		for (size_t s = 0; s < r.stages.size(); ++s) {
+			fprintf(fp, "        \"%s\": { \"min_msec\": %.3f, \"median_msec\": %.3f, \"median_peak_bytes\": %.0f }%s\n",
+				r.stages[s].name.c_str(),
+				minOf(r.stages[s].msec),
+				medianOf(r.stages[s].msec),
+				medianOf(r.stages[s].peakBytes),
+				(s + 1 < r.stages.size()) ? "," : "");
+		}
+		fprintf(fp, "      },\n");
+		fprintf(fp, "      \"total\": { \"min_msec\": %.3f, \"median_msec\": %.3f, \"median_peak_bytes\": %.0f }\n",
+			minOf(r.totals), medianOf(r.totals), medianOf(r.peaks));
+		fprintf(fp, "    }%s\n", (i + 1 < results.size()) ? "," : "");
+	}
+	fprintf(fp, "  ]\n");
+	fprintf(fp, "}\n");
+}
+
+static void printUsage()
+{
+	printf("Usage: exportgpb_bench [options]\n"
+		"  --preset NAME          small, medium, large, ngon, seams, materials, skinned, many_bones, kitbash or all (default: small)\n"
+		"  --objects N            object count\n"
+		"  --faces N              faces per object\n"
+		"  --ngon-ratio R         ratio of pentagons instead of quads (0-1)\n"
+		"  --seam-density R       ratio of faces moved to a separate UV island (0-1)\n"
+		"  --materials N          material count\n"
+		"  --bones N              bone count\n"
+		"  --weights N            weights per vertex\n"
+		"  --material-variants N  distinct render states among the materials (0: all distinct)\n"
+		"  --merge-materials      merge materials with the same render state\n"
+		"  --atlas                pack clamped textures into texture atlases\n"
+		"  --weld                 weld vertices within tolerance across objects\n"
+		"  --repeat N             exports per scene (default: 5)\n"
+		"  --seed N               random seed (default: 1)\n"
+		"  --outdir DIR           folder for the exported files (default: current folder)\n"
+		"  --json FILE            write the result to FILE instead of stdout\n"
+		"  --validate             check the last exported file with GPBReader\n");
+}
+
+int main(int argc, char** argv)
+{
+	MQMockHost::Install();
+	MQMockHost::SetMessageHandler(benchMessageHandler);
+
+	std::vector<BenchSceneParam> params;
+	BenchSceneParam custom = s_Presets[0];
+	custom.name = "custom";
+	bool useCustom = false;
+	int repeat = 5;
+	unsigned int seed = 1;
+	MString outDir = MFileUtil::getCurrentDirectory();
+	const char* jsonPath = nullptr;
+	BenchOption benchOption;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h") {
+			printUsage();
+			return 0;
+		}
+		if (arg == "--validate") {
+			benchOption.validate = true;
+			continue;
+		}
+		if (arg == "--merge-materials") {
+			benchOption.mergeMaterials = true;
+			continue;
+		}
+		if (arg == "--atlas") {
+			benchOption.atlas = true;
+			continue;
+		}
+		if (arg == "--weld") {
+			benchOption.weld = true;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			fprintf(stderr, "Missing value for %s\n", arg.c_str());
+			printUsage();
+			return 1;
+		}
+		const char* value = argv[++i];
+		if (arg == "--preset") {
+			bool found = false;
+			for (const auto& preset : s_Presets) {
+				if (strcmp(value, "all") == 0 || strcmp(value, preset.name) == 0) {
+					params.push_back(preset);
+					found = true;
+				}
+			}
+			if (!found) {
+				fprintf(stderr, "Unknown preset: %s\n", value);
+				return 1;
+			}
+		} else if (arg == "--objects") {
+			custom.objects = atoi(value);
+			useCustom = true;
+		} else if (arg == "--faces") {
+			custom.facesPerObject = atoi(value);
+			useCustom = true;
+		} else if (arg == "--ngon-ratio") {
+			custom.ngonRatio = (float)atof(value);
+			useCustom = true;
+		} else if (arg == "--seam-density") {
+			custom.seamDensity = (float)atof(value);
+			useCustom = true;
+		} else if (arg == "--materials") {
+			custom.materials = atoi(value);
+			useCustom = true;
+		} else if (arg == "--bones") {
+			custom.bones = atoi(value);
+			useCustom = true;
+		} else if (arg == "--weights") {
+			custom.weightsPerVertex = atoi(value);
+			useCustom = true;
+		} else if (arg == "--material-variants") {
+			custom.materialVariants = atoi(value);
+			useCustom = true;
+		} else if (arg == "--repeat") {
+			repeat = std::max(1, atoi(value));
+		} else if (arg == "--seed") {
+			seed = (unsigned int)strtoul(value, nullptr, 10);
+		} else if (arg == "--outdir") {
+			outDir = MString::fromUtf8String(value);
+		} else if (arg == "--json") {
+			jsonPath = value;
+		} else {
+			fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+			printUsage();
+			return 1;
+		}
+	}
+	if (useCustom) {
+		params.push_back(custom);
+	}
+	if (params.empty()) {
+		params.push_back(s_Presets[0]);
+	}
+	MFileUtil::createDirectory(outDir);
+
+	ExportGPBPlugin plugin;
+	std::vector<BenchResult> results;
+	bool ok = true;
+	for (const auto& param : params) {
+		fprintf(stderr, "%s ...\n", param.name);
+		results.push_back(runBench(plugin, param, repeat, seed, outDir, benchOption));
+		if (!results.back().succeeded) {
+			fprintf(stderr, "%s: export failed\n", param.name);
+			ok = false;
+		}
+		if (results.back().validationErrors > 0) {
+			ok = false;
+		}
+	}
+
+	FILE* fp = stdout;
+	if (jsonPath != nullptr) {
+		fp = fopen(jsonPath, "w");
+		if (fp == nullptr) {
+			fprintf(stderr, "Failed to open %s\n", jsonPath);
+			return 1;
+		}
+	}
+	writeJson(fp, results, repeat, seed, benchOption);
+	if (fp != stdout) {
+		fclose(fp);
+	}
+	return ok ? 0 : 1;
+}
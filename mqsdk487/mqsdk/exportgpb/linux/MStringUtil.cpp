@@ -0,0 +1,287 @@
+﻿#include "MStringUtil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <wchar.h>
+#include <iconv.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <codecvt>
+#include <locale>
+#include <vector>
+
+
+//------------------------------------------------------------------
+//  Character encoding
+//------------------------------------------------------------------
+
+// Convert a byte string between encodings by iconv. Return false if the
+// conversion is not available or the input is invalid.
+static bool convertByIconv(const char *to_code, const char *from_code, const char *src, size_t src_len, std::string& dst)
+{
+	iconv_t cd = iconv_open(to_code, from_code);
+	if(cd == (iconv_t)-1)
+		return false;
+
+	std::vector<char> buf(src_len * 4 + 16);
+	char *inptr = const_cast<char*>(src);
+	size_t inleft = src_len;
+	char *outptr = buf.data();
+	size_t outleft = buf.size();
+	size_t ret = iconv(cd, &inptr, &inleft, &outptr, &outleft);
+	iconv_close(cd);
+	if(ret == (size_t)-1)
+		return false;
+
+	dst.assign(buf.data(), buf.size() - outleft);
+	return true;
+}
+
+MAnsiString MStringUtil::MStringToShiftJisString(const MString& str)
+{
+	MAnsiString utf8 = MStringToUtf8String(str);
+	std::string ret;
+	if(!convertByIconv("CP932", "UTF-8", utf8.c_str(), utf8.length(), ret))
+		return utf8;
+	return MAnsiString(ret.c_str());
+}
+
+MAnsiString MStringUtil::MStringToUtf8String(const MString& str)
+{
+	try {
+		std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> conv;
+		return MAnsiString(conv.to_bytes(str.c_str()).c_str());
+	}catch(...){
+	}
+	return MAnsiString();
+}
+
+MString MStringUtil::ShiftJisStringToMString(const MAnsiString& str)
+{
+	std::string utf8;
+	if(!convertByIconv("UTF-8", "CP932", str.c_str(), str.length(), utf8))
+		return Utf8StringToMString(str.c_str());
+	return Utf8StringToMString(utf8.c_str());
+}
+
+MString MStringUtil::Utf8StringToMString(const char *str)
+{
+	try {
+		std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> conv;
+		return MString(conv.from_bytes(str).c_str());
+	}catch(...){
+	}
+	return MString();
+}
+
+
+//------------------------------------------------------------------
+//  File system
+//------------------------------------------------------------------
+
+BOOL MStringUtil::IsHiddenFile(const MString& path, bool is_directory)
+{
+	size_t p = path.lastIndexOf(L'/');
+	MString name = (p != MString::kInvalid) ? path.substring(p+1) : path;
+	return (name.length() > 0 && name[0] == L'.');
+}
+
+BOOL MStringUtil::CreateDirectory(const MString& path)
+{
+	MAnsiString upath = path.toUtf8String();
+	std::string cur;
+	for(size_t i = 0; i <= upath.length(); i++){
+		char c = (i < upath.length()) ? upath[i] : '/';
+		if(c == '/' && cur.length() > 0){
+			struct stat st;
+			if(stat(cur.c_str(), &st) != 0){
+				if(mkdir(cur.c_str(), 0755) != 0 && errno != EEXIST)
+					return false;
+			}else if(!S_ISDIR(st.st_mode)){
+				return false;
+			}
+		}
+		cur += c;
+	}
+	return true;
+}
+
+BOOL MStringUtil::CopyFile(const MString& dst_file, const MString& src_file)
+{
+	FILE *src = fopen(src_file.toUtf8String().c_str(), "rb");
+	if(src == nullptr)
+		return false;
+	FILE *dst = fopen(dst_file.toUtf8String().c_str(), "wb");
+	if(dst == nullptr){
+		fclose(src);
+		return false;
+	}
+
+	bool ok = true;
+	char buf[65536];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), src)) > 0){
+		if(fwrite(buf, 1, n, dst) != n){
+			ok = false;
+			break;
+		}
+	}
+	if(ferror(src))
+		ok = false;
+	fclose(src);
+	if(fclose(dst) != 0)
+		ok = false;
+	return ok;
+}
+
+MString MStringUtil::ConvertToFullPath(const MString& path)
+{
+	char buf[PATH_MAX];
+	if(realpath(path.toUtf8String().c_str(), buf) != nullptr)
+		return MString::fromUtf8String(buf);
+	return path; // The file does not exist yet.
+}
+
+static MString getUserDir(const char *xdg_name, const wchar_t *sub_dir)
+{
+	const char *xdg = getenv(xdg_name);
+	if(xdg != nullptr && xdg[0] != '\0')
+		return MString::fromUtf8String(xdg);
+	const char *home = getenv("HOME");
+	if(home == nullptr)
+		return MString();
+	MString ret = MString::fromUtf8String(home);
+	ret += L"/";
+	ret += sub_dir;
+	return ret;
+}
+
+MString MStringUtil::GetMyDocumentDir()
+{
+	return getUserDir("XDG_DOCUMENTS_DIR", L"Documents");
+}
+
+MString MStringUtil::GetMyPictureDir()
+{
+	return getUserDir("XDG_PICTURES_DIR", L"Pictures");
+}
+
+MString MStringUtil::GetDesktopDir()
+{
+	return getUserDir("XDG_DESKTOP_DIR", L"Desktop");
+}
+
+
+//------------------------------------------------------------------
+//  Compatible functions declared in MLibsDll.h
+//------------------------------------------------------------------
+
+errno_t strcpy_s(char *dst, size_t num, const char *src)
+{
+	if(dst == nullptr || src == nullptr || num == 0)
+		return EINVAL;
+	size_t len = strlen(src);
+	if(len >= num){
+		dst[0] = '\0';
+		return ERANGE;
+	}
+	memcpy(dst, src, len+1);
+	return 0;
+}
+
+errno_t memcpy_s(void *dst, size_t nelems, const void *src, size_t n)
+{
+	if(n == 0)
+		return 0;
+	if(dst == nullptr || src == nullptr)
+		return EINVAL;
+	if(n > nelems){
+		memset(dst, 0, nelems);
+		return ERANGE;
+	}
+	memcpy(dst, src, n);
+	return 0;
+}
+
+int _wtoi(const wchar_t *s)
+{
+	return (int)wcstol(s, nullptr, 10);
+}
+
+double _wtof(const wchar_t *s)
+{
+	return wcstod(s, nullptr);
+}
+
+int64_t _atoi64(const char *s)
+{
+	return strtoll(s, nullptr, 10);
+}
+
+int64_t _wtoi64(const wchar_t *s)
+{
+	return wcstoll(s, nullptr, 10);
+}
+
+int64_t _strtoi64(const char *s, size_t *idx, int base)
+{
+	char *end = nullptr;
+	int64_t ret = strtoll(s, &end, base);
+	if(idx != nullptr) *idx = end - s;
+	return ret;
+}
+
+uint64_t _strtoui64(const char *s, size_t *idx, int base)
+{
+	char *end = nullptr;
+	uint64_t ret = strtoull(s, &end, base);
+	if(idx != nullptr) *idx = end - s;
+	return ret;
+}
+
+int64_t _wcstoi64(const wchar_t *s, size_t *idx, int base)
+{
+	wchar_t *end = nullptr;
+	int64_t ret = wcstoll(s, &end, base);
+	if(idx != nullptr) *idx = end - s;
+	return ret;
+}
+
+int64_t _wcstoui64(const wchar_t *s, size_t *idx, int base)
+{
+	wchar_t *end = nullptr;
+	int64_t ret = (int64_t)wcstoull(s, &end, base);
+	if(idx != nullptr) *idx = end - s;
+	return ret;
+}
+
+errno_t fopen_s(FILE** fh, const char *filename, const char *mode)
+{
+	if(fh == nullptr)
+		return EINVAL;
+	*fh = fopen(filename, mode);
+	return (*fh != nullptr) ? 0 : errno;
+}
+
+errno_t _wfopen_s(FILE** fh, const wchar_t *filename, const wchar_t *mode)
+{
+	if(fh == nullptr)
+		return EINVAL;
+	MAnsiString ufn = MString(filename).toUtf8String();
+	MAnsiString umode = MString(mode).toUtf8String();
+	// "ccs=UTF-8" etc. is not supported by fopen.
+	std::string m = umode.c_str();
+	size_t p = m.find(',');
+	if(p != std::string::npos)
+		m = m.substr(0, p);
+	*fh = fopen(ufn.c_str(), m.c_str());
+	return (*fh != nullptr) ? 0 : errno;
+}
+
+BOOL IsDBCSLeadByte(BYTE ch)
+{
+	// Shift-JIS lead bytes
+	return ((ch >= 0x81 && ch <= 0x9F) || (ch >= 0xE0 && ch <= 0xFC));
+}
@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#ifndef _MSTRINGUTIL_LINUX_H_
+#define _MSTRINGUTIL_LINUX_H_
+
+#include "../MLibsDll.h"
+#include "../MString.h"
+#include "../MAnsiString.h"
+
+
+// Platform functions for Linux. Same interface as osx/MStringUtil.h.
+// Shift-JIS conversion uses iconv (CP932).
+namespace MStringUtil
+{
+	MAnsiString MStringToShiftJisString(const MString& str);
+	MAnsiString MStringToUtf8String(const MString& str);
+	MString ShiftJisStringToMString(const MAnsiString& str);
+	MString Utf8StringToMString(const char *str);
+
+	BOOL IsHiddenFile(const MString& path, bool is_directory);
+	BOOL CreateDirectory(const MString& path);
+	BOOL CopyFile(const MString& dst_file, const MString& src_file);
+	MString ConvertToFullPath(const MString& path);
+
+	// Return $XDG_*_DIR if set, or a folder under $HOME.
+	MString GetMyDocumentDir();
+	MString GetMyPictureDir();
+	MString GetDesktopDir();
+}
+
+#endif //_MSTRINGUTIL_LINUX_H_
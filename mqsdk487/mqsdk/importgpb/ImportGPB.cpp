@@ -0,0 +1,715 @@
+﻿//---------------------------------------------------------------------------
+// ExportGPB が書き出した .gpb を読み込むプラグイン
+//    　作成したDLLは"Plugins\Import"フォルダに入れる必要がある。
+//---------------------------------------------------------------------------
+
+#include "./ImportGPB.h"
+#include <algorithm>
+#include <string.h>
+
+
+// 面を追加する間に進捗とキャンセルを調べる間隔
+#define PROGRESS_FACE_INTERVAL (4096)
+
+// 警告ダイアログに出す検証結果の最大行数
+#define REPORT_LINE_MAX (20)
+
+
+#ifdef _WIN32
+wchar_t s_DllPath[MAX_PATH];
+
+BOOL APIENTRY DllMain( HMODULE hModule,
+	DWORD  ul_reason_for_call,
+	LPVOID lpReserved
+	)
+{
+	switch (ul_reason_for_call)
+	{
+	case DLL_PROCESS_ATTACH:
+		::GetModuleFileName((HMODULE)hModule, s_DllPath, MAX_PATH);
+		break;
+	}
+	return TRUE;
+}
+#endif
+#if __APPLE__
+static MString GetResourceDir()
+{
+	// Get a resource directory.
+	CFBundleRef bundleRef = CFBundleGetBundleWithIdentifier(CFSTR("hta393939.ImportGPB"));
+	if(bundleRef == NULL) return MString();
+	
+	CFURLRef resourceUrl = CFBundleCopyResourcesDirectoryURL(bundleRef);
+	char path[PATH_MAX+100];
+	Boolean ret = CFURLGetFileSystemRepresentation(resourceUrl, TRUE, (UInt8*)path, PATH_MAX+100);
+	CFRelease(resourceUrl);
+	if(!ret) return MString();
+	
+	return MString::fromUtf8String(path);
+}
+#endif
+
+
+/// <summary>
+/// マップ上の float を読む. 4バイト境界とは限らない
+/// </summary>
+static float _readFloat(const uint8_t* p, int index) {
+	float v;
+	memcpy(&v, p + index * 4, sizeof(v));
+	return v;
+}
+
+/// <summary>
+/// gpb の行列 (MQMatrix と同じ行ベクトル形式) の積 a * b
+/// </summary>
+static void _mulMatrix(const float a[16], const float b[16], float dst[16]) {
+	for (int r = 0; r < 4; ++r) {
+		for (int c = 0; c < 4; ++c) {
+			float sum = 0.0f;
+			for (int k = 0; k < 4; ++k) {
+				sum += a[r * 4 + k] * b[k * 4 + c];
+			}
+			dst[r * 4 + c] = sum;
+		}
+	}
+}
+
+static MQPoint _transformPoint(const float m[16], const MQPoint& p) {
+	return MQPoint(
+		p.x * m[0] + p.y * m[4] + p.z * m[8] + m[12],
+		p.x * m[1] + p.y * m[5] + p.z * m[9] + m[13],
+		p.x * m[2] + p.y * m[6] + p.z * m[10] + m[14]);
+}
+
+/// <summary>
+/// 逆バインド行列からジョイントの位置を求める.
+/// p * invBind = 0 となる p を 3x3 部分の逆行列で解く
+/// </summary>
+static bool _inverseBindToPosition(const uint8_t* inverseBind, MQPoint& pos) {
+	float m[16];
+	for (int i = 0; i < 16; ++i) {
+		m[i] = _readFloat(inverseBind, i);
+	}
+	float det = m[0] * (m[5] * m[10] - m[6] * m[9])
+		- m[1] * (m[4] * m[10] - m[6] * m[8])
+		+ m[2] * (m[4] * m[9] - m[5] * m[8]);
+	if (fabsf(det) < 1e-12f) {
+		return false;
+	}
+	float inv[9] = {
+		(m[5] * m[10] - m[6] * m[9]) / det,
+		(m[2] * m[9] - m[1] * m[10]) / det,
+		(m[1] * m[6] - m[2] * m[5]) / det,
+		(m[6] * m[8] - m[4] * m[10]) / det,
+		(m[0] * m[10] - m[2] * m[8]) / det,
+		(m[2] * m[4] - m[0] * m[6]) / det,
+		(m[4] * m[9] - m[5] * m[8]) / det,
+		(m[1] * m[8] - m[0] * m[9]) / det,
+		(m[0] * m[5] - m[1] * m[4]) / det,
+	};
+	float tx = -m[12], ty = -m[13], tz = -m[14];
+	pos.x = tx * inv[0] + ty * inv[3] + tz * inv[6];
+	pos.y = tx * inv[1] + ty * inv[4] + tz * inv[7];
+	pos.z = tx * inv[2] + ty * inv[5] + tz * inv[8];
+	return true;
+}
+
+static std::string _trim(const std::string& s) {
+	size_t b = s.find_first_not_of(" \t\r\n");
+	if (b == std::string::npos) {
+		return std::string();
+	}
+	size_t e = s.find_last_not_of(" \t\r\n");
+	return s.substr(b, e - b + 1);
+}
+
+static int _toWrap(const std::string& s) {
+	if (s == "MIRROR") {
+		return MQMATERIAL_WRAP_MIRROR;
+	}
+	if (s == "CLAMP") {
+		return MQMATERIAL_WRAP_CLAMP;
+	}
+	return MQMATERIAL_WRAP_REPEAT;
+}
+
+
+
+ImportGPBPlugin::ImportGPBPlugin()
+{
+}
+
+ImportGPBPlugin::~ImportGPBPlugin()
+{
+}
+
+
+void ImportGPBPlugin::GetPlugInID(DWORD *Product, DWORD *ID)
+{
+	*Product = MY_PRODUCT;
+	*ID      = MY_ID;
+}
+
+const char *ImportGPBPlugin::GetPlugInName(void)
+{
+	return MY_PLUGINNAME;
+}
+
+const char *ImportGPBPlugin::EnumFileType(int index)
+{
+	if(index == 0){
+		return MY_FILETYPE;
+	}
+	return NULL;
+}
+
+const char *ImportGPBPlugin::EnumFileExt(int index)
+{
+	if(index == 0){
+		return MY_EXT;
+	}
+	return NULL;
+}
+
+
+/// <summary>
+/// makeMaterial() が書いた .material を読む.
+/// 行単位で "material 名前 : 親" のブロックと、その中の値だけを拾う
+/// </summary>
+int ImportGPBPlugin::loadMaterialFile(const MString& path,
+	std::map<std::string, GPBImportMaterial>& materials)
+{
+	FILE* fh = nullptr;
+#ifdef _WIN32
+	errno_t err = _wfopen_s(&fh, path.c_str(), L"r");
+	if (err != 0) {
+		return 0;
+	}
+#else
+	fh = fopen(path.toUtf8String().c_str(), "r");
+#endif
+	if (fh == nullptr) {
+		return 0;
+	}
+
+	GPBImportMaterial* cur = nullptr;
+	std::string curName;
+	int depth = 0;
+	char buf[1024];
+	while (fgets(buf, sizeof(buf), fh) != nullptr) {
+		std::string line = _trim(buf);
+		if (line.empty() || line.compare(0, 2, "//") == 0) {
+			continue;
+		}
+		if (line == "{") {
+			depth++;
+			continue;
+		}
+		if (line == "}") {
+			depth--;
+			if (depth <= 0) {
+				depth = 0;
+				cur = nullptr;
+			}
+			continue;
+		}
+
+		if (depth == 0) {
+			// material name : textured
+			if (line.compare(0, 9, "material ") == 0) {
+				std::string rest = line.substr(9);
+				size_t colon = rest.find(':');
+				if (colon == std::string::npos) {
+					// 親の colored, textured
+					cur = nullptr;
+					continue;
+				}
+				curName = _trim(rest.substr(0, colon));
+				cur = &materials[curName];
+				cur->name = curName;
+				cur->useTexture = (_trim(rest.substr(colon + 1)) == "textured");
+				cur->useLighting = false;
+			}
+			continue;
+		}
+		if (cur == nullptr) {
+			continue;
+		}
+
+		size_t eq = line.find('=');
+		if (eq == std::string::npos) {
+			continue;
+		}
+		std::string key = _trim(line.substr(0, eq));
+		std::string value = _trim(line.substr(eq + 1));
+		if (key == "u_diffuseColor") {
+			sscanf(value.c_str(), "%f , %f , %f , %f",
+				&cur->diffuse[0], &cur->diffuse[1], &cur->diffuse[2], &cur->diffuse[3]);
+		}
+		else if (key == "u_specularExponent") {
+			cur->spc_pow = (float)atof(value.c_str());
+		}
+		else if (key == "cullFace") {
+			cur->isDouble = (value == "false");
+		}
+		else if (key == "path") {
+			size_t slash = value.find_last_of("/\\");
+			cur->texture = (slash == std::string::npos) ? value : value.substr(slash + 1);
+		}
+		else if (key == "wrapS") {
+			cur->wrapU = _toWrap(value);
+		}
+		else if (key == "wrapT") {
+			cur->wrapV = _toWrap(value);
+		}
+		else if (key == "defines") {
+			cur->useLighting = (value.find("DIRECTIONAL_LIGHT_COUNT") != std::string::npos);
+		}
+	}
+	fclose(fh);
+
+	return (int)materials.size();
+}
+
+
+void ImportGPBPlugin::addJoint(MQBoneManager& bone_manager,
+	const GPBReader& reader,
+	const std::map<uint32_t, std::string>& nodeNames,
+	const std::vector<float>& worlds,
+	const std::map<std::string, const uint8_t*>& inverseBinds,
+	int nodeIndex,
+	UINT parentID,
+	std::map<int, UINT>& boneIDs)
+{
+	const GPBReadNode& node = reader.nodes[nodeIndex];
+	auto itName = nodeNames.find(node.offset);
+	std::string name = (itName != nodeNames.end()) ? itName->second : std::string();
+
+	MQBoneManager::ADD_BONE_PARAM param;
+	// 逆バインド行列があればそれを優先する. ルートのジョイントは変換行列に位置を持たない
+	auto itBind = inverseBinds.find(name);
+	if (itBind == inverseBinds.end() || !_inverseBindToPosition(itBind->second, param.pos)) {
+		const float* world = &worlds[nodeIndex * 16];
+		param.pos = MQPoint(world[12], world[13], world[14]);
+	}
+	param.name = MString::fromAnsiString(name.c_str()).c_str();
+	param.parent_id = parentID;
+
+	UINT boneID = bone_manager.AddBone(param);
+	boneIDs[nodeIndex] = boneID;
+
+	for (int child : node.children) {
+		if (reader.nodes[child].type != GPBNODE_JOINT) {
+			continue;
+		}
+		addJoint(bone_manager, reader, nodeNames, worlds, inverseBinds,
+			child, boneID, boneIDs);
+	}
+}
+
+
+bool ImportGPBPlugin::addMesh(MQDocument doc,
+	MQBoneManager* bone_manager,
+	const GPBReadMesh& mesh,
+	const std::string& name,
+	const float world[16],
+	const std::vector<UINT>& jointBoneIDs,
+	const std::vector<int>& materialIndices,
+	float progressBegin,
+	float progressEnd)
+{
+	const int vert_num = (int)mesh.getVertexCount();
+	// 大きさの合わない属性は読まない (validate() がエラーにする)
+	const int posAttr = mesh.findAttr(ATTR_POSITION, 3, 3);
+	const int uvAttr = mesh.findAttr(ATTR_TEXCOORD0, 2, UINT32_MAX);
+	const int weightAttr = mesh.findAttr(ATTR_BLENDWEIGHTS, 4, 4);
+	const int indexAttr = mesh.findAttr(ATTR_BLENDINDICES, 4, 4);
+	const bool skinned = (weightAttr >= 0 && indexAttr >= 0 && !jointBoneIDs.empty());
+	if (posAttr < 0) {
+		return true;
+	}
+
+	//// 溶接
+	// エクスポート時に法線と UV で分割された頂点を、位置とウェイトが同じなら一つに戻す.
+	// UV は面側に持つので失われない
+	const int keyStride = skinned ? 11 : 3;
+	std::vector<float> keys((size_t)vert_num * keyStride);
+	for (int v = 0; v < vert_num; ++v) {
+		float* key = &keys[(size_t)v * keyStride];
+		for (int k = 0; k < 3; ++k) {
+			key[k] = mesh.getFloat(v, posAttr + k);
+		}
+		if (skinned) {
+			for (int k = 0; k < 4; ++k) {
+				key[3 + k] = mesh.getFloat(v, weightAttr + k);
+				key[7 + k] = mesh.getFloat(v, indexAttr + k);
+			}
+		}
+	}
+	std::vector<int> order(vert_num);
+	for (int v = 0; v < vert_num; ++v) {
+		order[v] = v;
+	}
+	auto keyLess = [&](int a, int b) {
+		const float* ka = &keys[(size_t)a * keyStride];
+		const float* kb = &keys[(size_t)b * keyStride];
+		return std::lexicographical_compare(ka, ka + keyStride, kb, kb + keyStride);
+	};
+	std::stable_sort(order.begin(), order.end(), keyLess);
+
+	std::vector<int> group(vert_num);
+	int groupNum = 0;
+	for (int i = 0; i < vert_num; ++i) {
+		if (i == 0 || keyLess(order[i - 1], order[i])) {
+			groupNum++;
+		}
+		group[order[i]] = groupNum - 1;
+	}
+	// 元の並び順で番号を振り直す. representatives は溶接後の頂点 -> 元の頂点
+	std::vector<int> groupIndex(groupNum, -1);
+	std::vector<int> representatives;
+	representatives.reserve(groupNum);
+	std::vector<int> remap(vert_num);
+	for (int v = 0; v < vert_num; ++v) {
+		int& gi = groupIndex[group[v]];
+		if (gi < 0) {
+			gi = (int)representatives.size();
+			representatives.push_back(v);
+		}
+		remap[v] = gi;
+	}
+
+	MQObject obj = MQ_CreateObject();
+	obj->SetName(MString::fromAnsiString(name.c_str()).c_str());
+	for (int v : representatives) {
+		MQPoint p(mesh.getFloat(v, posAttr), mesh.getFloat(v, posAttr + 1), mesh.getFloat(v, posAttr + 2));
+		obj->AddVertex(_transformPoint(world, p));
+	}
+
+	//// 面
+	uint32_t totalIndices = 0;
+	for (const auto& part : mesh.parts) {
+		totalIndices += part.getIndexCount();
+	}
+	uint32_t doneIndices = 0;
+	int faceCount = 0;
+	for (size_t pi = 0; pi < mesh.parts.size(); ++pi) {
+		const GPBReadPart& part = mesh.parts[pi];
+		if (part.primitive != GL_TRIANGLE || part.getIndexSize() == 0) {
+			continue;
+		}
+		const int material = (pi < materialIndices.size()) ? materialIndices[pi] : -1;
+		const uint32_t count = part.getIndexCount() / 3 * 3;
+		for (uint32_t i = 0; i < count; i += 3) {
+			// ExportGPB は 0, 2, 1 の順で書いている
+			uint32_t src[3] = { part.getIndex(i), part.getIndex(i + 2), part.getIndex(i + 1) };
+			if (src[0] >= (uint32_t)vert_num || src[1] >= (uint32_t)vert_num || src[2] >= (uint32_t)vert_num) {
+				continue;
+			}
+			int vi[3] = { remap[src[0]], remap[src[1]], remap[src[2]] };
+			if (vi[0] == vi[1] || vi[1] == vi[2] || vi[2] == vi[0]) {
+				continue;
+			}
+			int face = obj->AddFace(3, vi);
+			if (material >= 0) {
+				obj->SetFaceMaterial(face, material);
+			}
+			if (uvAttr >= 0) {
+				MQCoordinate uv[3];
+				for (int k = 0; k < 3; ++k) {
+					uv[k].u = mesh.getFloat(src[k], uvAttr);
+					uv[k].v = 1.0f - mesh.getFloat(src[k], uvAttr + 1);
+				}
+				obj->SetFaceCoordinateArray(face, uv);
+			}
+
+			if (++faceCount % PROGRESS_FACE_INTERVAL == 0) {
+				if (IsCanceled()) {
+					obj->DeleteThis();
+					return false;
+				}
+				float rate = (totalIndices > 0) ? (float)(doneIndices + i) / totalIndices : 1.0f;
+				SetProgress(progressBegin + (progressEnd - progressBegin) * rate);
+			}
+		}
+		doneIndices += part.getIndexCount();
+	}
+
+	obj->SetShading(MQOBJECT_SHADE_GOURAUD);
+	doc->AddObject(obj);
+
+	//// ウェイト
+	if (skinned && bone_manager != nullptr) {
+		// 溶接後の頂点ごとのウェイト表を作って一度に設定する
+		MQBoneManager::VERTEX_WEIGHT_TABLE table;
+		table.offsets.resize(representatives.size() + 1, 0);
+		table.bone_ids.reserve(representatives.size() * 4);
+		table.weights.reserve(representatives.size() * 4);
+		for (size_t i = 0; i < representatives.size(); ++i) {
+			int v = representatives[i];
+			for (int k = 0; k < 4; ++k) {
+				float w = mesh.getFloat(v, weightAttr + k);
+				int joint = (int)mesh.getFloat(v, indexAttr + k);
+				if (w <= 0.0f || joint < 0 || joint >= (int)jointBoneIDs.size()) {
+					continue;
+				}
+				// 名前が解決できなかったジョイントはボーンが無い
+				if (jointBoneIDs[joint] == 0) {
+					continue;
+				}
+				table.bone_ids.push_back(jointBoneIDs[joint]);
+				table.weights.push_back(w);
+			}
+			table.offsets[i + 1] = (int)table.bone_ids.size();
+		}
+		bone_manager->SetVertexWeightTable(obj, table);
+	}
+
+	return true;
+}
+
+
+BOOL ImportGPBPlugin::ImportFile(int index, const wchar_t *filename, MQDocument doc)
+{
+	std::wstring lang = GetSettingValue(MQSETTINGVALUE_LANGUAGE);
+#ifdef _WIN32
+	// DLLフォルダ
+	MString dir = MFileUtil::extractDirectory(s_DllPath);
+#elif __linux__
+	// リソースフォルダが無いのでカレントフォルダ
+	MString dir = MFileUtil::getCurrentDirectory();
+#else
+	MString dir = GetResourceDir();
+#endif
+	MString path = MFileUtil::combinePath(dir, L"ImportGPB.resource.xml");
+	MLanguage language;
+	language.Load(lang, path.c_str());
+	// リソースが見つからなくても空のタイトルにはしない
+	std::wstring errorTitle = language.Search("Error");
+	if (errorTitle.empty()) {
+		errorTitle = L"Error";
+	}
+
+	GPBReader reader;
+#ifdef _WIN32
+	bool opened = reader.open(filename);
+#else
+	bool opened = reader.open(MString(filename).toUtf8String().c_str());
+#endif
+	if (!opened) {
+		if (!IsBackground()) {
+			MQWindow mainwin = MQWindow::GetMainWindow();
+			MString message = MString(language.Search("ReadFailed"))
+				+ L"\n"
+				+ MString::fromAnsiString(reader.getError().c_str())
+				+ L"\n"
+				+ filename;
+			MQDialog::MessageWarningBox(mainwin,
+				message.c_str(),
+				errorTitle);
+		}
+		return FALSE;
+	}
+
+	// 検証で問題があっても、デバッグのために読める範囲は読み込む
+	GPBValidationReport report;
+	if (reader.validate(report) > 0 && !IsBackground()) {
+		MString message = MString(language.Search("ValidationFailed")) + L"\n" + filename + L"\n";
+		int lines = 0;
+		for (const auto& e : report.errors) {
+			if (++lines > REPORT_LINE_MAX) {
+				message += MString::format(L"... (%d errors)\n", (int)report.errors.size());
+				break;
+			}
+			message += MString::fromAnsiString(e.c_str()) + L"\n";
+		}
+		MQWindow mainwin = MQWindow::GetMainWindow();
+		MQDialog::MessageWarningBox(mainwin,
+			message.c_str(),
+			errorTitle);
+	}
+	SetProgress(0.05f);
+
+	//// 名前
+	std::map<uint32_t, std::string> nodeNames;
+	for (const auto& ref : reader.refs) {
+		if (ref.type == REF_NODE) {
+			nodeNames[ref.offset] = ref.name;
+		}
+	}
+	std::map<std::string, int> nodeByName;
+	for (size_t i = 0; i < reader.nodes.size(); ++i) {
+		auto it = nodeNames.find(reader.nodes[i].offset);
+		if (it != nodeNames.end()) {
+			nodeByName[it->second] = (int)i;
+		}
+	}
+
+	// 親は子より前に並んでいるので一回で求まる
+	std::vector<float> worlds(reader.nodes.size() * 16);
+	for (size_t i = 0; i < reader.nodes.size(); ++i) {
+		const GPBReadNode& node = reader.nodes[i];
+		if (node.parent < 0) {
+			memcpy(&worlds[i * 16], node.transform, sizeof(node.transform));
+		}
+		else {
+			_mulMatrix(node.transform, &worlds[node.parent * 16], &worlds[i * 16]);
+		}
+	}
+
+	//// 材質
+	std::map<std::string, GPBImportMaterial> materialSettings;
+	loadMaterialFile(MFileUtil::changeExtension(filename, L".material"), materialSettings);
+
+	std::map<std::string, int> materialIndices;
+	for (const auto& node : reader.nodes) {
+		for (const auto& name : node.materialNames) {
+			if (materialIndices.find(name) != materialIndices.end()) {
+				continue;
+			}
+			MQMaterial mat = MQ_CreateMaterial();
+			mat->SetName(MString::fromAnsiString(name.c_str()).c_str());
+			auto it = materialSettings.find(name);
+			if (it != materialSettings.end()) {
+				const GPBImportMaterial& setting = it->second;
+				mat->SetColor(MQColor(setting.diffuse[0], setting.diffuse[1], setting.diffuse[2]));
+				mat->SetAlpha(setting.diffuse[3]);
+				mat->SetPower(setting.spc_pow);
+				mat->SetDoubleSided(setting.isDouble ? TRUE : FALSE);
+				mat->SetShader(setting.useLighting ? MQMATERIAL_SHADER_PHONG : MQMATERIAL_SHADER_CONSTANT);
+				if (setting.useTexture && !setting.texture.empty()) {
+					mat->SetTextureName(MString::fromAnsiString(setting.texture.c_str()).c_str());
+					mat->SetWrapModeU(setting.wrapU);
+					mat->SetWrapModeV(setting.wrapV);
+				}
+			}
+			materialIndices[name] = doc->AddMaterial(mat);
+		}
+	}
+	SetProgress(0.1f);
+
+	//// ボーン
+	bool hasJoint = false;
+	for (const auto& node : reader.nodes) {
+		if (node.type == GPBNODE_JOINT) {
+			hasJoint = true;
+			break;
+		}
+	}
+	MQBoneManager bone_manager(this, doc);
+	const bool useBone = hasJoint && bone_manager.Verified();
+	std::map<int, UINT> boneIDs;
+	if (useBone) {
+		bone_manager.BeginImport();
+
+		// ジョイント名 -> 逆バインド行列. 最初に見つかったスキンのものを使う
+		std::map<std::string, const uint8_t*> inverseBinds;
+		for (const auto& node : reader.nodes) {
+			if (!node.hasSkin || node.inverseBindNum != node.jointNames.size() * 16) {
+				continue;
+			}
+			for (size_t j = 0; j < node.jointNames.size(); ++j) {
+				const std::string& jointName = node.jointNames[j];
+				if (jointName.size() > 1 && jointName[0] == '#') {
+					inverseBinds.insert(std::make_pair(jointName.substr(1), node.inverseBind + j * 16 * 4));
+				}
+			}
+		}
+
+		for (size_t i = 0; i < reader.nodes.size(); ++i) {
+			const GPBReadNode& node = reader.nodes[i];
+			if (node.type != GPBNODE_JOINT) {
+				continue;
+			}
+			if (node.parent >= 0 && reader.nodes[node.parent].type == GPBNODE_JOINT) {
+				continue;
+			}
+			addJoint(bone_manager, reader, nodeNames, worlds, inverseBinds,
+				(int)i, 0, boneIDs);
+		}
+	}
+	SetProgress(0.15f);
+
+	//// メッシュ
+	int meshNodeNum = 0;
+	for (const auto& node : reader.nodes) {
+		if (!node.meshName.empty()) {
+			meshNodeNum++;
+		}
+	}
+	int meshNodeCount = 0;
+	BOOL result = TRUE;
+	for (size_t i = 0; i < reader.nodes.size(); ++i) {
+		const GPBReadNode& node = reader.nodes[i];
+		if (node.meshName.empty()) {
+			continue;
+		}
+		int meshIndex = -1;
+		if (node.meshName[0] == '#') {
+			const GPBReadRef* ref = reader.findRef(node.meshName.substr(1), REF_MESH);
+			if (ref != nullptr) {
+				meshIndex = reader.findMeshByOffset(ref->offset);
+			}
+		}
+		if (meshIndex < 0) {
+			continue;
+		}
+
+		std::vector<UINT> jointBoneIDs;
+		if (useBone && node.hasSkin) {
+			for (const auto& jointName : node.jointNames) {
+				UINT boneID = 0;
+				auto it = (jointName.size() > 1 && jointName[0] == '#') ? nodeByName.find(jointName.substr(1)) : nodeByName.end();
+				if (it != nodeByName.end() && boneIDs.find(it->second) != boneIDs.end()) {
+					boneID = boneIDs[it->second];
+				}
+				jointBoneIDs.push_back(boneID);
+			}
+		}
+
+		std::vector<int> partMaterials;
+		for (const auto& name : node.materialNames) {
+			partMaterials.push_back(materialIndices[name]);
+		}
+
+		std::string objName;
+		auto itName = nodeNames.find(node.offset);
+		if (itName != nodeNames.end()) {
+			objName = itName->second;
+		}
+		else {
+			objName = MFileUtil::extractFileNameOnly(filename).toAnsiString().c_str();
+		}
+
+		float begin = 0.15f + 0.85f * meshNodeCount / meshNodeNum;
+		float end = 0.15f + 0.85f * (meshNodeCount + 1) / meshNodeNum;
+		meshNodeCount++;
+		if (!addMesh(doc, useBone ? &bone_manager : nullptr,
+			reader.meshes[meshIndex], objName, &worlds[i * 16],
+			jointBoneIDs, partMaterials, begin, end)) {
+			result = FALSE;
+			break;
+		}
+	}
+
+	if (useBone) {
+		bone_manager.EndImport();
+	}
+	SetProgress(1.0f);
+
+	return result;
+}
+
+
+//---------------------------------------------------------------------------
+//  GetPluginClass
+//    プラグインのベースクラスを返す.
+//    Linux のテストではエクスポーターと一緒にリンクするので定義しない
+//---------------------------------------------------------------------------
+#ifndef IMPORTGPB_NO_PLUGIN_CLASS
+MQBasePlugin *GetPluginClass()
+{
+	static ImportGPBPlugin plugin;
+	return &plugin;
+}
+#endif
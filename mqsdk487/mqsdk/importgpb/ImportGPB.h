@@ -0,0 +1,137 @@
+﻿//---------------------------------------------------------------------------
+// ExportGPB が書き出した .gpb を読み込むプラグイン
+//    　作成したDLLは"Plugins\Import"フォルダに入れる必要がある。
+// https://github.com/gameplay3d/gameplay/blob/master/gameplay/src/Bundle.cpp
+//---------------------------------------------------------------------------
+
+#define MY_PRODUCT (0xB2B2501D)
+#define MY_ID (0x5A1C7E42)
+#define MY_PLUGINNAME "Import GPB Copyright(C) 2024, hta393939"
+#define MY_FILETYPE "HSP GPB(*.gpb)"
+#define MY_EXT "gpb"
+
+#define IDENVER "0.1.0"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+#if __APPLE__
+#include <CoreFoundation/CFBundle.h>
+#define _MAX_PATH PATH_MAX
+#endif
+#include "MQPlugin.h"
+#include "MQWidget.h"
+#include "MQBasePlugin.h"
+#include "MQBoneManager.h"
+#include <vector>
+#include <map>
+#include <string>
+#include "MString.h"
+#include "MFileUtil.h"
+#include "Language.h"
+#include "GPBReader.h"
+
+
+/// <summary>
+/// .material から読み取った材質一つ分
+/// </summary>
+struct GPBImportMaterial {
+	std::string name;
+	bool useTexture;
+	// テクスチャのファイル名. フォルダは除く
+	std::string texture;
+	int wrapU;
+	int wrapV;
+	float diffuse[4];
+	float spc_pow;
+	bool isDouble;
+	bool useLighting;
+
+	GPBImportMaterial() {
+		useTexture = false;
+		wrapU = MQMATERIAL_WRAP_REPEAT;
+		wrapV = MQMATERIAL_WRAP_REPEAT;
+		diffuse[0] = 1.0f;
+		diffuse[1] = 1.0f;
+		diffuse[2] = 1.0f;
+		diffuse[3] = 1.0f;
+		spc_pow = 5.0f;
+		isDouble = false;
+		useLighting = true;
+	}
+};
+
+
+class ImportGPBPlugin : public MQImportPlugin
+{
+public:
+	ImportGPBPlugin();
+	~ImportGPBPlugin();
+
+	// Get a plug-in ID
+	// プラグインIDを返す。
+	void GetPlugInID(DWORD *Product, DWORD *ID) override;
+
+	// Get a plug-in name
+	// プラグイン名を返す。
+	const char *GetPlugInName(void) override;
+
+	// Get a file type for importing
+	// 入力出力可能なファイルタイプを返す。
+	const char *EnumFileType(int index) override;
+
+	// Get a file extension for importing
+	// 入力可能な拡張子を返す。
+	const char *EnumFileExt(int index) override;
+
+	// Import a file
+	// ファイルの読み込み
+	BOOL ImportFile(int index, const wchar_t *filename, MQDocument doc) override;
+
+	// Get whether a background loading can be processed or not.
+	// バックグラウンド読み込みが可能かどうかを返す。
+	BOOL SupportBackground(void) override { return TRUE; }
+
+private:
+	/// <summary>
+	/// 同じフォルダの .material を読む. 無ければ空
+	/// </summary>
+	/// <param name="path">.material のパス</param>
+	/// <returns>読めた材質数</returns>
+	int loadMaterialFile(const MString& path,
+		std::map<std::string, GPBImportMaterial>& materials);
+
+	/// <summary>
+	/// ジョイントノードをボーンとして追加する. 子も再帰で追加する
+	/// </summary>
+	/// <param name="worlds">ノードごとのワールド行列 (16 float ずつ)</param>
+	/// <param name="inverseBinds">ジョイント名から逆バインド行列へ</param>
+	/// <param name="nodeIndex">reader.nodes のインデックス</param>
+	/// <param name="parentID">親ボーンID. ルートは 0</param>
+	/// <param name="boneIDs">ノードインデックスからボーンIDへ</param>
+	void addJoint(MQBoneManager& bone_manager,
+		const GPBReader& reader,
+		const std::map<uint32_t, std::string>& nodeNames,
+		const std::vector<float>& worlds,
+		const std::map<std::string, const uint8_t*>& inverseBinds,
+		int nodeIndex,
+		UINT parentID,
+		std::map<int, UINT>& boneIDs);
+
+	/// <summary>
+	/// メッシュを一つのオブジェクトとして追加する
+	/// </summary>
+	/// <param name="jointBoneIDs">スキンのジョイント順のボーンID</param>
+	/// <param name="materialIndices">パーツ順の材質インデックス</param>
+	/// <returns>キャンセルされたら false</returns>
+	bool addMesh(MQDocument doc,
+		MQBoneManager* bone_manager,
+		const GPBReadMesh& mesh,
+		const std::string& name,
+		const float world[16],
+		const std::vector<UINT>& jointBoneIDs,
+		const std::vector<int>& materialIndices,
+		float progressBegin,
+		float progressEnd);
+};
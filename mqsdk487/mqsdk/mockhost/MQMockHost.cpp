@@ -0,0 +1,1835 @@
+﻿//---------------------------------------------------------------------------
+//
+//   MQMockHost.cpp
+//
+//     Implementation of the in-memory host. See MQMockHost.h.
+//    　模擬ホストの実装。MQMockHost.hを参照。
+//
+//---------------------------------------------------------------------------
+
+#include "MQMockHost.h"
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cwchar>
+
+
+//---------------------------------------------------------------------------
+//  In-memory data
+//---------------------------------------------------------------------------
+
+struct MockFace
+{
+	std::vector<int> points;
+	std::vector<MQCoordinate> uv;
+	std::vector<DWORD> colors;
+	std::vector<BYTE> normalFlags;
+	std::vector<MQPoint> normals;
+	std::vector<float> creases;
+	int material;
+	UINT uniqueID;
+	BOOL visible;
+
+	void resize(int count){
+		points.resize(count);
+		uv.resize(count, MQCoordinate(0,0));
+		colors.resize(count, 0xFFFFFFFF);
+		normalFlags.resize(count, 0);
+		normals.resize(count, MQPoint(0,0,0));
+		creases.resize(count, 0.0f);
+	}
+	void clear(){
+		points.clear();
+		uv.clear();
+		colors.clear();
+		normalFlags.clear();
+		normals.clear();
+		creases.clear();
+	}
+};
+
+struct MockDocument;
+
+struct MockObject
+{
+	MockDocument *doc;
+	std::wstring name;
+	UINT uniqueID;
+
+	std::vector<MQPoint> vertices;
+	std::vector<UINT> vertexIDs;
+	std::vector<float> vertexWeights;
+	std::vector<char> vertexDeleted;
+	UINT nextVertexID;
+
+	std::vector<MockFace> faces;
+	UINT nextFaceID;
+
+	// Vertex-to-face table. Rebuilt when the topology is changed.
+	// 頂点から面への参照表。形状が変わると作り直す。
+	bool relationDirty;
+	std::vector<int> relationStart;
+	std::vector<int> relationFaces;
+
+	int depth;
+	int folding;
+	int locking;
+	int type;
+	int selected;
+	int colorValid;
+	float color[3];
+	DWORD visible;
+	DWORD patchType;
+	int patchSegment;
+	int patchTriangle;
+	int patchSmoothTriangle;
+	int patchMeshInterp;
+	int patchUVInterp;
+	int patchLimitSurface;
+	int shading;
+	float smoothAngle;
+	int mirrorType;
+	DWORD mirrorAxis;
+	float mirrorDistance;
+	int latheType;
+	DWORD latheAxis;
+	int latheSegment;
+	MQPoint scaling;
+	MQAngle rotation;
+	MQPoint translation;
+	float lightValue;
+	int lightAttenuation;
+	float lightFallOffEnd;
+	float lightFallOffHalf;
+
+	MockObject(){
+		doc = NULL;
+		uniqueID = 0;
+		nextVertexID = 1;
+		nextFaceID = 1;
+		relationDirty = true;
+		depth = 0;
+		folding = 0;
+		locking = 0;
+		type = 0;
+		selected = 0;
+		colorValid = 0;
+		color[0] = color[1] = color[2] = 1.0f;
+		visible = 0xFFFFFFFF;
+		patchType = MQOBJECT_PATCH_NONE;
+		patchSegment = 1;
+		patchTriangle = 0;
+		patchSmoothTriangle = 0;
+		patchMeshInterp = 0;
+		patchUVInterp = 0;
+		patchLimitSurface = 0;
+		shading = MQOBJECT_SHADE_GOURAUD;
+		smoothAngle = 59.5f;
+		mirrorType = MQOBJECT_MIRROR_NONE;
+		mirrorAxis = MQOBJECT_MIRROR_AXIS_X;
+		mirrorDistance = 0.0f;
+		latheType = MQOBJECT_LATHE_NONE;
+		latheAxis = MQOBJECT_LATHE_X;
+		latheSegment = 12;
+		scaling = MQPoint(1,1,1);
+		rotation = MQAngle(0,0,0);
+		translation = MQPoint(0,0,0);
+		lightValue = 1.0f;
+		lightAttenuation = 0;
+		lightFallOffEnd = 0.0f;
+		lightFallOffHalf = 0.0f;
+	}
+};
+
+struct MockMaterial
+{
+	MockDocument *doc;
+	std::wstring name;
+	UINT uniqueID;
+	int shader;
+	int vertexColor;
+	int doubleSided;
+	int selected;
+	MQColor color;
+	float alpha;
+	float diffuse;
+	float ambient;
+	float emission;
+	float specular;
+	float power;
+	float reflection;
+	float refraction;
+	MQColor ambientColor;
+	MQColor specularColor;
+	MQColor emissionColor;
+	int mapProj;
+	float mapProjPosition[3];
+	float mapProjScaling[3];
+	float mapProjAngle[3];
+	int wrapU;
+	int wrapV;
+	int mapFilter;
+	bool mapTransformValid;
+	float mapTransform[5];
+	std::wstring textureName;
+	std::wstring alphaName;
+	std::wstring bumpName;
+	UINT textureUVChannel;
+	UINT alphaUVChannel;
+	UINT bumpUVChannel;
+
+	MockMaterial(){
+		doc = NULL;
+		uniqueID = 0;
+		shader = MQMATERIAL_SHADER_PHONG;
+		vertexColor = MQMATERIAL_VERTEXCOLOR_DISABLE;
+		doubleSided = 0;
+		selected = 0;
+		color = MQColor(1,1,1);
+		alpha = 1.0f;
+		diffuse = 0.8f;
+		ambient = 0.6f;
+		emission = 0.0f;
+		specular = 0.0f;
+		power = 5.0f;
+		reflection = 0.0f;
+		refraction = 1.0f;
+		ambientColor = MQColor(1,1,1);
+		specularColor = MQColor(1,1,1);
+		emissionColor = MQColor(1,1,1);
+		mapProj = MQMATERIAL_PROJECTION_UV;
+		for(int i=0; i<3; i++){
+			mapProjPosition[i] = 0.0f;
+			mapProjScaling[i] = 1.0f;
+			mapProjAngle[i] = 0.0f;
+		}
+		wrapU = MQMATERIAL_WRAP_REPEAT;
+		wrapV = MQMATERIAL_WRAP_REPEAT;
+		mapFilter = MQMATERIAL_FILTER_LINEAR;
+		mapTransformValid = false;
+		mapTransform[0] = mapTransform[1] = 1.0f;
+		mapTransform[2] = mapTransform[3] = mapTransform[4] = 0.0f;
+		textureUVChannel = 0;
+		alphaUVChannel = 0;
+		bumpUVChannel = 0;
+	}
+};
+
+// An image returned by MQDoc_GetMappingImage(), stored as a bottom-up DIB.
+// MQDoc_GetMappingImage()が返す画像。下の行から並ぶDIBとして保持する。
+struct MockImage
+{
+	int width;
+	int height;
+	int bpp;
+	std::vector<BYTE> buffer;
+	std::vector<RGBQUAD> colors;
+};
+
+struct MockDocument
+{
+	// A deleted slot is kept as NULL, as the host does until Compact().
+	// 削除した位置はホストと同様にCompact()までNULLとして残す。
+	std::vector<MockObject*> objects;
+	std::vector<MockMaterial*> materials;
+	std::map<std::pair<DWORD, std::wstring>, MockImage> images;
+	int currentObject;
+	int currentMaterial;
+	UINT nextObjectID;
+	UINT nextMaterialID;
+
+	MockDocument(){
+		currentObject = 0;
+		currentMaterial = 0;
+		nextObjectID = 1;
+		nextMaterialID = 1;
+	}
+};
+
+static MQMockHost::MessageHandler s_MessageHandler = NULL;
+
+inline static MockDocument *toDoc(MQDocument doc) { return reinterpret_cast<MockDocument*>(doc); }
+inline static MockObject *toObj(MQObject obj) { return reinterpret_cast<MockObject*>(obj); }
+inline static MockMaterial *toMat(MQMaterial mat) { return reinterpret_cast<MockMaterial*>(mat); }
+inline static MQDocument fromDoc(MockDocument *doc) { return reinterpret_cast<MQDocument>(doc); }
+inline static MQObject fromObj(MockObject *obj) { return reinterpret_cast<MQObject>(obj); }
+inline static MQMaterial fromMat(MockMaterial *mat) { return reinterpret_cast<MQMaterial>(mat); }
+
+inline static bool isValidVertex(MockObject *o, int index) { return index >= 0 && index < (int)o->vertices.size(); }
+inline static bool isValidFace(MockObject *o, int index) { return index >= 0 && index < (int)o->faces.size(); }
+inline static bool isValidApex(MockObject *o, int face, int apex) { return isValidFace(o, face) && apex >= 0 && apex < (int)o->faces[face].points.size(); }
+
+
+//---------------------------------------------------------------------------
+//  Helpers
+//---------------------------------------------------------------------------
+
+// Copy a string to a buffer in the manner of the host: return the length
+// and write nothing if the buffer is NULL.
+// ホストと同様に文字列をバッファにコピーし長さを返す。バッファがNULLなら書き込まない。
+template<typename C> static int copyString(const std::basic_string<C>& src, C *buffer, int size)
+{
+	if(buffer != NULL && size > 0){
+		int n = std::min((int)src.length(), size - 1);
+		std::copy(src.begin(), src.begin() + n, buffer);
+		buffer[n] = 0;
+	}
+	return (int)src.length();
+}
+
+// Find a value by a key in a NULL-terminated "key, value, ..." array.
+// NULL終端の「キー, 値, ...」配列からキーで値を探す。
+static void *findArg(void **args, const char *key)
+{
+	if(args == NULL) return NULL;
+	for(int i=0; args[i] != NULL; i+=2){
+		if(strcmp((const char*)args[i], key) == 0)
+			return args[i+1];
+	}
+	return NULL;
+}
+
+static void buildRelation(MockObject *o)
+{
+	if(!o->relationDirty) return;
+
+	size_t vc = o->vertices.size();
+	o->relationStart.assign(vc + 1, 0);
+	for(auto& f : o->faces){
+		for(int v : f.points){
+			if(v >= 0 && v < (int)vc) o->relationStart[v+1]++;
+		}
+	}
+	for(size_t i=0; i<vc; i++){
+		o->relationStart[i+1] += o->relationStart[i];
+	}
+	o->relationFaces.resize(o->relationStart[vc]);
+	std::vector<int> pos(o->relationStart.begin(), o->relationStart.end() - 1);
+	for(size_t fi=0; fi<o->faces.size(); fi++){
+		for(int v : o->faces[fi].points){
+			if(v >= 0 && v < (int)vc) o->relationFaces[pos[v]++] = (int)fi;
+		}
+	}
+	o->relationDirty = false;
+}
+
+static MQPoint faceNormal(MockObject *o, const MockFace& f)
+{
+	// Newell's method
+	MQPoint n(0,0,0);
+	size_t count = f.points.size();
+	for(size_t i=0; i<count; i++){
+		const MQPoint& a = o->vertices[f.points[i]];
+		const MQPoint& b = o->vertices[f.points[(i+1) % count]];
+		n.x += (a.y - b.y) * (a.z + b.z);
+		n.y += (a.z - b.z) * (a.x + b.x);
+		n.z += (a.x - b.x) * (a.y + b.y);
+	}
+	float len = n.abs();
+	if(len > 0.0f) n /= len;
+	return n;
+}
+
+// Rotation in the order of bank(Z), pitch(X), head(Y) for row vectors.
+// 行ベクトルに対してバンク(Z)、ピッチ(X)、ヘディング(Y)の順に回転する。
+static void angleToRotation(float head, float pitch, float bank, float r[3][3])
+{
+	const float d2r = (float)(3.14159265358979323846 / 180.0);
+	float ch = cosf(head * d2r), sh = sinf(head * d2r);
+	float cp = cosf(pitch * d2r), sp = sinf(pitch * d2r);
+	float cb = cosf(bank * d2r), sb = sinf(bank * d2r);
+	r[0][0] = cb*ch + sb*sp*sh;  r[0][1] = sb*cp;  r[0][2] = -cb*sh + sb*sp*ch;
+	r[1][0] = -sb*ch + cb*sp*sh; r[1][1] = cb*cp;  r[1][2] = sb*sh + cb*sp*ch;
+	r[2][0] = cp*sh;             r[2][1] = -sp;    r[2][2] = cp*ch;
+}
+
+static void rotationToAngle(const float r[3][3], float& head, float& pitch, float& bank)
+{
+	const float r2d = (float)(180.0 / 3.14159265358979323846);
+	float sp = std::max(-1.0f, std::min(1.0f, -r[2][1]));
+	pitch = asinf(sp) * r2d;
+	head = atan2f(r[2][0], r[2][2]) * r2d;
+	bank = atan2f(r[0][1], r[1][1]) * r2d;
+}
+
+static void composeMatrix(const float *val, float *mtx)
+{
+	float r[3][3];
+	angleToRotation(val[3], val[4], val[5], r);
+	for(int i=0; i<3; i++){
+		for(int j=0; j<3; j++){
+			mtx[i*4+j] = val[i] * r[i][j];
+		}
+		mtx[i*4+3] = 0.0f;
+	}
+	mtx[12] = val[6];
+	mtx[13] = val[7];
+	mtx[14] = val[8];
+	mtx[15] = 1.0f;
+}
+
+static void decomposeMatrix(const float *mtx, float *scaling, float *angle, float *trans)
+{
+	float s[3], r[3][3];
+	for(int i=0; i<3; i++){
+		s[i] = sqrtf(mtx[i*4+0]*mtx[i*4+0] + mtx[i*4+1]*mtx[i*4+1] + mtx[i*4+2]*mtx[i*4+2]);
+		for(int j=0; j<3; j++){
+			r[i][j] = (s[i] != 0.0f) ? mtx[i*4+j] / s[i] : 0.0f;
+		}
+	}
+	if(scaling != NULL){
+		scaling[0] = s[0]; scaling[1] = s[1]; scaling[2] = s[2];
+	}
+	if(angle != NULL){
+		rotationToAngle(r, angle[0], angle[1], angle[2]);
+	}
+	if(trans != NULL){
+		trans[0] = mtx[12]; trans[1] = mtx[13]; trans[2] = mtx[14];
+	}
+}
+
+static void multiplyMatrix(const float *a, const float *b, float *out)
+{
+	float tmp[16];
+	for(int i=0; i<4; i++){
+		for(int j=0; j<4; j++){
+			tmp[i*4+j] = a[i*4+0]*b[0*4+j] + a[i*4+1]*b[1*4+j] + a[i*4+2]*b[2*4+j] + a[i*4+3]*b[3*4+j];
+		}
+	}
+	memcpy(out, tmp, sizeof(tmp));
+}
+
+static void inverseMatrix(const float *m, float *out)
+{
+	// Affine inverse: the upper 3x3 by cofactors, then the translation.
+	// アフィン逆行列。3x3部分を余因子で求め、次に平行移動を求める。
+	float a = m[0], b = m[1], c = m[2];
+	float d = m[4], e = m[5], f = m[6];
+	float g = m[8], h = m[9], i = m[10];
+	float det = a*(e*i - f*h) - b*(d*i - f*g) + c*(d*h - e*g);
+	float inv[16] = {1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1};
+	if(det != 0.0f){
+		float id = 1.0f / det;
+		inv[0] = (e*i - f*h) * id; inv[1] = (c*h - b*i) * id; inv[2] = (b*f - c*e) * id;
+		inv[4] = (f*g - d*i) * id; inv[5] = (a*i - c*g) * id; inv[6] = (c*d - a*f) * id;
+		inv[8] = (d*h - e*g) * id; inv[9] = (b*g - a*h) * id; inv[10] = (a*e - b*d) * id;
+	}
+	for(int j=0; j<3; j++){
+		inv[12+j] = -(m[12]*inv[0*4+j] + m[13]*inv[1*4+j] + m[14]*inv[2*4+j]);
+	}
+	memcpy(out, inv, sizeof(inv));
+}
+
+static void objectLocalMatrix(MockObject *o, float *mtx)
+{
+	float val[9] = {o->scaling.x, o->scaling.y, o->scaling.z,
+		o->rotation.head, o->rotation.pitch, o->rotation.bank,
+		o->translation.x, o->translation.y, o->translation.z};
+	composeMatrix(val, mtx);
+}
+
+static MockObject *cloneObject(MockObject *src)
+{
+	MockObject *o = new MockObject(*src);
+	o->doc = NULL;
+	o->uniqueID = 0;
+	return o;
+}
+
+// Remove deleted vertices and faces and renumber the rest.
+// 削除された頂点と面を取り除き、残りを詰める。
+static void compactObject(MockObject *o)
+{
+	std::vector<int> remap(o->vertices.size(), -1);
+	size_t n = 0;
+	for(size_t i=0; i<o->vertices.size(); i++){
+		if(o->vertexDeleted[i]) continue;
+		remap[i] = (int)n;
+		o->vertices[n] = o->vertices[i];
+		o->vertexIDs[n] = o->vertexIDs[i];
+		o->vertexWeights[n] = o->vertexWeights[i];
+		o->vertexDeleted[n] = 0;
+		n++;
+	}
+	o->vertices.resize(n);
+	o->vertexIDs.resize(n);
+	o->vertexWeights.resize(n);
+	o->vertexDeleted.resize(n);
+
+	size_t fn = 0;
+	for(size_t i=0; i<o->faces.size(); i++){
+		if(o->faces[i].points.empty()) continue;
+		if(fn != i) o->faces[fn] = std::move(o->faces[i]);
+		for(int& v : o->faces[fn].points) v = remap[v];
+		fn++;
+	}
+	o->faces.resize(fn);
+	o->relationDirty = true;
+}
+
+static void deleteUnreferencedVertices(MockObject *o, const std::vector<int>& candidates)
+{
+	buildRelation(o);
+	for(int v : candidates){
+		if(!isValidVertex(o, v) || o->vertexDeleted[v]) continue;
+		bool used = false;
+		for(int k=o->relationStart[v]; k<o->relationStart[v+1]; k++){
+			if(!o->faces[o->relationFaces[k]].points.empty()){
+				used = true;
+				break;
+			}
+		}
+		if(!used) o->vertexDeleted[v] = 1;
+	}
+}
+
+// Ear clipping on the plane of the polygon.
+// 多角形の平面上で耳刈り取りを行う。
+static bool triangulatePolygon(const MQPoint *points, int num, int *index_array)
+{
+	MQPoint n(0,0,0);
+	for(int i=0; i<num; i++){
+		const MQPoint& a = points[i];
+		const MQPoint& b = points[(i+1) % num];
+		n.x += (a.y - b.y) * (a.z + b.z);
+		n.y += (a.z - b.z) * (a.x + b.x);
+		n.z += (a.x - b.x) * (a.y + b.y);
+	}
+	// Project onto the axis plane that has the largest area.
+	// 面積が最大となる軸平面に投影する。
+	int ax = 0, ay = 1;
+	float sign;
+	if(fabsf(n.x) >= fabsf(n.y) && fabsf(n.x) >= fabsf(n.z)){ ax = 1; ay = 2; sign = n.x; }
+	else if(fabsf(n.y) >= fabsf(n.z)){ ax = 2; ay = 0; sign = n.y; }
+	else { sign = n.z; }
+	auto coord = [&](int i, int axis) -> float {
+		return (axis == 0) ? points[i].x : (axis == 1) ? points[i].y : points[i].z;
+	};
+	auto cross = [&](int a, int b, int c) -> float {
+		float v = (coord(b,ax) - coord(a,ax)) * (coord(c,ay) - coord(a,ay))
+			- (coord(b,ay) - coord(a,ay)) * (coord(c,ax) - coord(a,ax));
+		return (sign >= 0.0f) ? v : -v;
+	};
+
+	std::vector<int> poly(num);
+	for(int i=0; i<num; i++) poly[i] = i;
+	int out = 0;
+	int guard = 0;
+	while(poly.size() > 3 && guard < num * num){
+		int m = (int)poly.size();
+		bool clipped = false;
+		for(int i=0; i<m; i++){
+			int a = poly[(i+m-1) % m], b = poly[i], c = poly[(i+1) % m];
+			if(cross(a, b, c) <= 0.0f) continue; // reflex
+			bool inside = false;
+			for(int k=0; k<m && !inside; k++){
+				int p = poly[k];
+				if(p == a || p == b || p == c) continue;
+				if(cross(a, b, p) >= 0.0f && cross(b, c, p) >= 0.0f && cross(c, a, p) >= 0.0f)
+					inside = true;
+			}
+			if(inside) continue;
+			index_array[out++] = a;
+			index_array[out++] = b;
+			index_array[out++] = c;
+			poly.erase(poly.begin() + i);
+			clipped = true;
+			break;
+		}
+		if(!clipped){
+			// Degenerate polygon. Fall back to a fan.
+			// 縮退した多角形。扇形分割にする。
+			for(size_t i=1; i+1<poly.size(); i++){
+				index_array[out++] = poly[0];
+				index_array[out++] = poly[i];
+				index_array[out++] = poly[i+1];
+			}
+			return true;
+		}
+		guard++;
+	}
+	if(poly.size() == 3){
+		index_array[out++] = poly[0];
+		index_array[out++] = poly[1];
+		index_array[out++] = poly[2];
+	}
+	return true;
+}
+
+
+//---------------------------------------------------------------------------
+//  Global functions
+//---------------------------------------------------------------------------
+
+static MQObject MQAPICALL mock_CreateObject(void)
+{
+	return fromObj(new MockObject());
+}
+
+static MQMaterial MQAPICALL mock_CreateMaterial(void)
+{
+	return fromMat(new MockMaterial());
+}
+
+static BOOL MQAPICALL mock_GetSystemPath(char *buffer, int type)
+{
+	return FALSE;
+}
+
+static BOOL MQAPICALL mock_GetSystemPathW(wchar_t *buffer, int type)
+{
+	return FALSE;
+}
+
+static void MQAPICALL mock_RefreshView(void *reserved)
+{
+}
+
+static BOOL MQAPICALL mock_SendMessage(int message_type, MQSendMessageInfo *info)
+{
+	if(s_MessageHandler != NULL)
+		return s_MessageHandler(message_type, info);
+	return FALSE;
+}
+
+
+//---------------------------------------------------------------------------
+//  Document
+//---------------------------------------------------------------------------
+
+static int MQAPICALL mock_Doc_GetObjectCount(MQDocument doc)
+{
+	return (int)toDoc(doc)->objects.size();
+}
+
+static MQObject MQAPICALL mock_Doc_GetObject(MQDocument doc, int index)
+{
+	MockDocument *d = toDoc(doc);
+	if(index < 0 || index >= (int)d->objects.size()) return NULL;
+	return fromObj(d->objects[index]);
+}
+
+static MQObject MQAPICALL mock_Doc_GetObjectFromUniqueID(MQDocument doc, int id)
+{
+	for(MockObject *o : toDoc(doc)->objects){
+		if(o != NULL && o->uniqueID == (UINT)id) return fromObj(o);
+	}
+	return NULL;
+}
+
+static int MQAPICALL mock_Doc_GetCurrentObjectIndex(MQDocument doc)
+{
+	return toDoc(doc)->currentObject;
+}
+
+static void MQAPICALL mock_Doc_SetCurrentObjectIndex(MQDocument doc, int index)
+{
+	toDoc(doc)->currentObject = index;
+}
+
+static int MQAPICALL mock_Doc_AddObject(MQDocument doc, MQObject obj)
+{
+	MockDocument *d = toDoc(doc);
+	MockObject *o = toObj(obj);
+	o->doc = d;
+	o->uniqueID = d->nextObjectID++;
+	d->objects.push_back(o);
+	return (int)d->objects.size() - 1;
+}
+
+static void MQAPICALL mock_Doc_DeleteObject(MQDocument doc, int index)
+{
+	MockDocument *d = toDoc(doc);
+	if(index < 0 || index >= (int)d->objects.size()) return;
+	delete d->objects[index];
+	d->objects[index] = NULL;
+}
+
+static int MQAPICALL mock_Doc_GetObjectIndex(MQDocument doc, MQObject obj)
+{
+	MockDocument *d = toDoc(doc);
+	for(size_t i=0; i<d->objects.size(); i++){
+		if(d->objects[i] == toObj(obj)) return (int)i;
+	}
+	return -1;
+}
+
+static void MQAPICALL mock_Doc_GetUnusedObjectNameW(MQDocument doc, wchar_t *buffer, int buffer_size, const wchar_t *base_name)
+{
+	MockDocument *d = toDoc(doc);
+	std::wstring base = (base_name != NULL) ? base_name : L"obj";
+	for(int n=1; ; n++){
+		std::wstring name = base + std::to_wstring(n);
+		bool used = false;
+		for(MockObject *o : d->objects){
+			if(o != NULL && o->name == name){
+				used = true;
+				break;
+			}
+		}
+		if(!used){
+			copyString(name, buffer, buffer_size);
+			return;
+		}
+	}
+}
+
+static void MQAPICALL mock_Doc_GetUnusedObjectName(MQDocument doc, char *buffer, int buffer_size, const char *base_name)
+{
+	std::wstring base = (base_name != NULL) ? MQEncoding::AnsiToWide(base_name) : std::wstring(L"obj");
+	std::vector<wchar_t> wbuf(buffer_size + 16);
+	mock_Doc_GetUnusedObjectNameW(doc, wbuf.data(), (int)wbuf.size(), base.c_str());
+	copyString(MQEncoding::WideToAnsi(wbuf.data()), buffer, buffer_size);
+}
+
+static int MQAPICALL mock_Doc_GetMaterialCount(MQDocument doc)
+{
+	return (int)toDoc(doc)->materials.size();
+}
+
+static MQMaterial MQAPICALL mock_Doc_GetMaterial(MQDocument doc, int index)
+{
+	MockDocument *d = toDoc(doc);
+	if(index < 0 || index >= (int)d->materials.size()) return NULL;
+	return fromMat(d->materials[index]);
+}
+
+static MQMaterial MQAPICALL mock_Doc_GetMaterialFromUniqueID(MQDocument doc, int id)
+{
+	for(MockMaterial *m : toDoc(doc)->materials){
+		if(m != NULL && m->uniqueID == (UINT)id) return fromMat(m);
+	}
+	return NULL;
+}
+
+static int MQAPICALL mock_Doc_GetCurrentMaterialIndex(MQDocument doc)
+{
+	return toDoc(doc)->currentMaterial;
+}
+
+static void MQAPICALL mock_Doc_SetCurrentMaterialIndex(MQDocument doc, int index)
+{
+	toDoc(doc)->currentMaterial = index;
+}
+
+static int MQAPICALL mock_Doc_AddMaterial(MQDocument doc, MQMaterial mat)
+{
+	MockDocument *d = toDoc(doc);
+	MockMaterial *m = toMat(mat);
+	m->doc = d;
+	m->uniqueID = d->nextMaterialID++;
+	d->materials.push_back(m);
+	return (int)d->materials.size() - 1;
+}
+
+static void MQAPICALL mock_Doc_DeleteMaterial(MQDocument doc, int index)
+{
+	MockDocument *d = toDoc(doc);
+	if(index < 0 || index >= (int)d->materials.size()) return;
+	delete d->materials[index];
+	d->materials[index] = NULL;
+	for(MockObject *o : d->objects){
+		if(o == NULL) continue;
+		for(auto& f : o->faces){
+			if(f.material == index) f.material = -1;
+		}
+	}
+}
+
+static void MQAPICALL mock_Doc_GetUnusedMaterialNameW(MQDocument doc, wchar_t *buffer, int buffer_size, const wchar_t *base_name)
+{
+	MockDocument *d = toDoc(doc);
+	std::wstring base = (base_name != NULL) ? base_name : L"mat";
+	for(int n=1; ; n++){
+		std::wstring name = base + std::to_wstring(n);
+		bool used = false;
+		for(MockMaterial *m : d->materials){
+			if(m != NULL && m->name == name){
+				used = true;
+				break;
+			}
+		}
+		if(!used){
+			copyString(name, buffer, buffer_size);
+			return;
+		}
+	}
+}
+
+static void MQAPICALL mock_Doc_GetUnusedMaterialName(MQDocument doc, char *buffer, int buffer_size, const char *base_name)
+{
+	std::wstring base = (base_name != NULL) ? MQEncoding::AnsiToWide(base_name) : std::wstring(L"mat");
+	std::vector<wchar_t> wbuf(buffer_size + 16);
+	mock_Doc_GetUnusedMaterialNameW(doc, wbuf.data(), (int)wbuf.size(), base.c_str());
+	copyString(MQEncoding::WideToAnsi(wbuf.data()), buffer, buffer_size);
+}
+
+static BOOL MQAPICALL mock_Doc_FindMappingFile(MQDocument doc, char *out_path, const char *filename, DWORD map_type)
+{
+	return FALSE;
+}
+
+static BOOL MQAPICALL mock_Doc_FindMappingFileW(MQDocument doc, wchar_t *out_path, const wchar_t *filename, DWORD map_type)
+{
+	return FALSE;
+}
+
+static BOOL MQAPICALL mock_Doc_GetMappingImageW(MQDocument doc, const wchar_t *filename, DWORD map_type, void **array)
+{
+	MockDocument *d = toDoc(doc);
+	if(filename == NULL || array == NULL) return FALSE;
+	auto it = d->images.find(std::make_pair(map_type, std::wstring(filename)));
+	if(it == d->images.end()) return FALSE;
+
+	const MockImage& image = it->second;
+	*(int*)array[0] = image.width;
+	*(int*)array[1] = image.height;
+	*(int*)array[2] = image.bpp;
+	*(const RGBQUAD**)array[3] = image.colors.empty() ? NULL : image.colors.data();
+	*(const BYTE**)array[4] = image.buffer.data();
+	return TRUE;
+}
+
+static BOOL MQAPICALL mock_Doc_GetMappingImage(MQDocument doc, const char *filename, DWORD map_type, void **array)
+{
+	if(filename == NULL) return FALSE;
+	return mock_Doc_GetMappingImageW(doc, MQEncoding::AnsiToWide(filename).c_str(), map_type, array);
+}
+
+static void MQAPICALL mock_Doc_Compact(MQDocument doc)
+{
+	MockDocument *d = toDoc(doc);
+	d->objects.erase(std::remove(d->objects.begin(), d->objects.end(), (MockObject*)NULL), d->objects.end());
+	for(MockObject *o : d->objects){
+		compactObject(o);
+	}
+}
+
+// The parent is the nearest preceding object with a smaller depth.
+// 親は手前にある、より浅い階層の最も近いオブジェクト。
+static MQObject MQAPICALL mock_Doc_GetParentObject(MQDocument doc, MQObject obj)
+{
+	MockDocument *d = toDoc(doc);
+	MockObject *o = toObj(obj);
+	int index = mock_Doc_GetObjectIndex(doc, obj);
+	for(int i=index-1; i>=0; i--){
+		MockObject *p = d->objects[i];
+		if(p != NULL && p->depth < o->depth) return fromObj(p);
+	}
+	return NULL;
+}
+
+static int MQAPICALL mock_Doc_GetChildObjectCount(MQDocument doc, MQObject obj)
+{
+	MockDocument *d = toDoc(doc);
+	int count = 0;
+	for(MockObject *c : d->objects){
+		if(c != NULL && c != toObj(obj) && mock_Doc_GetParentObject(doc, fromObj(c)) == obj) count++;
+	}
+	return count;
+}
+
+static MQObject MQAPICALL mock_Doc_GetChildObject(MQDocument doc, MQObject obj, int index)
+{
+	MockDocument *d = toDoc(doc);
+	for(MockObject *c : d->objects){
+		if(c != NULL && c != toObj(obj) && mock_Doc_GetParentObject(doc, fromObj(c)) == obj){
+			if(index-- == 0) return fromObj(c);
+		}
+	}
+	return NULL;
+}
+
+static void MQAPICALL mock_Doc_GetGlobalMatrix(MQDocument doc, MQObject obj, float *matrix)
+{
+	objectLocalMatrix(toObj(obj), matrix);
+	for(MQObject p = mock_Doc_GetParentObject(doc, obj); p != NULL; p = mock_Doc_GetParentObject(doc, p)){
+		float pm[16];
+		objectLocalMatrix(toObj(p), pm);
+		multiplyMatrix(matrix, pm, matrix);
+	}
+}
+
+static void MQAPICALL mock_Doc_GetGlobalInverseMatrix(MQDocument doc, MQObject obj, float *matrix)
+{
+	float m[16];
+	mock_Doc_GetGlobalMatrix(doc, obj, m);
+	inverseMatrix(m, matrix);
+}
+
+static int MQAPICALL mock_Doc_InsertObject(MQDocument doc, MQObject obj, MQObject before)
+{
+	MockDocument *d = toDoc(doc);
+	int index = (before != NULL) ? mock_Doc_GetObjectIndex(doc, before) : -1;
+	if(index < 0) return mock_Doc_AddObject(doc, obj);
+	MockObject *o = toObj(obj);
+	o->doc = d;
+	o->uniqueID = d->nextObjectID++;
+	d->objects.insert(d->objects.begin() + index, o);
+	return index;
+}
+
+static BOOL MQAPICALL mock_Doc_RemoveObject(MQDocument doc, MQObject obj)
+{
+	MockDocument *d = toDoc(doc);
+	int index = mock_Doc_GetObjectIndex(doc, obj);
+	if(index < 0) return FALSE;
+	d->objects.erase(d->objects.begin() + index);
+	toObj(obj)->doc = NULL;
+	return TRUE;
+}
+
+static BOOL MQAPICALL mock_Doc_Triangulate(MQDocument doc, const MQPoint *points, int points_num, int *index_array, int index_num)
+{
+	if(points_num < 3 || index_num < (points_num - 2) * 3) return FALSE;
+	return triangulatePolygon(points, points_num, index_array) ? TRUE : FALSE;
+}
+
+
+//---------------------------------------------------------------------------
+//  Object
+//---------------------------------------------------------------------------
+
+static void MQAPICALL mock_Obj_Delete(MQObject obj)
+{
+	delete toObj(obj);
+}
+
+static MQObject MQAPICALL mock_Obj_Clone(MQObject obj)
+{
+	return fromObj(cloneObject(toObj(obj)));
+}
+
+static void MQAPICALL mock_Obj_Merge(MQObject dest, MQObject source)
+{
+	MockObject *d = toObj(dest);
+	MockObject *s = toObj(source);
+	int base = (int)d->vertices.size();
+	for(size_t i=0; i<s->vertices.size(); i++){
+		d->vertices.push_back(s->vertices[i]);
+		d->vertexIDs.push_back(d->nextVertexID++);
+		d->vertexWeights.push_back(s->vertexWeights[i]);
+		d->vertexDeleted.push_back(s->vertexDeleted[i]);
+	}
+	for(const auto& f : s->faces){
+		MockFace nf = f;
+		for(int& v : nf.points) v += base;
+		nf.uniqueID = d->nextFaceID++;
+		d->faces.push_back(std::move(nf));
+	}
+	d->relationDirty = true;
+}
+
+static void MQAPICALL mock_Obj_Clear(MQObject obj, DWORD flag)
+{
+	MockObject *o = toObj(obj);
+	o->vertices.clear();
+	o->vertexIDs.clear();
+	o->vertexWeights.clear();
+	o->vertexDeleted.clear();
+	o->faces.clear();
+	o->relationDirty = true;
+}
+
+static void MQAPICALL mock_Obj_Freeze(MQObject obj, DWORD flag)
+{
+	// Mirror, lathe and patch are not evaluated in the mock.
+	// 模擬ホストではミラー・回転体・曲面を評価しない。
+}
+
+static int MQAPICALL mock_Obj_GetVertexCount(MQObject obj)
+{
+	return (int)toObj(obj)->vertices.size();
+}
+
+static void MQAPICALL mock_Obj_GetVertex(MQObject obj, int index, MQPoint *pts)
+{
+	MockObject *o = toObj(obj);
+	*pts = isValidVertex(o, index) ? o->vertices[index] : MQPoint(0,0,0);
+}
+
+static void MQAPICALL mock_Obj_SetVertex(MQObject obj, int index, MQPoint *pts)
+{
+	MockObject *o = toObj(obj);
+	if(isValidVertex(o, index)) o->vertices[index] = *pts;
+}
+
+static void MQAPICALL mock_Obj_GetVertexArray(MQObject obj, MQPoint *ptsarray)
+{
+	MockObject *o = toObj(obj);
+	std::copy(o->vertices.begin(), o->vertices.end(), ptsarray);
+}
+
+static int MQAPICALL mock_Obj_GetFaceCount(MQObject obj)
+{
+	return (int)toObj(obj)->faces.size();
+}
+
+static int MQAPICALL mock_Obj_GetFacePointCount(MQObject obj, int face)
+{
+	MockObject *o = toObj(obj);
+	return isValidFace(o, face) ? (int)o->faces[face].points.size() : 0;
+}
+
+static void MQAPICALL mock_Obj_GetFacePointArray(MQObject obj, int face, int *vertex)
+{
+	MockObject *o = toObj(obj);
+	if(!isValidFace(o, face)) return;
+	std::copy(o->faces[face].points.begin(), o->faces[face].points.end(), vertex);
+}
+
+static void MQAPICALL mock_Obj_GetFaceCoordinateArray(MQObject obj, int face, MQCoordinate *uvarray)
+{
+	MockObject *o = toObj(obj);
+	if(!isValidFace(o, face)) return;
+	std::copy(o->faces[face].uv.begin(), o->faces[face].uv.end(), uvarray);
+}
+
+static void MQAPICALL mock_Obj_GetFaceCoordinate(MQObject obj, int face, int apex, MQCoordinate& uv)
+{
+	MockObject *o = toObj(obj);
+	if(isValidApex(o, face, apex)) uv = o->faces[face].uv[apex];
+}
+
+static BOOL MQAPICALL mock_Obj_GetFaceChannelCoordinate(MQObject obj, int face, int apex, UINT channelID, MQCoordinate& uv)
+{
+	// Only the first UV channel exists.
+	// UVチャンネルは最初の一つだけ。
+	MockObject *o = toObj(obj);
+	if(channelID != 0 || !isValidApex(o, face, apex)) return FALSE;
+	uv = o->faces[face].uv[apex];
+	return TRUE;
+}
+
+static int MQAPICALL mock_Obj_GetFaceMaterial(MQObject obj, int face)
+{
+	MockObject *o = toObj(obj);
+	return isValidFace(o, face) ? o->faces[face].material : -1;
+}
+
+static UINT MQAPICALL mock_Obj_GetFaceUniqueID(MQObject obj, int face)
+{
+	MockObject *o = toObj(obj);
+	return isValidFace(o, face) ? o->faces[face].uniqueID : 0;
+}
+
+static int MQAPICALL mock_Obj_GetFaceIndexFromUniqueID(MQObject obj, UINT unique_id)
+{
+	MockObject *o = toObj(obj);
+	for(size_t i=0; i<o->faces.size(); i++){
+		if(o->faces[i].uniqueID == unique_id) return (int)i;
+	}
+	return -1;
+}
+
+static void MQAPICALL mock_Obj_SetName(MQObject obj, const char *buffer)
+{
+	toObj(obj)->name = MQEncoding::AnsiToWide(buffer);
+}
+
+static int MQAPICALL mock_Obj_AddVertex(MQObject obj, MQPoint *p)
+{
+	MockObject *o = toObj(obj);
+	o->vertices.push_back(*p);
+	o->vertexIDs.push_back(o->nextVertexID++);
+	o->vertexWeights.push_back(0.0f);
+	o->vertexDeleted.push_back(0);
+	o->relationDirty = true;
+	return (int)o->vertices.size() - 1;
+}
+
+static BOOL MQAPICALL mock_Obj_DeleteVertex(MQObject obj, int index, BOOL del_vert)
+{
+	MockObject *o = toObj(obj);
+	if(!isValidVertex(o, index) || o->vertexDeleted[index]) return FALSE;
+	buildRelation(o);
+	std::vector<int> others;
+	for(int k=o->relationStart[index]; k<o->relationStart[index+1]; k++){
+		MockFace& f = o->faces[o->relationFaces[k]];
+		for(int v : f.points){
+			if(v != index) others.push_back(v);
+		}
+		f.clear();
+	}
+	o->vertexDeleted[index] = 1;
+	o->relationDirty = true;
+	if(del_vert) deleteUnreferencedVertices(o, others);
+	return TRUE;
+}
+
+static int MQAPICALL mock_Obj_GetVertexRefCount(MQObject obj, int index)
+{
+	MockObject *o = toObj(obj);
+	if(!isValidVertex(o, index) || o->vertexDeleted[index]) return 0;
+	buildRelation(o);
+	return o->relationStart[index+1] - o->relationStart[index];
+}
+
+static UINT MQAPICALL mock_Obj_GetVertexUniqueID(MQObject obj, int index)
+{
+	MockObject *o = toObj(obj);
+	return isValidVertex(o, index) ? o->vertexIDs[index] : 0;
+}
+
+static int MQAPICALL mock_Obj_GetVertexIndexFromUniqueID(MQObject obj, UINT unique_id)
+{
+	MockObject *o = toObj(obj);
+	// IDs are increasing unless vertices were merged from another object.
+	// 他のオブジェクトから結合しない限りIDは昇順。
+	auto it = std::lower_bound(o->vertexIDs.begin(), o->vertexIDs.end(), unique_id);
+	if(it != o->vertexIDs.end() && *it == unique_id) return (int)(it - o->vertexIDs.begin());
+	for(size_t i=0; i<o->vertexIDs.size(); i++){
+		if(o->vertexIDs[i] == unique_id) return (int)i;
+	}
+	return -1;
+}
+
+static int MQAPICALL mock_Obj_GetVertexRelatedFaces(MQObject obj, int vertex, int *faces)
+{
+	MockObject *o = toObj(obj);
+	if(!isValidVertex(o, vertex)) return 0;
+	buildRelation(o);
+	int begin = o->relationStart[vertex];
+	int end = o->relationStart[vertex+1];
+	if(faces != NULL) std::copy(o->relationFaces.begin() + begin, o->relationFaces.begin() + end, faces);
+	return end - begin;
+}
+
+static float MQAPICALL mock_Obj_GetVertexWeight(MQObject obj, int index)
+{
+	MockObject *o = toObj(obj);
+	return isValidVertex(o, index) ? o->vertexWeights[index] : 0.0f;
+}
+
+static void MQAPICALL mock_Obj_SetVertexWeight(MQObject obj, int index, float value)
+{
+	MockObject *o = toObj(obj);
+	if(isValidVertex(o, index)) o->vertexWeights[index] = value;
+}
+
+static void MQAPICALL mock_Obj_CopyVertexAttribute(MQObject obj, int vert1, MQObject obj2, int vert2)
+{
+	MockObject *o = toObj(obj);
+	MockObject *o2 = toObj(obj2);
+	if(isValidVertex(o, vert1) && isValidVertex(o2, vert2)) o->vertexWeights[vert1] = o2->vertexWeights[vert2];
+}
+
+static int MQAPICALL mock_Obj_InsertFace(MQObject obj, int face_index, int count, int *vert_index)
+{
+	MockObject *o = toObj(obj);
+	if(count < 1) return -1;
+	for(int i=0; i<count; i++){
+		if(!isValidVertex(o, vert_index[i])) return -1;
+	}
+	if(face_index < 0 || face_index > (int)o->faces.size()) face_index = (int)o->faces.size();
+	MockFace f;
+	f.resize(count);
+	std::copy(vert_index, vert_index + count, f.points.begin());
+	f.material = -1;
+	f.uniqueID = o->nextFaceID++;
+	f.visible = TRUE;
+	o->faces.insert(o->faces.begin() + face_index, std::move(f));
+	o->relationDirty = true;
+	return face_index;
+}
+
+static int MQAPICALL mock_Obj_AddFace(MQObject obj, int count, int *index)
+{
+	return mock_Obj_InsertFace(obj, -1, count, index);
+}
+
+static BOOL MQAPICALL mock_Obj_DeleteFace(MQObject obj, int index, BOOL del_vert)
+{
+	MockObject *o = toObj(obj);
+	if(!isValidFace(o, index) || o->faces[index].points.empty()) return FALSE;
+	std::vector<int> points = o->faces[index].points;
+	o->faces[index].clear();
+	o->relationDirty = true;
+	if(del_vert) deleteUnreferencedVertices(o, points);
+	return TRUE;
+}
+
+static BOOL MQAPICALL mock_Obj_InvertFace(MQObject obj, int index)
+{
+	MockObject *o = toObj(obj);
+	if(!isValidFace(o, index)) return FALSE;
+	MockFace& f = o->faces[index];
+	std::reverse(f.points.begin(), f.points.end());
+	std::reverse(f.uv.begin(), f.uv.end());
+	std::reverse(f.colors.begin(), f.colors.end());
+	std::reverse(f.normalFlags.begin(), f.normalFlags.end());
+	std::reverse(f.normals.begin(), f.normals.end());
+	return TRUE;
+}
+
+static void MQAPICALL mock_Obj_SetFaceMaterial(MQObject obj, int face, int material)
+{
+	MockObject *o = toObj(obj);
+	if(isValidFace(o, face)) o->faces[face].material = material;
+}
+
+static void MQAPICALL mock_Obj_SetFaceCoordinateArray(MQObject obj, int face, MQCoordinate *uvarray)
+{
+	MockObject *o = toObj(obj);
+	if(!isValidFace(o, face)) return;
+	std::copy(uvarray, uvarray + o->faces[face].uv.size(), o->faces[face].uv.begin());
+}
+
+static void MQAPICALL mock_Obj_SetFaceCoordinate(MQObject obj, int face, int vertex, const MQCoordinate& uv)
+{
+	MockObject *o = toObj(obj);
+	if(isValidApex(o, face, vertex)) o->faces[face].uv[vertex] = uv;
+}
+
+static BOOL MQAPICALL mock_Obj_SetFaceChannelCoordinate(MQObject obj, int face, int apex, UINT channelID, const MQCoordinate& uv)
+{
+	MockObject *o = toObj(obj);
+	if(channelID != 0 || !isValidApex(o, face, apex)) return FALSE;
+	o->faces[face].uv[apex] = uv;
+	return TRUE;
+}
+
+static DWORD MQAPICALL mock_Obj_GetFaceVertexColor(MQObject obj, int face, int vertex)
+{
+	MockObject *o = toObj(obj);
+	return isValidApex(o, face, vertex) ? o->faces[face].colors[vertex] : 0xFFFFFFFF;
+}
+
+static void MQAPICALL mock_Obj_SetFaceVertexColor(MQObject obj, int face, int vertex, DWORD color)
+{
+	MockObject *o = toObj(obj);
+	if(isValidApex(o, face, vertex)) o->faces[face].colors[vertex] = color;
+}
+
+static float MQAPICALL mock_Obj_GetFaceEdgeCrease(MQObject obj, int face, int line)
+{
+	MockObject *o = toObj(obj);
+	return isValidApex(o, face, line) ? o->faces[face].creases[line] : 0.0f;
+}
+
+static void MQAPICALL mock_Obj_SetFaceEdgeCrease(MQObject obj, int face, int line, float crease)
+{
+	MockObject *o = toObj(obj);
+	if(isValidApex(o, face, line)) o->faces[face].creases[line] = crease;
+}
+
+// Returns the normal set by SetFaceVertexNormal(), or the face normal.
+// Smoothing by the angle is done by MQObjNormal, not here.
+// SetFaceVertexNormal()で設定した法線か、面の法線を返す。
+// スムージング角による平滑化はここではなくMQObjNormalで行う。
+static void MQAPICALL mock_Obj_GetFaceVertexNormal(MQObject obj, int face, int vertex, BYTE &flag, MQPoint &normal)
+{
+	MockObject *o = toObj(obj);
+	if(!isValidApex(o, face, vertex)){
+		flag = 0;
+		normal = MQPoint(0,0,0);
+		return;
+	}
+	MockFace& f = o->faces[face];
+	flag = f.normalFlags[vertex];
+	normal = (flag != 0) ? f.normals[vertex] : faceNormal(o, f);
+}
+
+static void MQAPICALL mock_Obj_SetFaceVertexNormal(MQObject obj, int face, int vertex, BYTE flag, MQPoint normal)
+{
+	MockObject *o = toObj(obj);
+	if(!isValidApex(o, face, vertex)) return;
+	o->faces[face].normalFlags[vertex] = flag;
+	o->faces[face].normals[vertex] = normal;
+}
+
+static BOOL MQAPICALL mock_Obj_GetFaceVisible(MQObject obj, int face)
+{
+	MockObject *o = toObj(obj);
+	return isValidFace(o, face) ? o->faces[face].visible : FALSE;
+}
+
+static void MQAPICALL mock_Obj_SetFaceVisible(MQObject obj, int face, BOOL flag)
+{
+	MockObject *o = toObj(obj);
+	if(isValidFace(o, face)) o->faces[face].visible = flag;
+}
+
+static void MQAPICALL mock_Obj_OptimizeVertex(MQObject obj, float distance, MQBool *apply)
+{
+}
+
+static void MQAPICALL mock_Obj_Compact(MQObject obj)
+{
+	compactObject(toObj(obj));
+}
+
+static DWORD MQAPICALL mock_Obj_GetVisible(MQObject obj) { return toObj(obj)->visible; }
+static void MQAPICALL mock_Obj_SetVisible(MQObject obj, DWORD visible) { toObj(obj)->visible = visible; }
+static DWORD MQAPICALL mock_Obj_GetPatchType(MQObject obj) { return toObj(obj)->patchType; }
+static void MQAPICALL mock_Obj_SetPatchType(MQObject obj, DWORD type) { toObj(obj)->patchType = type; }
+static int MQAPICALL mock_Obj_GetPatchSegment(MQObject obj) { return toObj(obj)->patchSegment; }
+static void MQAPICALL mock_Obj_SetPatchSegment(MQObject obj, int segment) { toObj(obj)->patchSegment = segment; }
+static int MQAPICALL mock_Obj_GetShading(MQObject obj) { return toObj(obj)->shading; }
+static void MQAPICALL mock_Obj_SetShading(MQObject obj, int type) { toObj(obj)->shading = type; }
+static float MQAPICALL mock_Obj_GetSmoothAngle(MQObject obj) { return toObj(obj)->smoothAngle; }
+static void MQAPICALL mock_Obj_SetSmoothAngle(MQObject obj, float degree) { toObj(obj)->smoothAngle = degree; }
+static int MQAPICALL mock_Obj_GetMirrorType(MQObject obj) { return toObj(obj)->mirrorType; }
+static void MQAPICALL mock_Obj_SetMirrorType(MQObject obj, int type) { toObj(obj)->mirrorType = type; }
+static DWORD MQAPICALL mock_Obj_GetMirrorAxis(MQObject obj) { return toObj(obj)->mirrorAxis; }
+static void MQAPICALL mock_Obj_SetMirrorAxis(MQObject obj, DWORD axis) { toObj(obj)->mirrorAxis = axis; }
+static float MQAPICALL mock_Obj_GetMirrorDistance(MQObject obj) { return toObj(obj)->mirrorDistance; }
+static void MQAPICALL mock_Obj_SetMirrorDistance(MQObject obj, float dis) { toObj(obj)->mirrorDistance = dis; }
+static int MQAPICALL mock_Obj_GetLatheType(MQObject obj) { return toObj(obj)->latheType; }
+static void MQAPICALL mock_Obj_SetLatheType(MQObject obj, int type) { toObj(obj)->latheType = type; }
+static DWORD MQAPICALL mock_Obj_GetLatheAxis(MQObject obj) { return toObj(obj)->latheAxis; }
+static void MQAPICALL mock_Obj_SetLatheAxis(MQObject obj, DWORD axis) { toObj(obj)->latheAxis = axis; }
+static int MQAPICALL mock_Obj_GetLatheSegment(MQObject obj) { return toObj(obj)->latheSegment; }
+static void MQAPICALL mock_Obj_SetLatheSegment(MQObject obj, int segment) { toObj(obj)->latheSegment = segment; }
+
+static int MQAPICALL mock_Obj_GetIntValue(MQObject obj, int type_id)
+{
+	MockObject *o = toObj(obj);
+	switch(type_id){
+	case MQOBJ_ID_DEPTH: return o->depth;
+	case MQOBJ_ID_FOLDING: return o->folding;
+	case MQOBJ_ID_LOCKING: return o->locking;
+	case MQOBJ_ID_UNIQUE_ID: return (int)o->uniqueID;
+	case MQOBJ_ID_TYPE: return o->type;
+	case MQOBJ_ID_SELECTED: return o->selected;
+	case MQOBJ_ID_PATCH_TRIANGLE: return o->patchTriangle;
+	case MQOBJ_ID_PATCH_SMOOTH_TRIANGLE: return o->patchSmoothTriangle;
+	case MQOBJ_ID_PATCH_MESH_INTERP: return o->patchMeshInterp;
+	case MQOBJ_ID_PATCH_UV_INTERP: return o->patchUVInterp;
+	case MQOBJ_ID_PATCH_LIMIT_SURFACE: return o->patchLimitSurface;
+	case MQOBJ_ID_COLOR_VALID: return o->colorValid;
+	case MQOBJ_ID_LIGHT_ATTENUATION: return o->lightAttenuation;
+	}
+	return 0;
+}
+
+static void MQAPICALL mock_Obj_SetIntValue(MQObject obj, int type_id, int value)
+{
+	MockObject *o = toObj(obj);
+	switch(type_id){
+	case MQOBJ_ID_DEPTH: o->depth = value; break;
+	case MQOBJ_ID_FOLDING: o->folding = value; break;
+	case MQOBJ_ID_LOCKING: o->locking = value; break;
+	case MQOBJ_ID_TYPE: o->type = value; break;
+	case MQOBJ_ID_SELECTED: o->selected = value; break;
+	case MQOBJ_ID_PATCH_TRIANGLE: o->patchTriangle = value; break;
+	case MQOBJ_ID_PATCH_SMOOTH_TRIANGLE: o->patchSmoothTriangle = value; break;
+	case MQOBJ_ID_PATCH_MESH_INTERP: o->patchMeshInterp = value; break;
+	case MQOBJ_ID_PATCH_UV_INTERP: o->patchUVInterp = value; break;
+	case MQOBJ_ID_PATCH_LIMIT_SURFACE: o->patchLimitSurface = value; break;
+	case MQOBJ_ID_COLOR_VALID: o->colorValid = value; break;
+	case MQOBJ_ID_LIGHT_ATTENUATION: o->lightAttenuation = value; break;
+	}
+}
+
+static void MQAPICALL mock_Obj_GetFloatArray(MQObject obj, int type_id, float *array)
+{
+	MockObject *o = toObj(obj);
+	switch(type_id){
+	case MQOBJ_ID_COLOR:
+		array[0] = o->color[0]; array[1] = o->color[1]; array[2] = o->color[2];
+		break;
+	case MQOBJ_ID_SCALING:
+		array[0] = o->scaling.x; array[1] = o->scaling.y; array[2] = o->scaling.z;
+		break;
+	case MQOBJ_ID_ROTATION:
+		array[0] = o->rotation.head; array[1] = o->rotation.pitch; array[2] = o->rotation.bank;
+		break;
+	case MQOBJ_ID_TRANSLATION:
+		array[0] = o->translation.x; array[1] = o->translation.y; array[2] = o->translation.z;
+		break;
+	case MQOBJ_ID_LOCAL_MATRIX:
+		objectLocalMatrix(o, array);
+		break;
+	case MQOBJ_ID_LOCAL_INVERSE_MATRIX:
+		{
+			float m[16];
+			objectLocalMatrix(o, m);
+			inverseMatrix(m, array);
+		}
+		break;
+	case MQOBJ_ID_LIGHT_VALUE: array[0] = o->lightValue; break;
+	case MQOBJ_ID_LIGHT_FALLOFF_END: array[0] = o->lightFallOffEnd; break;
+	case MQOBJ_ID_LIGHT_FALLOFF_HALF: array[0] = o->lightFallOffHalf; break;
+	}
+}
+
+static void MQAPICALL mock_Obj_SetFloatArray(MQObject obj, int type_id, const float *array)
+{
+	MockObject *o = toObj(obj);
+	switch(type_id){
+	case MQOBJ_ID_COLOR:
+		o->color[0] = array[0]; o->color[1] = array[1]; o->color[2] = array[2];
+		break;
+	case MQOBJ_ID_SCALING: o->scaling = MQPoint(array[0], array[1], array[2]); break;
+	case MQOBJ_ID_ROTATION: o->rotation = MQAngle(array[0], array[1], array[2]); break;
+	case MQOBJ_ID_TRANSLATION: o->translation = MQPoint(array[0], array[1], array[2]); break;
+	case MQOBJ_ID_LOCAL_MATRIX:
+		{
+			float s[3], r[3], t[3];
+			decomposeMatrix(array, s, r, t);
+			o->scaling = MQPoint(s[0], s[1], s[2]);
+			o->rotation = MQAngle(r[0], r[1], r[2]);
+			o->translation = MQPoint(t[0], t[1], t[2]);
+		}
+		break;
+	case MQOBJ_ID_LIGHT_VALUE: o->lightValue = array[0]; break;
+	case MQOBJ_ID_LIGHT_FALLOFF_END: o->lightFallOffEnd = array[0]; break;
+	case MQOBJ_ID_LIGHT_FALLOFF_HALF: o->lightFallOffHalf = array[0]; break;
+	}
+}
+
+static void MQAPICALL mock_Obj_PointerArray(MQObject obj, int type_id, void **array)
+{
+	MockObject *o = toObj(obj);
+	switch(type_id){
+	case MQOBJ_ID_NAME:
+		*(int*)array[2] = copyString(MQEncoding::WideToAnsi(o->name.c_str()), (char*)array[0], *(int*)array[1]);
+		break;
+	case MQOBJ_ID_NAME_W:
+		*(int*)array[2] = copyString(o->name, (wchar_t*)array[0], *(int*)array[1]);
+		break;
+	case MQOBJ_ID_SET_NAME_W:
+		o->name = (const wchar_t*)array[0];
+		break;
+	case MQOBJ_ID_RESERVE_VERTEX:
+		{
+			int *size = (int*)findArg(array, "size");
+			BOOL *result = (BOOL*)findArg(array, "result");
+			if(size != NULL){
+				o->vertices.reserve(*size);
+				o->vertexIDs.reserve(*size);
+				o->vertexWeights.reserve(*size);
+				o->vertexDeleted.reserve(*size);
+			}
+			if(result != NULL) *result = TRUE;
+		}
+		break;
+	case MQOBJ_ID_RESERVE_FACE:
+		{
+			int *size = (int*)findArg(array, "size");
+			BOOL *result = (BOOL*)findArg(array, "result");
+			if(size != NULL) o->faces.reserve(*size);
+			if(result != NULL) *result = TRUE;
+		}
+		break;
+	case MQOBJ_ID_MERGE:
+		{
+			MQObject source = (MQObject)findArg(array, "source");
+			BOOL *result = (BOOL*)findArg(array, "result");
+			if(source != NULL) mock_Obj_Merge(obj, source);
+			if(result != NULL) *result = (source != NULL);
+		}
+		break;
+	case MQOBJ_ID_FREEZE:
+	case MQOBJ_ID_OPTIMIZE:
+		{
+			BOOL *result = (BOOL*)findArg(array, "result");
+			if(result != NULL) *result = FALSE;
+		}
+		break;
+	case MQOBJ_ID_UPDATE_NORMAL:
+		break;
+	}
+}
+
+
+//---------------------------------------------------------------------------
+//  Material
+//---------------------------------------------------------------------------
+
+static void MQAPICALL mock_Mat_Delete(MQMaterial mat)
+{
+	delete toMat(mat);
+}
+
+static int MQAPICALL mock_Mat_GetIntValue(MQMaterial mat, int type_id)
+{
+	MockMaterial *m = toMat(mat);
+	switch(type_id){
+	case MQMAT_ID_SHADER: return m->shader;
+	case MQMAT_ID_VERTEXCOLOR: return m->vertexColor;
+	case MQMAT_ID_UNIQUE_ID: return (int)m->uniqueID;
+	case MQMAT_ID_DOUBLESIDED: return m->doubleSided;
+	case MQMAT_ID_SELECTED: return m->selected;
+	case MQMAT_ID_MAPPROJ: return m->mapProj;
+	case MQMAT_ID_MAPWRAPU: return m->wrapU;
+	case MQMAT_ID_MAPWRAPV: return m->wrapV;
+	case MQMAT_ID_MAPFILTER: return m->mapFilter;
+	case MQMAT_ID_TEXTURE_UVCHANNEL: return (int)m->textureUVChannel;
+	case MQMAT_ID_ALPHA_UVCHANNEL: return (int)m->alphaUVChannel;
+	case MQMAT_ID_BUMP_UVCHANNEL: return (int)m->bumpUVChannel;
+	}
+	return 0;
+}
+
+static void MQAPICALL mock_Mat_SetIntValue(MQMaterial mat, int type_id, int value)
+{
+	MockMaterial *m = toMat(mat);
+	switch(type_id){
+	case MQMAT_ID_SHADER: m->shader = value; break;
+	case MQMAT_ID_VERTEXCOLOR: m->vertexColor = value; break;
+	case MQMAT_ID_DOUBLESIDED: m->doubleSided = value; break;
+	case MQMAT_ID_SELECTED: m->selected = value; break;
+	case MQMAT_ID_MAPPROJ: m->mapProj = value; break;
+	case MQMAT_ID_MAPWRAPU: m->wrapU = value; break;
+	case MQMAT_ID_MAPWRAPV: m->wrapV = value; break;
+	case MQMAT_ID_MAPFILTER: m->mapFilter = value; break;
+	case MQMAT_ID_TEXTURE_UVCHANNEL: m->textureUVChannel = (UINT)value; break;
+	case MQMAT_ID_ALPHA_UVCHANNEL: m->alphaUVChannel = (UINT)value; break;
+	case MQMAT_ID_BUMP_UVCHANNEL: m->bumpUVChannel = (UINT)value; break;
+	}
+}
+
+static void MQAPICALL mock_Mat_GetFloatArray(MQMaterial mat, int type_id, float *array)
+{
+	MockMaterial *m = toMat(mat);
+	switch(type_id){
+	case MQMAT_ID_REFLECTION: array[0] = m->reflection; break;
+	case MQMAT_ID_REFRACTION: array[0] = m->refraction; break;
+	case MQMAT_ID_AMBIENT_COLOR: array[0] = m->ambientColor.r; array[1] = m->ambientColor.g; array[2] = m->ambientColor.b; break;
+	case MQMAT_ID_SPECULAR_COLOR: array[0] = m->specularColor.r; array[1] = m->specularColor.g; array[2] = m->specularColor.b; break;
+	case MQMAT_ID_EMISSION_COLOR: array[0] = m->emissionColor.r; array[1] = m->emissionColor.g; array[2] = m->emissionColor.b; break;
+	case MQMAT_ID_MAPPROJ_POSITION: memcpy(array, m->mapProjPosition, sizeof(float)*3); break;
+	case MQMAT_ID_MAPPROJ_SCALING: memcpy(array, m->mapProjScaling, sizeof(float)*3); break;
+	case MQMAT_ID_MAPPROJ_ANGLE: memcpy(array, m->mapProjAngle, sizeof(float)*3); break;
+	case MQMAT_ID_MAPTRANSFORM:
+		array[0] = m->mapTransformValid ? 1.0f : 0.0f;
+		memcpy(array + 1, m->mapTransform, sizeof(float)*5);
+		break;
+	}
+}
+
+static void MQAPICALL mock_Mat_SetFloatArray(MQMaterial mat, int type_id, const float *array)
+{
+	MockMaterial *m = toMat(mat);
+	switch(type_id){
+	case MQMAT_ID_REFLECTION: m->reflection = array[0]; break;
+	case MQMAT_ID_REFRACTION: m->refraction = array[0]; break;
+	case MQMAT_ID_AMBIENT_COLOR: m->ambientColor = MQColor(array[0], array[1], array[2]); break;
+	case MQMAT_ID_SPECULAR_COLOR: m->specularColor = MQColor(array[0], array[1], array[2]); break;
+	case MQMAT_ID_EMISSION_COLOR: m->emissionColor = MQColor(array[0], array[1], array[2]); break;
+	case MQMAT_ID_MAPPROJ_POSITION: memcpy(m->mapProjPosition, array, sizeof(float)*3); break;
+	case MQMAT_ID_MAPPROJ_SCALING: memcpy(m->mapProjScaling, array, sizeof(float)*3); break;
+	case MQMAT_ID_MAPPROJ_ANGLE: memcpy(m->mapProjAngle, array, sizeof(float)*3); break;
+	case MQMAT_ID_MAPTRANSFORM:
+		m->mapTransformValid = true;
+		memcpy(m->mapTransform, array, sizeof(float)*5);
+		break;
+	}
+}
+
+static void MQAPICALL mock_Mat_GetColor(MQMaterial mat, MQColor *color) { *color = toMat(mat)->color; }
+static float MQAPICALL mock_Mat_GetAlpha(MQMaterial mat) { return toMat(mat)->alpha; }
+static float MQAPICALL mock_Mat_GetDiffuse(MQMaterial mat) { return toMat(mat)->diffuse; }
+static float MQAPICALL mock_Mat_GetAmbient(MQMaterial mat) { return toMat(mat)->ambient; }
+static float MQAPICALL mock_Mat_GetEmission(MQMaterial mat) { return toMat(mat)->emission; }
+static float MQAPICALL mock_Mat_GetSpecular(MQMaterial mat) { return toMat(mat)->specular; }
+static float MQAPICALL mock_Mat_GetPower(MQMaterial mat) { return toMat(mat)->power; }
+static void MQAPICALL mock_Mat_SetColor(MQMaterial mat, MQColor *color) { toMat(mat)->color = *color; }
+static void MQAPICALL mock_Mat_SetAlpha(MQMaterial mat, float value) { toMat(mat)->alpha = value; }
+static void MQAPICALL mock_Mat_SetDiffuse(MQMaterial mat, float value) { toMat(mat)->diffuse = value; }
+static void MQAPICALL mock_Mat_SetAmbient(MQMaterial mat, float value) { toMat(mat)->ambient = value; }
+static void MQAPICALL mock_Mat_SetEmission(MQMaterial mat, float value) { toMat(mat)->emission = value; }
+static void MQAPICALL mock_Mat_SetSpecular(MQMaterial mat, float value) { toMat(mat)->specular = value; }
+static void MQAPICALL mock_Mat_SetPower(MQMaterial mat, float value) { toMat(mat)->power = value; }
+
+static void MQAPICALL mock_Mat_GetTextureName(MQMaterial mat, char *buffer, int size) { copyString(MQEncoding::WideToAnsi(toMat(mat)->textureName.c_str()), buffer, size); }
+static void MQAPICALL mock_Mat_GetAlphaName(MQMaterial mat, char *buffer, int size) { copyString(MQEncoding::WideToAnsi(toMat(mat)->alphaName.c_str()), buffer, size); }
+static void MQAPICALL mock_Mat_GetBumpName(MQMaterial mat, char *buffer, int size) { copyString(MQEncoding::WideToAnsi(toMat(mat)->bumpName.c_str()), buffer, size); }
+static void MQAPICALL mock_Mat_SetName(MQMaterial mat, const char *name) { toMat(mat)->name = MQEncoding::AnsiToWide(name); }
+static void MQAPICALL mock_Mat_SetTextureName(MQMaterial mat, const char *name) { toMat(mat)->textureName = MQEncoding::AnsiToWide(name); }
+static void MQAPICALL mock_Mat_SetAlphaName(MQMaterial mat, const char *name) { toMat(mat)->alphaName = MQEncoding::AnsiToWide(name); }
+static void MQAPICALL mock_Mat_SetBumpName(MQMaterial mat, const char *name) { toMat(mat)->bumpName = MQEncoding::AnsiToWide(name); }
+
+static void MQAPICALL mock_Mat_GetValueArray(MQMaterial mat, int type_id, void **array)
+{
+	MockMaterial *m = toMat(mat);
+	switch(type_id){
+	case MQMAT_ID_CLONE:
+		{
+			MockMaterial *c = new MockMaterial(*m);
+			c->doc = NULL;
+			c->uniqueID = 0;
+			array[0] = fromMat(c);
+		}
+		break;
+	case MQMAT_ID_NAME:
+		*(int*)array[2] = copyString(MQEncoding::WideToAnsi(m->name.c_str()), (char*)array[0], *(int*)array[1]);
+		break;
+	case MQMAT_ID_NAME_W:
+		*(int*)array[2] = copyString(m->name, (wchar_t*)array[0], *(int*)array[1]);
+		break;
+	case MQMAT_ID_TEXTURE_NAME_W:
+		*(int*)array[2] = copyString(m->textureName, (wchar_t*)array[0], *(int*)array[1]);
+		break;
+	case MQMAT_ID_ALPHA_NAME_W:
+		*(int*)array[2] = copyString(m->alphaName, (wchar_t*)array[0], *(int*)array[1]);
+		break;
+	case MQMAT_ID_BUMP_NAME_W:
+		*(int*)array[2] = copyString(m->bumpName, (wchar_t*)array[0], *(int*)array[1]);
+		break;
+	// Custom shaders are not supported. Report no name and no parameters.
+	// カスタムシェーダーには非対応。名前もパラメータも無いものとする。
+	case MQMAT_ID_SHADER_NAME:
+		*(int*)array[2] = copyString(std::string(), (char*)array[0], *(int*)array[1]);
+		break;
+	case MQMAT_ID_SHADER_PARAM_NUM:
+	case MQMAT_ID_SHADER_MAP_NUM:
+		*(int*)array[0] = 0;
+		break;
+	}
+}
+
+static void MQAPICALL mock_Mat_SetValueArray(MQMaterial mat, int type_id, void **array)
+{
+	MockMaterial *m = toMat(mat);
+	switch(type_id){
+	case MQMAT_ID_NAME_W: m->name = (const wchar_t*)array[0]; break;
+	case MQMAT_ID_TEXTURE_NAME_W: m->textureName = (const wchar_t*)array[0]; break;
+	case MQMAT_ID_ALPHA_NAME_W: m->alphaName = (const wchar_t*)array[0]; break;
+	case MQMAT_ID_BUMP_NAME_W: m->bumpName = (const wchar_t*)array[0]; break;
+	case MQMAT_ID_SHADER_NAME: *(bool*)array[1] = false; break;
+	}
+}
+
+
+//---------------------------------------------------------------------------
+//  Matrix
+//---------------------------------------------------------------------------
+
+static void MQAPICALL mock_Matrix_FloatValue(float *mtx, int type_id, float *values)
+{
+	switch(type_id){
+	case MQMATRIX_GET_SCALING: decomposeMatrix(mtx, values, NULL, NULL); break;
+	case MQMATRIX_GET_ROTATION: decomposeMatrix(mtx, NULL, values, NULL); break;
+	case MQMATRIX_GET_TRANSLATION: decomposeMatrix(mtx, NULL, NULL, values); break;
+	case MQMATRIX_SET_TRANSFORM: composeMatrix(values, mtx); break;
+	case MQMATRIX_SET_INVERSE_TRANSFORM:
+		{
+			float m[16];
+			composeMatrix(values, m);
+			inverseMatrix(m, mtx);
+		}
+		break;
+	}
+}
+
+
+//---------------------------------------------------------------------------
+//  XML
+//---------------------------------------------------------------------------
+
+// Documents can be created, but files are never loaded or saved. Resource
+// files of plug-ins are therefore treated as missing.
+// ドキュメントは作成できるが、ファイルの読み書きは常に失敗する。
+// そのためプラグインのリソースファイルは見つからないものとして扱われる。
+struct MockXmlDocument
+{
+};
+
+static void MQAPICALL mock_XmlDoc_Value(MQXmlDocument doc, int type_id, void *values)
+{
+	void **ptr = (void**)values;
+	switch(type_id){
+	case MQXMLDOC_CREATE: ptr[0] = new MockXmlDocument(); break;
+	case MQXMLDOC_DELETE: delete reinterpret_cast<MockXmlDocument*>(doc); break;
+	case MQXMLDOC_LOAD:
+	case MQXMLDOC_SAVE: *(BOOL*)ptr[1] = FALSE; break;
+	case MQXMLDOC_CREATE_ROOT_ELEMENT: ptr[1] = NULL; break;
+	case MQXMLDOC_GET_ROOT_ELEMENT: ptr[0] = NULL; break;
+	}
+}
+
+
+//---------------------------------------------------------------------------
+//  class MQMockHost
+//---------------------------------------------------------------------------
+
+void MQMockHost::Install()
+{
+	MQ_CreateObject = mock_CreateObject;
+	MQ_CreateMaterial = mock_CreateMaterial;
+	MQ_GetSystemPath = mock_GetSystemPath;
+	MQ_GetSystemPathW = mock_GetSystemPathW;
+	MQ_RefreshView = mock_RefreshView;
+	MQ_SendMessage = mock_SendMessage;
+
+	MQDoc_GetObjectCount = mock_Doc_GetObjectCount;
+	MQDoc_GetObject = mock_Doc_GetObject;
+	MQDoc_GetObjectFromUniqueID = mock_Doc_GetObjectFromUniqueID;
+	MQDoc_GetCurrentObjectIndex = mock_Doc_GetCurrentObjectIndex;
+	MQDoc_SetCurrentObjectIndex = mock_Doc_SetCurrentObjectIndex;
+	MQDoc_AddObject = mock_Doc_AddObject;
+	MQDoc_DeleteObject = mock_Doc_DeleteObject;
+	MQDoc_GetObjectIndex = mock_Doc_GetObjectIndex;
+	MQDoc_GetUnusedObjectName = mock_Doc_GetUnusedObjectName;
+	MQDoc_GetUnusedObjectNameW = mock_Doc_GetUnusedObjectNameW;
+	MQDoc_GetMaterialCount = mock_Doc_GetMaterialCount;
+	MQDoc_GetMaterial = mock_Doc_GetMaterial;
+	MQDoc_GetMaterialFromUniqueID = mock_Doc_GetMaterialFromUniqueID;
+	MQDoc_GetCurrentMaterialIndex = mock_Doc_GetCurrentMaterialIndex;
+	MQDoc_SetCurrentMaterialIndex = mock_Doc_SetCurrentMaterialIndex;
+	MQDoc_AddMaterial = mock_Doc_AddMaterial;
+	MQDoc_DeleteMaterial = mock_Doc_DeleteMaterial;
+	MQDoc_GetUnusedMaterialName = mock_Doc_GetUnusedMaterialName;
+	MQDoc_GetUnusedMaterialNameW = mock_Doc_GetUnusedMaterialNameW;
+	MQDoc_FindMappingFile = mock_Doc_FindMappingFile;
+	MQDoc_FindMappingFileW = mock_Doc_FindMappingFileW;
+	MQDoc_GetMappingImage = mock_Doc_GetMappingImage;
+	MQDoc_GetMappingImageW = mock_Doc_GetMappingImageW;
+	MQDoc_Compact = mock_Doc_Compact;
+	MQDoc_GetParentObject = mock_Doc_GetParentObject;
+	MQDoc_GetChildObjectCount = mock_Doc_GetChildObjectCount;
+	MQDoc_GetChildObject = mock_Doc_GetChildObject;
+	MQDoc_GetGlobalMatrix = mock_Doc_GetGlobalMatrix;
+	MQDoc_GetGlobalInverseMatrix = mock_Doc_GetGlobalInverseMatrix;
+	MQDoc_InsertObject = mock_Doc_InsertObject;
+	MQDoc_RemoveObject = mock_Doc_RemoveObject;
+	MQDoc_Triangulate = mock_Doc_Triangulate;
+
+	MQObj_Delete = mock_Obj_Delete;
+	MQObj_Clone = mock_Obj_Clone;
+	MQObj_Merge = mock_Obj_Merge;
+	MQObj_Clear = mock_Obj_Clear;
+	MQObj_Freeze = mock_Obj_Freeze;
+	MQObj_GetVertexCount = mock_Obj_GetVertexCount;
+	MQObj_GetVertex = mock_Obj_GetVertex;
+	MQObj_SetVertex = mock_Obj_SetVertex;
+	MQObj_GetVertexArray = mock_Obj_GetVertexArray;
+	MQObj_GetFaceCount = mock_Obj_GetFaceCount;
+	MQObj_GetFacePointCount = mock_Obj_GetFacePointCount;
+	MQObj_GetFacePointArray = mock_Obj_GetFacePointArray;
+	MQObj_GetFaceCoordinateArray = mock_Obj_GetFaceCoordinateArray;
+	MQObj_GetFaceCoordinate = mock_Obj_GetFaceCoordinate;
+	MQObj_GetFaceChannelCoordinate = mock_Obj_GetFaceChannelCoordinate;
+	MQObj_GetFaceMaterial = mock_Obj_GetFaceMaterial;
+	MQObj_GetFaceUniqueID = mock_Obj_GetFaceUniqueID;
+	MQObj_GetFaceIndexFromUniqueID = mock_Obj_GetFaceIndexFromUniqueID;
+	MQObj_SetName = mock_Obj_SetName;
+	MQObj_AddVertex = mock_Obj_AddVertex;
+	MQObj_DeleteVertex = mock_Obj_DeleteVertex;
+	MQObj_GetVertexRefCount = mock_Obj_GetVertexRefCount;
+	MQObj_GetVertexUniqueID = mock_Obj_GetVertexUniqueID;
+	MQObj_GetVertexIndexFromUniqueID = mock_Obj_GetVertexIndexFromUniqueID;
+	MQObj_GetVertexRelatedFaces = mock_Obj_GetVertexRelatedFaces;
+	MQObj_GetVertexWeight = mock_Obj_GetVertexWeight;
+	MQObj_SetVertexWeight = mock_Obj_SetVertexWeight;
+	MQObj_CopyVertexAttribute = mock_Obj_CopyVertexAttribute;
+	MQObj_AddFace = mock_Obj_AddFace;
+	MQObj_InsertFace = mock_Obj_InsertFace;
+	MQObj_DeleteFace = mock_Obj_DeleteFace;
+	MQObj_InvertFace = mock_Obj_InvertFace;
+	MQObj_SetFaceMaterial = mock_Obj_SetFaceMaterial;
+	MQObj_SetFaceCoordinateArray = mock_Obj_SetFaceCoordinateArray;
+	MQObj_SetFaceCoordinate = mock_Obj_SetFaceCoordinate;
+	MQObj_SetFaceChannelCoordinate = mock_Obj_SetFaceChannelCoordinate;
+	MQObj_GetFaceVertexColor = mock_Obj_GetFaceVertexColor;
+	MQObj_SetFaceVertexColor = mock_Obj_SetFaceVertexColor;
+	MQObj_GetFaceEdgeCrease = mock_Obj_GetFaceEdgeCrease;
+	MQObj_SetFaceEdgeCrease = mock_Obj_SetFaceEdgeCrease;
+	MQObj_GetFaceVertexNormal = mock_Obj_GetFaceVertexNormal;
+	MQObj_SetFaceVertexNormal = mock_Obj_SetFaceVertexNormal;
+	MQObj_GetFaceVisible = mock_Obj_GetFaceVisible;
+	MQObj_SetFaceVisible = mock_Obj_SetFaceVisible;
+	MQObj_OptimizeVertex = mock_Obj_OptimizeVertex;
+	MQObj_Compact = mock_Obj_Compact;
+	MQObj_GetVisible = mock_Obj_GetVisible;
+	MQObj_SetVisible = mock_Obj_SetVisible;
+	MQObj_GetPatchType = mock_Obj_GetPatchType;
+	MQObj_SetPatchType = mock_Obj_SetPatchType;
+	MQObj_GetPatchSegment = mock_Obj_GetPatchSegment;
+	MQObj_SetPatchSegment = mock_Obj_SetPatchSegment;
+	MQObj_GetShading = mock_Obj_GetShading;
+	MQObj_SetShading = mock_Obj_SetShading;
+	MQObj_GetSmoothAngle = mock_Obj_GetSmoothAngle;
+	MQObj_SetSmoothAngle = mock_Obj_SetSmoothAngle;
+	MQObj_GetMirrorType = mock_Obj_GetMirrorType;
+	MQObj_SetMirrorType = mock_Obj_SetMirrorType;
+	MQObj_GetMirrorAxis = mock_Obj_GetMirrorAxis;
+	MQObj_SetMirrorAxis = mock_Obj_SetMirrorAxis;
+	MQObj_GetMirrorDistance = mock_Obj_GetMirrorDistance;
+	MQObj_SetMirrorDistance = mock_Obj_SetMirrorDistance;
+	MQObj_GetLatheType = mock_Obj_GetLatheType;
+	MQObj_SetLatheType = mock_Obj_SetLatheType;
+	MQObj_GetLatheAxis = mock_Obj_GetLatheAxis;
+	MQObj_SetLatheAxis = mock_Obj_SetLatheAxis;
+	MQObj_GetLatheSegment = mock_Obj_GetLatheSegment;
+	MQObj_SetLatheSegment = mock_Obj_SetLatheSegment;
+	MQObj_GetIntValue = mock_Obj_GetIntValue;
+	MQObj_GetFloatArray = mock_Obj_GetFloatArray;
+	MQObj_SetIntValue = mock_Obj_SetIntValue;
+	MQObj_SetFloatArray = mock_Obj_SetFloatArray;
+	MQObj_PointerArray = mock_Obj_PointerArray;
+
+	MQMat_Delete = mock_Mat_Delete;
+	MQMat_GetIntValue = mock_Mat_GetIntValue;
+	MQMat_GetFloatArray = mock_Mat_GetFloatArray;
+	MQMat_GetColor = mock_Mat_GetColor;
+	MQMat_GetAlpha = mock_Mat_GetAlpha;
+	MQMat_GetDiffuse = mock_Mat_GetDiffuse;
+	MQMat_GetAmbient = mock_Mat_GetAmbient;
+	MQMat_GetEmission = mock_Mat_GetEmission;
+	MQMat_GetSpecular = mock_Mat_GetSpecular;
+	MQMat_GetPower = mock_Mat_GetPower;
+	MQMat_GetTextureName = mock_Mat_GetTextureName;
+	MQMat_GetAlphaName = mock_Mat_GetAlphaName;
+	MQMat_GetBumpName = mock_Mat_GetBumpName;
+	MQMat_SetIntValue = mock_Mat_SetIntValue;
+	MQMat_SetFloatArray = mock_Mat_SetFloatArray;
+	MQMat_SetName = mock_Mat_SetName;
+	MQMat_SetColor = mock_Mat_SetColor;
+	MQMat_SetAlpha = mock_Mat_SetAlpha;
+	MQMat_SetDiffuse = mock_Mat_SetDiffuse;
+	MQMat_SetAmbient = mock_Mat_SetAmbient;
+	MQMat_SetEmission = mock_Mat_SetEmission;
+	MQMat_SetSpecular = mock_Mat_SetSpecular;
+	MQMat_SetPower = mock_Mat_SetPower;
+	MQMat_SetTextureName = mock_Mat_SetTextureName;
+	MQMat_SetAlphaName = mock_Mat_SetAlphaName;
+	MQMat_SetBumpName = mock_Mat_SetBumpName;
+	MQMat_GetValueArray = mock_Mat_GetValueArray;
+	MQMat_SetValueArray = mock_Mat_SetValueArray;
+
+	MQMatrix_FloatValue = mock_Matrix_FloatValue;
+
+	MQXmlDoc_Value = mock_XmlDoc_Value;
+}
+
+MQDocument MQMockHost::CreateDocument()
+{
+	return fromDoc(new MockDocument());
+}
+
+void MQMockHost::DeleteDocument(MQDocument doc)
+{
+	MockDocument *d = toDoc(doc);
+	if(d == NULL) return;
+	for(MockObject *o : d->objects) delete o;
+	for(MockMaterial *m : d->materials) delete m;
+	delete d;
+}
+
+void MQMockHost::AddMappingImage(MQDocument doc, const wchar_t *filename, DWORD map_type, int width, int height, int bpp, const BYTE *buffer, const RGBQUAD *colors)
+{
+	MockDocument *d = toDoc(doc);
+	if(d == NULL || filename == NULL || buffer == NULL) return;
+
+	MockImage image;
+	image.width = width;
+	image.height = height;
+	image.bpp = bpp;
+	size_t stride = (((size_t)width * bpp + 31) / 32) * 4;
+	image.buffer.assign(buffer, buffer + stride * height);
+	if(bpp == 8 && colors != NULL){
+		image.colors.assign(colors, colors + 256);
+	}
+	d->images[std::make_pair(map_type, std::wstring(filename))] = image;
+}
+
+void MQMockHost::SetMessageHandler(MessageHandler handler)
+{
+	s_MessageHandler = handler;
+}
@@ -0,0 +1,63 @@
+﻿//---------------------------------------------------------------------------
+//
+//   MQMockHost.h
+//
+//     An in-memory stand-in for the Metasequoia host. It implements the
+//    MQ_*, MQDoc_*, MQObj_*, MQMat_* and MQMatrix_* function pointers
+//    declared in MQPlugin.h, so that plug-in code can be built and run on
+//    Linux for tests and benchmarks.
+//
+//    　Metasequoia本体の代わりにメモリ上のデータで動作する模擬ホスト。
+//    MQPlugin.hのMQ_*, MQDoc_*, MQObj_*, MQMat_*, MQMatrix_*関数ポインタを
+//    実装し、Linux上でプラグインのコードをビルド・実行できるようにする。
+//
+//     Only the functions used by the geometry and export code are
+//    implemented. XML documents can be created but never load a file, so
+//    resource files of plug-ins are missing. The other pointers (scenes,
+//    user data, XML elements, widgets, canvas, shader nodes) are left NULL.
+//    　実装しているのはジオメトリとエクスポートで使う関数だけ。XMLドキュメントは
+//    作成できるがファイルは読めないので、プラグインのリソースファイルは無いものと
+//    なる。シーン、ユーザーデータ、XML要素、ウィジェット、キャンバス、
+//    シェーダーノードの関数ポインタはNULLのままとなる。
+//
+//---------------------------------------------------------------------------
+
+#ifndef _MQMOCKHOST_H_
+#define _MQMOCKHOST_H_
+
+#include "MQPlugin.h"
+
+
+class MQMockHost
+{
+public:
+	// Handler for MQ_SendMessage(). Return FALSE if the message is not handled.
+	// MQ_SendMessage()の処理関数。処理しない場合はFALSEを返す。
+	typedef BOOL (*MessageHandler)(int message_type, MQSendMessageInfo *info);
+
+	// Assign the host function pointers. Call it once before using any SDK class.
+	// ホストの関数ポインタを設定する。SDKのクラスを使う前に一度呼び出す。
+	static void Install();
+
+	// Create an empty document.
+	// 空のドキュメントを作成する。
+	static MQDocument CreateDocument();
+
+	// Delete a document with all objects and materials in it.
+	// ドキュメントを中のオブジェクト・材質と共に削除する。
+	static void DeleteDocument(MQDocument doc);
+
+	// Register an image returned by MQDoc_GetMappingImage() for the file name.
+	// The buffer is a bottom-up DIB with rows aligned to 4 bytes. An 8-bit
+	// image needs 256 palette colors.
+	// MQDoc_GetMappingImage()がファイル名に対して返す画像を登録する。
+	// バッファは1行が4バイト境界の下から並ぶDIB。8ビット画像には256色のパレットが必要。
+	static void AddMappingImage(MQDocument doc, const wchar_t *filename, DWORD map_type, int width, int height, int bpp, const BYTE *buffer, const RGBQUAD *colors = NULL);
+
+	// Set a handler for MQ_SendMessage(). NULL makes every message fail.
+	// MQ_SendMessage()の処理関数を設定する。NULLなら常に失敗する。
+	static void SetMessageHandler(MessageHandler handler);
+};
+
+
+#endif //_MQMOCKHOST_H_
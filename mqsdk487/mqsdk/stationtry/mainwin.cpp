@@ -5,10 +5,21 @@
 
 #include "MQBoneManager.h"
 
+#include <algorithm>
+
+// ポーズ適用の間隔(ms). 60fps 相当
+#define POSE_FRAME_MS (16)
+
 
 MainWindow::MainWindow(WidgetTestPlugin *plugin, MQWindowBase& parent) : MQWindow(parent)
 {
 	m_pPlugin = plugin;
+	m_PosePending = false;
+	m_PlaybackDirty = true;
+	m_PlayButton = nullptr;
+	m_SkinButton = nullptr;
+	m_SkinDQCheck = nullptr;
+	m_PlayStartTick = 0;
 
 	SetTitle(L"Station Try Widget Test");
 	SetOutSpace(0.4);
@@ -372,6 +383,20 @@ MQFrame *MainWindow::CreateSliderFrame(MQWidgetBase *parent)
 	m_Slider->AddChangedEvent(this, &MainWindow::SliderChanged);
 	m_Slider->AddChangingEvent(this, &MainWindow::SliderChanging);
 
+	m_PlayButton = CreateButton(root, L"Play");
+	m_PlayButton->SetToggle(true);
+	m_PlayButton->AddClickEvent(this, &MainWindow::PlayButtonClick);
+	// キー情報が設定されるまでは再生できない
+	m_PlayButton->SetEnabled(!m_BonesInfo.keyvals.empty());
+
+	m_SkinButton = CreateButton(root, L"Skinning preview");
+	m_SkinButton->SetToggle(true);
+	m_SkinButton->AddClickEvent(this, &MainWindow::SkinButtonClick);
+
+	m_SkinDQCheck = CreateCheckBox(root);
+	m_SkinDQCheck->SetText(L"Dual quaternion");
+	m_SkinDQCheck->AddChangedEvent(this, &MainWindow::SkinDQChanged);
+
 	MQFrame *frame;
 	MQLabel *label;
 	int r,g,b,a;
@@ -806,43 +831,112 @@ BOOL MainWindow::DSpinBoxChanging(MQWidgetBase *sender, MQDocument doc)
 int MainWindow::changeBone(MQDocument doc, BONESINFO& boneInfo)
 {
 	MQBoneManager bone_manager(this->m_pPlugin, doc);
-	int bone_num = bone_manager.GetBoneNum();
+	// IDリストはキャッシュを使い回す
+	int bone_num = bone_manager.RefreshBoneSnapshot(m_BoneSnapshot, 0);
 	if (bone_num == 0) {
 		return 0;
 	}
 
-	// Enum bones ボーンのIDリスト
-	std::vector<UINT> bone_id;
-	//std::vector<GPBBoneParam> bone_param;
-
-	bone_id.resize(bone_num); // 領域確保する
-	bone_manager.EnumBoneID(bone_id); // IDリストを取得
-
+	m_PoseParams.resize(bone_num);
 	for (int i = 0; i < bone_num; ++i) {
-		std::wstring name;
-		MQPoint translate;
-		translate.x = 10.0f * (float)i;
-		translate.y = (float)(i * i);
-		translate.z = 0.0f;
-		bone_manager.SetDeformTranslate(bone_id[i], translate);
-		/*
-		// ボーンID指定して受け取り変数を指定する
-		bone_manager.GetParent(bone_id[i], bone_param[i].parent);
-		// 子ボーン個数
-		bone_manager.GetChildNum(bone_id[i], bone_param[i].child_num);
-		bone_manager.GetBasePos(bone_id[i], bone_param[i].org_pos);
-		bone_manager.GetDeformPos(bone_id[i], bone_param[i].def_pos);
-		bone_manager.GetDeformMatrix(bone_id[i], bone_param[i].mtx);
-		bone_manager.GetBaseMatrix(bone_id[i], bone_param[i].base_mtx);
-		//bone_manager.GetDeformScale(bone_id[i], bone_param[i].scale);
-		bone_manager.GetName(bone_id[i], name);
-		bone_manager.GetDummy(bone_id[i], bone_param[i].dummy);
-		*/
+		MQBoneManager::DEFORM_PARAM& param = m_PoseParams[i];
+		param.bone_id = m_BoneSnapshot.id[i];
+		param.set_flags = MQBoneManager::DEFORM_PARAM::SET_TRANSLATE;
+		param.translate.x = 10.0f * (float)i;
+		param.translate.y = (float)(i * i);
+		param.translate.z = 0.0f;
 	}
-	bone_manager.Update();
+	applyPose(doc, bone_manager);
 	return 1;
 }
 
+void MainWindow::applyPose(MQDocument doc, MQBoneManager& bone_manager)
+{
+	// 全ボーンを設定してから Update() を1回だけ呼ぶ.
+	// ボーンの変形行列は SetBone では変わらず Update() で計算し直されるので、
+	// プレビュー中も Update() の後で行列を取り直す
+	bone_manager.SetDeformArray(m_PoseParams.data(), m_PoseParams.size());
+	if (m_SkinButton != nullptr && m_SkinButton->GetDown()) {
+		updateSkinPreview(doc, bone_manager);
+	}
+}
+
+void MainWindow::updateSkinPreview(MQDocument doc, MQBoneManager& bone_manager)
+{
+	int bone_num = bone_manager.RefreshBoneSnapshot(m_BoneSnapshot, MQBoneManager::SNAPSHOT_DEFORM);
+	if (bone_num == 0) {
+		m_Skin.clear();
+		m_SkinnedPos.clear();
+		return;
+	}
+	if (!(m_BoneSnapshot.flags & MQBoneManager::SNAPSHOT_BASE)) {
+		bone_manager.RefreshBoneSnapshot(m_BoneSnapshot, MQBoneManager::SNAPSHOT_BASE);
+	}
+
+	// 基本姿勢とウェイトはカレントオブジェクトが変わったときだけ取り直す
+	MQObject obj = doc->GetObject(doc->GetCurrentObjectIndex());
+	if (obj == nullptr) {
+		m_Skin.clear();
+		m_SkinnedPos.clear();
+		return;
+	}
+	if (m_Skin.isEmpty() || m_Skin.getObjectUniqueID() != obj->GetUniqueID() || m_Skin.getVertexCount() != obj->GetVertexCount()) {
+		m_Skin.build(bone_manager, obj, m_BoneSnapshot);
+	}
+
+	SkinningPreview::MODE mode = (m_SkinDQCheck != nullptr && m_SkinDQCheck->GetChecked())
+		? SkinningPreview::MODE_DUAL_QUATERNION : SkinningPreview::MODE_LINEAR;
+	SkinningPreview::buildPalette(m_BoneSnapshot, m_SkinPalette, mode);
+	m_Skin.deform(m_SkinPalette, m_SkinnedPos, mode);
+
+	m_pPlugin->RedrawAllScene();
+}
+
+void MainWindow::drawSkinPreview(MQDocument doc)
+{
+	if (m_SkinButton == nullptr || !m_SkinButton->GetDown() || m_SkinnedPos.empty()) {
+		return;
+	}
+	MQObject src = doc->GetObjectFromUniqueID(m_Skin.getObjectUniqueID());
+	if (src == nullptr) {
+		return;
+	}
+
+	// 面の構成は元のオブジェクトを複製して使い、頂点位置だけ差し替える
+	MQObject draw = m_pPlugin->CreateDrawingObjectByClone(doc, src, MQBasePlugin::DRAW_OBJECT_LINE);
+	if (draw == nullptr) {
+		return;
+	}
+	int num = std::min(draw->GetVertexCount(), (int)m_SkinnedPos.size());
+	for (int i = 0; i < num; ++i) {
+		draw->SetVertex(i, m_SkinnedPos[i]);
+	}
+}
+
+BOOL MainWindow::SkinButtonClick(MQWidgetBase *sender, MQDocument doc)
+{
+	m_Skin.clear();
+	m_SkinnedPos.clear();
+	if (m_SkinButton->GetDown()) {
+		MQBoneManager bone_manager(this->m_pPlugin, doc);
+		bone_manager.RefreshBoneSnapshot(m_BoneSnapshot, MQBoneManager::SNAPSHOT_BASE);
+		updateSkinPreview(doc, bone_manager);
+	}
+	else {
+		m_pPlugin->RedrawAllScene();
+	}
+	return FALSE;
+}
+
+BOOL MainWindow::SkinDQChanged(MQWidgetBase *sender, MQDocument doc)
+{
+	if (m_SkinButton->GetDown()) {
+		MQBoneManager bone_manager(this->m_pPlugin, doc);
+		updateSkinPreview(doc, bone_manager);
+	}
+	return FALSE;
+}
+
 /// <summary>
 /// スライダー変化時の処理か
 /// </summary>
@@ -865,8 +959,136 @@ BOOL MainWindow::SliderChanging(MQWidgetBase *sender, MQDocument doc)
 	swprintf_s(text, L"Slider changing %d %f", ipos, pos);
 
 	m_BottomLabel->SetText(text);
-	BONESINFO bonesInfo;
-	this->changeBone(doc, bonesInfo);
+
+	// ドラッグ中のイベントはまとめて次のフレームで1回だけ適用する
+	m_PosePending = true;
+	if (!ExistsTimerEvent(this, &MainWindow::PoseTimer)) {
+		AddTimerEvent(this, &MainWindow::PoseTimer, POSE_FRAME_MS);
+	}
+	return FALSE;
+}
+
+/// <summary>
+/// 保留中のポーズを適用する
+/// </summary>
+BOOL MainWindow::PoseTimer(MQWidgetBase *sender, MQDocument doc)
+{
+	if (!m_PosePending) {
+		return FALSE;
+	}
+	m_PosePending = false;
+
+	if (m_BonesInfo.keyvals.empty()) {
+		BONESINFO bonesInfo;
+		this->changeBone(doc, bonesInfo);
+		return FALSE;
+	}
+
+	// キー情報があればスライダー位置を時刻とみなす
+	double rate = (m_Slider->GetPosition() - m_Slider->GetMin()) / (m_Slider->GetMax() - m_Slider->GetMin());
+	this->playBone(doc, (int)(rate * m_Playback.getDuration()));
+	return FALSE;
+}
+
+void MainWindow::clearDocumentCache()
+{
+	// 同じボーンIDが別のドキュメントで使われることもあるので、IDの比較に頼らず捨てる
+	m_BoneSnapshot.clear();
+	m_Skin.clear();
+	m_SkinnedPos.clear();
+	m_PlaybackDirty = true;
+}
+
+void MainWindow::setBonesInfo(const BONESINFO& info)
+{
+	m_BonesInfo = info;
+	m_PlaybackDirty = true;
+
+	if (m_PlayButton != nullptr) {
+		bool playable = !m_BonesInfo.keyvals.empty();
+		if (!playable) {
+			stopPlayback();
+		}
+		m_PlayButton->SetEnabled(playable);
+	}
+}
+
+void MainWindow::stopPlayback()
+{
+	m_PlayButton->SetDown(false);
+	if (ExistsTimerEvent(this, &MainWindow::PlaybackTimer)) {
+		RemoveTimerEvent(this, &MainWindow::PlaybackTimer);
+	}
+}
+
+int MainWindow::playBone(MQDocument doc, int msec)
+{
+	MQBoneManager bone_manager(this->m_pPlugin, doc);
+
+	bool rebuilt = false;
+	int bone_num = bone_manager.RefreshBoneSnapshot(m_BoneSnapshot, 0, &rebuilt);
+	if (bone_num == 0) {
+		return 0;
+	}
+
+	// ボーン名の解決はキー情報かボーン構成が変わったときだけ行う
+	if (m_PlaybackDirty || rebuilt || !(m_BoneSnapshot.flags & MQBoneManager::SNAPSHOT_NAME)) {
+		bone_manager.RefreshBoneSnapshot(m_BoneSnapshot, MQBoneManager::SNAPSHOT_NAME);
+		m_Playback.compile(m_BonesInfo, m_BoneSnapshot);
+		m_PlaybackDirty = false;
+	}
+	if (m_Playback.isEmpty()) {
+		return 0;
+	}
+
+	int num = m_Playback.evaluate(msec, m_PoseParams);
+	applyPose(doc, bone_manager);
+	return num;
+}
+
+BOOL MainWindow::PlayButtonClick(MQWidgetBase *sender, MQDocument doc)
+{
+	if (m_PlayButton->GetDown()) {
+		if (m_BonesInfo.keyvals.empty()) {
+			stopPlayback();
+			return FALSE;
+		}
+		m_PlayStartTick = GetTickCount();
+		AddTimerEvent(this, &MainWindow::PlaybackTimer, POSE_FRAME_MS, true);
+	}
+	else {
+		RemoveTimerEvent(this, &MainWindow::PlaybackTimer);
+	}
+	return FALSE;
+}
+
+/// <summary>
+/// 再生中は1フレームごとに姿勢を更新する
+/// </summary>
+BOOL MainWindow::PlaybackTimer(MQWidgetBase *sender, MQDocument doc)
+{
+	if (!m_PlayButton->GetDown()) {
+		return FALSE;
+	}
+
+	// 最後のキーまで行ったら先頭に戻る
+	int elapsed = (int)(GetTickCount() - m_PlayStartTick);
+	int duration = m_Playback.getDuration();
+	int msec = (duration > 0) ? (elapsed % (duration + 1)) : 0;
+	int num = this->playBone(doc, msec);
+
+	// キーがどのボーンにも当たらなければ再生を止める
+	if (m_Playback.isEmpty()) {
+		stopPlayback();
+		m_BottomLabel->SetText(L"Play stopped: no keys for the bones");
+		return FALSE;
+	}
+
+	wchar_t text[64];
+	swprintf_s(text, L"Play %d ms %d bones", msec, num);
+	m_BottomLabel->SetText(text);
+
+	AddTimerEvent(this, &MainWindow::PlaybackTimer, POSE_FRAME_MS, true);
 	return FALSE;
 }
 
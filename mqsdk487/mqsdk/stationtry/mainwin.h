@@ -2,8 +2,11 @@
 #pragma once
 
 #include "MQWidget.h"
+#include "MQBoneManager.h"
 
 #include "datastruct.h"
+#include "playback.h"
+#include "skinning.h"
 
 class WidgetTestPlugin;
 
@@ -74,7 +77,102 @@ public:
 	/// <returns></returns>
 	int changeBone(MQDocument doc, BONESINFO& boneInfo);
 
+	/// <summary>
+	/// ボーン情報のキャッシュ. ボーンIDの並びが変わったら取り直す
+	/// </summary>
+	MQBoneManager::BONE_SNAPSHOT m_BoneSnapshot;
+
+	/// <summary>
+	/// ドキュメントが切り替わったのでボーンとスキニングのキャッシュを捨てる
+	/// </summary>
+	void clearDocumentCache();
+
+	/// <summary>
+	/// ポーズ適用用の再利用バッファ
+	/// </summary>
+	std::vector<MQBoneManager::DEFORM_PARAM> m_PoseParams;
+
+	/// <summary>
+	/// スライダー変化でポーズ適用待ちかどうか. 1フレームに1回だけ適用する
+	/// </summary>
+	bool m_PosePending;
+
+	/// <summary>
+	/// 再生するキー情報
+	/// </summary>
+	BONESINFO m_BonesInfo;
+
+	/// <summary>
+	/// m_BonesInfo をボーンごとに並べ替えたもの
+	/// </summary>
+	BonePlayback m_Playback;
+
+	/// <summary>
+	/// m_BonesInfo かボーン構成が変わったので compile し直すかどうか
+	/// </summary>
+	bool m_PlaybackDirty;
+
+	MQButton *m_PlayButton;
+
+	/// <summary>
+	/// 再生開始時の GetTickCount()
+	/// </summary>
+	DWORD m_PlayStartTick;
+
+	/// <summary>
+	/// 再生するキー情報を設定する
+	/// </summary>
+	void setBonesInfo(const BONESINFO& info);
+
+	/// <summary>
+	/// 再生ボタンを上げてタイマーを止める
+	/// </summary>
+	void stopPlayback();
+
+	/// <summary>
+	/// 時刻 msec の姿勢を適用する
+	/// </summary>
+	/// <returns>適用したボーン数</returns>
+	int playBone(MQDocument doc, int msec);
+
+	/// <summary>
+	/// カレントオブジェクトの CPU スキニング
+	/// </summary>
+	SkinningPreview m_Skin;
+
+	MQButton *m_SkinButton;
+
+	/// <summary>
+	/// プレビューをデュアルクォータニオンで計算する
+	/// </summary>
+	MQCheckBox *m_SkinDQCheck;
+
+	/// <summary>
+	/// 関節パレットの再利用バッファ
+	/// </summary>
+	std::vector<float> m_SkinPalette;
+
+	/// <summary>
+	/// 変形後の頂点位置. OnDraw() で描画オブジェクトに反映する
+	/// </summary>
+	std::vector<MQPoint> m_SkinnedPos;
+
+	/// <summary>
+	/// OnDraw() から呼ぶ. スキニング結果を描画オブジェクトで表示する
+	/// </summary>
+	void drawSkinPreview(MQDocument doc);
+
 private:
+	/// <summary>
+	/// ポーズを設定する. プレビュー中は Update() 後の変形行列から CPU でも計算する
+	/// </summary>
+	void applyPose(MQDocument doc, MQBoneManager& bone_manager);
+
+	/// <summary>
+	/// 現在のボーン姿勢で m_SkinnedPos を計算する
+	/// </summary>
+	void updateSkinPreview(MQDocument doc, MQBoneManager& bone_manager);
+
 	MQFrame *CreateButtonFrame(MQWidgetBase *parent);
 	MQFrame *CreateCheckFrame(MQWidgetBase *parent);
 	MQFrame *CreateComboFrame(MQWidgetBase *parent);
@@ -126,6 +224,11 @@ private:
 	BOOL DSpinBoxChanging(MQWidgetBase *sender, MQDocument doc);
 	BOOL SliderChanged(MQWidgetBase *sender, MQDocument doc);
 	BOOL SliderChanging(MQWidgetBase *sender, MQDocument doc);
+	BOOL PoseTimer(MQWidgetBase *sender, MQDocument doc);
+	BOOL PlayButtonClick(MQWidgetBase *sender, MQDocument doc);
+	BOOL PlaybackTimer(MQWidgetBase *sender, MQDocument doc);
+	BOOL SkinButtonClick(MQWidgetBase *sender, MQDocument doc);
+	BOOL SkinDQChanged(MQWidgetBase *sender, MQDocument doc);
 	BOOL ScrollBarChanged(MQWidgetBase *sender, MQDocument doc);
 	BOOL ScrollBarChanging(MQWidgetBase *sender, MQDocument doc);
 	BOOL ScrollSpinChanged(MQWidgetBase *sender, MQDocument doc);
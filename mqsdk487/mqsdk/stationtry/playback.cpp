@@ -0,0 +1,157 @@
+﻿
+#include "stdafx.h"
+#include "playback.h"
+
+#include <algorithm>
+#include <map>
+
+
+/// <summary>
+/// 角度の差を -180 から 180 の範囲にする
+/// </summary>
+static float _wrapDegree(float deg) {
+	while (deg > 180.0f) {
+		deg -= 360.0f;
+	}
+	while (deg < -180.0f) {
+		deg += 360.0f;
+	}
+	return deg;
+}
+
+static float _lerp(float a, float b, float t) {
+	return a + (b - a) * t;
+}
+
+/// <summary>
+/// 角度は近い向きで補間する
+/// </summary>
+static float _lerpDegree(float a, float b, float t) {
+	return a + _wrapDegree(b - a) * t;
+}
+
+
+BonePlayback::BonePlayback()
+{
+	m_Duration = 0;
+}
+
+void BonePlayback::clear()
+{
+	m_Channels.clear();
+	m_Duration = 0;
+}
+
+int BonePlayback::compile(const BONESINFO& info, const MQBoneManager::BONE_SNAPSHOT& snapshot)
+{
+	clear();
+
+	// ボーン名からボーンのインデックスを引く
+	std::map<std::wstring, int> name_index;
+	for (size_t i = 0; i < snapshot.name.size(); ++i) {
+		name_index[snapshot.name[i]] = (int)i;
+	}
+	// ボーンのインデックスからチャンネルを引く
+	std::vector<int> bone_channel(snapshot.size(), -1);
+
+	// 時刻順に処理する
+	std::vector<int> order(info.keyvals.size());
+	for (size_t i = 0; i < order.size(); ++i) {
+		order[i] = (int)i;
+	}
+	std::stable_sort(order.begin(), order.end(),
+		[&info](int a, int b) { return info.keyvals[a].msec < info.keyvals[b].msec; });
+
+	for (int ki : order) {
+		const ONEKEYVAL& keyval = info.keyvals[ki];
+		for (const auto& target : keyval.vals) {
+			auto it = name_index.find(target.target);
+			if (it == name_index.end()) {
+				continue; // 存在しないボーン
+			}
+			int& chi = bone_channel[it->second];
+			if (chi < 0) {
+				Channel ch;
+				ch.bone_id = snapshot.id[it->second];
+				chi = (int)m_Channels.size();
+				m_Channels.push_back(ch);
+			}
+
+			Channel& ch = m_Channels[chi];
+			if (!ch.times.empty() && ch.times.back() == keyval.msec) {
+				ch.values.back() = target.val; // 同時刻は後勝ち
+			}
+			else {
+				ch.times.push_back(keyval.msec);
+				ch.values.push_back(target.val);
+			}
+			m_Duration = std::max(m_Duration, keyval.msec);
+		}
+	}
+
+	return (int)m_Channels.size();
+}
+
+/// <summary>
+/// times[i] <= msec < times[i+1] となる i を返す.
+/// 再生中はほとんど前回と同じか次の区間なので、先にそこを調べる
+/// </summary>
+int BonePlayback::findSegment(Channel& ch, int msec)
+{
+	const int num = (int)ch.times.size();
+	int c = ch.cursor;
+	if (c < num - 1) {
+		if (ch.times[c] <= msec && msec < ch.times[c + 1]) {
+			return c;
+		}
+		if (c + 2 < num && ch.times[c + 1] <= msec && msec < ch.times[c + 2]) {
+			ch.cursor = c + 1;
+			return c + 1;
+		}
+	}
+
+	auto it = std::upper_bound(ch.times.begin(), ch.times.end(), msec);
+	int index = (int)(it - ch.times.begin()) - 1;
+	if (index < 0) {
+		index = 0;
+	}
+	ch.cursor = index;
+	return index;
+}
+
+int BonePlayback::evaluate(int msec, std::vector<MQBoneManager::DEFORM_PARAM>& params)
+{
+	const int num = (int)m_Channels.size();
+	params.resize(num);
+	for (int i = 0; i < num; ++i) {
+		Channel& ch = m_Channels[i];
+		MQBoneManager::DEFORM_PARAM& param = params[i];
+		param.bone_id = ch.bone_id;
+		param.set_flags = MQBoneManager::DEFORM_PARAM::SET_TRANSLATE | MQBoneManager::DEFORM_PARAM::SET_ROTATE;
+
+		ONEVAL v;
+		const int keynum = (int)ch.times.size();
+		if (keynum == 1 || msec <= ch.times.front()) {
+			v = ch.values.front();
+		}
+		else if (msec >= ch.times.back()) {
+			v = ch.values.back();
+		}
+		else {
+			int seg = findSegment(ch, msec);
+			const ONEVAL& a = ch.values[seg];
+			const ONEVAL& b = ch.values[seg + 1];
+			float t = (float)(msec - ch.times[seg]) / (float)(ch.times[seg + 1] - ch.times[seg]);
+			v.x = _lerp(a.x, b.x, t);
+			v.y = _lerp(a.y, b.y, t);
+			v.z = _lerp(a.z, b.z, t);
+			v.head = _lerpDegree(a.head, b.head, t);
+			v.pitch = _lerpDegree(a.pitch, b.pitch, t);
+			v.bank = _lerpDegree(a.bank, b.bank, t);
+		}
+
+		param.translate = MQPoint(v.x, v.y, v.z);
+		param.rotate = MQAngle(v.head, v.pitch, v.bank);
+	}
+	return num;
+}
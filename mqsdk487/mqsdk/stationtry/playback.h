@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include "MQBoneManager.h"
+
+#include "datastruct.h"
+
+
+/// <summary>
+/// BONESINFO をボーンごとのチャンネル配列に変換して再生する
+/// </summary>
+class BonePlayback
+{
+public:
+	BonePlayback();
+
+	/// <summary>
+	/// キー配列をボーンごとに並べ替える. ボーン名はここで1回だけIDに解決する
+	/// </summary>
+	/// <param name="info">キー情報</param>
+	/// <param name="snapshot">SNAPSHOT_NAME を含むボーン情報</param>
+	/// <returns>解決できたチャンネル数</returns>
+	int compile(const BONESINFO& info, const MQBoneManager::BONE_SNAPSHOT& snapshot);
+
+	void clear();
+
+	bool isEmpty() const { return m_Channels.empty(); }
+
+	/// <summary>
+	/// 最後のキーの時刻(ms)
+	/// </summary>
+	int getDuration() const { return m_Duration; }
+
+	/// <summary>
+	/// 時刻 msec の姿勢を求める. params はチャンネル数に揃える
+	/// </summary>
+	/// <returns>チャンネル数</returns>
+	int evaluate(int msec, std::vector<MQBoneManager::DEFORM_PARAM>& params);
+
+private:
+	struct Channel {
+		UINT bone_id;
+		/// 昇順の時刻
+		std::vector<int> times;
+		std::vector<ONEVAL> values;
+		/// 前回使った区間の先頭インデックス
+		int cursor;
+
+		Channel() {
+			bone_id = 0;
+			cursor = 0;
+		}
+	};
+
+	std::vector<Channel> m_Channels;
+	int m_Duration;
+
+	static int findSegment(Channel& ch, int msec);
+};
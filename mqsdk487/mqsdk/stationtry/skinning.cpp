@@ -0,0 +1,394 @@
+﻿
+#include "stdafx.h"
+#include "skinning.h"
+#include "Common/MQDualQuaternion.h"
+#include "MQ3DLib.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define SKIN_ENABLE_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define SKIN_ENABLE_AVX2 0
+#endif
+
+// MSVC は /arch 無しでも AVX2 の組み込み関数を使えるので関数単位の指定は要らない
+#if SKIN_ENABLE_AVX2 && defined(__GNUC__)
+#define SKIN_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define SKIN_TARGET_AVX2
+#endif
+
+// 1スレッドあたりの最小頂点数. 少ないときはスレッドを立てない
+#define SKIN_MIN_VERTS_PER_THREAD (16384)
+
+
+SkinningPreview::SkinningPreview()
+{
+	m_VertexNum = 0;
+	m_ObjectUniqueID = 0;
+}
+
+void SkinningPreview::clear()
+{
+	m_VertexNum = 0;
+	m_ObjectUniqueID = 0;
+	m_PosX.clear();
+	m_PosY.clear();
+	m_PosZ.clear();
+	for (int k = 0; k < INFLUENCE_NUM; ++k) {
+		m_Joint[k].clear();
+		m_Weight[k].clear();
+	}
+}
+
+int SkinningPreview::build(MQBoneManager& bone_manager, MQObject obj, const MQBoneManager::BONE_SNAPSHOT& snapshot)
+{
+	clear();
+	if (obj == nullptr) {
+		return 0;
+	}
+
+	const int vert_num = obj->GetVertexCount();
+	std::vector<MQPoint> pos(vert_num);
+	if (vert_num > 0) {
+		obj->GetVertexArray(pos.data());
+	}
+
+	MQBoneManager::VERTEX_WEIGHT_TABLE table;
+	bone_manager.GetVertexWeightTable(obj, table);
+
+	m_PosX.resize(vert_num);
+	m_PosY.resize(vert_num);
+	m_PosZ.resize(vert_num);
+	for (int k = 0; k < INFLUENCE_NUM; ++k) {
+		m_Joint[k].assign(vert_num, 0);
+		m_Weight[k].assign(vert_num, 0.0f);
+	}
+
+	std::vector<std::pair<float, int>> influences;
+	for (int i = 0; i < vert_num; ++i) {
+		m_PosX[i] = pos[i].x;
+		m_PosY[i] = pos[i].y;
+		m_PosZ[i] = pos[i].z;
+
+		// 大きい順に4つまで. 関節番号 0 は単位行列
+		influences.clear();
+		if (i < table.GetVertexCount()) {
+			int num = table.GetWeightNum(i);
+			const UINT *ids = table.GetBoneIDs(i);
+			const float *weights = table.GetWeights(i);
+			for (int j = 0; j < num; ++j) {
+				int index = snapshot.indexOf(ids[j]);
+				if (index >= 0 && weights[j] > 0.0f) {
+					influences.push_back(std::make_pair(weights[j], index + 1));
+				}
+			}
+		}
+		int use_num = std::min((int)influences.size(), (int)INFLUENCE_NUM);
+		std::partial_sort(influences.begin(), influences.begin() + use_num, influences.end(),
+			[](const std::pair<float, int>& a, const std::pair<float, int>& b) { return a.first > b.first; });
+
+		float total = 0.0f;
+		for (int k = 0; k < use_num; ++k) {
+			total += influences[k].first;
+		}
+		if (total <= 0.0f) {
+			m_Weight[0][i] = 1.0f;
+			continue;
+		}
+		for (int k = 0; k < use_num; ++k) {
+			m_Joint[k][i] = influences[k].second;
+			m_Weight[k][i] = influences[k].first / total;
+		}
+	}
+
+	m_VertexNum = vert_num;
+	m_ObjectUniqueID = obj->GetUniqueID();
+	return m_VertexNum;
+}
+
+int SkinningPreview::buildPalette(const MQBoneManager::BONE_SNAPSHOT& snapshot, std::vector<float>& palette, MODE mode)
+{
+	const int bone_num = (int)snapshot.size();
+	std::vector<MQMatrix> matrices(bone_num + 1);
+	matrices[0].Identify();
+	for (int i = 0; i < bone_num; ++i) {
+		MQMatrix inv;
+		if (!snapshot.base_matrix[i].Inverse(inv)) {
+			inv.Identify();
+		}
+		matrices[i + 1] = inv * snapshot.deform_matrix[i];
+	}
+
+	if (mode == MODE_DUAL_QUATERNION) {
+		palette.resize(matrices.size() * DQ_PALETTE_STRIDE);
+		MQDualQuaternion::toPalette(matrices.data(), matrices.size(), palette.data());
+		return bone_num + 1;
+	}
+
+	palette.resize(matrices.size() * PALETTE_STRIDE);
+	float *dst = palette.data();
+	for (const auto& mtx : matrices) {
+		for (int r = 0; r < 4; ++r) {
+			dst[r * 3 + 0] = mtx(r, 0);
+			dst[r * 3 + 1] = mtx(r, 1);
+			dst[r * 3 + 2] = mtx(r, 2);
+		}
+		dst += PALETTE_STRIDE;
+	}
+	return bone_num + 1;
+}
+
+#if SKIN_ENABLE_AVX2
+/// <summary>
+/// 8頂点ずつ処理する. 処理し終えた位置を返す
+/// </summary>
+SKIN_TARGET_AVX2
+static int _deformAVX2(const float *palette,
+	const float *px, const float *py, const float *pz,
+	const int *const *joint, const float *const *weight,
+	MQPoint *out, int begin, int end)
+{
+	const __m256i stride = _mm256_set1_epi32(SkinningPreview::PALETTE_STRIDE);
+	int v = begin;
+	for (; v + 8 <= end; v += 8) {
+		__m256 m[SkinningPreview::PALETTE_STRIDE];
+		for (int e = 0; e < SkinningPreview::PALETTE_STRIDE; ++e) {
+			m[e] = _mm256_setzero_ps();
+		}
+		for (int k = 0; k < SkinningPreview::INFLUENCE_NUM; ++k) {
+			__m256 w = _mm256_loadu_ps(weight[k] + v);
+			__m256i offset = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(joint[k] + v)), stride);
+			for (int e = 0; e < SkinningPreview::PALETTE_STRIDE; ++e) {
+				m[e] = _mm256_fmadd_ps(w, _mm256_i32gather_ps(palette + e, offset, 4), m[e]);
+			}
+		}
+
+		__m256 x = _mm256_loadu_ps(px + v);
+		__m256 y = _mm256_loadu_ps(py + v);
+		__m256 z = _mm256_loadu_ps(pz + v);
+		__m256 ox = _mm256_fmadd_ps(x, m[0], _mm256_fmadd_ps(y, m[3], _mm256_fmadd_ps(z, m[6], m[9])));
+		__m256 oy = _mm256_fmadd_ps(x, m[1], _mm256_fmadd_ps(y, m[4], _mm256_fmadd_ps(z, m[7], m[10])));
+		__m256 oz = _mm256_fmadd_ps(x, m[2], _mm256_fmadd_ps(y, m[5], _mm256_fmadd_ps(z, m[8], m[11])));
+
+		float bx[8], by[8], bz[8];
+		_mm256_storeu_ps(bx, ox);
+		_mm256_storeu_ps(by, oy);
+		_mm256_storeu_ps(bz, oz);
+		for (int i = 0; i < 8; ++i) {
+			out[v + i] = MQPoint(bx[i], by[i], bz[i]);
+		}
+	}
+	return v;
+}
+
+/// <summary>
+/// デュアルクォータニオン版. 8頂点ずつ処理する
+/// </summary>
+SKIN_TARGET_AVX2
+static int _deformDQAVX2(const float *palette,
+	const float *px, const float *py, const float *pz,
+	const int *const *joint, const float *const *weight,
+	MQPoint *out, int begin, int end)
+{
+	const __m256i stride = _mm256_set1_epi32(SkinningPreview::DQ_PALETTE_STRIDE);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 two = _mm256_set1_ps(2.0f);
+	int v = begin;
+	for (; v + 8 <= end; v += 8) {
+		__m256 q[SkinningPreview::DQ_PALETTE_STRIDE];
+		for (int e = 0; e < SkinningPreview::DQ_PALETTE_STRIDE; ++e) {
+			q[e] = zero;
+		}
+		__m256 r0[4];
+		for (int k = 0; k < SkinningPreview::INFLUENCE_NUM; ++k) {
+			__m256 w = _mm256_loadu_ps(weight[k] + v);
+			__m256i offset = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(joint[k] + v)), stride);
+			__m256 c[SkinningPreview::DQ_PALETTE_STRIDE];
+			for (int e = 0; e < SkinningPreview::DQ_PALETTE_STRIDE; ++e) {
+				c[e] = _mm256_i32gather_ps(palette + e, offset, 4);
+			}
+			if (k == 0) {
+				for (int e = 0; e < 4; ++e) {
+					r0[e] = c[e];
+				}
+			}
+			else {
+				// 最初の関節と逆向きの半球なら符号を反転する
+				__m256 dot = _mm256_fmadd_ps(c[0], r0[0], _mm256_fmadd_ps(c[1], r0[1], _mm256_fmadd_ps(c[2], r0[2], _mm256_mul_ps(c[3], r0[3]))));
+				__m256 neg = _mm256_and_ps(_mm256_cmp_ps(dot, zero, _CMP_LT_OQ), _mm256_set1_ps(-0.0f));
+				w = _mm256_xor_ps(w, neg);
+			}
+			for (int e = 0; e < SkinningPreview::DQ_PALETTE_STRIDE; ++e) {
+				q[e] = _mm256_fmadd_ps(w, c[e], q[e]);
+			}
+		}
+
+		// 実部の長さで正規化する
+		__m256 len2 = _mm256_fmadd_ps(q[0], q[0], _mm256_fmadd_ps(q[1], q[1], _mm256_fmadd_ps(q[2], q[2], _mm256_mul_ps(q[3], q[3]))));
+		__m256 inv = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(len2));
+		for (int e = 0; e < SkinningPreview::DQ_PALETTE_STRIDE; ++e) {
+			q[e] = _mm256_mul_ps(q[e], inv);
+		}
+		const __m256 &rx = q[0], &ry = q[1], &rz = q[2], &rw = q[3];
+		const __m256 &dx = q[4], &dy = q[5], &dz = q[6], &dw = q[7];
+
+		__m256 x = _mm256_loadu_ps(px + v);
+		__m256 y = _mm256_loadu_ps(py + v);
+		__m256 z = _mm256_loadu_ps(pz + v);
+
+		// c = cross(r, p) + w * p
+		__m256 cx = _mm256_fmadd_ps(rw, x, _mm256_fmsub_ps(ry, z, _mm256_mul_ps(rz, y)));
+		__m256 cy = _mm256_fmadd_ps(rw, y, _mm256_fmsub_ps(rz, x, _mm256_mul_ps(rx, z)));
+		__m256 cz = _mm256_fmadd_ps(rw, z, _mm256_fmsub_ps(rx, y, _mm256_mul_ps(ry, x)));
+		// t = 2 * (w_r * d - w_d * r + cross(r, d))
+		__m256 tx = _mm256_fmsub_ps(rw, dx, _mm256_mul_ps(dw, rx));
+		__m256 ty = _mm256_fmsub_ps(rw, dy, _mm256_mul_ps(dw, ry));
+		__m256 tz = _mm256_fmsub_ps(rw, dz, _mm256_mul_ps(dw, rz));
+		tx = _mm256_add_ps(tx, _mm256_fmsub_ps(ry, dz, _mm256_mul_ps(rz, dy)));
+		ty = _mm256_add_ps(ty, _mm256_fmsub_ps(rz, dx, _mm256_mul_ps(rx, dz)));
+		tz = _mm256_add_ps(tz, _mm256_fmsub_ps(rx, dy, _mm256_mul_ps(ry, dx)));
+		// p' = p + 2 * (cross(r, c) + t)
+		__m256 ox = _mm256_fmadd_ps(two, _mm256_add_ps(_mm256_fmsub_ps(ry, cz, _mm256_mul_ps(rz, cy)), tx), x);
+		__m256 oy = _mm256_fmadd_ps(two, _mm256_add_ps(_mm256_fmsub_ps(rz, cx, _mm256_mul_ps(rx, cz)), ty), y);
+		__m256 oz = _mm256_fmadd_ps(two, _mm256_add_ps(_mm256_fmsub_ps(rx, cy, _mm256_mul_ps(ry, cx)), tz), z);
+
+		float bx[8], by[8], bz[8];
+		_mm256_storeu_ps(bx, ox);
+		_mm256_storeu_ps(by, oy);
+		_mm256_storeu_ps(bz, oz);
+		for (int i = 0; i < 8; ++i) {
+			out[v + i] = MQPoint(bx[i], by[i], bz[i]);
+		}
+	}
+	return v;
+}
+#endif
+
+bool SkinningPreview::hasAVX2()
+{
+#if SKIN_ENABLE_AVX2
+	static const bool supported = []() {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return false;
+		}
+		__cpuid(info, 1);
+		bool fma = (info[2] & (1 << 12)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		if (!fma || !osxsave || (_xgetbv(0) & 6) != 6) {
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}();
+	return supported;
+#else
+	return false;
+#endif
+}
+
+void SkinningPreview::deformRange(const float *palette, MQPoint *out, int begin, int end, bool use_avx2) const
+{
+	int v = begin;
+#if SKIN_ENABLE_AVX2
+	if (use_avx2) {
+		const int *joint[INFLUENCE_NUM];
+		const float *weight[INFLUENCE_NUM];
+		for (int k = 0; k < INFLUENCE_NUM; ++k) {
+			joint[k] = m_Joint[k].data();
+			weight[k] = m_Weight[k].data();
+		}
+		v = _deformAVX2(palette, m_PosX.data(), m_PosY.data(), m_PosZ.data(), joint, weight, out, begin, end);
+	}
+#endif
+
+	// 残りとスカラー版
+	for (; v < end; ++v) {
+		float m[PALETTE_STRIDE] = {};
+		for (int k = 0; k < INFLUENCE_NUM; ++k) {
+			float w = m_Weight[k][v];
+			if (w == 0.0f) {
+				continue;
+			}
+			const float *src = palette + m_Joint[k][v] * PALETTE_STRIDE;
+			for (int e = 0; e < PALETTE_STRIDE; ++e) {
+				m[e] += w * src[e];
+			}
+		}
+		float x = m_PosX[v];
+		float y = m_PosY[v];
+		float z = m_PosZ[v];
+		out[v] = MQPoint(
+			x * m[0] + y * m[3] + z * m[6] + m[9],
+			x * m[1] + y * m[4] + z * m[7] + m[10],
+			x * m[2] + y * m[5] + z * m[8] + m[11]);
+	}
+}
+
+void SkinningPreview::deformRangeDQ(const float *palette, MQPoint *out, int begin, int end, bool use_avx2) const
+{
+	int v = begin;
+#if SKIN_ENABLE_AVX2
+	if (use_avx2) {
+		const int *joint[INFLUENCE_NUM];
+		const float *weight[INFLUENCE_NUM];
+		for (int k = 0; k < INFLUENCE_NUM; ++k) {
+			joint[k] = m_Joint[k].data();
+			weight[k] = m_Weight[k].data();
+		}
+		v = _deformDQAVX2(palette, m_PosX.data(), m_PosY.data(), m_PosZ.data(), joint, weight, out, begin, end);
+	}
+#endif
+
+	// 残りとスカラー版
+	for (; v < end; ++v) {
+		MQDualQuaternion dq;
+		dq.real[3] = 0.0f;
+		const float *first = palette + m_Joint[0][v] * DQ_PALETTE_STRIDE;
+		for (int k = 0; k < INFLUENCE_NUM; ++k) {
+			float w = m_Weight[k][v];
+			if (w == 0.0f) {
+				continue;
+			}
+			const float *src = palette + m_Joint[k][v] * DQ_PALETTE_STRIDE;
+			// 最初の関節と逆向きの半球なら符号を反転する
+			if (src[0] * first[0] + src[1] * first[1] + src[2] * first[2] + src[3] * first[3] < 0.0f) {
+				w = -w;
+			}
+			for (int e = 0; e < 4; ++e) {
+				dq.real[e] += w * src[e];
+				dq.dual[e] += w * src[4 + e];
+			}
+		}
+		dq.normalize();
+		out[v] = dq.transform(MQPoint(m_PosX[v], m_PosY[v], m_PosZ[v]));
+	}
+}
+
+void SkinningPreview::deform(const std::vector<float>& palette, std::vector<MQPoint>& out, MODE mode, int thread_num, bool allow_avx2) const
+{
+	out.resize(m_VertexNum);
+	if (m_VertexNum == 0 || palette.empty()) {
+		return;
+	}
+
+	const bool use_avx2 = allow_avx2 && hasAVX2();
+	auto range = (mode == MODE_DUAL_QUATERNION) ? &SkinningPreview::deformRangeDQ : &SkinningPreview::deformRange;
+
+	// 頂点が少ないときは呼び出し元のスレッドだけで処理される
+	MQParallelRange(m_VertexNum, thread_num, SKIN_MIN_VERTS_PER_THREAD, [&](int begin, int end) {
+		(this->*range)(palette.data(), out.data(), begin, end, use_avx2);
+	});
+}
@@ -0,0 +1,97 @@
+﻿#pragma once
+
+#include "MQBoneManager.h"
+
+#include <vector>
+
+
+/// <summary>
+/// ボーン変形を CPU で計算するプレビュー用のスキニング
+/// </summary>
+class SkinningPreview
+{
+public:
+	/// <summary>
+	/// 1頂点あたりのウェイト数
+	/// </summary>
+	static const int INFLUENCE_NUM = 4;
+
+	/// <summary>
+	/// パレット1関節あたりの float 数. 3x4 行列(行ベクトル形式の1-3列目)
+	/// </summary>
+	static const int PALETTE_STRIDE = 12;
+
+	/// <summary>
+	/// デュアルクォータニオンのパレット1関節あたりの float 数. 実部 xyzw, 双対部 xyzw
+	/// </summary>
+	static const int DQ_PALETTE_STRIDE = 8;
+
+	enum MODE {
+		/// 線形ブレンド(LBS)
+		MODE_LINEAR = 0,
+		/// デュアルクォータニオン(DQS)
+		MODE_DUAL_QUATERNION = 1,
+	};
+
+	SkinningPreview();
+
+	/// <summary>
+	/// 基本姿勢の頂点位置と上位4つのウェイトを保持する
+	/// </summary>
+	/// <param name="bone_manager"></param>
+	/// <param name="obj">対象オブジェクト</param>
+	/// <param name="snapshot">ボーンID一覧. パレットの並びはこの順</param>
+	/// <returns>頂点数</returns>
+	int build(MQBoneManager& bone_manager, MQObject obj, const MQBoneManager::BONE_SNAPSHOT& snapshot);
+
+	void clear();
+
+	bool isEmpty() const { return m_VertexNum == 0; }
+
+	int getVertexCount() const { return m_VertexNum; }
+
+	/// <summary>
+	/// build() したオブジェクトのユニークID
+	/// </summary>
+	UINT getObjectUniqueID() const { return m_ObjectUniqueID; }
+
+	/// <summary>
+	/// 関節パレットを作る. 先頭はウェイトの無い頂点用の単位行列で、
+	/// 以降 snapshot の順に inverse(base_matrix) * deform_matrix が並ぶ.
+	/// MODE_DUAL_QUATERNION ではそれぞれをデュアルクォータニオンにする
+	/// </summary>
+	/// <param name="snapshot">SNAPSHOT_BASE と SNAPSHOT_DEFORM を含むボーン情報</param>
+	/// <returns>関節数</returns>
+	static int buildPalette(const MQBoneManager::BONE_SNAPSHOT& snapshot, std::vector<float>& palette, MODE mode = MODE_LINEAR);
+
+	/// <summary>
+	/// 変形後の頂点位置を求める
+	/// </summary>
+	/// <param name="palette">同じ mode で buildPalette() した結果</param>
+	/// <param name="out">頂点数に揃える</param>
+	/// <param name="thread_num">0 なら CPU のスレッド数</param>
+	/// <param name="allow_avx2">false ならスカラー版だけを使う. テストで AVX2 版と比べる</param>
+	void deform(const std::vector<float>& palette, std::vector<MQPoint>& out, MODE mode = MODE_LINEAR, int thread_num = 0, bool allow_avx2 = true) const;
+
+	/// <summary>
+	/// AVX2 の経路を使えるかどうか
+	/// </summary>
+	static bool hasAVX2();
+
+private:
+	int m_VertexNum;
+	UINT m_ObjectUniqueID;
+
+	// SIMD で読みやすいように成分ごとに持つ
+	std::vector<float> m_PosX;
+	std::vector<float> m_PosY;
+	std::vector<float> m_PosZ;
+	/// <summary>
+	/// パレット上の関節番号
+	/// </summary>
+	std::vector<int> m_Joint[INFLUENCE_NUM];
+	std::vector<float> m_Weight[INFLUENCE_NUM];
+
+	void deformRange(const float *palette, MQPoint *out, int begin, int end, bool use_avx2) const;
+	void deformRangeDQ(const float *palette, MQPoint *out, int begin, int end, bool use_avx2) const;
+};
@@ -122,6 +122,44 @@ BOOL WidgetTestPlugin::IsActivated(MQDocument doc)
 	return m_bActivate;
 }
 
+//---------------------------------------------------------------------------
+//  OnDraw
+//    描画時の処理
+//---------------------------------------------------------------------------
+void WidgetTestPlugin::OnDraw(MQDocument doc, MQScene scene, int width, int height)
+{
+	if (m_Window == NULL)
+		return;
+
+	// スキニングのプレビューを描画オブジェクトとして追加する
+	m_Window->drawSkinPreview(doc);
+}
+
+//---------------------------------------------------------------------------
+//  OnNewDocument
+//    ドキュメント初期化時の処理
+//---------------------------------------------------------------------------
+void WidgetTestPlugin::OnNewDocument(MQDocument doc, const char *filename, NEW_DOCUMENT_PARAM& param)
+{
+	if (m_Window == NULL)
+		return;
+
+	// 前のドキュメントのボーン情報を使い回さない
+	m_Window->clearDocumentCache();
+}
+
+//---------------------------------------------------------------------------
+//  OnEndDocument
+//    ドキュメント終了時の処理
+//---------------------------------------------------------------------------
+void WidgetTestPlugin::OnEndDocument(MQDocument doc)
+{
+	if (m_Window == NULL)
+		return;
+
+	m_Window->clearDocumentCache();
+}
+
 //---------------------------------------------------------------------------
 //  ExecuteCallback
 //    コールバックに対する実装部
@@ -29,6 +29,12 @@ public:
 	virtual BOOL Activate(MQDocument doc, BOOL flag);
 	// 表示・非表示状態の返答
 	virtual BOOL IsActivated(MQDocument doc);
+	// 描画時の処理
+	virtual void OnDraw(MQDocument doc, MQScene scene, int width, int height);
+	// ドキュメント初期化時の処理
+	virtual void OnNewDocument(MQDocument doc, const char *filename, NEW_DOCUMENT_PARAM& param);
+	// ドキュメント終了時の処理
+	virtual void OnEndDocument(MQDocument doc);
 
 
 	typedef bool (WidgetTestPlugin::*ExecuteCallbackProc)(MQDocument doc);
@@ -1,6 +1,8 @@
 ﻿
 #pragma once
 
+// Linux のテストでは playback.cpp だけをビルドするので windows.h を使わない
+#ifdef _WIN32
 #ifndef WINVER
 #define WINVER 0x0501
 #endif
@@ -11,5 +13,7 @@
 
 
 #define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
 #include <windows.h>
+#endif
 
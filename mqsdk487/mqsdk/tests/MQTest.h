@@ -0,0 +1,63 @@
+﻿//---------------------------------------------------------------------------
+//
+//   MQTest.h
+//
+//     A small test registry for the Linux build on the mock host.
+//    Each test is a function that returns the number of failed checks, and
+//    is run as 'mqsdk_test <name>' from ctest.
+//    　模擬ホスト上のLinuxビルド用の小さなテスト登録機構。
+//    各テストは失敗した検査の数を返す関数で、ctestから
+//    'mqsdk_test <name>' として実行される。
+//
+//---------------------------------------------------------------------------
+
+#ifndef _MQTEST_H_
+#define _MQTEST_H_
+
+#include <cstdio>
+#include <vector>
+
+
+typedef int (*MQTestFunc)();
+
+struct MQTestEntry
+{
+	const char *name;
+	MQTestFunc func;
+};
+
+class MQTestRegistry
+{
+public:
+	static std::vector<MQTestEntry>& GetEntries()
+	{
+		static std::vector<MQTestEntry> entries;
+		return entries;
+	}
+	static bool Add(const char *name, MQTestFunc func)
+	{
+		MQTestEntry entry = { name, func };
+		GetEntries().push_back(entry);
+		return true;
+	}
+};
+
+// Define a test. The body counts failures in 'failures' and returns it.
+// テストを定義する。本体は失敗数を'failures'に数えて返す。
+#define MQTEST(name) \
+	static int MQTest_##name(); \
+	static bool MQTest_##name##_added = MQTestRegistry::Add(#name, MQTest_##name); \
+	static int MQTest_##name()
+
+// Count a failure and print the condition if it is false
+// 条件が偽なら失敗を数えて条件を表示する
+#define MQTEST_CHECK(cond) \
+	do{ \
+		if(!(cond)){ \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	}while(0)
+
+
+#endif //_MQTEST_H_
@@ -0,0 +1,201 @@
+﻿//---------------------------------------------------------------------------
+//
+//   MQTestBonePlugin.cpp
+//
+//     A fake bone plug-in on the mock host.
+//    　模擬ホスト上の偽のボーンプラグイン。
+//
+//---------------------------------------------------------------------------
+
+#include "MQTestBonePlugin.h"
+#include "MQBoneManager.h"
+#include "MQMockHost.h"
+#include <algorithm>
+#include <cstring>
+
+
+void MQTestBonePlugin::Clear()
+{
+	bones.clear();
+	weights.clear();
+	object_id = 0;
+	rejected_bone.clear();
+	added_bones.clear();
+	added_weights.clear();
+	invalid_weights = 0;
+	message_count.clear();
+}
+
+MQTestBonePlugin::Bone& MQTestBonePlugin::AddBone(UINT id, UINT parent, const MQPoint& pos, const wchar_t *name)
+{
+	Bone bone;
+	bone.id = id;
+	bone.parent = parent;
+	bone.pos = pos;
+	bone.name = name;
+	bone.base_matrix.Identify();
+	bone.base_matrix.t[12] = pos.x;
+	bone.base_matrix.t[13] = pos.y;
+	bone.base_matrix.t[14] = pos.z;
+	bone.deform_matrix = bone.base_matrix;
+	bones.push_back(bone);
+	return bones.back();
+}
+
+const MQTestBonePlugin::Bone *MQTestBonePlugin::FindBone(const std::vector<Bone>& list, UINT id) const
+{
+	for(size_t i=0; i<list.size(); i++){
+		if(list[i].id == id) return &list[i];
+	}
+	return nullptr;
+}
+
+MQTestBonePlugin& MQTestBonePlugin::Get()
+{
+	static MQTestBonePlugin plugin;
+	return plugin;
+}
+
+static void *FindArg(void **args, const char *key)
+{
+	if(args == nullptr) return nullptr;
+	for(int i=0; args[i] != nullptr; i+=2){
+		if(strcmp((const char*)args[i], key) == 0) return args[i+1];
+	}
+	return nullptr;
+}
+
+static int BoneMessage(const char *description, void *message)
+{
+	MQTestBonePlugin& bp = MQTestBonePlugin::Get();
+	void **args = (void**)message;
+	bp.message_count[description]++;
+	if(strcmp(description, "QueryAPIVersion") == 0){
+		return 1;
+	}
+	if(strcmp(description, "QueryBoneNum") == 0){
+		return (int)bp.bones.size();
+	}
+	if(strcmp(description, "EnumBoneID") == 0){
+		for(size_t i=0; i<bp.bones.size(); i++) ((UINT*)message)[i] = bp.bones[i].id;
+		return 1;
+	}
+	if(strcmp(description, "QueryObjectNum") == 0){
+		return bp.bones.empty() ? 0 : 1;
+	}
+	if(strcmp(description, "EnumObjectID") == 0){
+		*(UINT*)message = bp.object_id;
+		return 1;
+	}
+	if(strcmp(description, "GetBone") == 0){
+		UINT *id = (UINT*)FindArg(args, "id");
+		const MQTestBonePlugin::Bone *bone = (id != nullptr) ? bp.FindBone(bp.bones, *id) : nullptr;
+		if(bone == nullptr) return 0;
+		int child_num = 0;
+		for(size_t i=0; i<bp.bones.size(); i++){
+			if(bp.bones[i].parent == bone->id) child_num++;
+		}
+		for(int i=0; args[i] != nullptr; i+=2){
+			const char *key = (const char*)args[i];
+			void *value = args[i+1];
+			if(strcmp(key, "parent") == 0){
+				*(UINT*)value = bone->parent;
+			}else if(strcmp(key, "child_num") == 0){
+				*(int*)value = child_num;
+			}else if(strcmp(key, "org_pos") == 0){
+				*(MQPoint*)value = bone->pos;
+			}else if(strcmp(key, "def_pos") == 0){
+				*(MQPoint*)value = bone->deform_matrix.GetTranslation();
+			}else if(strcmp(key, "base_matrix") == 0){
+				memcpy(value, bone->base_matrix.t, sizeof(float) * 16);
+			}else if(strcmp(key, "matrix") == 0){
+				memcpy(value, bone->deform_matrix.t, sizeof(float) * 16);
+			}else if(strcmp(key, "scale") == 0){
+				*(MQPoint*)value = MQPoint(1.0f, 1.0f, 1.0f);
+			}else if(strcmp(key, "name") == 0){
+				*(const wchar_t**)value = bone->name.c_str();
+			}else if(strcmp(key, "dummy") == 0){
+				*(bool*)value = false;
+			}
+		}
+		return 1;
+	}
+	if(strcmp(description, "GetBoneWeight") == 0){
+		UINT bone_id = *(UINT*)args[1];
+		if(*(UINT*)args[0] != bp.object_id || bp.FindBone(bp.bones, bone_id) == nullptr) return 0;
+		int num = 0;
+		for(auto it = bp.weights.begin(); it != bp.weights.end(); ++it){
+			for(size_t i=0; i<it->second.size(); i++){
+				if(it->second[i].first != bone_id) continue;
+				if(args[2] != nullptr && args[3] != nullptr){
+					((UINT*)args[2])[num] = it->first;
+					((float*)args[3])[num] = it->second[i].second;
+				}
+				num++;
+			}
+		}
+		return num;
+	}
+	if(strcmp(description, "GetVertexWeight") == 0){
+		if(*(UINT*)args[0] != bp.object_id) return 0;
+		auto it = bp.weights.find(*(UINT*)args[1]);
+		if(it == bp.weights.end()) return 0;
+		int num = (std::min)((int)it->second.size(), *(int*)args[2]);
+		for(int i=0; i<num; i++){
+			((UINT*)args[3])[i] = it->second[i].first;
+			((float*)args[4])[i] = it->second[i].second;
+		}
+		return (int)it->second.size();
+	}
+
+	// Messages to add bones and weights
+	// ボーンとウェイトを追加するメッセージ
+	if(strcmp(description, "AddBone") == 0){
+		MQTestBonePlugin::Bone bone;
+		bone.name = *(const wchar_t**)FindArg(args, "name");
+		if(bone.name == bp.rejected_bone) return 0;
+		bone.id = 100 + (UINT)bp.added_bones.size();
+		bone.parent = *(UINT*)FindArg(args, "parent");
+		bone.pos = *(MQPoint*)FindArg(args, "pos");
+		bp.added_bones.push_back(bone);
+		return (int)bone.id;
+	}
+	if(strcmp(description, "SetWeight") == 0){
+		UINT bone_id = *(UINT*)FindArg(args, "bone");
+		if(bp.FindBone(bp.added_bones, bone_id) == nullptr){
+			bp.invalid_weights++;
+			return 0;
+		}
+		UINT vertex_id = *(UINT*)FindArg(args, "vertex");
+		bp.added_weights[vertex_id].push_back(std::make_pair(bone_id, *(float*)FindArg(args, "weight")));
+		return 1;
+	}
+	if(strcmp(description, "Init") == 0 || strcmp(description, "NoDelEndDoc") == 0 || strcmp(description, "AddObject") == 0){
+		return 1;
+	}
+	return 0;
+}
+
+static BOOL TestMessageHandler(int message_type, MQSendMessageInfo *info)
+{
+	if(message_type != MQMESSAGE_USER_MESSAGE || info == nullptr) return FALSE;
+	void **args = (void**)info->option;
+	DWORD *product = (DWORD*)FindArg(args, "target_product");
+	DWORD *id = (DWORD*)FindArg(args, "target_id");
+	const char *description = (const char*)FindArg(args, "description");
+	int *result = (int*)FindArg(args, "result");
+	if(product == nullptr || id == nullptr || description == nullptr || result == nullptr) return FALSE;
+	if(*product != MQBoneManager::GetProductID() || *id != MQBoneManager::GetPluginID()) return FALSE;
+	*result = BoneMessage(description, FindArg(args, "message"));
+	return TRUE;
+}
+
+void MQTestBonePlugin::Install()
+{
+	MQMockHost::SetMessageHandler(TestMessageHandler);
+}
+
+void MQTestBonePlugin::Uninstall()
+{
+	MQMockHost::SetMessageHandler(nullptr);
+}
@@ -0,0 +1,81 @@
+﻿//---------------------------------------------------------------------------
+//
+//   MQTestBonePlugin.h
+//
+//     A fake bone plug-in on the mock host. It answers the messages of
+//    MQBoneManager from bones and weights held in memory.
+//    　模擬ホスト上の偽のボーンプラグイン。MQBoneManagerのメッセージに
+//    メモリ上のボーンとウェイトから応答する。
+//
+//---------------------------------------------------------------------------
+
+#ifndef _MQTESTBONEPLUGIN_H_
+#define _MQTESTBONEPLUGIN_H_
+
+#include "MQBasePlugin.h"
+#include <map>
+#include <string>
+#include <vector>
+
+
+// Bones and weights of the document are read from 'bones' and 'weights'.
+// Bones and weights added by AddBone and SetWeight are recorded.
+// 文書のボーンとウェイトは'bones'と'weights'から読む。
+// AddBoneとSetWeightで追加されたボーンとウェイトは記録する。
+struct MQTestBonePlugin
+{
+	struct Bone {
+		UINT id;
+		UINT parent;
+		MQPoint pos;
+		std::wstring name;
+		MQMatrix base_matrix;
+		MQMatrix deform_matrix;
+	};
+
+	std::vector<Bone> bones;
+	// vertex unique ID -> (bone ID, weight)
+	std::map<UINT, std::vector<std::pair<UINT, float>>> weights;
+	UINT object_id;
+
+	// Name of a bone for which AddBone fails
+	// AddBoneが失敗するボーンの名前
+	std::wstring rejected_bone;
+	std::vector<Bone> added_bones;
+	std::map<UINT, std::vector<std::pair<UINT, float>>> added_weights;
+	int invalid_weights;
+
+	// Number of received messages by description
+	// 受け取ったメッセージの説明ごとの数
+	std::map<std::string, int> message_count;
+
+	void Clear();
+
+	// Add a bone at 'pos'. Both matrices are the translation to 'pos'.
+	// 'pos'にボーンを追加する。どちらの行列も'pos'への平行移動
+	Bone& AddBone(UINT id, UINT parent, const MQPoint& pos, const wchar_t *name);
+
+	const Bone *FindBone(const std::vector<Bone>& list, UINT id) const;
+
+	static MQTestBonePlugin& Get();
+
+	// Set and reset the message handler of the mock host
+	// 模擬ホストのメッセージハンドラを設定、解除する
+	static void Install();
+	static void Uninstall();
+};
+
+// A plug-in which only sends messages through MQBoneManager
+// MQBoneManager経由でメッセージを送るだけのプラグイン
+class MQTestSenderPlugin : public MQExportPlugin
+{
+public:
+	virtual void GetPlugInID(DWORD *Product, DWORD *ID) { *Product = 0x12345678; *ID = 0x9ABCDEF0; }
+	virtual const char *GetPlugInName(void) { return "Test sender"; }
+	virtual const char *EnumFileType(int index) { return nullptr; }
+	virtual const char *EnumFileExt(int index) { return nullptr; }
+	virtual BOOL ExportFile(int index, const wchar_t *filename, MQDocument doc) { return FALSE; }
+};
+
+
+#endif //_MQTESTBONEPLUGIN_H_
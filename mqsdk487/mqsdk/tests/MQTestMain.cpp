@@ -0,0 +1,41 @@
+﻿//---------------------------------------------------------------------------
+//
+//   MQTestMain.cpp
+//
+//     Entry point of the tests. Without arguments all tests are run.
+//    　テストのエントリポイント。引数が無ければ全テストを実行する。
+//
+//---------------------------------------------------------------------------
+
+#include "MQTest.h"
+#include "MQMockHost.h"
+#include <cstring>
+
+
+int main(int argc, char **argv)
+{
+	MQMockHost::Install();
+
+	const std::vector<MQTestEntry>& entries = MQTestRegistry::GetEntries();
+	int failures = 0;
+	int run = 0;
+	for(size_t i=0; i<entries.size(); i++){
+		bool selected = (argc < 2);
+		for(int a=1; a<argc; a++){
+			if(strcmp(argv[a], entries[i].name) == 0)
+				selected = true;
+		}
+		if(!selected)
+			continue;
+
+		int n = entries[i].func();
+		printf("%s: %s\n", entries[i].name, (n == 0) ? "passed" : "FAILED");
+		failures += n;
+		run++;
+	}
+	if(run == 0){
+		fprintf(stderr, "No test matched\n");
+		return 1;
+	}
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,420 @@
+﻿//---------------------------------------------------------------------------
+//
+//   Test3DLib.cpp
+//
+//     Tests of MQ3DLib against the scalar implementations they replaced.
+//    　MQ3DLibを、置き換える前のスカラー実装と比べるテスト。
+//
+//---------------------------------------------------------------------------
+
+#include "MQTest.h"
+#include "MQMockHost.h"
+#include "MQ3DLib.h"
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+
+//---------------------------------------------------------------------------
+//  Normals
+//---------------------------------------------------------------------------
+
+// A bumpy grid of triangles and quadrangles with degenerate faces and a
+// hexagon.
+// 三角形と四角形の起伏のある格子に、縮退面と六角形を加える。
+static MQObject CreateTestGrid(int size, unsigned int seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> height(0.0f, 3.0f);
+
+	MQObject obj = MQ_CreateObject();
+	for(int z=0; z<=size; z++){
+		for(int x=0; x<=size; x++){
+			obj->AddVertex(MQPoint((float)x, height(rng), (float)z));
+		}
+	}
+
+	std::vector<std::vector<int>> faces;
+	for(int z=0; z<size; z++){
+		for(int x=0; x<size; x++){
+			int a = z*(size+1)+x, b = a+1, c = a+size+2, d = a+size+1;
+			switch(rng() % 6){
+			case 0:
+				faces.push_back({a, d, c});
+				faces.push_back({a, c, b});
+				break;
+			case 1:
+				faces.push_back({a, a, c});
+				faces.push_back({a, d, c, b});
+				break;
+			default:
+				faces.push_back({a, d, c, b});
+				break;
+			}
+		}
+	}
+	faces.push_back({0, size+1, 2*(size+1), 2*(size+1)+1, size+2, 1});
+	for(size_t i=0; i<faces.size(); i++){
+		obj->AddFace((int)faces[i].size(), faces[i].data());
+	}
+	return obj;
+}
+
+static void GetFaceArrays(MQObject obj, std::vector<int>& face_offset, std::vector<int>& face_vert)
+{
+	int face_count = obj->GetFaceCount();
+	face_offset.assign(face_count+1, 0);
+	for(int i=0; i<face_count; i++){
+		face_offset[i+1] = face_offset[i] + obj->GetFacePointCount(i);
+	}
+	face_vert.resize(face_offset[face_count]);
+	for(int i=0; i<face_count; i++){
+		if(face_offset[i+1] > face_offset[i])
+			obj->GetFacePointArray(i, &face_vert[face_offset[i]]);
+	}
+}
+
+static MQPoint GetScalarFaceNormal(const MQPoint *p, int count)
+{
+	if(count < 3) return MQPoint(0,0,0);
+	if(count == 3) return GetNormal(p[0], p[1], p[2]);
+	if(count == 4) return GetQuadNormal(p[0], p[1], p[2], p[3]);
+	return GetPolyNormal(p, count);
+}
+
+// Normals smoothed by the scalar code which MQObjNormal(obj, true) replaced.
+// Apex normals with close face normals are chained per vertex.
+// MQObjNormal(obj, true)が置き換えたスカラーのコードで平滑化した法線。
+// 面法線が近い頂点法線を頂点ごとにつないでいく。
+static void GetScalarObjectNormal(MQObject obj, std::vector<std::vector<MQPoint>>& normal)
+{
+	struct Chain {
+		MQPoint nv;
+		int count;
+		int next;
+	};
+
+	int face_count = obj->GetFaceCount();
+	int vert_count = obj->GetVertexCount();
+	std::vector<int> face_offset, face_vert;
+	GetFaceArrays(obj, face_offset, face_vert);
+
+	std::vector<MQPoint> face_n(face_count);
+	std::vector<MQPoint> pts;
+	for(int i=0; i<face_count; i++){
+		int count = face_offset[i+1] - face_offset[i];
+		pts.resize(count);
+		for(int j=0; j<count; j++) pts[j] = obj->GetVertex(face_vert[face_offset[i]+j]);
+		face_n[i] = GetScalarFaceNormal(pts.data(), count);
+	}
+
+	normal.assign(face_count, std::vector<MQPoint>());
+	if(obj->GetShading() != MQOBJECT_SHADE_GOURAUD){
+		for(int i=0; i<face_count; i++){
+			int count = face_offset[i+1] - face_offset[i];
+			if(count >= 3) normal[i].assign(count, face_n[i]);
+		}
+		return;
+	}
+
+	float facet = cosf(RAD(obj->GetSmoothAngle()));
+	std::vector<Chain> chain(vert_count);
+	for(int v=0; v<vert_count; v++){
+		chain[v].nv = MQPoint(0,0,0);
+		chain[v].count = 0;
+		chain[v].next = -1;
+	}
+	std::vector<int> apex_chain(face_vert.size(), -1);
+	for(int i=0; i<face_count; i++){
+		int count = face_offset[i+1] - face_offset[i];
+		if(count < 3) continue;
+		const MQPoint& pa = face_n[i];
+		float da = pa.norm();
+		for(int j=0; j<count; j++){
+			int ci = face_vert[face_offset[i]+j];
+			if(chain[ci].count == 0){
+				chain[ci].nv = pa;
+				chain[ci].count = 1;
+				apex_chain[face_offset[i]+j] = ci;
+				continue;
+			}
+			for(;;){
+				float c = 0.0f;
+				if(da > 0.0f){
+					float db = chain[ci].nv.norm();
+					if(db > 0.0f) c = GetInnerProduct(pa, chain[ci].nv) / sqrtf(da * db);
+				}
+				if(c >= facet){
+					chain[ci].nv += pa;
+					chain[ci].count++;
+					break;
+				}
+				if(chain[ci].next < 0){
+					Chain item;
+					item.nv = pa;
+					item.count = 1;
+					item.next = -1;
+					chain.push_back(item);
+					chain[ci].next = (int)chain.size() - 1;
+					ci = chain[ci].next;
+					break;
+				}
+				ci = chain[ci].next;
+			}
+			apex_chain[face_offset[i]+j] = ci;
+		}
+	}
+	for(size_t k=0; k<chain.size(); k++){
+		if(chain[k].count > 1) chain[k].nv.normalize();
+	}
+	for(int i=0; i<face_count; i++){
+		int count = face_offset[i+1] - face_offset[i];
+		if(count < 3) continue;
+		normal[i].resize(count);
+		for(int j=0; j<count; j++) normal[i][j] = chain[apex_chain[face_offset[i]+j]].nv;
+	}
+}
+
+static float GetMaxDiff(const MQPoint& a, const MQPoint& b)
+{
+	return (std::max)(fabsf(a.x - b.x), (std::max)(fabsf(a.y - b.y), fabsf(a.z - b.z)));
+}
+
+
+// GetFaceNormalArray() in SSE batches and threads gives the scalar normals
+MQTEST(face_normal_array)
+{
+	int failures = 0;
+	MQObject obj = CreateTestGrid(150, 1);
+	std::vector<int> face_offset, face_vert;
+	GetFaceArrays(obj, face_offset, face_vert);
+	int face_count = obj->GetFaceCount();
+	std::vector<MQPoint> pts(obj->GetVertexCount());
+	obj->GetVertexArray(pts.data());
+
+	for(int thread_num=1; thread_num<=4; thread_num+=3){
+		std::vector<MQPoint> face_n(face_count);
+		GetFaceNormalArray(pts.data(), face_offset.data(), face_vert.data(), face_count, face_n.data(), thread_num);
+
+		float maxdiff = 0.0f;
+		std::vector<MQPoint> fp;
+		for(int i=0; i<face_count; i++){
+			int count = face_offset[i+1] - face_offset[i];
+			fp.resize(count);
+			for(int j=0; j<count; j++) fp[j] = pts[face_vert[face_offset[i]+j]];
+			maxdiff = (std::max)(maxdiff, GetMaxDiff(face_n[i], GetScalarFaceNormal(fp.data(), count)));
+		}
+		MQTEST_CHECK(maxdiff < 1e-5f);
+	}
+	obj->DeleteThis();
+	return failures;
+}
+
+// MQObjNormal(obj, true) gives the normals of the scalar smoothing
+MQTEST(obj_normal)
+{
+	int failures = 0;
+	MQObject obj = CreateTestGrid(60, 2);
+	for(int mode=0; mode<3; mode++){
+		obj->SetShading(mode == 0 ? MQOBJECT_SHADE_FLAT : MQOBJECT_SHADE_GOURAUD);
+		obj->SetSmoothAngle(mode == 2 ? 180.0f : 40.0f);
+
+		std::vector<std::vector<MQPoint>> ref;
+		GetScalarObjectNormal(obj, ref);
+		MQObjNormal normal(obj, true);
+		float maxdiff = 0.0f;
+		for(int i=0; i<obj->GetFaceCount(); i++){
+			for(size_t j=0; j<ref[i].size(); j++){
+				maxdiff = (std::max)(maxdiff, GetMaxDiff(normal.Get(i, (int)j), ref[i][j]));
+			}
+		}
+		MQTEST_CHECK(maxdiff < 1e-5f);
+	}
+	obj->DeleteThis();
+	return failures;
+}
+
+// MQObjNormalCache::Update() after moving vertices gives the same normals as
+// a full rebuild
+MQTEST(normal_cache)
+{
+	int failures = 0;
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	MQObject obj = CreateTestGrid(40, 3);
+	obj->SetShading(MQOBJECT_SHADE_GOURAUD);
+	obj->SetSmoothAngle(50.0f);
+	int vert_count = obj->GetVertexCount();
+
+	MQObjNormalCache cache;
+	cache.Build(obj);
+	for(int it=0; it<20; it++){
+		int moved[16];
+		for(int k=0; k<16; k++){
+			moved[k] = rng() % vert_count;
+			MQPoint p = obj->GetVertex(moved[k]);
+			obj->SetVertex(moved[k], p + MQPoint(unit(rng), unit(rng), unit(rng)));
+		}
+		cache.Update(obj, moved, 16);
+	}
+
+	MQObjNormalCache rebuilt;
+	rebuilt.Build(obj);
+	MQObjNormal normal(obj, true);
+	int diff = 0;
+	float maxdiff = 0.0f;
+	for(int i=0; i<obj->GetFaceCount(); i++){
+		int count = obj->GetFacePointCount(i);
+		if(count < 3) continue;
+		for(int j=0; j<count; j++){
+			if(!(cache.Get(i, j) == rebuilt.Get(i, j))) diff++;
+			maxdiff = (std::max)(maxdiff, GetMaxDiff(cache.Get(i, j), normal.Get(i, j)));
+		}
+	}
+	MQTEST_CHECK(diff == 0);
+	MQTEST_CHECK(maxdiff < 1e-5f);
+	obj->DeleteThis();
+	return failures;
+}
+
+
+//---------------------------------------------------------------------------
+//  Edge pairs
+//---------------------------------------------------------------------------
+
+// A grid like CreateTestGrid() whose edges are made non-manifold by
+// duplicated and flipped faces. Lines and pentagons with a repeated vertex
+// are added, and the faces are shuffled.
+// CreateTestGrid()と同様の格子で、重複した面と裏返った面で非多様体のエッジを作る。
+// 線と頂点が重複した五角形を加え、面の順序をばらばらにする。
+static MQObject CreateNonManifoldGrid(int size, unsigned int seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> height(0.0f, 3.0f);
+
+	MQObject obj = MQ_CreateObject();
+	for(int z=0; z<=size; z++){
+		for(int x=0; x<=size; x++){
+			obj->AddVertex(MQPoint((float)x, height(rng), (float)z));
+		}
+	}
+
+	std::vector<std::vector<int>> faces;
+	for(int z=0; z<size; z++){
+		for(int x=0; x<size; x++){
+			int a = z*(size+1)+x, b = a+1, c = a+size+2, d = a+size+1;
+			switch(rng() % 8){
+			case 0:
+				faces.push_back({a, d, c});
+				faces.push_back({a, c, b});
+				break;
+			case 1:
+				faces.push_back({a, a, c});
+				faces.push_back({a, d, c, b});
+				break;
+			case 2:
+				faces.push_back({a, b, c, d});
+				break;
+			default:
+				faces.push_back({a, d, c, b});
+				break;
+			}
+			if(rng() % 20 == 0) faces.push_back({a, d, c, b});
+			if(rng() % 30 == 0) faces.push_back({a, b});
+			if(rng() % 40 == 0) faces.push_back({a, d, c, b, b});
+		}
+	}
+	faces.push_back({0, size+1, 2*(size+1), 2*(size+1)+1, size+2, 1});
+	for(size_t i=faces.size()-1; i>0; i--){
+		std::swap(faces[i], faces[rng() % (i+1)]);
+	}
+	for(size_t i=0; i<faces.size(); i++){
+		obj->AddFace((int)faces[i].size(), faces[i].data());
+	}
+	return obj;
+}
+
+// Edge pairs found by the scalar code which MQObjEdge replaced. Each line of
+// a face is registered to its start vertex, and is paired with the first
+// unpaired line in the opposite direction registered to its end vertex.
+// MQObjEdgeが置き換えたスカラーのコードで求めたエッジ対。面の各辺を始点に登録し、
+// 終点に登録された逆向きで未対の最初の辺と対にする。
+static void GetScalarEdgePair(MQObject obj, std::vector<std::vector<MQObjEdgePair>>& pair)
+{
+	int face_count = obj->GetFaceCount();
+	int vert_count = obj->GetVertexCount();
+	std::vector<int> face_offset, face_vert;
+	GetFaceArrays(obj, face_offset, face_vert);
+
+	pair.assign(face_count, std::vector<MQObjEdgePair>());
+	std::vector<std::vector<MQObjEdgePair>> reg(vert_count);
+	for(int cf=0; cf<face_count; cf++){
+		int count = face_offset[cf+1] - face_offset[cf];
+		if(count < 3) continue;
+		pair[cf].assign(count, MQObjEdgePair(-1, -1));
+		const int *cvi = &face_vert[face_offset[cf]];
+		for(int j=0; j<count; j++){
+			int v1 = cvi[j];
+			int v2 = cvi[(j+1) % count];
+			bool found = false;
+			for(size_t r=0; r<reg[v2].size(); r++){
+				int df = reg[v2][r].face;
+				int dl = reg[v2][r].line;
+				int dcount = face_offset[df+1] - face_offset[df];
+				if(pair[df][dl].face < 0 && v1 == face_vert[face_offset[df] + (dl+1) % dcount]){
+					pair[df][dl] = MQObjEdgePair(cf, j);
+					pair[cf][j] = MQObjEdgePair(df, dl);
+					found = true;
+					break;
+				}
+			}
+			if(!found) reg[v1].push_back(MQObjEdgePair(cf, j));
+		}
+	}
+}
+
+// MQObjEdge and MQObjHalfEdge give the pairs of the scalar code on
+// non-manifold input
+MQTEST(obj_edge)
+{
+	int failures = 0;
+	for(int trial=0; trial<4; trial++){
+		MQObject obj = CreateNonManifoldGrid(20 + trial*15, 10 + trial);
+		std::vector<std::vector<MQObjEdgePair>> ref;
+		GetScalarEdgePair(obj, ref);
+		MQObjEdge edge(obj);
+		MQObjHalfEdge he(obj, 2);
+
+		int diff = 0, paired = 0;
+		for(int f=0; f<obj->GetFaceCount(); f++){
+			int count = obj->GetFacePointCount(f);
+			if(count < 3) continue;
+			for(int j=0; j<count; j++){
+				int pf = -1, pl = -1;
+				bool found = edge.getPair(f, j, pf, pl);
+				if(found != (ref[f][j].face >= 0) || (found && (pf != ref[f][j].face || pl != ref[f][j].line))) diff++;
+				int hf = -1, hl = -1;
+				bool hfound = he.GetPair(f, j, hf, hl);
+				if(hfound != found || (found && (hf != pf || hl != pl))) diff++;
+
+				int h = he.GetHalfEdge(f, j);
+				if(he.GetFace(h) != f || he.GetLine(h) != j) diff++;
+				if(he.GetPrev(he.GetNext(h)) != h) diff++;
+				int t = he.GetTwin(h);
+				if(t >= 0){
+					paired++;
+					if(he.GetTwin(t) != h || he.GetStartVertex(t) != he.GetEndVertex(h)) diff++;
+				}
+			}
+		}
+		for(int v=0; v<obj->GetVertexCount(); v++){
+			for(int i=0; i<he.GetVertexHalfEdgeCount(v); i++){
+				if(he.GetStartVertex(he.GetVertexHalfEdgeArray(v)[i]) != v) diff++;
+			}
+		}
+		MQTEST_CHECK(diff == 0);
+		MQTEST_CHECK(paired > 0);
+		obj->DeleteThis();
+	}
+	return failures;
+}
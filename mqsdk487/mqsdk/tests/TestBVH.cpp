@@ -0,0 +1,261 @@
+﻿//---------------------------------------------------------------------------
+//
+//   TestBVH.cpp
+//
+//     Tests of MQBVH against brute force over all faces.
+//    　MQBVHを全ての面の総当たりと比べるテスト。
+//
+//---------------------------------------------------------------------------
+
+#include "MQTest.h"
+#include "MQBVH.h"
+#include "MQ3DLib.h"
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+
+struct TestMesh
+{
+	std::vector<MQPoint> pts;
+	std::vector<int> face_offset;
+	std::vector<int> face_vert;
+
+	int GetFaceCount() const { return (int)face_offset.size() - 1; }
+};
+
+// A wavy grid of quadrangles and triangles with a line, and random polygons
+// crossing it.
+// 四角形と三角形の波打つ格子に線を加え、それを横切る不規則な多角形を加える。
+static void CreateTestMesh(TestMesh& mesh, unsigned int seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	const int size = 80;
+
+	mesh.pts.clear();
+	mesh.face_offset.assign(1, 0);
+	mesh.face_vert.clear();
+	for(int y=0; y<=size; y++){
+		for(int x=0; x<=size; x++){
+			mesh.pts.push_back(MQPoint(x*0.1f, y*0.1f, sinf(x*0.3f)*cosf(y*0.2f) + unit(rng)*0.05f));
+		}
+	}
+	for(int y=0; y<size; y++){
+		for(int x=0; x<size; x++){
+			int a = y*(size+1)+x;
+			if((x+y) % 3 == 0){
+				mesh.face_vert.insert(mesh.face_vert.end(), {a, a+1, a+size+2});
+				mesh.face_offset.push_back((int)mesh.face_vert.size());
+				mesh.face_vert.insert(mesh.face_vert.end(), {a, a+size+2, a+size+1});
+			}else{
+				mesh.face_vert.insert(mesh.face_vert.end(), {a, a+1, a+size+2, a+size+1});
+			}
+			mesh.face_offset.push_back((int)mesh.face_vert.size());
+		}
+	}
+	mesh.face_vert.insert(mesh.face_vert.end(), {0, 1});
+	mesh.face_offset.push_back((int)mesh.face_vert.size());
+
+	int base = (int)mesh.pts.size();
+	for(int i=0; i<300; i++){
+		mesh.pts.push_back(MQPoint(unit(rng)*4.0f+4.0f, unit(rng)*4.0f+4.0f, unit(rng)*2.0f));
+	}
+	for(int i=0; i<200; i++){
+		int count = 3 + rng() % 3;
+		for(int k=0; k<count; k++){
+			mesh.face_vert.push_back(base + rng() % 300);
+		}
+		mesh.face_offset.push_back((int)mesh.face_vert.size());
+	}
+}
+
+static float GetNearestDistanceBruteForce(const TestMesh& mesh, const MQPoint& p)
+{
+	float best = FLT_MAX;
+	for(int f=0; f<mesh.GetFaceCount(); f++){
+		const int *vi = &mesh.face_vert[mesh.face_offset[f]];
+		int count = mesh.face_offset[f+1] - mesh.face_offset[f];
+		for(int j=1; j+1<count; j++){
+			MQPoint q = MQBVH::GetNearestPointOnTriangle(p, mesh.pts[vi[0]], mesh.pts[vi[j]], mesh.pts[vi[j+1]]);
+			best = (std::min)(best, (q - p).abs());
+		}
+	}
+	return best;
+}
+
+static void QueryBoxBruteForce(const TestMesh& mesh, const MQBoundingBox& box, std::vector<int>& faces)
+{
+	faces.clear();
+	for(int f=0; f<mesh.GetFaceCount(); f++){
+		const int *vi = &mesh.face_vert[mesh.face_offset[f]];
+		int count = mesh.face_offset[f+1] - mesh.face_offset[f];
+		if(count < 3) continue;
+		MQBoundingBox fb(mesh.pts[vi[0]], mesh.pts[vi[0]]);
+		for(int j=1; j<count; j++) fb.expand(mesh.pts[vi[j]]);
+		if(fb.minp.x <= box.maxp.x && box.minp.x <= fb.maxp.x
+		&& fb.minp.y <= box.maxp.y && box.minp.y <= fb.maxp.y
+		&& fb.minp.z <= box.maxp.z && box.minp.z <= fb.maxp.z)
+			faces.push_back(f);
+	}
+}
+
+static int CheckNearestAndBox(const TestMesh& mesh, const MQBVH& bvh, unsigned int seed)
+{
+	int failures = 0;
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	int diff = 0;
+	for(int k=0; k<200; k++){
+		MQPoint p(unit(rng)*5.0f+4.0f, unit(rng)*5.0f+4.0f, unit(rng)*3.0f);
+		float best = GetNearestDistanceBruteForce(mesh, p);
+		float dis;
+		MQPoint nearest;
+		int face = bvh.GetNearestFace(p, FLT_MAX, &nearest, &dis);
+		if(face < 0 || fabsf(dis - best) > 1e-4f || fabsf((nearest - p).abs() - dis) > 1e-4f) diff++;
+		if(bvh.GetNearestFace(p, best * 0.5f) >= 0) diff++;
+
+		MQBoundingBox box(MQPoint(p.x-1.0f, p.y-1.0f, -5.0f), MQPoint(p.x+1.0f, p.y+1.0f, 5.0f));
+		std::vector<int> faces, ref;
+		bvh.QueryBox(box, faces);
+		std::sort(faces.begin(), faces.end());
+		QueryBoxBruteForce(mesh, box, ref);
+		if(faces != ref) diff++;
+	}
+	MQTEST_CHECK(diff == 0);
+	return failures;
+}
+
+
+// GetNearestFace() and QueryBox() give the results of brute force, before
+// and after Refit()
+MQTEST(bvh_query)
+{
+	int failures = 0;
+	TestMesh mesh;
+	CreateTestMesh(mesh, 1);
+
+	MQBVH bvh;
+	MQTEST_CHECK(bvh.Build(mesh.pts.data(), (int)mesh.pts.size(), mesh.face_offset.data(), mesh.face_vert.data(), mesh.GetFaceCount()));
+	failures += CheckNearestAndBox(mesh, bvh, 3);
+
+	for(size_t i=0; i<mesh.pts.size(); i++){
+		mesh.pts[i].z *= 2.0f;
+		mesh.pts[i].x += mesh.pts[i].z * 0.1f;
+	}
+	MQTEST_CHECK(bvh.Refit(mesh.pts.data(), (int)mesh.pts.size()));
+	failures += CheckNearestAndBox(mesh, bvh, 4);
+	return failures;
+}
+
+// Nearest hit over all triangles of the fans in the Moller-Trumbore way
+// 全ての扇形の三角形についてMoller-Trumbore法で最も近い交点を求める
+static int RayCastBruteForce(const TestMesh& mesh, const MQBVH::Ray& ray, float& best_t, bool& front)
+{
+	int best_face = -1;
+	best_t = ray.tmax;
+	front = false;
+	for(int f=0; f<mesh.GetFaceCount(); f++){
+		const int *vi = &mesh.face_vert[mesh.face_offset[f]];
+		int count = mesh.face_offset[f+1] - mesh.face_offset[f];
+		for(int j=1; j+1<count; j++){
+			MQPoint e1 = mesh.pts[vi[j]] - mesh.pts[vi[0]];
+			MQPoint e2 = mesh.pts[vi[j+1]] - mesh.pts[vi[0]];
+			MQPoint pv = GetCrossProduct(ray.dir, e2);
+			float det = GetInnerProduct(e1, pv);
+			if(det == 0.0f) continue;
+			float inv_det = 1.0f / det;
+			MQPoint tv = ray.org - mesh.pts[vi[0]];
+			float u = GetInnerProduct(tv, pv) * inv_det;
+			if(u < 0.0f || u > 1.0f) continue;
+			MQPoint qv = GetCrossProduct(tv, e1);
+			float v = GetInnerProduct(ray.dir, qv) * inv_det;
+			if(v < 0.0f || u + v > 1.0f) continue;
+			float t = GetInnerProduct(e2, qv) * inv_det;
+			if(t >= ray.tmin && t < best_t){
+				best_t = t;
+				best_face = f;
+				front = (det < 0.0f);
+			}
+		}
+	}
+	return best_face;
+}
+
+static void CreateTestRays(std::vector<MQBVH::Ray>& rays, unsigned int seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	rays.resize(1000);
+	for(size_t i=0; i<rays.size(); i++){
+		rays[i].org = MQPoint(unit(rng)*5.0f+4.0f, unit(rng)*5.0f+4.0f, unit(rng)*3.0f);
+		rays[i].dir = MQPoint(unit(rng), unit(rng), unit(rng));
+		rays[i].tmin = 0.0f;
+		rays[i].tmax = (i % 4 == 0) ? 2.0f : FLT_MAX;
+	}
+}
+
+static int CheckRayCast(const TestMesh& mesh, const MQBVH& bvh, const std::vector<MQBVH::Ray>& rays)
+{
+	int failures = 0;
+	std::vector<MQBVH::Hit> hits(rays.size());
+	bvh.RayCastArray(rays.data(), (int)rays.size(), hits.data(), false, false, 4);
+
+	int diff = 0, hit_count = 0;
+	for(size_t i=0; i<rays.size(); i++){
+		float t;
+		bool front;
+		int face = RayCastBruteForce(mesh, rays[i], t, front);
+		if(face >= 0) hit_count++;
+		if((face < 0) != (hits[i].face < 0)){
+			diff++;
+		}else if(face >= 0 && (fabsf(t - hits[i].t) > 1e-4f*(std::max)(t, 1.0f) || front != hits[i].front)){
+			diff++;
+		}
+
+		MQBVH::Hit single;
+		bvh.RayCast(rays[i], single);
+		if(single.face != hits[i].face || single.t != hits[i].t) diff++;
+
+		// Any hit and front-only hits are consistent with the nearest hit
+		// 任意の交点と表側のみの交点が最も近い交点と矛盾しないこと
+		MQBVH::Hit any;
+		bool any_found = bvh.RayCast(rays[i], any, true);
+		if(any_found != (hits[i].face >= 0) || (any_found && any.t < hits[i].t - 1e-4f*(std::max)(hits[i].t, 1.0f))) diff++;
+		MQBVH::Hit front_hit;
+		if(bvh.RayCast(rays[i], front_hit, false, true)){
+			if(!front_hit.front || front_hit.t < hits[i].t - 1e-4f*(std::max)(hits[i].t, 1.0f)) diff++;
+		}else if(hits[i].face >= 0 && hits[i].front){
+			diff++;
+		}
+	}
+	MQTEST_CHECK(diff == 0);
+	MQTEST_CHECK(hit_count > 0);
+	return failures;
+}
+
+
+// RayCast() and RayCastArray() give the nearest hits of brute force, before
+// and after Refit()
+MQTEST(bvh_raycast)
+{
+	int failures = 0;
+	TestMesh mesh;
+	CreateTestMesh(mesh, 1);
+	std::vector<MQBVH::Ray> rays;
+	CreateTestRays(rays, 2);
+
+	MQBVH bvh;
+	MQTEST_CHECK(bvh.Build(mesh.pts.data(), (int)mesh.pts.size(), mesh.face_offset.data(), mesh.face_vert.data(), mesh.GetFaceCount()));
+	failures += CheckRayCast(mesh, bvh, rays);
+
+	for(size_t i=0; i<mesh.pts.size(); i++){
+		mesh.pts[i].z *= 2.0f;
+		mesh.pts[i].x += mesh.pts[i].z * 0.1f;
+	}
+	MQTEST_CHECK(bvh.Refit(mesh.pts.data(), (int)mesh.pts.size()));
+	failures += CheckRayCast(mesh, bvh, rays);
+	return failures;
+}
@@ -0,0 +1,180 @@
+﻿//---------------------------------------------------------------------------
+//
+//   TestBoneManager.cpp
+//
+//     Tests of MQBoneManager against MQTestBonePlugin.
+//    　MQTestBonePluginを相手にしたMQBoneManagerのテスト。
+//
+//---------------------------------------------------------------------------
+
+#include "MQTest.h"
+#include "MQMockHost.h"
+#include "MQTestBonePlugin.h"
+#include "MQBoneManager.h"
+#include <algorithm>
+#include <random>
+
+
+//---------------------------------------------------------------------------
+//  Vertex weight table
+//---------------------------------------------------------------------------
+
+// An object of 'vert_num' vertices. Each vertex has 0 to 'max_weight'
+// weights of distinct bones out of 'bone_num' bones. A weight of a vertex
+// which is not in the object is also registered.
+// 'vert_num'個の頂点を持つオブジェクト。各頂点は'bone_num'本のボーンの
+// うち異なる0～'max_weight'本のウェイトを持つ。オブジェクトに無い頂点の
+// ウェイトも登録する。
+static MQObject CreateWeightedObject(MQDocument doc, int vert_num, int bone_num, int max_weight, unsigned int seed)
+{
+	MQTestBonePlugin& bp = MQTestBonePlugin::Get();
+	bp.Clear();
+	for(int i=0; i<bone_num; i++){
+		bp.AddBone(i + 1, 0, MQPoint((float)i, 0.0f, 0.0f), L"bone");
+	}
+
+	MQObject obj = MQ_CreateObject();
+	for(int v=0; v<vert_num; v++){
+		obj->AddVertex(MQPoint((float)v, 0.0f, 0.0f));
+	}
+	doc->AddObject(obj);
+	bp.object_id = obj->GetUniqueID();
+
+	std::mt19937 rng(seed);
+	std::vector<UINT> ids(bone_num);
+	for(int i=0; i<bone_num; i++) ids[i] = i + 1;
+	for(int v=0; v<vert_num; v++){
+		int num = (int)(rng() % (max_weight + 1));
+		std::shuffle(ids.begin(), ids.end(), rng);
+		std::vector<std::pair<UINT, float>> list;
+		for(int i=0; i<num && i<bone_num; i++){
+			list.push_back(std::make_pair(ids[i], (float)(rng() % 100 + 1) / 100.0f));
+		}
+		if(!list.empty()) bp.weights[obj->GetVertexUniqueID(v)] = list;
+	}
+	bp.weights[0x7FFFFFFF].push_back(std::make_pair((UINT)1, 1.0f));
+	return obj;
+}
+
+// Compare the table with the weights of the plug-in regardless of the order
+// in each vertex. At most 'max_weight_num' weights in the plug-in's order
+// are expected per vertex.
+// 頂点内の順序によらず表をプラグインのウェイトと比べる。頂点ごとに
+// プラグインの順で最大'max_weight_num'個のウェイトがあるはず。
+static int CompareWeightTable(MQObject obj, const MQBoneManager::VERTEX_WEIGHT_TABLE& table, int max_weight_num)
+{
+	int failures = 0;
+	MQTestBonePlugin& bp = MQTestBonePlugin::Get();
+	int vert_num = obj->GetVertexCount();
+	MQTEST_CHECK(table.GetVertexCount() == vert_num);
+	if(table.GetVertexCount() != vert_num) return failures;
+
+	int diff = 0;
+	for(int v=0; v<vert_num; v++){
+		std::vector<std::pair<UINT, float>> expected;
+		auto it = bp.weights.find(obj->GetVertexUniqueID(v));
+		if(it != bp.weights.end()) expected = it->second;
+		if((int)expected.size() > max_weight_num) expected.resize(max_weight_num);
+
+		std::vector<std::pair<UINT, float>> actual;
+		for(int i=0; i<table.GetWeightNum(v); i++){
+			actual.push_back(std::make_pair(table.GetBoneIDs(v)[i], table.GetWeights(v)[i]));
+		}
+		std::sort(expected.begin(), expected.end());
+		std::sort(actual.begin(), actual.end());
+		if(actual != expected) diff++;
+	}
+	MQTEST_CHECK(diff == 0);
+	MQTEST_CHECK((int)table.bone_ids.size() == table.offsets[vert_num]);
+	MQTEST_CHECK((int)table.weights.size() == table.offsets[vert_num]);
+	return failures;
+}
+
+// Fewer bones than vertices: weights are queried bone by bone
+// 頂点よりボーンが少ない: ボーンごとに問い合わせる
+MQTEST(weight_table_per_bone)
+{
+	int failures = 0;
+	MQTestBonePlugin::Install();
+	MQDocument doc = MQMockHost::CreateDocument();
+	MQObject obj = CreateWeightedObject(doc, 500, 6, 4, 1);
+	MQTestBonePlugin& bp = MQTestBonePlugin::Get();
+
+	MQTestSenderPlugin plugin;
+	MQBoneManager bone_manager(&plugin, doc);
+	MQBoneManager::VERTEX_WEIGHT_TABLE table;
+	bp.message_count.clear();
+	int num = bone_manager.GetVertexWeightTable(obj, table);
+	MQTEST_CHECK(bp.message_count["GetBoneWeight"] > 0);
+	MQTEST_CHECK(bp.message_count["GetVertexWeight"] == 0);
+	MQTEST_CHECK(num == table.offsets[obj->GetVertexCount()]);
+	failures += CompareWeightTable(obj, table, 16);
+
+	MQMockHost::DeleteDocument(doc);
+	MQTestBonePlugin::Uninstall();
+	return failures;
+}
+
+// More bones than vertices: weights are queried vertex by vertex, and at
+// most 'max_weight_num' weights are taken
+// 頂点よりボーンが多い: 頂点ごとに問い合わせ、最大'max_weight_num'個を取る
+MQTEST(weight_table_per_vertex)
+{
+	int failures = 0;
+	MQTestBonePlugin::Install();
+	MQDocument doc = MQMockHost::CreateDocument();
+	MQObject obj = CreateWeightedObject(doc, 40, 30, 6, 2);
+	MQTestBonePlugin& bp = MQTestBonePlugin::Get();
+
+	MQTestSenderPlugin plugin;
+	MQBoneManager bone_manager(&plugin, doc);
+	MQBoneManager::VERTEX_WEIGHT_TABLE table;
+	bp.message_count.clear();
+	int num = bone_manager.GetVertexWeightTable(obj, table);
+	MQTEST_CHECK(bp.message_count["GetBoneWeight"] == 0);
+	MQTEST_CHECK(bp.message_count["GetVertexWeight"] == obj->GetVertexCount());
+	MQTEST_CHECK(num == table.offsets[obj->GetVertexCount()]);
+	failures += CompareWeightTable(obj, table, 16);
+
+	bone_manager.GetVertexWeightTable(obj, table, 2);
+	failures += CompareWeightTable(obj, table, 2);
+
+	MQMockHost::DeleteDocument(doc);
+	MQTestBonePlugin::Uninstall();
+	return failures;
+}
+
+// Both queries give the same table for the same weights
+// 同じウェイトならどちらの問い合わせも同じ表になる
+MQTEST(weight_table_same)
+{
+	int failures = 0;
+	MQTestBonePlugin::Install();
+	MQDocument doc = MQMockHost::CreateDocument();
+	MQObject obj = CreateWeightedObject(doc, 20, 4, 3, 3);
+	MQTestBonePlugin& bp = MQTestBonePlugin::Get();
+
+	MQTestSenderPlugin plugin;
+	MQBoneManager bone_manager(&plugin, doc);
+	MQBoneManager::VERTEX_WEIGHT_TABLE per_bone, per_vertex;
+	bp.message_count.clear();
+	bone_manager.GetVertexWeightTable(obj, per_bone);
+	MQTEST_CHECK(bp.message_count["GetVertexWeight"] == 0);
+
+	// Extra bones without weights switch the query to per vertex.
+	// ウェイトの無いボーンを足すと頂点ごとの問い合わせになる
+	for(int i=0; i<20; i++){
+		bp.AddBone(100 + i, 0, MQPoint(), L"extra");
+	}
+	bp.message_count.clear();
+	bone_manager.GetVertexWeightTable(obj, per_vertex);
+	MQTEST_CHECK(bp.message_count["GetBoneWeight"] == 0);
+
+	MQTEST_CHECK(per_bone.offsets == per_vertex.offsets);
+	failures += CompareWeightTable(obj, per_bone, 16);
+	failures += CompareWeightTable(obj, per_vertex, 16);
+
+	MQMockHost::DeleteDocument(doc);
+	MQTestBonePlugin::Uninstall();
+	return failures;
+}
@@ -0,0 +1,197 @@
+﻿//---------------------------------------------------------------------------
+//
+//   TestGPBReader.cpp
+//
+//     Tests of GPBReader with small .gpb files built in memory, including
+//    broken files which must be rejected without crashing.
+//    　メモリ上で組み立てた小さな.gpbによるGPBReaderのテスト。クラッシュ
+//    せずに拒否すべき壊れたファイルも含む。
+//
+//---------------------------------------------------------------------------
+
+#include "MQTest.h"
+#include "GPBReader.h"
+#include <cstring>
+
+
+// Little endian writer of .gpb values
+// .gpbの値をリトルエンディアンで書く
+struct GPBTestWriter
+{
+	std::vector<uint8_t> data;
+
+	void u8(uint8_t v) { data.push_back(v); }
+	void u32(uint32_t v)
+	{
+		for(int i=0; i<4; i++) data.push_back((uint8_t)(v >> (i * 8)));
+	}
+	void f32(float v)
+	{
+		uint32_t u;
+		memcpy(&u, &v, 4);
+		u32(u);
+	}
+	void str(const char *s)
+	{
+		u32((uint32_t)strlen(s));
+		data.insert(data.end(), s, s + strlen(s));
+	}
+};
+
+// A file with one mesh of 'vert_num' vertices and one triangle, and no
+// nodes. Every float of the vertices is 0 except the first blend weight.
+// 'vert_num'個の頂点と1つの三角形のメッシュを1つ持ち、ノードの無いファイル。
+// 頂点の float は最初のブレンドウェイト以外すべて0。
+static std::vector<uint8_t> BuildMeshFile(const std::vector<GPBReadAttr>& attrs, uint32_t vert_num)
+{
+	GPBTestWriter w;
+	w.data.insert(w.data.end(), GPB_IDENTIFIER, GPB_IDENTIFIER + GPB_IDENTIFIER_SIZE);
+	w.u8(1);
+	w.u8(5);
+	w.u32(0);
+
+	w.u32(1);
+	w.u32((uint32_t)attrs.size());
+	uint32_t stride = 0;
+	for(size_t i=0; i<attrs.size(); i++){
+		w.u32(attrs[i].usage);
+		w.u32(attrs[i].size);
+		stride += attrs[i].size;
+	}
+	w.u32(vert_num * stride * 4);
+	for(uint32_t v=0; v<vert_num; v++){
+		for(size_t i=0; i<attrs.size(); i++){
+			for(uint32_t k=0; k<attrs[i].size; k++){
+				w.f32((attrs[i].usage == ATTR_BLENDWEIGHTS && k == 0) ? 1.0f : 0.0f);
+			}
+		}
+	}
+	for(int i=0; i<10; i++) w.f32(0.0f);
+	w.u32(1);
+	w.u32(GL_TRIANGLE);
+	w.u32(GL_UNSIGNED_SHORT);
+	w.u32(6);
+	for(int i=0; i<3; i++){
+		w.u8((uint8_t)(vert_num > 0 ? i % vert_num : 0));
+		w.u8(0);
+	}
+
+	w.u32(0);
+	w.u32(0);
+	w.str("");
+	for(int i=0; i<3; i++) w.f32(0.0f);
+	w.u32(0);
+	return w.data;
+}
+
+static GPBReadAttr MakeAttr(uint32_t usage, uint32_t size)
+{
+	GPBReadAttr attr = { usage, size };
+	return attr;
+}
+
+static int CountErrors(const GPBValidationReport& report, const char *text)
+{
+	int num = 0;
+	for(size_t i=0; i<report.errors.size(); i++){
+		if(report.errors[i].find(text) != std::string::npos) num++;
+	}
+	return num;
+}
+
+
+// A well-formed file is read and has no errors
+// 正しいファイルは読めてエラーが無い
+MQTEST(gpb_reader_valid)
+{
+	int failures = 0;
+	std::vector<GPBReadAttr> attrs;
+	attrs.push_back(MakeAttr(ATTR_POSITION, 3));
+	attrs.push_back(MakeAttr(ATTR_TEXCOORD0, 2));
+	attrs.push_back(MakeAttr(ATTR_BLENDWEIGHTS, 4));
+	attrs.push_back(MakeAttr(ATTR_BLENDINDICES, 4));
+	std::vector<uint8_t> data = BuildMeshFile(attrs, 3);
+
+	GPBReader reader;
+	MQTEST_CHECK(reader.parse(data.data(), data.size()));
+	MQTEST_CHECK(reader.meshes.size() == 1);
+	if(reader.meshes.size() != 1) return failures;
+	const GPBReadMesh& mesh = reader.meshes[0];
+	MQTEST_CHECK(mesh.vertexStride == 13);
+	MQTEST_CHECK(mesh.getVertexCount() == 3);
+	MQTEST_CHECK(mesh.findAttr(ATTR_TEXCOORD0, 2, 2) == 3);
+	MQTEST_CHECK(mesh.findAttr(ATTR_BLENDINDICES, 4, 4) == 9);
+
+	GPBValidationReport report;
+	MQTEST_CHECK(reader.validate(report) == 0);
+	return failures;
+}
+
+// Attribute sizes of zero or beyond the limit are rejected by parse().
+// A size of 2^30 used to make the 32-bit stride in bytes wrap to zero, and
+// validate() divided by it.
+// 0や上限を超える属性の大きさはparse()が拒否する。2^30では32bitの
+// バイト単位のストライドが0に戻り、validate()が0で割っていた。
+MQTEST(gpb_reader_attr_limit)
+{
+	int failures = 0;
+	const uint32_t sizes[3] = { 0, 17, 1u << 30 };
+	for(int i=0; i<3; i++){
+		std::vector<GPBReadAttr> attrs;
+		attrs.push_back(MakeAttr(ATTR_POSITION, 3));
+		attrs.push_back(MakeAttr(ATTR_NORMAL, sizes[i]));
+		std::vector<uint8_t> data = BuildMeshFile(attrs, 0);
+
+		GPBReader reader;
+		bool parsed = reader.parse(data.data(), data.size());
+		MQTEST_CHECK(!parsed);
+		MQTEST_CHECK(reader.getError().find("attribute size") != std::string::npos);
+		if(parsed){
+			GPBValidationReport report;
+			reader.validate(report);
+		}
+	}
+
+	// The largest accepted size
+	// 受け付ける最大の大きさ
+	std::vector<GPBReadAttr> attrs;
+	attrs.push_back(MakeAttr(ATTR_POSITION, 3));
+	attrs.push_back(MakeAttr(ATTR_NORMAL, 16));
+	std::vector<uint8_t> data = BuildMeshFile(attrs, 2);
+	GPBReader reader;
+	MQTEST_CHECK(reader.parse(data.data(), data.size()));
+	MQTEST_CHECK(reader.meshes.size() == 1 && reader.meshes[0].getVertexCount() == 2);
+	return failures;
+}
+
+// Attributes of unexpected sizes are reported by validate() and are not
+// read. The short position is the last attribute, so reading three floats
+// from it would run past the vertex data.
+// 大きさの合わない属性はvalidate()が報告し、読まない。短い位置属性は
+// 最後の属性なので、3つ読むと頂点データの外に出る。
+MQTEST(gpb_reader_attr_size)
+{
+	int failures = 0;
+	std::vector<GPBReadAttr> attrs;
+	attrs.push_back(MakeAttr(ATTR_TEXCOORD0, 1));
+	attrs.push_back(MakeAttr(ATTR_BLENDWEIGHTS, 3));
+	attrs.push_back(MakeAttr(ATTR_BLENDINDICES, 5));
+	attrs.push_back(MakeAttr(ATTR_POSITION, 2));
+	std::vector<uint8_t> data = BuildMeshFile(attrs, 3);
+
+	GPBReader reader;
+	MQTEST_CHECK(reader.parse(data.data(), data.size()));
+	if(reader.meshes.size() != 1) return failures + 1;
+	const GPBReadMesh& mesh = reader.meshes[0];
+	MQTEST_CHECK(mesh.findAttr(ATTR_POSITION) == 9);
+	MQTEST_CHECK(mesh.findAttr(ATTR_POSITION, 3, 3) < 0);
+	MQTEST_CHECK(mesh.findAttr(ATTR_TEXCOORD0, 2, UINT32_MAX) < 0);
+	MQTEST_CHECK(mesh.findAttr(ATTR_BLENDWEIGHTS, 4, 4) < 0);
+	MQTEST_CHECK(mesh.findAttr(ATTR_BLENDINDICES, 4, 4) < 0);
+
+	GPBValidationReport report;
+	reader.validate(report);
+	MQTEST_CHECK(CountErrors(report, "unexpected size") == 4);
+	MQTEST_CHECK(CountErrors(report, "no position") == 0);
+	return failures;
+}
@@ -0,0 +1,702 @@
+﻿//---------------------------------------------------------------------------
+//
+//   TestGPBRoundTrip.cpp
+//
+//     Export a document with ExportGPB and import it again with ImportGPB
+//    on the mock host. MQTestBonePlugin answers the messages of
+//    MQBoneManager.
+//    　模擬ホスト上でExportGPBで書き出した文書をImportGPBで読み戻す。
+//    MQBoneManagerのメッセージにはMQTestBonePluginが応答する。
+//
+//---------------------------------------------------------------------------
+
+#include "MQTest.h"
+#include "MQMockHost.h"
+#include "MQTestBonePlugin.h"
+#include "ExportGPB.h"
+// Both plug-ins define their IDs and names with the same macros
+// 両方のプラグインが同じマクロでIDと名前を定義する
+#undef MY_PRODUCT
+#undef MY_ID
+#undef MY_PLUGINNAME
+#undef MY_FILETYPE
+#undef MY_EXT
+#undef IDENVER
+#include "ImportGPB.h"
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+//---------------------------------------------------------------------------
+//  Round trip
+//---------------------------------------------------------------------------
+
+// A grid of quadrangles and concave pentagons with two materials and UVs.
+// Each vertex has two weights of a chain of three bones.
+// 四角形と凹五角形の格子で、2つの材質とUVを持つ。各頂点は3本のボーンの
+// 連なりのうち2本のウェイトを持つ。
+static MQDocument CreateTestDocument(bool with_bone)
+{
+	MQDocument doc = MQMockHost::CreateDocument();
+	const char *mat_names[2] = { "red", "blue" };
+	for(int i=0; i<2; i++){
+		MQMaterial mat = MQ_CreateMaterial();
+		mat->SetName(mat_names[i]);
+		mat->SetColor(MQColor(1.0f - i, 0.0f, (float)i));
+		doc->AddMaterial(mat);
+	}
+
+	const int cols = 6, rows = 4;
+	MQObject obj = MQ_CreateObject();
+	obj->SetName("grid");
+	std::vector<int> grid((cols+1)*(rows+1));
+	for(int y=0; y<=rows; y++){
+		for(int x=0; x<=cols; x++){
+			grid[y*(cols+1)+x] = obj->AddVertex(MQPoint((float)x, 0.2f*sinf((float)x), (float)y));
+		}
+	}
+	for(int y=0; y<rows; y++){
+		for(int x=0; x<cols; x++){
+			int v00 = grid[y*(cols+1)+x], v10 = grid[y*(cols+1)+x+1];
+			int v11 = grid[(y+1)*(cols+1)+x+1], v01 = grid[(y+1)*(cols+1)+x];
+			float u0 = (float)x / cols, u1 = (float)(x+1) / cols;
+			float t0 = (float)y / rows, t1 = (float)(y+1) / rows;
+			int fi;
+			if((x + y) % 5 == 0){
+				int mid = obj->AddVertex(MQPoint(x + 0.5f, 0.1f, y + 0.3f));
+				int vi[5] = { v00, v01, v11, v10, mid };
+				fi = obj->AddFace(5, vi);
+				MQCoordinate uv[5] = {
+					MQCoordinate(u0, t0), MQCoordinate(u0, t1), MQCoordinate(u1, t1),
+					MQCoordinate(u1, t0), MQCoordinate((u0 + u1) * 0.5f, t0 + (t1 - t0) * 0.3f),
+				};
+				obj->SetFaceCoordinateArray(fi, uv);
+			}else{
+				int vi[4] = { v00, v01, v11, v10 };
+				fi = obj->AddFace(4, vi);
+				MQCoordinate uv[4] = {
+					MQCoordinate(u0, t0), MQCoordinate(u0, t1), MQCoordinate(u1, t1), MQCoordinate(u1, t0),
+				};
+				obj->SetFaceCoordinateArray(fi, uv);
+			}
+			obj->SetFaceMaterial(fi, (x < cols/2) ? 0 : 1);
+		}
+	}
+	doc->AddObject(obj);
+
+	MQTestBonePlugin& bp = MQTestBonePlugin::Get();
+	bp.Clear();
+	if(with_bone){
+		const wchar_t *bone_names[3] = { L"root", L"arm", L"hand" };
+		for(int i=0; i<3; i++){
+			bp.AddBone(i + 1, i, MQPoint(2.0f * i, 0.0f, 1.0f), bone_names[i]);
+		}
+		bp.object_id = obj->GetUniqueID();
+		for(int v=0; v<obj->GetVertexCount(); v++){
+			std::vector<std::pair<UINT, float>> list;
+			list.push_back(std::make_pair((UINT)(v % 3 + 1), 0.75f));
+			list.push_back(std::make_pair((UINT)((v + 1) % 3 + 1), 0.25f));
+			bp.weights[obj->GetVertexUniqueID(v)] = list;
+		}
+	}
+	return doc;
+}
+
+// Options of the exporter with every optional process turned off
+// 任意の処理をすべて無効にした書き出しのオプション
+static CreateDialogOptionParam CreateTestOption(bool with_bone)
+{
+	CreateDialogOptionParam option;
+	option.visible_only = false;
+	option.bone_exists = with_bone;
+	option.output_bone = with_bone ? 1 : 0;
+	option.mtlfile = FILEOUT_FORCE;
+	// The importer does not read .hsp, which is written above the folder
+	// インポーターは.hspを読まない。.hspはフォルダの一つ上に書かれる
+	option.hspfile = FILEOUT_NO;
+	option.texture_prefix = L"";
+	option.input_xmlanim = FILEIN_NOTUSE;
+	option.material_conv = 0;
+	option.material_merge = 0;
+	option.texture_atlas = ATLAS_NO;
+	option.weld = 0;
+	return option;
+}
+
+// 'output_files' receives the list of the files as ExportFile() shows it
+// 'output_files'はExportFile()が表示するファイルの一覧を受け取る
+static bool ExportTestDocument(MQDocument doc, const MString& path, const CreateDialogOptionParam& option, GPBExportProfile& profile,
+	MString *output_files = nullptr)
+{
+	ExportGPBPlugin plugin;
+	MLanguage language;
+	MString files = path;
+	BOOL ret = plugin.exportDocument(path.c_str(), doc, option, 1.0f, language, files, &profile);
+	if(output_files != nullptr) *output_files = files;
+	return ret != FALSE;
+}
+
+static bool ExportTestDocument(MQDocument doc, const MString& path, bool with_bone)
+{
+	GPBExportProfile profile;
+	return ExportTestDocument(doc, path, CreateTestOption(with_bone), profile);
+}
+
+static long long GetProfileCount(const GPBExportProfile& profile, const char *name)
+{
+	const std::vector<std::pair<const char*, long long>>& counts = profile.getCounts();
+	for(size_t i=0; i<counts.size(); i++){
+		if(strcmp(counts[i].first, name) == 0) return counts[i].second;
+	}
+	return -1;
+}
+
+static bool IsSamePoint(const MQPoint& a, const MQPoint& b)
+{
+	return fabsf(a.x - b.x) < 1e-4f && fabsf(a.y - b.y) < 1e-4f && fabsf(a.z - b.z) < 1e-4f;
+}
+
+// Index of the source vertex at the position, or -1
+// その位置にある元の頂点のインデックス。無ければ-1
+static int FindVertex(MQObject obj, const MQPoint& p)
+{
+	for(int v=0; v<obj->GetVertexCount(); v++){
+		if(IsSamePoint(obj->GetVertex(v), p)) return v;
+	}
+	return -1;
+}
+
+// What the export options may change in the imported document
+// 書き出しのオプションで読み戻した文書が変わってよいこと
+struct RoundTripExpect {
+	// Source material name -> material name after the export
+	// 元の材質名 -> 書き出し後の材質名
+	std::map<std::string, std::string> renamed_materials;
+	// The UVs of each source material are moved into a rectangle of a
+	// texture atlas
+	// 元の材質ごとのUVがテクスチャアトラスの矩形に移る
+	bool uv_remapped;
+	// Vertices may be duplicated or welded, so the count may differ from
+	// the source
+	// 頂点が複製、溶接されることがあり、数が元と違ってよい
+	bool vertex_count_changed;
+	// Source faces which must not come back
+	// 戻ってはならない元の面
+	std::vector<int> dropped_faces;
+	// A bone for which AddBone fails. Its weights must be missing.
+	// AddBoneが失敗するボーン。そのウェイトは無くなっていなければならない
+	std::wstring dropped_bone;
+
+	RoundTripExpect() : uv_remapped(false), vertex_count_changed(false) {}
+};
+
+// Check that the UVs of each source material are moved by one scale and
+// offset, and that the whole texture of each material is moved to its own
+// rectangle in [0, 1]. 'uv_pairs' holds the source and imported UVs by
+// source material.
+// 元の材質ごとのUVが1つの拡大と平行移動で移り、各材質のテクスチャ全体が
+// [0, 1]の中の重ならない矩形に移ることを確かめる。'uv_pairs'は元の材質ごとの
+// 元と読み戻したUVを持つ。
+static int CompareRemappedUV(const std::map<int, std::vector<std::pair<MQCoordinate, MQCoordinate>>>& uv_pairs)
+{
+	int failures = 0;
+	const float eps = 1e-4f;
+	int uv_diff = 0;
+	std::vector<std::pair<MQCoordinate, MQCoordinate>> rects;
+	for(auto it = uv_pairs.begin(); it != uv_pairs.end(); ++it){
+		const std::vector<std::pair<MQCoordinate, MQCoordinate>>& pairs = it->second;
+		size_t umin = 0, umax = 0, vmin = 0, vmax = 0;
+		for(size_t i=1; i<pairs.size(); i++){
+			if(pairs[i].first.u < pairs[umin].first.u) umin = i;
+			if(pairs[i].first.u > pairs[umax].first.u) umax = i;
+			if(pairs[i].first.v < pairs[vmin].first.v) vmin = i;
+			if(pairs[i].first.v > pairs[vmax].first.v) vmax = i;
+		}
+		float su = (pairs[umax].second.u - pairs[umin].second.u) / (pairs[umax].first.u - pairs[umin].first.u);
+		float sv = (pairs[vmax].second.v - pairs[vmin].second.v) / (pairs[vmax].first.v - pairs[vmin].first.v);
+		float ou = pairs[umin].second.u - pairs[umin].first.u * su;
+		float ov = pairs[vmin].second.v - pairs[vmin].first.v * sv;
+		for(size_t i=0; i<pairs.size(); i++){
+			const MQCoordinate& s = pairs[i].first;
+			const MQCoordinate& d = pairs[i].second;
+			if(fabsf(ou + s.u * su - d.u) > eps || fabsf(ov + s.v * sv - d.v) > eps) uv_diff++;
+		}
+
+		// The rectangle of the whole texture
+		// テクスチャ全体の矩形
+		MQCoordinate lo((std::min)(ou, ou + su), (std::min)(ov, ov + sv));
+		MQCoordinate hi((std::max)(ou, ou + su), (std::max)(ov, ov + sv));
+		if(lo.u < -eps || lo.v < -eps || hi.u > 1.0f + eps || hi.v > 1.0f + eps) uv_diff++;
+		for(size_t r=0; r<rects.size(); r++){
+			if(lo.u + eps < rects[r].second.u && rects[r].first.u + eps < hi.u
+				&& lo.v + eps < rects[r].second.v && rects[r].first.v + eps < hi.v) uv_diff++;
+		}
+		rects.push_back(std::make_pair(lo, hi));
+	}
+	MQTEST_CHECK(rects.size() >= 2);
+	MQTEST_CHECK(uv_diff == 0);
+	return failures;
+}
+
+// Compare the imported document with the source. Each imported triangle
+// must have three distinct vertices at the corners of a source face with
+// the same UVs and material, and every source face must be covered by
+// count-2 triangles. Weights are compared by bone names. 'expect' relaxes
+// the comparison for the export options.
+// 読み戻した文書を元と比べる。読み戻した三角形は3つの異なる頂点が同じUVと材質を
+// 持つ元の面の角にあり、元の面は頂点数-2個の三角形で覆われていなければならない。
+// ウェイトはボーン名で比べる。'expect'で書き出しのオプションに合わせて比較を緩める。
+static int CompareDocument(MQDocument src_doc, MQDocument dst_doc, bool with_bone, const RoundTripExpect& expect)
+{
+	int failures = 0;
+	MQTEST_CHECK(dst_doc->GetObjectCount() == 1);
+	if(dst_doc->GetObjectCount() != 1) return failures;
+	MQObject src = src_doc->GetObject(0);
+	MQObject dst = dst_doc->GetObject(0);
+	if(!expect.vertex_count_changed){
+		MQTEST_CHECK(dst->GetVertexCount() == src->GetVertexCount());
+	}
+
+	std::vector<int> vert_map(dst->GetVertexCount());
+	int vert_diff = 0;
+	for(int v=0; v<dst->GetVertexCount(); v++){
+		vert_map[v] = FindVertex(src, dst->GetVertex(v));
+		if(vert_map[v] < 0) vert_diff++;
+	}
+	for(int v=0; v<src->GetVertexCount(); v++){
+		if(FindVertex(dst, src->GetVertex(v)) < 0) vert_diff++;
+	}
+	MQTEST_CHECK(vert_diff == 0);
+	if(vert_diff != 0) return failures;
+
+	std::vector<int> covered(src->GetFaceCount(), 0);
+	std::map<int, std::vector<std::pair<MQCoordinate, MQCoordinate>>> uv_pairs;
+	int face_diff = 0;
+	for(int f=0; f<dst->GetFaceCount(); f++){
+		if(dst->GetFacePointCount(f) != 3){
+			face_diff++;
+			continue;
+		}
+		int vi[3];
+		MQCoordinate uv[3];
+		dst->GetFacePointArray(f, vi);
+		dst->GetFaceCoordinateArray(f, uv);
+		if(vi[0] == vi[1] || vi[1] == vi[2] || vi[2] == vi[0]){
+			face_diff++;
+			continue;
+		}
+
+		int found = -1;
+		MQCoordinate src_uv[3];
+		for(int sf=0; sf<src->GetFaceCount() && found < 0; sf++){
+			int count = src->GetFacePointCount(sf);
+			std::vector<int> svi(count);
+			std::vector<MQCoordinate> suv(count);
+			src->GetFacePointArray(sf, svi.data());
+			src->GetFaceCoordinateArray(sf, suv.data());
+			int matched = 0;
+			for(int k=0; k<3; k++){
+				for(int j=0; j<count; j++){
+					if(!IsSamePoint(src->GetVertex(svi[j]), dst->GetVertex(vi[k]))) continue;
+					if(!expect.uv_remapped && (fabsf(suv[j].u - uv[k].u) >= 1e-5f || fabsf(suv[j].v - uv[k].v) >= 1e-5f)) continue;
+					src_uv[k] = suv[j];
+					matched++;
+					break;
+				}
+			}
+			if(matched == 3) found = sf;
+		}
+		if(found < 0){
+			face_diff++;
+			continue;
+		}
+		covered[found]++;
+		for(int k=0; k<3; k++){
+			uv_pairs[src->GetFaceMaterial(found)].push_back(std::make_pair(src_uv[k], uv[k]));
+		}
+
+		// The same orientation as the source face
+		// 元の面と同じ向き
+		MQPoint n = GetNormal(dst->GetVertex(vi[0]), dst->GetVertex(vi[1]), dst->GetVertex(vi[2]));
+		std::vector<MQPoint> pts(src->GetFacePointCount(found));
+		std::vector<int> svi(pts.size());
+		src->GetFacePointArray(found, svi.data());
+		for(size_t j=0; j<pts.size(); j++) pts[j] = src->GetVertex(svi[j]);
+		if(GetInnerProduct(n, GetPolyNormal(pts.data(), (int)pts.size())) <= 0.0f) face_diff++;
+
+		MQMaterial src_mat = src_doc->GetMaterial(src->GetFaceMaterial(found));
+		int dst_mat_index = dst->GetFaceMaterial(f);
+		MQMaterial dst_mat = (dst_mat_index >= 0) ? dst_doc->GetMaterial(dst_mat_index) : nullptr;
+		std::string mat_name = src_mat->GetName();
+		auto renamed = expect.renamed_materials.find(mat_name);
+		if(renamed != expect.renamed_materials.end()) mat_name = renamed->second;
+		if(dst_mat == nullptr || dst_mat->GetName() != mat_name) face_diff++;
+	}
+	for(int sf=0; sf<src->GetFaceCount(); sf++){
+		bool dropped = std::find(expect.dropped_faces.begin(), expect.dropped_faces.end(), sf) != expect.dropped_faces.end();
+		if(covered[sf] != (dropped ? 0 : src->GetFacePointCount(sf) - 2)) face_diff++;
+	}
+	MQTEST_CHECK(face_diff == 0);
+	if(expect.uv_remapped){
+		failures += CompareRemappedUV(uv_pairs);
+	}
+
+	if(!with_bone) return failures;
+
+	MQTestBonePlugin& bp = MQTestBonePlugin::Get();
+	MQTEST_CHECK(bp.invalid_weights == 0);
+	MQTEST_CHECK(bp.added_bones.size() == bp.bones.size() - (expect.dropped_bone.empty() ? 0 : 1));
+	for(size_t i=0; i<bp.added_bones.size(); i++){
+		const MQTestBonePlugin::Bone& bone = bp.added_bones[i];
+		const MQTestBonePlugin::Bone *src_bone = nullptr;
+		for(size_t j=0; j<bp.bones.size(); j++){
+			if(bp.bones[j].name == bone.name) src_bone = &bp.bones[j];
+		}
+		MQTEST_CHECK(src_bone != nullptr && IsSamePoint(src_bone->pos, bone.pos));
+	}
+
+	int weight_diff = 0;
+	for(int v=0; v<dst->GetVertexCount(); v++){
+		const std::vector<std::pair<UINT, float>>& src_weights = bp.weights[src->GetVertexUniqueID(vert_map[v])];
+		std::map<std::wstring, float> expected, actual;
+		for(size_t i=0; i<src_weights.size(); i++){
+			const std::wstring& name = bp.FindBone(bp.bones, src_weights[i].first)->name;
+			if(name != expect.dropped_bone) expected[name] = src_weights[i].second;
+		}
+		const std::vector<std::pair<UINT, float>>& dst_weights = bp.added_weights[dst->GetVertexUniqueID(v)];
+		for(size_t i=0; i<dst_weights.size(); i++){
+			const MQTestBonePlugin::Bone *bone = bp.FindBone(bp.added_bones, dst_weights[i].first);
+			if(bone != nullptr) actual[bone->name] = dst_weights[i].second;
+		}
+		if(expected.size() != actual.size()){
+			weight_diff++;
+			continue;
+		}
+		for(auto it = expected.begin(); it != expected.end(); ++it){
+			auto a = actual.find(it->first);
+			if(a == actual.end() || fabsf(a->second - it->second) > 1e-3f) weight_diff++;
+		}
+	}
+	MQTEST_CHECK(weight_diff == 0);
+	return failures;
+}
+
+static MString GetTestPath(const char *name)
+{
+	MString dir = MFileUtil::combinePath(MFileUtil::getCurrentDirectory(), L"gpb_roundtrip");
+	MFileUtil::createDirectory(dir);
+	return MFileUtil::combinePath(dir, MString::fromUtf8String(name) + L".gpb");
+}
+
+// Export 'src_doc' with 'option', import it again and compare. 'profile'
+// receives the profile of the export.
+// 'src_doc'を'option'で書き出し、読み戻して比べる。'profile'は書き出しの計測を受け取る
+static int RunRoundTrip(const char *name, MQDocument src_doc, const CreateDialogOptionParam& option,
+	const RoundTripExpect& expect, GPBExportProfile& profile)
+{
+	int failures = 0;
+	bool with_bone = (option.output_bone != 0);
+	MString path = GetTestPath(name);
+	MQTEST_CHECK(ExportTestDocument(src_doc, path, option, profile));
+
+	// Forget the bones and weights added by a previous import
+	// 前の読み込みで追加されたボーンとウェイトを忘れる
+	MQTestBonePlugin& bp = MQTestBonePlugin::Get();
+	bp.rejected_bone = expect.dropped_bone;
+	bp.added_bones.clear();
+	bp.added_weights.clear();
+	bp.invalid_weights = 0;
+	MQDocument dst_doc = MQMockHost::CreateDocument();
+	ImportGPBPlugin plugin;
+	MQTEST_CHECK(plugin.ImportFile(0, path.c_str(), dst_doc));
+	if(failures == 0){
+		failures += CompareDocument(src_doc, dst_doc, with_bone, expect);
+	}
+	MQMockHost::DeleteDocument(dst_doc);
+	return failures;
+}
+
+static int RunRoundTrip(const char *name, bool with_bone, const std::wstring& rejected_bone)
+{
+	MQTestBonePlugin::Install();
+	MQDocument src_doc = CreateTestDocument(with_bone);
+	RoundTripExpect expect;
+	expect.dropped_bone = rejected_bone;
+	GPBExportProfile profile;
+	int failures = RunRoundTrip(name, src_doc, CreateTestOption(with_bone), expect, profile);
+	MQMockHost::DeleteDocument(src_doc);
+	MQTestBonePlugin::Uninstall();
+	return failures;
+}
+
+
+static bool ReadFileBytes(const MString& path, std::vector<unsigned char>& bytes)
+{
+	bytes.clear();
+	FILE *fp = fopen(path.toUtf8String().c_str(), "rb");
+	if(fp == nullptr) return false;
+	unsigned char buf[4096];
+	size_t n;
+	while((n = fread(buf, 1, sizeof(buf), fp)) > 0){
+		bytes.insert(bytes.end(), buf, buf + n);
+	}
+	fclose(fp);
+	return true;
+}
+
+static bool WriteFileBytes(const MString& path, const std::vector<unsigned char>& bytes)
+{
+	FILE *fp = fopen(path.toUtf8String().c_str(), "wb");
+	if(fp == nullptr) return false;
+	bool ret = (fwrite(bytes.data(), 1, bytes.size(), fp) == bytes.size());
+	return (fclose(fp) == 0) && ret;
+}
+
+
+// Meshes, UVs and materials come back
+MQTEST(gpb_roundtrip)
+{
+	return RunRoundTrip("mesh", false, std::wstring());
+}
+
+// Bones and weights come back through the bone plug-in
+MQTEST(gpb_roundtrip_bone)
+{
+	return RunRoundTrip("bone", true, std::wstring());
+}
+
+// Weights of a joint whose bone could not be added are not sent with an
+// invalid bone ID
+MQTEST(gpb_roundtrip_missing_bone)
+{
+	return RunRoundTrip("missing_bone", true, L"hand");
+}
+
+// A copy of a material is merged into the original, and the faces of both
+// come back with the original
+// 材質の複製は元の材質に統合され、両方の面が元の材質で戻る
+MQTEST(gpb_roundtrip_material_merge)
+{
+	int failures = 0;
+	MQTestBonePlugin::Install();
+	MQDocument src_doc = CreateTestDocument(true);
+	MQMaterial red = src_doc->GetMaterial(0);
+	MQMaterial copy = MQ_CreateMaterial();
+	copy->SetName("red_copy");
+	copy->SetColor(red->GetColor());
+	int copy_index = src_doc->AddMaterial(copy);
+	MQObject obj = src_doc->GetObject(0);
+	for(int f=0; f<obj->GetFaceCount(); f+=2){
+		if(obj->GetFaceMaterial(f) == 0) obj->SetFaceMaterial(f, copy_index);
+	}
+
+	CreateDialogOptionParam option = CreateTestOption(true);
+	RoundTripExpect expect;
+	GPBExportProfile separate;
+	failures += RunRoundTrip("material_separate", src_doc, option, expect, separate);
+	MQTEST_CHECK(GetProfileCount(separate, "merged_materials") == -1);
+
+	option.material_merge = 1;
+	expect.renamed_materials["red_copy"] = "red";
+	GPBExportProfile merged;
+	failures += RunRoundTrip("material_merge", src_doc, option, expect, merged);
+	MQTEST_CHECK(GetProfileCount(merged, "merged_materials") == 1);
+
+	MQMockHost::DeleteDocument(src_doc);
+	MQTestBonePlugin::Uninstall();
+	return failures;
+}
+
+// Give both materials white color and a clamped texture of their own, so
+// that only the textures differ
+// 両方の材質を白にして、それぞれにクランプのテクスチャを設定する。
+// テクスチャだけが違う
+static void SetClampedTextures(MQDocument doc)
+{
+	for(int i=0; i<2; i++){
+		MQMaterial mat = doc->GetMaterial(i);
+		MString texture = MString::fromAnsiString(mat->GetName().c_str()) + L".png";
+		mat->SetColor(MQColor(1.0f, 1.0f, 1.0f));
+		mat->SetTextureName(texture.toAnsiString().c_str());
+		mat->SetWrapModeU(MQMATERIAL_WRAP_CLAMP);
+		mat->SetWrapModeV(MQMATERIAL_WRAP_CLAMP);
+
+		const int size = 16;
+		std::vector<BYTE> pixels(size * size * 3, (BYTE)(0x40 + i * 0x80));
+		MQMockHost::AddMappingImage(doc, texture.c_str(), MQMAPPING_TEXTURE, size, size, 24, pixels.data());
+	}
+}
+
+// Both textures are packed into one atlas. The faces of both materials
+// come back with the first material, the atlas and the UVs moved into it.
+// Exporting again reports every file unchanged on its own line.
+// 両方のテクスチャが1つのアトラスに入る。両方の材質の面は最初の材質、
+// アトラスとその中に移ったUVで戻る。もう一度書き出すと、すべてのファイルが
+// それぞれの行で変更なしと表示される。
+MQTEST(gpb_roundtrip_texture_atlas)
+{
+	int failures = 0;
+	MQTestBonePlugin::Install();
+	MQDocument src_doc = CreateTestDocument(true);
+	SetClampedTextures(src_doc);
+
+	CreateDialogOptionParam option = CreateTestOption(true);
+	option.texture_atlas = ATLAS_ALL;
+	RoundTripExpect expect;
+	expect.renamed_materials["blue"] = "red";
+	expect.uv_remapped = true;
+	// Vertices shared by both materials are duplicated
+	// 両方の材質で共有する頂点は複製される
+	expect.vertex_count_changed = true;
+	GPBExportProfile profile;
+	failures += RunRoundTrip("texture_atlas", src_doc, option, expect, profile);
+	MQTEST_CHECK(GetProfileCount(profile, "atlas_materials") == 1);
+
+	MString path = GetTestPath("texture_atlas");
+	MString atlas_path = MFileUtil::changeExtension(path, L"_atlas0.png");
+	MString material_path = MFileUtil::changeExtension(path, L".material");
+	std::vector<unsigned char> atlas, material;
+	MQTEST_CHECK(ReadFileBytes(atlas_path, atlas) && !atlas.empty());
+	MQTEST_CHECK(ReadFileBytes(material_path, material));
+	std::string material_text(material.begin(), material.end());
+	MQTEST_CHECK(material_text.find("texture_atlas_atlas0.png") != std::string::npos);
+
+	GPBExportProfile again;
+	MString output_files;
+	MQTEST_CHECK(ExportTestDocument(src_doc, path, option, again, &output_files));
+	MQTEST_CHECK(GetProfileCount(again, "unchanged_files") == 3);
+	MLanguage language;
+	MString unchanged = MString(L" ") + language.Search("Unchanged");
+	MQTEST_CHECK(output_files == path + unchanged + L"\n" + atlas_path + unchanged + L"\n" + material_path + unchanged);
+
+	MQMockHost::DeleteDocument(src_doc);
+	MQTestBonePlugin::Uninstall();
+	return failures;
+}
+
+// A flat grid of 3x2 quadrangles. The second row has its own copies of the
+// vertices on the middle line, and a thin triangle joins two vertices of
+// the last line with a copy of one of them moved slightly. The index of
+// the thin triangle is returned in 'thin_face'.
+// 3x2の四角形の平らな格子。2行目は中央の線の頂点の複製を持ち、細い三角形が
+// 最後の線の2頂点と、その片方をわずかに動かした複製をつなぐ。細い三角形の
+// インデックスを'thin_face'に返す。
+static MQDocument CreateWeldDocument(int& thin_face)
+{
+	MQDocument doc = MQMockHost::CreateDocument();
+	MQMaterial mat = MQ_CreateMaterial();
+	mat->SetName("white");
+	doc->AddMaterial(mat);
+
+	const int cols = 3;
+	const float line_z[4] = { 0.0f, 1.0f, 1.0f, 2.0f };
+	MQObject obj = MQ_CreateObject();
+	obj->SetName("weld");
+	int line[4][cols+1];
+	for(int l=0; l<4; l++){
+		for(int x=0; x<=cols; x++){
+			line[l][x] = obj->AddVertex(MQPoint((float)x, 0.0f, line_z[l]));
+		}
+	}
+	for(int l=0; l<4; l+=2){
+		for(int x=0; x<cols; x++){
+			int vi[4] = { line[l][x], line[l+1][x], line[l+1][x+1], line[l][x+1] };
+			int fi = obj->AddFace(4, vi);
+			float u0 = (float)x / cols, u1 = (float)(x+1) / cols;
+			float t0 = line_z[l] / 2.0f, t1 = line_z[l+1] / 2.0f;
+			MQCoordinate uv[4] = {
+				MQCoordinate(u0, t0), MQCoordinate(u0, t1), MQCoordinate(u1, t1), MQCoordinate(u1, t0),
+			};
+			obj->SetFaceCoordinateArray(fi, uv);
+			obj->SetFaceMaterial(fi, 0);
+		}
+	}
+
+	// Within the tolerance of welding
+	// 溶接の許容誤差の内側
+	int moved = obj->AddVertex(MQPoint(0.00005f, 0.0f, 2.00005f));
+	int vi[3] = { line[3][0], moved, line[3][1] };
+	thin_face = obj->AddFace(3, vi);
+	MQCoordinate uv[3] = { MQCoordinate(0.0f, 1.0f), MQCoordinate(0.0f, 1.0f), MQCoordinate(1.0f / cols, 1.0f) };
+	obj->SetFaceCoordinateArray(thin_face, uv);
+	obj->SetFaceMaterial(thin_face, 0);
+	doc->AddObject(obj);
+	return doc;
+}
+
+// Welding joins the copies, and the thin triangle whose corners meet is
+// not exported
+// 溶接で複製がまとまり、角が重なった細い三角形は書き出されない
+MQTEST(gpb_roundtrip_weld)
+{
+	int failures = 0;
+	MQTestBonePlugin::Install();
+	MQTestBonePlugin::Get().Clear();
+	int thin_face = -1;
+	MQDocument src_doc = CreateWeldDocument(thin_face);
+
+	CreateDialogOptionParam option = CreateTestOption(false);
+	option.weld = 1;
+	RoundTripExpect expect;
+	expect.vertex_count_changed = true;
+	expect.dropped_faces.push_back(thin_face);
+	GPBExportProfile profile;
+	failures += RunRoundTrip("weld", src_doc, option, expect, profile);
+	MQTEST_CHECK(GetProfileCount(profile, "welded_vertices") == 5);
+	MQTEST_CHECK(GetProfileCount(profile, "dropped_triangles") == 1);
+	MQTEST_CHECK(GetProfileCount(profile, "vertices") == 12);
+	MQTEST_CHECK(GetProfileCount(profile, "triangles") == 12);
+
+	MQMockHost::DeleteDocument(src_doc);
+	MQTestBonePlugin::Uninstall();
+	return failures;
+}
+
+//---------------------------------------------------------------------------
+//  Unchanged files
+//---------------------------------------------------------------------------
+
+// Exporting the same document twice leaves every file unchanged, and a
+// file whose contents differ from the export is replaced even if its size
+// is the same
+// 同じ文書を2回書き出すとどのファイルも変わらない。書き出す内容と違う
+// ファイルは大きさが同じでも置き換えられる
+MQTEST(gpb_export_unchanged)
+{
+	int failures = 0;
+	MQTestBonePlugin::Install();
+	MString path = GetTestPath("unchanged");
+	MString material_path = MFileUtil::changeExtension(path, L".material");
+	MFileUtil::deleteFile(path);
+	MFileUtil::deleteFile(material_path);
+
+	MQDocument doc = CreateTestDocument(true);
+	CreateDialogOptionParam option = CreateTestOption(true);
+	GPBExportProfile first, second, third;
+	MQTEST_CHECK(ExportTestDocument(doc, path, option, first));
+	MQTEST_CHECK(GetProfileCount(first, "unchanged_files") == 0);
+
+	std::vector<unsigned char> gpb, material;
+	MQTEST_CHECK(ReadFileBytes(path, gpb) && !gpb.empty());
+	MQTEST_CHECK(ReadFileBytes(material_path, material) && !material.empty());
+
+	MQTEST_CHECK(ExportTestDocument(doc, path, option, second));
+	MQTEST_CHECK(GetProfileCount(second, "unchanged_files") == 2);
+
+	// Flip a byte in the middle of the .gpb
+	// .gpbの途中の1バイトを反転する
+	std::vector<unsigned char> broken = gpb;
+	broken[broken.size() / 2] ^= 0xFF;
+	MQTEST_CHECK(WriteFileBytes(path, broken));
+	MQTEST_CHECK(ExportTestDocument(doc, path, option, third));
+	MQTEST_CHECK(GetProfileCount(third, "unchanged_files") == 1);
+
+	std::vector<unsigned char> restored;
+	MQTEST_CHECK(ReadFileBytes(path, restored) && restored == gpb);
+
+	MQMockHost::DeleteDocument(doc);
+	MQTestBonePlugin::Uninstall();
+	return failures;
+}
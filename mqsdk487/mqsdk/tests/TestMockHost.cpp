@@ -0,0 +1,97 @@
+﻿//---------------------------------------------------------------------------
+//
+//   TestMockHost.cpp
+//
+//     Tests of the mock host itself.
+//    　模擬ホスト自体のテスト。
+//
+//---------------------------------------------------------------------------
+
+#include "MQTest.h"
+#include "MQMockHost.h"
+#include <cstring>
+
+
+// Objects and materials keep what is set, and unique IDs are distinct
+MQTEST(mockhost_document)
+{
+	int failures = 0;
+	MQDocument doc = MQMockHost::CreateDocument();
+
+	MQMaterial mat = MQ_CreateMaterial();
+	mat->SetName("mat");
+	mat->SetColor(MQColor(0.25f, 0.5f, 0.75f));
+	MQTEST_CHECK(doc->AddMaterial(mat) == 0);
+	MQTEST_CHECK(doc->GetMaterialCount() == 1);
+	MQTEST_CHECK(doc->GetMaterial(0)->GetName() == "mat");
+	MQTEST_CHECK(doc->GetMaterial(0)->GetColor().g == 0.5f);
+
+	MQObject obj = MQ_CreateObject();
+	obj->SetName("obj");
+	int vi[4];
+	vi[0] = obj->AddVertex(MQPoint(0, 0, 0));
+	vi[1] = obj->AddVertex(MQPoint(0, 0, 1));
+	vi[2] = obj->AddVertex(MQPoint(1, 0, 1));
+	vi[3] = obj->AddVertex(MQPoint(1, 0, 0));
+	int unused = obj->AddVertex(MQPoint(5, 5, 5));
+	int face = obj->AddFace(4, vi);
+	MQCoordinate uv[4] = { MQCoordinate(0, 0), MQCoordinate(0, 1), MQCoordinate(1, 1), MQCoordinate(1, 0) };
+	obj->SetFaceCoordinateArray(face, uv);
+	obj->SetFaceMaterial(face, 0);
+	doc->AddObject(obj);
+
+	MQObject got = doc->GetObject(0);
+	MQTEST_CHECK(doc->GetObjectCount() == 1 && got == obj);
+	MQTEST_CHECK(got->GetName() == "obj");
+	MQTEST_CHECK(got->GetVertexCount() == 5 && got->GetFaceCount() == 1);
+	MQTEST_CHECK(got->GetFacePointCount(face) == 4 && got->GetFaceMaterial(face) == 0);
+	int got_vi[4];
+	MQCoordinate got_uv[4];
+	got->GetFacePointArray(face, got_vi);
+	got->GetFaceCoordinateArray(face, got_uv);
+	MQTEST_CHECK(memcmp(got_vi, vi, sizeof(vi)) == 0);
+	MQTEST_CHECK(got_uv[2].u == 1.0f && got_uv[2].v == 1.0f);
+	MQTEST_CHECK(got->GetVertex(vi[2]) == MQPoint(1, 0, 1));
+	MQTEST_CHECK(got->GetVertexRefCount(vi[0]) == 1 && got->GetVertexRefCount(unused) == 0);
+
+	int distinct = 0;
+	for(int i=0; i<5; i++){
+		for(int j=i+1; j<5; j++){
+			if(got->GetVertexUniqueID(i) != got->GetVertexUniqueID(j)) distinct++;
+		}
+	}
+	MQTEST_CHECK(distinct == 10);
+
+	MQMockHost::DeleteDocument(doc);
+	return failures;
+}
+
+static int s_HandledMessages = 0;
+
+static BOOL TestMessageHandler(int message_type, MQSendMessageInfo *info)
+{
+	if(message_type != MQMESSAGE_USER_MESSAGE || info == nullptr) return FALSE;
+	s_HandledMessages++;
+	*(int*)info->option = 42;
+	return TRUE;
+}
+
+// MQ_SendMessage() is passed to the handler, and fails without it
+MQTEST(mockhost_message)
+{
+	int failures = 0;
+	int result = 0;
+	MQSendMessageInfo info;
+	memset(&info, 0, sizeof(info));
+	info.option = &result;
+
+	MQMockHost::SetMessageHandler(nullptr);
+	MQTEST_CHECK(!MQ_SendMessage(MQMESSAGE_USER_MESSAGE, &info));
+
+	MQMockHost::SetMessageHandler(TestMessageHandler);
+	MQTEST_CHECK(MQ_SendMessage(MQMESSAGE_USER_MESSAGE, &info));
+	MQTEST_CHECK(result == 42 && s_HandledMessages == 1);
+
+	MQMockHost::SetMessageHandler(nullptr);
+	return failures;
+}
@@ -0,0 +1,218 @@
+﻿//---------------------------------------------------------------------------
+//
+//   TestPlayback.cpp
+//
+//     Tests of BonePlayback in stationtry. Keys are compiled against a bone
+//    snapshot filled by hand, so no bone plug-in is needed.
+//    　stationtryのBonePlaybackのテスト。手で埋めたボーン情報に対してキーを
+//    変換するので、ボーンプラグインは不要。
+//
+//---------------------------------------------------------------------------
+
+#include "MQTest.h"
+#include "playback.h"
+#include <random>
+#include <cmath>
+
+
+static ONEVALTARGET MakeTarget(const wchar_t *name, float x, float head, float bank)
+{
+	ONEVALTARGET target;
+	target.target = name;
+	target.val.x = x;
+	target.val.head = head;
+	target.val.bank = bank;
+	return target;
+}
+
+// Keys are given out of time order. "arm" has two keys at 1000ms, and the
+// later one must win. "tail" is not in the snapshot.
+// キーは時刻順に並んでいない。"arm"は1000msに2つのキーを持ち、後のものが勝つ。
+// "tail"はボーン情報に無い。
+static void CreateTestKeys(BONESINFO& info, MQBoneManager::BONE_SNAPSHOT& snapshot)
+{
+	snapshot.resize(3);
+	const wchar_t *names[3] = { L"root", L"arm", L"hand" };
+	for(int i=0; i<3; i++){
+		snapshot.id[i] = (UINT)(10 * (i + 1));
+		snapshot.name[i] = names[i];
+	}
+
+	ONEKEYVAL key;
+	key.msec = 2000;
+	key.vals.push_back(MakeTarget(L"arm", 20.0f, -170.0f, 170.0f));
+	info.keyvals.push_back(key);
+
+	key.msec = 0;
+	key.vals.clear();
+	key.vals.push_back(MakeTarget(L"root", 0.0f, 0.0f, 0.0f));
+	key.vals.push_back(MakeTarget(L"arm", 0.0f, 170.0f, 0.0f));
+	key.vals.push_back(MakeTarget(L"tail", 1.0f, 1.0f, 1.0f));
+	info.keyvals.push_back(key);
+
+	key.msec = 1000;
+	key.vals.clear();
+	key.vals.push_back(MakeTarget(L"arm", 5.0f, 0.0f, 0.0f));
+	key.vals.push_back(MakeTarget(L"hand", 3.0f, 45.0f, 0.0f));
+	info.keyvals.push_back(key);
+
+	key.vals.clear();
+	key.vals.push_back(MakeTarget(L"arm", 10.0f, -170.0f, -170.0f));
+	info.keyvals.push_back(key);
+
+	key.msec = 3000;
+	key.vals.clear();
+	key.vals.push_back(MakeTarget(L"root", 30.0f, 90.0f, 0.0f));
+	info.keyvals.push_back(key);
+}
+
+static const MQBoneManager::DEFORM_PARAM *FindParam(const std::vector<MQBoneManager::DEFORM_PARAM>& params, UINT bone_id)
+{
+	for(size_t i=0; i<params.size(); i++){
+		if(params[i].bone_id == bone_id) return &params[i];
+	}
+	return nullptr;
+}
+
+// Difference of angles in degrees regardless of the turns
+// 回転数によらない角度の差
+static float GetAngleDiff(float a, float b)
+{
+	float d = fmodf(fabsf(a - b), 360.0f);
+	return (d > 180.0f) ? 360.0f - d : d;
+}
+
+static bool IsSameParam(const MQBoneManager::DEFORM_PARAM& a, const MQBoneManager::DEFORM_PARAM& b)
+{
+	return a.bone_id == b.bone_id && a.set_flags == b.set_flags
+		&& a.translate == b.translate
+		&& a.rotate.head == b.rotate.head && a.rotate.pich == b.rotate.pich && a.rotate.bank == b.rotate.bank;
+}
+
+
+// Channels, duplicate keys, clamping and shortest-arc interpolation
+MQTEST(playback_evaluate)
+{
+	int failures = 0;
+	BONESINFO info;
+	MQBoneManager::BONE_SNAPSHOT snapshot;
+	CreateTestKeys(info, snapshot);
+
+	BonePlayback playback;
+	MQTEST_CHECK(playback.compile(info, snapshot) == 3);
+	MQTEST_CHECK(playback.getDuration() == 3000);
+
+	std::vector<MQBoneManager::DEFORM_PARAM> params;
+	MQTEST_CHECK(playback.evaluate(1000, params) == 3);
+	MQTEST_CHECK(params.size() == 3);
+	const MQBoneManager::DEFORM_PARAM *arm = FindParam(params, 20);
+	const MQBoneManager::DEFORM_PARAM *hand = FindParam(params, 30);
+	MQTEST_CHECK(FindParam(params, 10) != nullptr && arm != nullptr && hand != nullptr);
+	if(arm == nullptr || hand == nullptr) return failures;
+
+	// The later key at the same time wins
+	// 同時刻は後のキーが勝つ
+	MQTEST_CHECK(arm->translate.x == 10.0f);
+	MQTEST_CHECK(arm->rotate.head == -170.0f);
+
+	// 170 -> -170 passes through 180, not 0
+	// 170 -> -170 は0ではなく180を通る
+	playback.evaluate(500, params);
+	arm = FindParam(params, 20);
+	MQTEST_CHECK(fabsf(arm->translate.x - 5.0f) < 1e-4f);
+	MQTEST_CHECK(GetAngleDiff(arm->rotate.head, 180.0f) < 1e-3f);
+	playback.evaluate(250, params);
+	arm = FindParam(params, 20);
+	MQTEST_CHECK(fabsf(arm->rotate.head - 175.0f) < 1e-3f);
+
+	// -170 -> 170 passes through -180
+	// -170 -> 170 は-180を通る
+	playback.evaluate(1750, params);
+	arm = FindParam(params, 20);
+	MQTEST_CHECK(GetAngleDiff(arm->rotate.bank, 175.0f) < 1e-3f);
+	MQTEST_CHECK(fabsf(arm->rotate.head - (-170.0f)) < 1e-3f);
+
+	// A channel with one key is constant, and the others are clamped
+	// キーが1つのチャンネルは一定で、それ以外は範囲外で端の値になる
+	for(int msec=-500; msec<=4000; msec+=4500){
+		playback.evaluate(msec, params);
+		hand = FindParam(params, 30);
+		arm = FindParam(params, 20);
+		const MQBoneManager::DEFORM_PARAM *root = FindParam(params, 10);
+		MQTEST_CHECK(hand->translate.x == 3.0f && hand->rotate.head == 45.0f);
+		MQTEST_CHECK(arm->translate.x == ((msec < 0) ? 0.0f : 20.0f));
+		MQTEST_CHECK(root->translate.x == ((msec < 0) ? 0.0f : 30.0f));
+		MQTEST_CHECK((root->set_flags & MQBoneManager::DEFORM_PARAM::SET_SCALE) == 0);
+	}
+	return failures;
+}
+
+// The cached segment gives the same results as a fresh search when playing
+// forward, seeking backward and jumping at random
+MQTEST(playback_cursor)
+{
+	int failures = 0;
+	BONESINFO info;
+	MQBoneManager::BONE_SNAPSHOT snapshot;
+	CreateTestKeys(info, snapshot);
+
+	// Many keys in one channel, so that the search is not trivial
+	// 探索が自明にならないよう、1つのチャンネルに多数のキーを置く
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> angle(-180.0f, 180.0f);
+	for(int msec=0; msec<=3000; msec+=30 + rng()%40){
+		ONEKEYVAL key;
+		key.msec = msec;
+		key.vals.push_back(MakeTarget(L"hand", angle(rng), angle(rng), angle(rng)));
+		info.keyvals.push_back(key);
+	}
+
+	BonePlayback playback;
+	playback.compile(info, snapshot);
+
+	std::vector<int> times;
+	for(int msec=-100; msec<=3100; msec+=7) times.push_back(msec);
+	for(int msec=3100; msec>=-100; msec-=13) times.push_back(msec);
+	std::uniform_int_distribution<int> jump(-100, 3100);
+	for(int i=0; i<500; i++) times.push_back(jump(rng));
+
+	int diff = 0;
+	std::vector<MQBoneManager::DEFORM_PARAM> params, ref_params;
+	for(size_t i=0; i<times.size(); i++){
+		BonePlayback fresh;
+		fresh.compile(info, snapshot);
+		playback.evaluate(times[i], params);
+		fresh.evaluate(times[i], ref_params);
+		if(params.size() != ref_params.size()){
+			diff++;
+			continue;
+		}
+		for(size_t k=0; k<params.size(); k++){
+			if(!IsSameParam(params[k], ref_params[k])) diff++;
+		}
+	}
+	MQTEST_CHECK(diff == 0);
+	return failures;
+}
+
+// Keys of bones missing from the snapshot are ignored
+MQTEST(playback_unknown_bone)
+{
+	int failures = 0;
+	BONESINFO info;
+	MQBoneManager::BONE_SNAPSHOT snapshot;
+	CreateTestKeys(info, snapshot);
+
+	MQBoneManager::BONE_SNAPSHOT empty;
+	BonePlayback playback;
+	MQTEST_CHECK(playback.compile(info, empty) == 0);
+	MQTEST_CHECK(playback.isEmpty());
+	std::vector<MQBoneManager::DEFORM_PARAM> params(2);
+	MQTEST_CHECK(playback.evaluate(100, params) == 0 && params.empty());
+
+	snapshot.name[2] = L"finger";
+	MQTEST_CHECK(playback.compile(info, snapshot) == 2);
+	playback.evaluate(1000, params);
+	MQTEST_CHECK(FindParam(params, 30) == nullptr);
+	return failures;
+}
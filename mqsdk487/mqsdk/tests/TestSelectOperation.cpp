@@ -0,0 +1,107 @@
+﻿//---------------------------------------------------------------------------
+//
+//   TestSelectOperation.cpp
+//
+//     Tests of the batch IsInside() of MQSelectOperation. The results with
+//    the cell mask must be the same as IsInsideRope() for every point.
+//    　MQSelectOperationの一括IsInside()のテスト。セルのマスクを使った
+//    結果は全ての点でIsInsideRope()と同じでなければならない。
+//
+//---------------------------------------------------------------------------
+
+#include "MQTest.h"
+#include "MQSelectOperation.h"
+#include <random>
+#include <cmath>
+
+
+// Points around the rope. Some are on integer coordinates and half pixels
+// to hit rope vertices and cell borders.
+// 投げ縄の周囲の点。投げ縄の頂点やセルの境界に当たるように、一部は整数座標や
+// 半ピクセルに置く。
+static void CreateTestPoints(std::vector<MQPoint>& pts, std::mt19937& rng, int range)
+{
+	std::uniform_real_distribution<float> coord(-20.0f, (float)range + 20.0f);
+	pts.resize(10000);
+	for(size_t i=0; i<pts.size(); i++){
+		pts[i] = MQPoint(coord(rng), coord(rng), 0.0f);
+		if(rng() % 4 == 0){
+			pts[i].x = floorf(pts[i].x);
+			pts[i].y = floorf(pts[i].y);
+		}
+		if(rng() % 8 == 0){
+			pts[i].x += 0.5f;
+		}
+	}
+	pts[0] = MQPoint(NAN, 0.0f, 0.0f);
+}
+
+// The batch IsInside() with a rope gives the same results as IsInsideRope()
+// through a copy taken before the mask is built
+MQTEST(select_rope)
+{
+	int failures = 0;
+	std::mt19937 rng(1);
+	int diff = 0;
+	long long inside = 0;
+	for(int trial=0; trial<30; trial++){
+		int range = (trial % 2) ? 2000 : 60;
+		std::uniform_int_distribution<int> coord(0, range);
+		MQSelectOperation op;
+		POINT p = { coord(rng), coord(rng) };
+		op.Begin(MQSelectOperation::SELECT_ROPE, p);
+
+		std::vector<MQPoint> pts;
+		CreateTestPoints(pts, rng, range);
+		std::vector<BYTE> out(pts.size());
+		for(int stage=0; stage<2; stage++){
+			int n = 3 + rng() % 300;
+			for(int i=0; i<n; i++){
+				POINT q = { coord(rng), coord(rng) };
+				if(trial % 3 == 0){
+					q.x = (q.x / 10) * 10;
+					q.y = (q.y / 10) * 10;
+				}
+				op.Move(q);
+			}
+
+			// The copy has no mask, so it tests points with IsInsideRope()
+			// 複製はマスクを持たないので、IsInsideRope()で点を判定する
+			MQSelectOperation rope = op;
+			op.IsInside(pts.data(), pts.size(), out.data(), (stage == 0) ? 1 : 4);
+			for(size_t i=0; i<pts.size(); i++){
+				bool ref = rope.IsInside(pts[i]);
+				if((out[i] != 0) != ref) diff++;
+				if(op.IsInside(pts[i]) != ref) diff++;
+				if(ref) inside++;
+			}
+		}
+	}
+	MQTEST_CHECK(diff == 0);
+	MQTEST_CHECK(inside > 0);
+	return failures;
+}
+
+// The batch IsInside() with a rectangle gives the same results as for each
+// point
+MQTEST(select_rect)
+{
+	int failures = 0;
+	std::mt19937 rng(2);
+	std::vector<MQPoint> pts;
+	CreateTestPoints(pts, rng, 100);
+	std::vector<BYTE> out(pts.size());
+
+	MQSelectOperation op;
+	POINT p1 = { 80, 10 }, p2 = { 20, 70 };
+	op.Begin(MQSelectOperation::SELECT_RECT, p1);
+	op.Move(p2);
+	op.IsInside(pts.data(), pts.size(), out.data());
+	int diff = 0;
+	for(size_t i=0; i<pts.size(); i++){
+		bool ref = (20.0f <= pts[i].x && pts[i].x <= 80.0f && 10.0f <= pts[i].y && pts[i].y <= 70.0f);
+		if((out[i] != 0) != ref || op.IsInside(pts[i]) != ref) diff++;
+	}
+	MQTEST_CHECK(diff == 0);
+	return failures;
+}
@@ -0,0 +1,288 @@
+﻿//---------------------------------------------------------------------------
+//
+//   TestSkinning.cpp
+//
+//     Tests of SkinningPreview of the station plug-in. The AVX2 paths are
+//    compared with the scalar paths, which are compared with a reference
+//    computed with MQMatrix. On a CPU without AVX2 both paths are scalar.
+//    　ステーションプラグインのSkinningPreviewのテスト。AVX2版はスカラー版と
+//    比べ、スカラー版はMQMatrixで求めた参照値と比べる。AVX2の無いCPUでは
+//    どちらもスカラー版になる。
+//
+//---------------------------------------------------------------------------
+
+#include "MQTest.h"
+#include "MQMockHost.h"
+#include "MQTestBonePlugin.h"
+#include "skinning.h"
+#include "Common/MQDualQuaternion.h"
+#include "MQ3DLib.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+
+// Transform a point by a row vector matrix (p * mtx)
+// 行ベクトル形式の行列で点を変換する (p * mtx)
+static MQPoint TransformPoint(const MQMatrix& mtx, const MQPoint& p)
+{
+	return MQPoint(
+		p.x * mtx(0,0) + p.y * mtx(1,0) + p.z * mtx(2,0) + mtx(3,0),
+		p.x * mtx(0,1) + p.y * mtx(1,1) + p.z * mtx(2,1) + mtx(3,1),
+		p.x * mtx(0,2) + p.y * mtx(1,2) + p.z * mtx(2,2) + mtx(3,2));
+}
+
+static float GetMaxDiff(const std::vector<MQPoint>& a, const std::vector<MQPoint>& b)
+{
+	if(a.size() != b.size()) return FLT_MAX;
+	float diff = 0.0f;
+	for(size_t i=0; i<a.size(); i++){
+		diff = (std::max)(diff, GetSize(a[i] - b[i]));
+	}
+	return diff;
+}
+
+// A chain of bones that are rotated and moved, and an object of 'vert_num'
+// vertices with 0 to 6 weights of distinct values. At most four of them
+// are used by SkinningPreview.
+// 回転と移動をしたボーンの連なりと、'vert_num'個の頂点を持つオブジェクト。
+// 各頂点は異なる値の0～6個のウェイトを持ち、SkinningPreviewはそのうち
+// 最大4個を使う。
+struct SkinningScene
+{
+	MQDocument doc;
+	MQObject obj;
+	MQTestSenderPlugin plugin;
+	MQBoneManager::BONE_SNAPSHOT snapshot;
+
+	void Create(int vert_num, int bone_num, unsigned int seed)
+	{
+		MQTestBonePlugin& bp = MQTestBonePlugin::Get();
+		bp.Clear();
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> angle(-170.0f, 170.0f);
+		for(int i=0; i<bone_num; i++){
+			MQTestBonePlugin::Bone& bone = bp.AddBone(i + 1, i, MQPoint(1.5f * i, 0.5f, -0.25f * i), L"bone");
+			bone.deform_matrix.SetTransform(MQPoint(1.0f, 1.0f, 1.0f),
+				MQAngle(angle(rng), angle(rng) * 0.5f, angle(rng)),
+				MQPoint(1.5f * i + 0.3f, 0.5f * i, 0.2f));
+		}
+
+		doc = MQMockHost::CreateDocument();
+		obj = MQ_CreateObject();
+		std::uniform_real_distribution<float> coord(-5.0f, 5.0f);
+		for(int v=0; v<vert_num; v++){
+			obj->AddVertex(MQPoint(coord(rng), coord(rng), coord(rng)));
+		}
+		doc->AddObject(obj);
+		bp.object_id = obj->GetUniqueID();
+
+		std::vector<int> values(100);
+		for(int i=0; i<100; i++) values[i] = i + 1;
+		std::vector<UINT> ids(bone_num);
+		for(int i=0; i<bone_num; i++) ids[i] = i + 1;
+		for(int v=0; v<vert_num; v++){
+			int num = (std::min)((int)(rng() % 7), bone_num);
+			std::shuffle(ids.begin(), ids.end(), rng);
+			std::shuffle(values.begin(), values.end(), rng);
+			std::vector<std::pair<UINT, float>> list;
+			for(int i=0; i<num; i++){
+				list.push_back(std::make_pair(ids[i], values[i] / 100.0f));
+			}
+			if(!list.empty()) bp.weights[obj->GetVertexUniqueID(v)] = list;
+		}
+
+		MQBoneManager bone_manager(&plugin, doc);
+		bone_manager.GetBoneSnapshot(snapshot, MQBoneManager::SNAPSHOT_ALL);
+	}
+
+	void Build(SkinningPreview& skin)
+	{
+		MQBoneManager bone_manager(&plugin, doc);
+		skin.build(bone_manager, obj, snapshot);
+	}
+
+	void Delete()
+	{
+		MQMockHost::DeleteDocument(doc);
+	}
+
+	// Positions by blending inverse(base_matrix) * deform_matrix of the four
+	// largest weights
+	// 大きい方から4つのウェイトでinverse(base_matrix) * deform_matrixを
+	// 混ぜた位置
+	void GetLinearReference(std::vector<MQPoint>& out) const
+	{
+		MQTestBonePlugin& bp = MQTestBonePlugin::Get();
+		out.resize(obj->GetVertexCount());
+		for(int v=0; v<obj->GetVertexCount(); v++){
+			std::vector<std::pair<float, UINT>> list;
+			auto it = bp.weights.find(obj->GetVertexUniqueID(v));
+			if(it != bp.weights.end()){
+				for(size_t i=0; i<it->second.size(); i++){
+					list.push_back(std::make_pair(it->second[i].second, it->second[i].first));
+				}
+			}
+			std::sort(list.rbegin(), list.rend());
+			if(list.size() > 4) list.resize(4);
+			if(list.empty()){
+				out[v] = obj->GetVertex(v);
+				continue;
+			}
+			float total = 0.0f;
+			for(size_t i=0; i<list.size(); i++) total += list[i].first;
+			MQPoint p = obj->GetVertex(v);
+			MQPoint sum(0.0f, 0.0f, 0.0f);
+			for(size_t i=0; i<list.size(); i++){
+				int index = snapshot.indexOf(list[i].second);
+				MQMatrix inv;
+				snapshot.base_matrix[index].Inverse(inv);
+				sum += TransformPoint(inv * snapshot.deform_matrix[index], p) * (list[i].first / total);
+			}
+			out[v] = sum;
+		}
+	}
+};
+
+// The AVX2 path, the scalar path and the reference agree. The vertex count
+// is not a multiple of 8, and threads are used for the larger object.
+// AVX2版、スカラー版、参照値が一致する。頂点数は8の倍数ではなく、
+// 大きい方のオブジェクトではスレッドを使う。
+MQTEST(skinning_linear)
+{
+	int failures = 0;
+	MQTestBonePlugin::Install();
+	const int vert_nums[2] = { 1003, 40005 };
+	for(int n=0; n<2; n++){
+		SkinningScene scene;
+		scene.Create(vert_nums[n], 8, n + 1);
+		SkinningPreview skin;
+		scene.Build(skin);
+		MQTEST_CHECK(skin.getVertexCount() == vert_nums[n]);
+
+		std::vector<float> palette;
+		MQTEST_CHECK(SkinningPreview::buildPalette(scene.snapshot, palette) == 9);
+		std::vector<MQPoint> simd, scalar, reference;
+		skin.deform(palette, simd, SkinningPreview::MODE_LINEAR, 4);
+		skin.deform(palette, scalar, SkinningPreview::MODE_LINEAR, 4, false);
+		scene.GetLinearReference(reference);
+		MQTEST_CHECK(GetMaxDiff(simd, scalar) < 1e-4f);
+		MQTEST_CHECK(GetMaxDiff(scalar, reference) < 1e-4f);
+		scene.Delete();
+	}
+	MQTestBonePlugin::Uninstall();
+	return failures;
+}
+
+// The AVX2 path and the scalar path agree, and vertices with at most one
+// weight are moved rigidly as in the linear blend
+// AVX2版とスカラー版が一致し、ウェイトが1つ以下の頂点は線形ブレンドと
+// 同じく剛体変換される
+MQTEST(skinning_dual_quaternion)
+{
+	int failures = 0;
+	MQTestBonePlugin::Install();
+	const int vert_nums[2] = { 1003, 40005 };
+	for(int n=0; n<2; n++){
+		SkinningScene scene;
+		scene.Create(vert_nums[n], 8, n + 11);
+		SkinningPreview skin;
+		scene.Build(skin);
+
+		std::vector<float> palette;
+		MQTEST_CHECK(SkinningPreview::buildPalette(scene.snapshot, palette, SkinningPreview::MODE_DUAL_QUATERNION) == 9);
+		MQTEST_CHECK(palette.size() == 9 * SkinningPreview::DQ_PALETTE_STRIDE);
+		std::vector<MQPoint> simd, scalar, reference;
+		skin.deform(palette, simd, SkinningPreview::MODE_DUAL_QUATERNION, 4);
+		skin.deform(palette, scalar, SkinningPreview::MODE_DUAL_QUATERNION, 4, false);
+		MQTEST_CHECK(GetMaxDiff(simd, scalar) < 1e-4f);
+
+		scene.GetLinearReference(reference);
+		MQTestBonePlugin& bp = MQTestBonePlugin::Get();
+		float rigid_diff = 0.0f;
+		int rigid_num = 0;
+		for(int v=0; v<vert_nums[n]; v++){
+			auto it = bp.weights.find(scene.obj->GetVertexUniqueID(v));
+			if(it != bp.weights.end() && it->second.size() > 1) continue;
+			rigid_diff = (std::max)(rigid_diff, GetSize(scalar[v] - reference[v]));
+			rigid_num++;
+		}
+		MQTEST_CHECK(rigid_num > 0);
+		MQTEST_CHECK(rigid_diff < 1e-4f);
+		scene.Delete();
+	}
+	MQTestBonePlugin::Uninstall();
+	return failures;
+}
+
+// MQDualQuaternion transforms points as the rigid matrix it is made from,
+// including half turns which take the other branches of setMatrix()
+// MQDualQuaternionは元の剛体行列と同じく点を変換する。setMatrix()の別の
+// 分岐を通る半回転も含む
+MQTEST(dual_quaternion_matrix)
+{
+	int failures = 0;
+	std::vector<MQAngle> angles;
+	angles.push_back(MQAngle(0.0f, 0.0f, 0.0f));
+	angles.push_back(MQAngle(180.0f, 0.0f, 0.0f));
+	angles.push_back(MQAngle(0.0f, 180.0f, 0.0f));
+	angles.push_back(MQAngle(0.0f, 0.0f, 180.0f));
+	angles.push_back(MQAngle(90.0f, 180.0f, 0.0f));
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> angle(-180.0f, 180.0f);
+	for(int i=0; i<200; i++){
+		angles.push_back(MQAngle(angle(rng), angle(rng) * 0.5f, angle(rng)));
+	}
+
+	std::uniform_real_distribution<float> coord(-10.0f, 10.0f);
+	std::vector<MQMatrix> matrices;
+	float point_diff = 0.0f, matrix_diff = 0.0f, trans_diff = 0.0f;
+	int non_rigid = 0;
+	for(size_t i=0; i<angles.size(); i++){
+		MQPoint trans(coord(rng), coord(rng), coord(rng));
+		MQMatrix mtx;
+		mtx.SetTransform(MQPoint(1.0f, 1.0f, 1.0f), angles[i], trans);
+		matrices.push_back(mtx);
+		if(!MQDualQuaternion::isRigid(mtx)) non_rigid++;
+
+		MQDualQuaternion dq(mtx);
+		for(int k=0; k<4; k++){
+			MQPoint p(coord(rng), coord(rng), coord(rng));
+			point_diff = (std::max)(point_diff, GetSize(dq.transform(p) - TransformPoint(mtx, p)));
+		}
+		MQMatrix back = dq.getMatrix();
+		for(int e=0; e<16; e++){
+			matrix_diff = (std::max)(matrix_diff, fabsf(back.t[e] - mtx.t[e]));
+		}
+		trans_diff = (std::max)(trans_diff, GetSize(dq.getTranslation() - trans));
+	}
+	MQTEST_CHECK(non_rigid == 0);
+	MQTEST_CHECK(point_diff < 1e-4f);
+	MQTEST_CHECK(matrix_diff < 1e-5f);
+	MQTEST_CHECK(trans_diff < 1e-5f);
+
+	// The palette holds the same quaternions
+	// パレットには同じクォータニオンが入る
+	std::vector<float> palette(matrices.size() * 8);
+	MQDualQuaternion::toPalette(matrices.data(), matrices.size(), palette.data());
+	int palette_diff = 0;
+	for(size_t i=0; i<matrices.size(); i++){
+		MQDualQuaternion dq(matrices[i]);
+		for(int k=0; k<4; k++){
+			if(palette[i*8 + k] != dq.real[k] || palette[i*8 + 4 + k] != dq.dual[k]) palette_diff++;
+		}
+	}
+	MQTEST_CHECK(palette_diff == 0);
+
+	// Scaling is not rigid, and is ignored by setMatrix()
+	// 拡大縮小は剛体ではなく、setMatrix()では無視される
+	MQMatrix scaled;
+	scaled.SetTransform(MQPoint(2.0f, 1.0f, 1.0f), angles[5], MQPoint(1.0f, 2.0f, 3.0f));
+	MQMatrix rigid;
+	rigid.SetTransform(MQPoint(1.0f, 1.0f, 1.0f), angles[5], MQPoint(1.0f, 2.0f, 3.0f));
+	MQTEST_CHECK(!MQDualQuaternion::isRigid(scaled));
+	MQPoint p(1.0f, -2.0f, 0.5f);
+	MQTEST_CHECK(GetSize(MQDualQuaternion(scaled).transform(p) - TransformPoint(rigid, p)) < 1e-4f);
+	return failures;
+}
@@ -0,0 +1,213 @@
+﻿//---------------------------------------------------------------------------
+//
+//   TestSymmetry.cpp
+//
+//     Tests of MQSymmetryTable on a mirrored grid whose pairs are known.
+//    　対が分かっている鏡像の格子でMQSymmetryTableをテストする。
+//
+//---------------------------------------------------------------------------
+
+#include "MQTest.h"
+#include "MQSymmetry.h"
+#include <random>
+#include <algorithm>
+#include <cfloat>
+
+
+struct MirroredGrid
+{
+	struct Cell {
+		std::vector<int> vert;
+		int ix, iy;
+	};
+
+	int N, M;
+	MQObject obj;
+	// Faces of the object in the same order
+	// オブジェクトの面と同じ順序
+	std::vector<Cell> cells;
+	std::vector<MQSymmetryTable::SymmetrySide> expected_side;
+	std::vector<int> expected_pair;
+	std::vector<int> ref_count;
+	int unused;
+};
+
+// A grid mirrored on the YZ plane with small errors. Vertices in column ix
+// pair with column -ix, and cells in column ix pair with column -ix-1.
+// Some cells on the minus side are removed, faces are shuffled and start at
+// random apexes, and a few vertices and faces have no mirror.
+// 小さな誤差を持つYZ平面で鏡像の格子。列ixの頂点は列-ixと、列ixのセルは
+// 列-ix-1と対になる。マイナス側のセルをいくつか取り除き、面の順序と
+// 開始頂点をばらばらにし、鏡像を持たない頂点と面をいくつか加える。
+static void CreateMirroredGrid(MirroredGrid& mg)
+{
+	const int N = 12, M = 10;
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> err(-0.01f, 0.01f);
+
+	mg.N = N;
+	mg.M = M;
+	mg.obj = MQ_CreateObject();
+	MQObject obj = mg.obj;
+	std::vector<int> grid((2*N+1)*(M+1));
+	for(int iy=0; iy<=M; iy++){
+		for(int ix=0; ix<=N; ix++){
+			MQPoint p((float)ix + err(rng), (float)iy + err(rng), err(rng)*20.0f);
+			if(ix == 0){
+				p.x = 0.0f;
+				grid[iy*(2*N+1)+N] = obj->AddVertex(p);
+				mg.expected_side.push_back(MQSymmetryTable::SideCenter);
+				mg.expected_pair.push_back(-1);
+				continue;
+			}
+			MQPoint q(-p.x + err(rng)*0.1f, p.y + err(rng)*0.1f, p.z + err(rng)*0.1f);
+			int vp = obj->AddVertex(p);
+			int vm = obj->AddVertex(q);
+			grid[iy*(2*N+1)+N+ix] = vp;
+			grid[iy*(2*N+1)+N-ix] = vm;
+			mg.expected_side.push_back(MQSymmetryTable::SidePlus);
+			mg.expected_side.push_back(MQSymmetryTable::SideMinus);
+			mg.expected_pair.push_back(vm);
+			mg.expected_pair.push_back(vp);
+		}
+	}
+	int lone[2];
+	lone[0] = obj->AddVertex(MQPoint((float)N + 5.0f, 0.0f, 0.0f));
+	lone[1] = obj->AddVertex(MQPoint((float)N + 5.0f, 1.0f, 0.0f));
+	for(int k=0; k<2; k++){
+		mg.expected_side.push_back(MQSymmetryTable::SidePlus);
+		mg.expected_pair.push_back(-1);
+	}
+
+	for(int iy=0; iy<M; iy++){
+		for(int ix=-N; ix<N; ix++){
+			if(ix < 0 && (ix*7+iy) % 5 == 0) continue;
+			MirroredGrid::Cell cell;
+			cell.ix = ix;
+			cell.iy = iy;
+			cell.vert.push_back(grid[iy*(2*N+1)+N+ix]);
+			cell.vert.push_back(grid[iy*(2*N+1)+N+ix+1]);
+			cell.vert.push_back(grid[(iy+1)*(2*N+1)+N+ix+1]);
+			cell.vert.push_back(grid[(iy+1)*(2*N+1)+N+ix]);
+			std::rotate(cell.vert.begin(), cell.vert.begin() + rng() % 4, cell.vert.end());
+			mg.cells.push_back(cell);
+		}
+	}
+	MirroredGrid::Cell extra;
+	extra.ix = N;
+	extra.iy = 0;
+	extra.vert.push_back(grid[N+N]);
+	extra.vert.push_back(lone[0]);
+	extra.vert.push_back(lone[1]);
+	mg.cells.push_back(extra);
+	std::shuffle(mg.cells.begin(), mg.cells.end(), rng);
+	for(size_t i=0; i<mg.cells.size(); i++){
+		obj->AddFace((int)mg.cells[i].vert.size(), mg.cells[i].vert.data());
+	}
+
+	// Vertices left without faces by the removed cells are ignored, and
+	// their mirrors have no pair.
+	// 取り除いたセルで面が無くなった頂点は無視され、その鏡像は対を持たない。
+	mg.ref_count.assign(obj->GetVertexCount(), 0);
+	for(size_t i=0; i<mg.cells.size(); i++){
+		for(size_t j=0; j<mg.cells[i].vert.size(); j++) mg.ref_count[mg.cells[i].vert[j]]++;
+	}
+	mg.unused = 0;
+	for(int v=0; v<obj->GetVertexCount(); v++){
+		if(mg.ref_count[v] > 0) continue;
+		if(mg.expected_pair[v] >= 0) mg.expected_pair[mg.expected_pair[v]] = -1;
+		mg.expected_pair[v] = -1;
+		mg.expected_side[v] = MQSymmetryTable::SideNone;
+		mg.unused++;
+	}
+}
+
+
+// InitVertexTable() finds the known vertex pairs, for an object and for
+// points
+MQTEST(symmetry_vertex)
+{
+	int failures = 0;
+	const float mindis = 0.1f;
+	MirroredGrid mg;
+	CreateMirroredGrid(mg);
+	MQObject obj = mg.obj;
+	MQTEST_CHECK(mg.unused > 0);
+
+	std::vector<MQSymmetryTable> vert_table;
+	int vert_pairs = MQSymmetryTable::InitVertexTable(obj, vert_table, nullptr, mindis, MQSymmetryTable::AxisX);
+	MQTEST_CHECK(vert_pairs == mg.N*(mg.M+1) - mg.unused);
+	MQTEST_CHECK((int)vert_table.size() == obj->GetVertexCount());
+	int vert_diff = 0;
+	for(int v=0; v<obj->GetVertexCount(); v++){
+		if(vert_table[v].side != mg.expected_side[v]) vert_diff++;
+		if(mg.expected_side[v] != MQSymmetryTable::SideCenter && vert_table[v].index != mg.expected_pair[v]) vert_diff++;
+	}
+	MQTEST_CHECK(vert_diff == 0);
+
+	std::vector<MQPoint> pts(obj->GetVertexCount());
+	obj->GetVertexArray(pts.data());
+	for(int v=0; v<obj->GetVertexCount(); v++){
+		if(mg.ref_count[v] == 0) pts[v] = MQPoint(FLT_MAX, FLT_MAX, FLT_MAX);
+	}
+	std::vector<MQSymmetryTable> pts_table;
+	MQTEST_CHECK(MQSymmetryTable::InitVertexTable(pts, pts_table, nullptr, mindis, MQSymmetryTable::AxisX) == vert_pairs);
+	int pts_diff = 0;
+	for(size_t v=0; v<pts_table.size(); v++){
+		if(pts_table[v].side != vert_table[v].side || pts_table[v].index != vert_table[v].index) pts_diff++;
+	}
+	MQTEST_CHECK(pts_diff == 0);
+
+	obj->DeleteThis();
+	return failures;
+}
+
+// InitFaceTable() pairs a face with the face of the mirrored cell if it
+// remains, and the pair has the mirrored vertices in the reverse order
+// starting at apex0
+MQTEST(symmetry_face)
+{
+	int failures = 0;
+	const float mindis = 0.1f;
+	MirroredGrid mg;
+	CreateMirroredGrid(mg);
+	MQObject obj = mg.obj;
+	const std::vector<MirroredGrid::Cell>& cells = mg.cells;
+
+	std::vector<MQSymmetryTable> vert_table;
+	MQSymmetryTable::InitVertexTable(obj, vert_table, nullptr, mindis, MQSymmetryTable::AxisX);
+	std::vector<MQSymmetryFaceTable> face_table;
+	int face_pairs = MQSymmetryTable::InitFaceTable(obj, face_table, nullptr, vert_table, mindis);
+	int expected_face_pairs = 0;
+	int face_diff = 0;
+	for(size_t f=0; f<cells.size(); f++){
+		const MirroredGrid::Cell& cell = cells[f];
+		int mirror = -1;
+		for(size_t g=0; g<cells.size(); g++){
+			if(cells[g].ix == -cell.ix-1 && cells[g].iy == cell.iy && cells[g].vert.size() == cell.vert.size()) mirror = (int)g;
+		}
+		if(mirror >= 0 && cell.ix >= 0) expected_face_pairs++;
+
+		const MQSymmetryFaceTable& ft = face_table[f];
+		if(ft.index != mirror){
+			face_diff++;
+			continue;
+		}
+		if(mirror < 0) continue;
+		MQSymmetryTable::SymmetrySide side = (cell.ix >= 0) ? MQSymmetryTable::SidePlus : MQSymmetryTable::SideMinus;
+		if(ft.side != side || face_table[mirror].index != (int)f || face_table[mirror].apex0 != ft.apex0) face_diff++;
+
+		int count = (int)cell.vert.size();
+		for(int j=0; j<count; j++){
+			const MQSymmetryTable& vt = vert_table[cell.vert[j]];
+			int symvert = (vt.side == MQSymmetryTable::SideCenter) ? cell.vert[j] : vt.index;
+			if(cells[mirror].vert[(count+ft.apex0-j) % count] != symvert) face_diff++;
+		}
+	}
+	MQTEST_CHECK(face_diff == 0);
+	MQTEST_CHECK(face_pairs == expected_face_pairs);
+	MQTEST_CHECK(expected_face_pairs > 0 && expected_face_pairs < mg.N*mg.M);
+
+	obj->DeleteThis();
+	return failures;
+}